@@ -0,0 +1,210 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_random.h>
+#include <cJSON.h>
+
+#include "network/mqtt.h"
+#include "nvsManager.h"
+#include "output.h"
+#include "utils/jsonWriter.h"
+
+/**
+ * Group command stagger mode
+ */
+typedef enum {
+	/// Commands are executed immediately
+	GROUP_STAGGER_NONE = 0,
+	/// Commands are delayed by a random time up to the stagger interval
+	GROUP_STAGGER_RANDOM = 1,
+	/// Commands are delayed by the slot index multiplied by the stagger interval
+	GROUP_STAGGER_SLOTTED = 2,
+} group_stagger_mode_t;
+
+/**
+ * Group command stagger configuration
+ */
+typedef struct GroupStagger {
+	/// Stagger mode
+	group_stagger_mode_t mode;
+	/// Stagger interval in milliseconds
+	uint32_t interval;
+	/// Slot index of this PDU in the slotted mode
+	uint8_t slot;
+} groupStagger_t;
+
+/**
+ * Fleet-wide PDU groups
+ * The PDU is a member of groups identified by tags stored in NVS and subscribes to `sbc_pdu/groups/<tag>/command`.
+ * Command: `{"action": "powerCycle", "outputs": [1, 2], "delay": 1000}`, omitted `outputs` selects all outputs.
+ * Enabling edges of the commands are delayed by the stagger to spread the inrush current of the member PDUs.
+ */
+class GroupManager {
+	public:
+		/**
+		 * Loads the group configuration from NVS, has to be called before any other method
+		 */
+		static void init();
+
+		/**
+		 * Binds the group commands to the MQTT client and subscribes to the group topics
+		 * @param mqtt MQTT client
+		 * @param outputs Output map <index, pointer to output>
+		 */
+		static void attach(Mqtt *mqtt, std::map<uint8_t, Output*> *outputs);
+
+		/**
+		 * Sets the configuration from JSON object `{"tags": ["rack1"], "stagger": {"mode": "slotted", "interval": 500, "slot": 2}}`
+		 * Both properties are optional, nothing is changed if any of them is invalid.
+		 * @param config JSON object with the configuration
+		 * @return Execution status
+		 */
+		static esp_err_t configure(const cJSON *config);
+
+		/**
+		 * Writes the JSON object with the configuration
+		 * @param writer JSON writer
+		 */
+		static void writeJson(JsonWriter &writer);
+
+		/**
+		 * Returns the group tags
+		 * @return Group tags
+		 */
+		static std::vector<std::string> getTags();
+
+		/**
+		 * Returns the stagger configuration
+		 * @return Stagger configuration
+		 */
+		static groupStagger_t getStagger();
+
+		/**
+		 * Group configuration MQTT message callback
+		 * @param event MQTT event
+		 */
+		static void configCallback(esp_mqtt_event_handle_t event);
+
+		/**
+		 * Group command MQTT message callback
+		 * Retained commands are ignored, they would be executed again on every reconnection.
+		 * @param event MQTT event
+		 */
+		static void commandCallback(esp_mqtt_event_handle_t event);
+
+		/// Base topic of the groups
+		static constexpr const char *BASE_TOPIC = "sbc_pdu/groups/";
+
+	private:
+		/**
+		 * Group command context
+		 */
+		struct Command {
+			/// Outputs to switch
+			std::vector<Output*> outputs;
+			/// Command action (enable, disable, toggle, powerCycle)
+			std::string action;
+			/// Power cycle delay in milliseconds
+			uint32_t delay;
+			/// Stagger delay in milliseconds
+			uint32_t stagger;
+		};
+
+		/**
+		 * Executes the command, the power cycle enables the outputs
+		 * @param command Command context
+		 */
+		static void execute(const Command &command);
+
+		/**
+		 * Command task - executes the command after the stagger delay
+		 * @param arg Pointer to the command context
+		 */
+		static void commandTask(void *arg);
+
+		/**
+		 * Returns the stagger delay of the next command
+		 * @return Stagger delay in milliseconds
+		 */
+		static uint32_t getStaggerDelay();
+
+		/**
+		 * Is the tag valid? Tags may contain only alphanumeric characters, `-` and `_`.
+		 * @param tag Tag
+		 * @return true Tag is valid
+		 * @return false Tag is invalid
+		 */
+		static bool isValidTag(std::string_view tag);
+
+		/**
+		 * Returns the command topic of the group
+		 * @param tag Group tag
+		 * @return Command topic
+		 */
+		static std::string getCommandTopic(const std::string &tag);
+
+		/**
+		 * Updates the command topic subscriptions, must not be called with the mutex taken
+		 * @param removedTags Tags to unsubscribe
+		 * @param addedTags Tags to subscribe
+		 */
+		static void updateSubscriptions(const std::vector<std::string> &removedTags, const std::vector<std::string> &addedTags);
+
+		/**
+		 * Stores the configuration into NVS, has to be called with the mutex taken
+		 * @return Execution status
+		 */
+		static esp_err_t store();
+
+		/// Maximal number of groups
+		static constexpr size_t MAX_TAGS = 8;
+		/// Maximal length of the tag
+		static constexpr size_t MAX_TAG_LENGTH = 32;
+		/// Maximal stagger interval in milliseconds
+		static constexpr uint32_t MAX_STAGGER_INTERVAL = 10000;
+		/// Maximal power cycle delay in milliseconds
+		static constexpr uint32_t MAX_POWER_CYCLE_DELAY = 60000;
+		/// Default power cycle delay in milliseconds
+		static constexpr uint32_t DEFAULT_POWER_CYCLE_DELAY = 1000;
+		/// Stagger mode names indexed by the stagger mode
+		static constexpr const char *STAGGER_MODE_NAMES[] = {"none", "random", "slotted"};
+		/// Group tags
+		static std::vector<std::string> tags;
+		/// Stagger configuration
+		static groupStagger_t stagger;
+		/// Pointer to the MQTT client
+		static Mqtt *mqtt;
+		/// Output map <index, pointer to output>
+		static std::map<uint8_t, Output*> *outputs;
+		/// Mutex
+		static SemaphoreHandle_t mutex;
+		/// Logger tag
+		static constexpr const char *TAG = "GroupManager";
+};
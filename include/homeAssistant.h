@@ -15,13 +15,18 @@
  */
 #pragma once
 
+#include <algorithm>
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <esp_ota_ops.h>
 #include <cJSON.h>
 
+#include "nvsManager.h"
 #include "network/hostname.h"
 #include "network/mqtt.h"
 #include "network/wifi.h"
@@ -35,6 +40,30 @@ typedef struct HomeAssistantSensor {
 	std::string unitOfMeasurement;
 } haSensor_t;
 
+/**
+ * Home Assistant discovery mode
+ */
+typedef enum {
+	/// One discovery message per entity
+	HA_DISCOVERY_ENTITY = 0,
+	/// One device discovery message with all entities as components
+	HA_DISCOVERY_DEVICE = 1,
+} ha_discovery_mode_t;
+
+/**
+ * Cached Home Assistant discovery message
+ */
+typedef struct HomeAssistantDiscovery {
+	/// Discovery topic
+	std::string topic;
+	/// Rendered discovery payload
+	std::string payload;
+	/// Hash of the rendered payload
+	uint32_t hash;
+	/// Hash of the last published payload, 0 if the payload was not published yet
+	uint32_t publishedHash;
+} haDiscovery_t;
+
 /**
  * Home Assistant MQTT client
  */
@@ -54,13 +83,48 @@ class HomeAssistant {
 		 */
 		static void connectCallback(Mqtt* client, esp_event_base_t base, esp_mqtt_event_handle_t event);
 
-		static void advertise(Mqtt *mqtt);
+		/**
+		 * Home Assistant status (birth message) MQTT message callback
+		 * All discovery messages are re-announced when Home Assistant comes online.
+		 * @param event MQTT event
+		 */
+		static void statusCallback(esp_mqtt_event_handle_t event);
 
-		static void advertiseAlert(Mqtt *mqtt, Output *output, cJSON *device);
+		/**
+		 * Publishes cached discovery messages
+		 * A message is marked as published only when it was handed to the client, deferred messages are published again next time.
+		 * @param mqtt MQTT client
+		 * @param force Publish all messages, not only the changed ones
+		 */
+		static void advertise(Mqtt *mqtt, bool force = false);
 
-		static void advertiseSensors(Mqtt *mqtt, Output *output, cJSON *device);
+		/**
+		 * Renders discovery messages of all outputs into the cache
+		 */
+		static void render();
 
-		static void advertiseSwitch(Mqtt *mqtt, Output *output, cJSON *device);
+		/**
+		 * Re-renders discovery messages and publishes the changed ones, has to be called after an input of the messages changes
+		 */
+		static void update();
+
+		/**
+		 * Returns the discovery mode
+		 * @return Discovery mode
+		 */
+		static ha_discovery_mode_t getMode();
+
+		/**
+		 * Sets and stores the discovery mode, messages of the previous mode are removed
+		 * @param mode Discovery mode
+		 */
+		static void setMode(ha_discovery_mode_t mode);
+
+		/**
+		 * Hostname change callback
+		 * @param hostname New hostname
+		 */
+		static void hostnameCallback(const std::string &hostname);
 
 	protected:
 		/// Base MQTT topic
@@ -68,8 +132,94 @@ class HomeAssistant {
 		/// Output map <index, pointer to output>
 		static std::map<uint8_t, Output*> *outputs;
 	private:
+		/**
+		 * Renders device discovery message with components of all outputs into the cache
+		 * Abbreviated configuration keys are used to keep the message compact.
+		 */
+		static void renderDevice();
+
+		/**
+		 * Renders output alert discovery message into the cache
+		 * @param output Pointer to the output
+		 * @param device Device object
+		 */
+		static void renderAlert(Output *output, cJSON *device);
+
+		/**
+		 * Renders output sensor discovery messages into the cache
+		 * @param output Pointer to the output
+		 * @param device Device object
+		 */
+		static void renderSensors(Output *output, cJSON *device);
+
+		/**
+		 * Renders output switch discovery message into the cache
+		 * @param output Pointer to the output
+		 * @param device Device object
+		 */
+		static void renderSwitch(Output *output, cJSON *device);
+
+		/**
+		 * Returns the discovery topic of the output entity
+		 * @param component Entity component (platform)
+		 * @param output Pointer to the output
+		 * @param entity Entity suffix of the unique ID
+		 * @return Discovery topic
+		 */
+		static std::string getEntityTopic(const std::string &component, Output *output, const std::string &entity);
+
+		/**
+		 * Returns the device discovery topic
+		 * @return Discovery topic
+		 */
+		static std::string getDeviceTopic();
+
+		/**
+		 * Collects discovery topics of the previously advertised mode, they are cleared on the next advertisement
+		 * @param mode Previously advertised discovery mode
+		 */
+		static void collectObsoleteTopics(ha_discovery_mode_t mode);
+
+		/**
+		 * Publishes empty retained messages to the obsolete discovery topics and stores the advertised mode when all were published
+		 * @param mqtt MQTT client
+		 */
+		static void removeObsolete(Mqtt *mqtt);
+
+		/**
+		 * Stores the rendered discovery message into the cache
+		 * @param topic Discovery topic
+		 * @param root Discovery message, the device object is detached and the message is deleted
+		 */
+		static void cache(const std::string &topic, cJSON *root);
+
+		/**
+		 * Computes the digest of all cached discovery topics and payload hashes, the mutex has to be held
+		 * @return Digest
+		 */
+		static uint32_t getDigest();
+
+		/**
+		 * Computes FNV-1a hash of the data
+		 * @param data Data
+		 * @return Hash
+		 */
+		static uint32_t hash(std::string_view data);
+
+		/// Home Assistant status topic
+		static constexpr const char *STATUS_TOPIC = "homeassistant/status";
 		/// Pointer to the MQTT client
-		Mqtt *mqtt;
+		static Mqtt *mqtt;
+		/// Mutex protecting the discovery cache, the mode and the obsolete topics, the MQTT client must not be called while it is held
+		static SemaphoreHandle_t mutex;
+		/// Discovery mode
+		static ha_discovery_mode_t mode;
+		/// Discovery topics of the previously advertised mode waiting for removal
+		static std::vector<std::string> obsoleteTopics;
+		/// Output sensors
+		static const std::vector<haSensor_t> sensors;
+		/// Discovery message cache
+		static std::vector<haDiscovery_t> discoveryCache;
 		/// Logger tag
 		constexpr static const char *TAG = "HomeAssistant";
 };
@@ -0,0 +1,100 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <map>
+#include <string>
+#include <string_view>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_err.h>
+#include <esp_log.h>
+#include <cJSON.h>
+
+#include "nvsManager.h"
+
+/**
+ * Runtime log level manager
+ * Log levels are stored in NVS as `tag=level` pairs separated by `;`, tag `*` sets the default level.
+ */
+class LogManager {
+	public:
+		/**
+		 * Applies log levels stored in NVS, has to be called before any other method
+		 */
+		static void init();
+
+		/**
+		 * Sets the log level of the tag
+		 * @param tag Logger tag, `*` sets the default level
+		 * @param level Log level
+		 * @param persist Store the level into NVS
+		 * @return Execution status
+		 */
+		static esp_err_t setLevel(const std::string &tag, esp_log_level_t level, bool persist = true);
+
+		/**
+		 * Sets log levels from JSON object `{"tag": "level"}`, no level is set if any entry is invalid
+		 * @param levels JSON object with log levels
+		 * @return Execution status
+		 */
+		static esp_err_t setLevels(const cJSON *levels);
+
+		/**
+		 * Returns configured log levels
+		 * @return Log levels <tag, level>
+		 */
+		static std::map<std::string, esp_log_level_t> getLevels();
+
+		/**
+		 * Parses the log level name
+		 * Levels above CONFIG_LOG_MAXIMUM_LEVEL are rejected, their messages are removed from the firmware at build time.
+		 * @param name Log level name (none, error, warn, info, debug, verbose)
+		 * @param level Parsed log level
+		 * @return true Log level name is valid
+		 * @return false Log level name is invalid or the level is not compiled into the firmware
+		 */
+		static bool parseLevel(std::string_view name, esp_log_level_t &level);
+
+		/**
+		 * Returns the log level name
+		 * @param level Log level
+		 * @return Log level name
+		 */
+		static const char *getLevelName(esp_log_level_t level);
+
+		/// Maximal log level compiled into the firmware
+		static constexpr esp_log_level_t MAXIMUM_LEVEL = static_cast<esp_log_level_t>(CONFIG_LOG_MAXIMUM_LEVEL);
+
+	private:
+		/**
+		 * Stores configured log levels into NVS
+		 * @return Execution status
+		 */
+		static esp_err_t store();
+
+		/// Maximal length of the logger tag
+		static constexpr size_t MAX_TAG_LENGTH = 31;
+		/// Log level names indexed by the log level
+		static constexpr const char *LEVEL_NAMES[] = {"none", "error", "warn", "info", "debug", "verbose"};
+		/// Configured log levels <tag, level>
+		static std::map<std::string, esp_log_level_t> levels;
+		/// Mutex
+		static SemaphoreHandle_t mutex;
+		/// Logger tag
+		static constexpr const char *TAG = "LogManager";
+};
@@ -0,0 +1,345 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <new>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_partition.h>
+
+#include "telemetryFrame.h"
+
+/// Maximal number of outputs in the history, output indices start at 1
+#define HISTORY_MAX_OUTPUTS 7
+
+/**
+ * Resolution tier of the measurement history
+ */
+typedef enum {
+	/// 1 s points kept in RAM
+	HISTORY_TIER_SECOND = 0,
+	/// 1 min points kept in the flash partition
+	HISTORY_TIER_MINUTE = 1,
+	/// 1 h points kept in the flash partition
+	HISTORY_TIER_HOUR = 2,
+	/// Number of tiers
+	HISTORY_TIER_COUNT = 3,
+} history_tier_t;
+
+/**
+ * Measurement history point of one output
+ */
+typedef struct HistoryPoint {
+	/// Unix timestamp of the period start in seconds
+	uint32_t timestamp;
+	/// Mean current in microamps
+	int32_t current;
+	/// Maximal current in microamps
+	int32_t currentMax;
+	/// Mean voltage in millivolts
+	int32_t voltage;
+} historyPoint_t;
+
+/**
+ * Rollup of the samples in one period
+ */
+typedef struct HistoryAccumulator {
+	/// Sum of currents in microamps
+	int64_t currentSum;
+	/// Sum of voltages in millivolts
+	int64_t voltageSum;
+	/// Maximal current in microamps
+	int32_t currentMax;
+	/// Number of samples
+	uint32_t count;
+} historyAccumulator_t;
+
+/**
+ * Header of the flash sector with the history records
+ */
+typedef struct __attribute__((packed)) HistorySectorHeader {
+	/// Magic number, marks an initialized sector
+	uint32_t magic;
+	/// Sequence number of the sector in the region
+	uint32_t sequence;
+	/// Unix timestamp of the first record in seconds
+	uint32_t timestamp;
+	/// Resolution of the records in seconds
+	uint32_t resolution;
+} historySectorHeader_t;
+
+/**
+ * Encoder and decoder state of the records in one flash sector
+ */
+typedef struct HistoryCodec {
+	/// Timestamp of the previous record
+	uint32_t timestamp;
+	/// Timestamp delta of the previous record
+	int32_t delta;
+	/// Previous values of the outputs <output, [current, maximal current, voltage]>
+	int32_t values[HISTORY_MAX_OUTPUTS][3];
+} historyCodec_t;
+
+/**
+ * Flash region of one tier, a ring of sectors where the oldest sector is erased when the region is full
+ */
+typedef struct HistoryRegion {
+	/// Resolution of the records in seconds
+	uint32_t resolution;
+	/// First sector of the region in the partition
+	uint32_t firstSector;
+	/// Number of sectors
+	uint32_t sectors;
+	/// Sector with the newest records, relative to the first sector
+	uint32_t head;
+	/// Sequence number of the head sector, 0 if the region is empty
+	uint32_t sequence;
+	/// Write offset in the head sector
+	uint32_t offset;
+	/// Unix timestamp of the oldest record, UINT32_MAX if the region is empty
+	uint32_t oldest;
+	/// Encoder state of the head sector
+	historyCodec_t codec;
+} historyRegion_t;
+
+/**
+ * On-device time-series store of the output measurements
+ *
+ * Samples are rolled up into 1 s, 1 min and 1 h periods with the mean current, maximal current and mean voltage.
+ * 1 s points are kept in RAM, 1 min and 1 h points are appended to two sector rings in the `history` flash partition.
+ * Each flash record consists of the bitmap of present outputs, delta-of-delta encoded timestamp and delta encoded values,
+ * all numbers are ZigZag varints, so a steady load takes a few bytes per output and minute.
+ * The retention of each tier is given by its capacity, the oldest points are dropped when the tier is full.
+ */
+class MeasurementHistory {
+	public:
+		/// History point callback, returns false to stop the query
+		typedef std::function<bool(const historyPoint_t &point)> callback_t;
+
+		/**
+		 * Finds the flash partition and recovers the state of the flash tiers
+		 * @param partitionLabel Flash partition label
+		 */
+		static void init(const char *partitionLabel = "history");
+
+		/**
+		 * Adds the samples measured at the current time
+		 * @param samples Telemetry samples
+		 */
+		static void record(const std::vector<telemetrySample_t> &samples);
+
+		/**
+		 * Selects the finest tier for the step which holds the points since the start of the range
+		 * @param output Output index
+		 * @param from Unix timestamp of the range start in seconds
+		 * @param step Requested step in seconds
+		 * @return Tier
+		 */
+		static history_tier_t selectTier(uint8_t output, uint32_t from, uint32_t step);
+
+		/**
+		 * Returns the resolution of the tier
+		 * @param tier Tier
+		 * @return Resolution in seconds
+		 */
+		static uint32_t getResolution(history_tier_t tier);
+
+		/**
+		 * Reads the completed points of the tier in the range aggregated to the step
+		 * @param tier Tier
+		 * @param output Output index
+		 * @param from Unix timestamp of the range start in seconds (inclusive)
+		 * @param to Unix timestamp of the range end in seconds (inclusive)
+		 * @param step Step in seconds, a multiple of the tier resolution
+		 * @param callback Point callback, called in chronological order without the mutex taken
+		 * @return Execution status
+		 */
+		static esp_err_t query(history_tier_t tier, uint8_t output, uint32_t from, uint32_t to, uint32_t step, const callback_t &callback);
+
+		/// Maximal number of outputs, output indices start at 1
+		static constexpr uint8_t MAX_OUTPUTS = HISTORY_MAX_OUTPUTS;
+		/// Unix timestamps before 2024-01-01 are considered as not synchronized clock
+		static constexpr uint32_t MIN_TIMESTAMP = 1704067200;
+
+	private:
+		/**
+		 * Recovers the state of the flash region
+		 * @param region Flash region
+		 * @param buffer Sector buffer
+		 */
+		static void recover(historyRegion_t &region, uint8_t *buffer);
+
+		/**
+		 * Adds the sample or the point of a finer period to the accumulator
+		 * @param accumulator Accumulator
+		 * @param point History point
+		 */
+		static void accumulate(historyAccumulator_t &accumulator, const historyPoint_t &point);
+
+		/**
+		 * Returns the point of the accumulated samples
+		 * @param accumulator Accumulator
+		 * @param timestamp Unix timestamp of the period start in seconds
+		 * @return History point
+		 */
+		static historyPoint_t toPoint(const historyAccumulator_t &accumulator, uint32_t timestamp);
+
+		/**
+		 * Completes the period of the tier and stores its points, has to be called with the mutex taken
+		 * @param tier Tier
+		 */
+		static void completePeriod(history_tier_t tier);
+
+		/**
+		 * Appends the record to the flash region, has to be called with the mutex taken
+		 * @param region Flash region
+		 * @param timestamp Unix timestamp of the period start in seconds
+		 * @param mask Bitmap of present outputs
+		 * @param points Points of the outputs, indexed by the output index - 1
+		 * @return Execution status
+		 */
+		static esp_err_t append(historyRegion_t &region, uint32_t timestamp, uint8_t mask, const historyPoint_t *points);
+
+		/**
+		 * Erases the next sector of the region and makes it the head sector, has to be called with the mutex taken
+		 * @param region Flash region
+		 * @param timestamp Unix timestamp of the first record in seconds
+		 * @return Execution status
+		 */
+		static esp_err_t openSector(historyRegion_t &region, uint32_t timestamp);
+
+		/**
+		 * Updates the timestamp of the oldest record in the region, has to be called with the mutex taken
+		 * @param region Flash region
+		 */
+		static void updateOldest(historyRegion_t &region);
+
+		/**
+		 * Reads the header of the region sector
+		 * @param region Flash region
+		 * @param sector Sector relative to the first sector of the region
+		 * @param header Sector header
+		 * @return true Sector holds the records of the region preceding the head sector
+		 * @return false Sector is erased, damaged or stale
+		 */
+		static bool readHeader(const historyRegion_t &region, uint32_t sector, historySectorHeader_t *header);
+
+		/**
+		 * Returns the address of the region sector in the partition
+		 * @param region Flash region
+		 * @param sector Sector relative to the first sector of the region
+		 * @return Address in the partition
+		 */
+		static size_t getAddress(const historyRegion_t &region, uint32_t sector);
+
+		/**
+		 * Returns the decoder state for the first record of the sector
+		 * @param header Sector header
+		 * @return Decoder state
+		 */
+		static historyCodec_t createCodec(const historySectorHeader_t &header);
+
+		/**
+		 * Encodes the record
+		 * @param codec Encoder state
+		 * @param timestamp Unix timestamp of the period start in seconds
+		 * @param mask Bitmap of present outputs
+		 * @param points Points of the outputs, indexed by the output index - 1
+		 * @param buffer Output buffer of MAX_RECORD_SIZE bytes
+		 * @return Length of the encoded record
+		 */
+		static size_t encode(historyCodec_t &codec, uint32_t timestamp, uint8_t mask, const historyPoint_t *points, uint8_t *buffer);
+
+		/**
+		 * Decodes the next record
+		 * @param codec Decoder state
+		 * @param data Sector data
+		 * @param size Sector data size
+		 * @param offset Offset of the record, moved behind the decoded record
+		 * @param mask Bitmap of present outputs
+		 * @return true Record was decoded
+		 * @return false End of the records or damaged record
+		 */
+		static bool decode(historyCodec_t &codec, const uint8_t *data, size_t size, size_t &offset, uint8_t &mask);
+
+		/**
+		 * Reads the points of the output from the RAM tier in the range
+		 * @param output Output index
+		 * @param from Unix timestamp of the range start in seconds
+		 * @param to Unix timestamp of the range end in seconds
+		 * @param callback Point callback
+		 * @return Execution status
+		 */
+		static esp_err_t querySeconds(uint8_t output, uint32_t from, uint32_t to, const callback_t &callback);
+
+		/**
+		 * Reads the points of the output from the flash region in the range
+		 * @param region Flash region
+		 * @param output Output index
+		 * @param from Unix timestamp of the range start in seconds
+		 * @param to Unix timestamp of the range end in seconds
+		 * @param callback Point callback
+		 * @return Execution status
+		 */
+		static esp_err_t queryRegion(historyRegion_t &region, uint8_t output, uint32_t from, uint32_t to, const callback_t &callback);
+
+		/**
+		 * Returns the Unix timestamp of the oldest point of the tier
+		 * @param tier Tier
+		 * @param output Output index
+		 * @return Unix timestamp in seconds, UINT32_MAX if the tier is empty
+		 */
+		static uint32_t getOldest(history_tier_t tier, uint8_t output);
+
+		/// Capacity of the RAM tier in points per output
+		static constexpr size_t SECONDS_CAPACITY = 300;
+		/// Share of the partition sectors for the 1 min tier in percent
+		static constexpr uint32_t MINUTE_SHARE = 75;
+		/// Maximal size of the encoded record
+		static constexpr size_t MAX_RECORD_SIZE = 1 + 5 + MAX_OUTPUTS * 3 * 5;
+		/// Sector header magic number
+		static constexpr uint32_t MAGIC = 0x48554450;
+		/// Resolutions of the tiers in seconds
+		static constexpr uint32_t RESOLUTIONS[HISTORY_TIER_COUNT] = {1, 60, 3600};
+		/// Flash partition
+		static const esp_partition_t *partition;
+		/// Flash regions of the 1 min and 1 h tiers
+		static historyRegion_t regions[HISTORY_TIER_COUNT - 1];
+		/// RAM tier <output index - 1, ring of points>
+		static historyPoint_t *seconds[MAX_OUTPUTS];
+		/// Slot of the next point in the RAM tier rings
+		static size_t secondsHead[MAX_OUTPUTS];
+		/// Number of points in the RAM tier rings
+		static size_t secondsCount[MAX_OUTPUTS];
+		/// Accumulators of the current periods <tier, output index - 1>
+		static historyAccumulator_t accumulators[HISTORY_TIER_COUNT][MAX_OUTPUTS];
+		/// Unix timestamps of the current periods, 0 if no sample was added
+		static uint32_t periods[HISTORY_TIER_COUNT];
+		/// Mutex
+		static SemaphoreHandle_t mutex;
+		/// Logger tag
+		static constexpr const char *TAG = "MeasurementHistory";
+};
@@ -0,0 +1,185 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_random.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+
+#include "network/mqtt.h"
+#include "sbcPduManagement.h"
+#include "telemetryBuffer.h"
+#include "telemetryFrame.h"
+#include "utils/jsonWriter.h"
+
+/**
+ * MQTT benchmark result
+ */
+typedef struct MqttBenchmarkResult {
+	/// Number of synthetic outputs
+	size_t outputs;
+	/// Requested duration in seconds
+	uint32_t duration;
+	/// Telemetry payload format
+	payload_format_t format;
+	/// Time of the benchmark start in microseconds
+	int64_t startedAt;
+	/// Elapsed time in microseconds
+	int64_t elapsed;
+	/// Number of published or queued messages
+	uint32_t messages;
+	/// Number of published or queued payload bytes
+	uint64_t bytes;
+	/// Number of messages which were not published
+	uint32_t failed;
+	/// Number of messages which were not published because the client was disconnected
+	uint32_t lost;
+	/// Number of lost broker connections during the benchmark
+	uint32_t disconnects;
+	/// Number of reconnections to the broker during the benchmark
+	uint32_t reconnects;
+	/// Total latency of the reconnections during the benchmark in microseconds
+	int64_t reconnectTime;
+	/// Maximal reconnection latency during the benchmark in microseconds
+	int64_t maxReconnectLatency;
+	/// Number of queued telemetry messages of the benchmarked clients dropped during the benchmark
+	uint32_t dropped;
+	/// Number of messages of the benchmarked clients deleted from the client outbox without acknowledgement during the benchmark
+	uint32_t expired;
+	/// Free heap at the benchmark start in bytes
+	uint32_t heapStart;
+	/// Lowest free heap observed during the benchmark in bytes
+	uint32_t heapMinimum;
+	/// Unused stack of the benchmark task in bytes
+	uint32_t stackHighWater;
+} mqttBenchmarkResult_t;
+
+/**
+ * On-device MQTT load benchmark
+ * Publishes telemetry of synthetic outputs through the same code paths and clients as the real telemetry,
+ * every 500 ms (the measurement period of the main loop). Text telemetry is published to `sbc_pdu/<MAC>/benchmark/<index>/...`,
+ * CBOR frames to `sbc_pdu/<MAC>/benchmark/telemetry`, so the real output topics and Home Assistant entities are not affected.
+ */
+class MqttBenchmark {
+	public:
+		/**
+		 * Initializes the benchmark, has to be called before any other method
+		 */
+		static void init();
+
+		/**
+		 * Starts the benchmark in a background task
+		 * @param outputs Number of synthetic outputs
+		 * @param duration Duration in seconds
+		 * @return Execution status, ESP_ERR_INVALID_ARG if the parameters are out of range, ESP_ERR_INVALID_STATE if the benchmark is running
+		 */
+		static esp_err_t start(size_t outputs, uint32_t duration);
+
+		/**
+		 * Is the benchmark running?
+		 * @return true Benchmark is running
+		 * @return false Benchmark is not running
+		 */
+		static bool isRunning();
+
+		/**
+		 * Writes the JSON object with the result of the running or the last benchmark
+		 * @param writer JSON writer
+		 */
+		static void writeJson(JsonWriter &writer);
+
+		/**
+		 * Writes the properties of the benchmark result into the currently open JSON object
+		 * @param writer JSON writer
+		 */
+		static void writeProperties(JsonWriter &writer);
+
+		/// Minimal number of synthetic outputs
+		static constexpr size_t MIN_OUTPUTS = 3;
+		/// Maximal number of synthetic outputs
+		static constexpr size_t MAX_OUTPUTS = 64;
+		/// Maximal duration in seconds
+		static constexpr uint32_t MAX_DURATION = 300;
+
+	private:
+		/**
+		 * Benchmark task
+		 * @param arg Task argument
+		 */
+		static void task(void *arg);
+
+		/**
+		 * Publishes one measurement period of all synthetic outputs
+		 * @param frameBuffer CBOR frame buffer
+		 * @param outputs Number of synthetic outputs
+		 * @param period Measurement period index
+		 */
+		static void publishPeriod(std::vector<uint8_t> &frameBuffer, size_t outputs, uint32_t period);
+
+		/**
+		 * Records the result of the publication
+		 * @param msgId Message ID, negative if the message was not published
+		 * @param length Payload length
+		 */
+		static void record(int msgId, size_t length);
+
+		/**
+		 * Records the messages which were not published because the client was disconnected
+		 * @param count Number of messages
+		 */
+		static void recordLost(uint32_t count);
+
+		/**
+		 * Returns the summed connection statistics of the benchmarked clients
+		 * @return Connection statistics
+		 */
+		static mqttConnectionStatistics_t getConnectionStatistics();
+
+		/**
+		 * Returns the number of dropped telemetry messages of the benchmarked clients
+		 * @return Number of dropped telemetry messages
+		 */
+		static uint32_t countDropped();
+
+		/**
+		 * Records the connection statistics of the benchmarked clients, has to be called with the mutex held
+		 * @param start Connection statistics at the benchmark start
+		 * @param previous Connection statistics at the end of the previous period
+		 * @param current Current connection statistics
+		 */
+		static void recordConnection(const mqttConnectionStatistics_t &start, const mqttConnectionStatistics_t &previous, const mqttConnectionStatistics_t &current);
+
+		/// Measurement period in milliseconds
+		static constexpr uint32_t PERIOD = 500;
+		/// Benchmark result
+		static mqttBenchmarkResult_t result;
+		/// Is the benchmark running?
+		static bool running;
+		/// Mutex
+		static SemaphoreHandle_t mutex;
+		/// Logger tag
+		static constexpr const char *TAG = "MqttBenchmark";
+};
@@ -0,0 +1,180 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <map>
+#include <string>
+#include <string_view>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_ota_ops.h>
+#include <esp_timer.h>
+#include <cJSON.h>
+
+#include "groupManager.h"
+#include "network/mqtt.h"
+#include "network/wifi.h"
+#include "output.h"
+#include "sbcPduManagement.h"
+
+/**
+ * MQTT RPC request
+ */
+typedef struct MqttRpcRequest {
+	/// Request ID from the JSON payload, echoed in the response
+	std::string id;
+	/// Response topic
+	std::string responseTopic;
+	/// MQTT 5 correlation data, echoed in the response
+	std::string correlationData;
+	/// Time of the request reception in microseconds
+	int64_t receivedAt;
+} mqttRpcRequest_t;
+
+/**
+ * MQTT request/response RPC channel
+ * Request: `{"id": "1", "method": "switch", "params": {"output": 1, "enabled": true}, "replyTo": "topic"}`.
+ * In MQTT 5 mode the response topic and correlation data properties of the request are used,
+ * `id` and `replyTo` are a fallback for MQTT 3.1.1 clients. Response topics with wildcards, under the device or group topics
+ * or matching a subscription of the client are rejected and the error is sent to the default response topic.
+ * Response: `{"id": "1", "ok": true, "result": {...}, "duration": 1234}` or `{"id": "1", "ok": false, "error": "..."}`,
+ * the duration is the time between the request reception and the response in microseconds.
+ */
+class MqttRpc {
+	public:
+		/**
+		 * Constructor
+		 * @param mqtt MQTT client
+		 * @param outputs Output map <index, pointer to output>
+		 */
+		explicit MqttRpc(Mqtt *mqtt, std::map<uint8_t, Output*> *outputs);
+
+		/**
+		 * RPC request MQTT message callback
+		 * @param event MQTT event
+		 */
+		static void requestCallback(esp_mqtt_event_handle_t event);
+
+	private:
+		/**
+		 * Is the requested response topic allowed?
+		 * @param topic Response topic
+		 * @return true Response topic is allowed
+		 * @return false Response topic contains wildcards or would be delivered to this device or its groups
+		 */
+		static bool isValidResponseTopic(const std::string &topic);
+
+		/**
+		 * Switches the output
+		 * Params: `{"output": 1, "enabled": true}`
+		 * @param request RPC request
+		 * @param params Request params
+		 */
+		static void switchOutput(const mqttRpcRequest_t &request, const cJSON *params);
+
+		/**
+		 * Power-cycles the output, the response is sent after the output is enabled again
+		 * Params: `{"output": 1, "delay": 1000}`, the delay is in milliseconds
+		 * @param request RPC request
+		 * @param params Request params
+		 */
+		static void powerCycle(const mqttRpcRequest_t &request, const cJSON *params);
+
+		/**
+		 * Power cycle task - enables the output after the delay and sends the response
+		 * @param arg Pointer to the power cycle context
+		 */
+		static void powerCycleTask(void *arg);
+
+		/**
+		 * Reads measurements of the output or all outputs
+		 * Params: `{"output": 1}`, omitted `output` selects all outputs
+		 * @param request RPC request
+		 * @param params Request params
+		 */
+		static void readStats(const mqttRpcRequest_t &request, const cJSON *params);
+
+		/**
+		 * Returns the device configuration
+		 * @param request RPC request
+		 */
+		static void getConfig(const mqttRpcRequest_t &request);
+
+		/**
+		 * Finds the output selected by the `output` param
+		 * @param request RPC request
+		 * @param params Request params
+		 * @return Pointer to the output or nullptr if the output does not exist, the error response is sent
+		 */
+		static Output *findOutput(const mqttRpcRequest_t &request, const cJSON *params);
+
+		/**
+		 * Creates the output state object
+		 * @param output Pointer to the output
+		 * @param measure Include current and voltage measurements
+		 * @return Output state object
+		 */
+		static cJSON *createOutputState(Output *output, bool measure);
+
+		/**
+		 * Sends the successful response
+		 * @param request RPC request
+		 * @param result Result, the ownership is transferred
+		 */
+		static void respond(const mqttRpcRequest_t &request, cJSON *result);
+
+		/**
+		 * Sends the error response
+		 * @param request RPC request
+		 * @param error Error message
+		 */
+		static void respondError(const mqttRpcRequest_t &request, const std::string &error);
+
+		/**
+		 * Publishes the response
+		 * @param request RPC request
+		 * @param response Response, the ownership is transferred
+		 */
+		static void publish(const mqttRpcRequest_t &request, cJSON *response);
+
+		/**
+		 * Power cycle context
+		 */
+		struct PowerCycle {
+			/// RPC request
+			mqttRpcRequest_t request;
+			/// Pointer to the output
+			Output *output;
+			/// Delay in milliseconds
+			uint32_t delay;
+		};
+
+		/// Maximal power cycle delay in milliseconds
+		static constexpr uint32_t MAX_POWER_CYCLE_DELAY = 60000;
+		/// Default power cycle delay in milliseconds
+		static constexpr uint32_t DEFAULT_POWER_CYCLE_DELAY = 1000;
+		/// Request topic
+		static std::string requestTopic;
+		/// Default response topic
+		static std::string responseTopic;
+		/// Pointer to the MQTT client
+		static Mqtt *mqtt;
+		/// Output map <index, pointer to output>
+		static std::map<uint8_t, Output*> *outputs;
+		/// Logger tag
+		static constexpr const char *TAG = "MqttRpc";
+};
@@ -0,0 +1,149 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_partition.h>
+
+/**
+ * Asset pack header
+ */
+typedef struct __attribute__((packed)) AssetPackHeader {
+	/// Magic bytes `SPAK`
+	char magic[4];
+	/// Format version
+	uint16_t version;
+	/// Number of entries
+	uint16_t count;
+	/// Size of the pack in bytes
+	uint32_t size;
+} assetPackHeader_t;
+
+/**
+ * Asset variant in the pack
+ */
+typedef struct __attribute__((packed)) AssetPackVariant {
+	/// Data offset
+	uint32_t offset;
+	/// Data length, 0 if the variant is absent
+	uint32_t length;
+	/// Offset of the quoted entity tag
+	uint32_t entityTag;
+} assetPackVariant_t;
+
+/**
+ * Asset variant encodings, indexes of the variants in the pack entry
+ */
+typedef enum {
+	/// Uncompressed asset
+	ASSET_ENCODING_IDENTITY = 0,
+	/// Brotli compressed asset
+	ASSET_ENCODING_BROTLI = 1,
+	/// Gzip compressed asset
+	ASSET_ENCODING_GZIP = 2,
+} asset_encoding_t;
+
+/**
+ * Asset pack entry
+ */
+typedef struct __attribute__((packed)) AssetPackEntry {
+	/// Offset of the asset path
+	uint32_t path;
+	/// Offset of the content type
+	uint32_t contentType;
+	/// Variants indexed by the encoding
+	assetPackVariant_t variants[3];
+} assetPackEntry_t;
+
+/**
+ * Read-only frontend asset pack memory-mapped from the flash partition
+ * The pack is built from `webapp/dist` by the webapp build (see `webapp/vite.config.ts`), entries are sorted by path
+ * and contain precomputed content types, entity tags and pre-compressed variants, so the assets are served without the filesystem.
+ */
+class AssetPack {
+	public:
+		/**
+		 * Constructor
+		 * @param partitionLabel Flash partition label
+		 */
+		explicit AssetPack(const std::string &partitionLabel = "assets");
+
+		/**
+		 * Is the pack mapped and valid?
+		 * @return true Pack is available
+		 * @return false Partition was not found or does not contain a valid pack
+		 */
+		bool isAvailable() const;
+
+		/**
+		 * Finds the asset by path
+		 * @param path Asset path
+		 * @return Asset entry, nullptr if the asset does not exist
+		 */
+		const assetPackEntry_t *find(std::string_view path) const;
+
+		/**
+		 * Returns the string stored in the pack
+		 * @param offset String offset
+		 * @return NUL-terminated string
+		 */
+		const char *getString(uint32_t offset) const;
+
+		/**
+		 * Returns the data of the asset variant
+		 * @param variant Asset variant
+		 * @return Variant data in the mapped flash
+		 */
+		const uint8_t *getData(const assetPackVariant_t &variant) const;
+
+	private:
+		/**
+		 * Checks that all offsets of the pack point into the pack and the entries are sorted
+		 * @return true Pack is valid
+		 * @return false Pack is corrupted
+		 */
+		bool validate() const;
+
+		/**
+		 * Is the string offset valid?
+		 * @param offset String offset
+		 * @return true String is NUL-terminated within the pack
+		 * @return false String exceeds the pack
+		 */
+		bool isStringValid(uint32_t offset) const;
+
+		/// Supported format version
+		static constexpr uint16_t VERSION = 1;
+		/// Logger tag
+		static constexpr const char *TAG = "AssetPack";
+		/// Mapped pack
+		const uint8_t *data = nullptr;
+		/// Pack entries
+		const assetPackEntry_t *entries = nullptr;
+		/// Number of entries
+		size_t count = 0;
+		/// Size of the pack in bytes
+		size_t size = 0;
+		/// Memory mapping handle
+		esp_partition_mmap_handle_t handle;
+};
@@ -15,6 +15,9 @@
  */
 #pragma once
 
+#include <functional>
+#include <string>
+
 #include "nvsManager.h"
 
 /**
@@ -22,6 +25,9 @@
  */
 class HostnameManager {
 	public:
+		/// Hostname change callback type definition
+		typedef std::function<void(const std::string &hostname)> change_callback_t;
+
 		/**
 		 * Returns the hostname
 		 * @return Hostname
@@ -34,7 +40,15 @@ class HostnameManager {
 		 */
 		void set(const std::string &hostname);
 
+		/**
+		 * Sets the callback of hostname changes
+		 * @param onChange Hostname change callback
+		 */
+		static void setOnChange(const HostnameManager::change_callback_t &onChange);
+
 	private:
+		/// Hostname change callback
+		static HostnameManager::change_callback_t onChange;
 		/// NVS manager
 		NvsManager nvs = NvsManager("hostname");
 };
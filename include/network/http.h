@@ -15,10 +15,22 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
 #include <string>
+#include <string_view>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
 #include <esp_event.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <esp_system.h>
 #include <nvs_flash.h>
 #include <sys/param.h>
@@ -26,14 +38,21 @@
 #include <esp_http_server.h>
 
 #include <fcntl.h>
+#include <sys/stat.h>
+#include <mbedtls/sha256.h>
 #include <esp_err.h>
 #include <esp_spiffs.h>
 #include <esp_vfs.h>
 #include <cJSON.h>
 
+#include "network/assetPack.h"
 #include "restApi/cors.h"
+#include "utils/bufferPool.h"
+#include "utils/jsonWriter.h"
 
 #define SCRATCH_BUFSIZE (10240)
+/// Number of file transfer workers
+#define HTTP_FILE_WORKERS (2)
 
 /**
  * REST API server context
@@ -41,10 +60,36 @@
 typedef struct rest_server_context {
 	/// Base path
 	std::string basePath;
-	/// Scratch buffer
-	char scratch[SCRATCH_BUFSIZE];
+	/// Memory-mapped asset pack, the files are served from the base path if the pack is not available
+	AssetPack *assets;
+	/// Scratch buffers of file transfers, one for each worker and one for the server task, nullptr if the asset pack is available
+	BufferPool *buffers;
+	/// Requests waiting for a file transfer worker, nullptr if the asset pack is available
+	QueueHandle_t requests;
+	/// Number of idle file transfer workers, nullptr if the asset pack is available
+	SemaphoreHandle_t idleWorkers;
 } rest_server_context_t;
 
+/**
+ * Frontend file transfer statistics
+ */
+typedef struct HttpTransferStatistics {
+	/// Number of completed transfers
+	uint32_t transfers;
+	/// Number of sent body bytes
+	uint64_t bytes;
+	/// Number of transfers in progress
+	uint32_t active;
+	/// Maximal number of concurrent transfers
+	uint32_t peakActive;
+	/// Time with at least one transfer in progress in microseconds
+	int64_t busyTime;
+	/// Start of the current busy period in microseconds
+	int64_t busySince;
+	/// Number of running file transfer workers, the asset pack is sent directly by the server task
+	uint32_t workers;
+} httpTransferStatistics_t;
+
 /**
  * HTTP server
  */
@@ -64,11 +109,21 @@ class HttpServer {
 
 		/**
 		 * Frontend handler
+		 * The transfer is handed over to an idle file transfer worker, so slow clients do not block the API requests.
+		 * The server task sends the file itself only if all workers are busy or if the files are served from the asset pack.
 		 * @param request HTTP request
 		 * @return Execution status
 		 */
 		static esp_err_t getFrontendFiles(httpd_req_t *request);
 
+		/**
+		 * Writes the JSON object with the frontend file transfer statistics
+		 * Throughput is the number of sent bytes divided by the time with at least one transfer in progress,
+		 * so it reflects the aggregate throughput of concurrent transfers.
+		 * @param writer JSON writer
+		 */
+		static void writeStatistics(JsonWriter &writer);
+
 		/**
 		 * Registers the frontend handler
 		 */
@@ -88,6 +143,87 @@ class HttpServer {
 		static esp_err_t setContentTypeFromFileExtension(httpd_req_t *request, const char *filePath);
 
 	protected:
+		/**
+		 * Sends the frontend file
+		 * @param request HTTP request
+		 * @return Execution status
+		 */
+		static esp_err_t sendFrontendFiles(httpd_req_t *request);
+
+		/**
+		 * File transfer worker task
+		 * @param arg REST API server context
+		 */
+		static void fileWorkerTask(void *arg);
+
+		/**
+		 * Records the start of the file transfer
+		 */
+		static void beginTransfer();
+
+		/**
+		 * Records the end of the file transfer
+		 * @param bytes Number of sent body bytes
+		 */
+		static void endTransfer(size_t bytes);
+
+		/**
+		 * Selects the pre-compressed variant accepted by the client
+		 * Brotli is preferred over gzip, the variant is used only if it exists.
+		 * @param request HTTP request
+		 * @param isAvailable Callback checking the existence of the variant with the content coding
+		 * @return Content coding of the variant (`br` or `gzip`), empty if the uncompressed representation should be sent
+		 */
+		static std::string selectEncoding(httpd_req_t *request, const std::function<bool(const std::string &encoding)> &isAvailable);
+
+		/**
+		 * Sends the asset from the asset pack
+		 * The data are sent directly from the memory-mapped flash.
+		 * @param request HTTP request
+		 * @param assets Asset pack
+		 * @param entry Asset entry
+		 * @return Execution status
+		 */
+		static esp_err_t sendAsset(httpd_req_t *request, const AssetPack *assets, const assetPackEntry_t *entry);
+
+		/**
+		 * Is the content coding accepted by the client?
+		 * @param acceptEncoding Value of the Accept-Encoding header
+		 * @param encoding Content coding
+		 * @return true Content coding is accepted
+		 * @return false Content coding is not listed or has zero quality
+		 * The quality of the listed content coding takes precedence over the quality of `*`.
+		 */
+		static bool isEncodingAccepted(std::string_view acceptEncoding, std::string_view encoding);
+
+		/**
+		 * Returns the strong entity tag of the file
+		 * Entity tags are computed from the file content on the first request and cached, the SPIFFS image changes only with reflashing.
+		 * @param fd File descriptor, the file offset is rewound to the beginning
+		 * @param path File path
+		 * @param buffer Scratch buffer with SCRATCH_BUFSIZE size
+		 * @return Quoted entity tag, empty if the file could not be read
+		 */
+		static std::string getEntityTag(int fd, const std::string &path, char *buffer);
+
+		/**
+		 * Does the If-None-Match header of the request match the entity tag?
+		 * @param request HTTP request
+		 * @param entityTag Quoted entity tag
+		 * @return true Client has the current representation
+		 * @return false Representation has to be sent
+		 */
+		static bool isNotModified(httpd_req_t *request, const std::string &entityTag);
+
+		/// Cache-Control of the frontend files, the single-file build has no hashed file names, so every file is revalidated by its entity tag
+		static constexpr const char *CACHE_CONTROL = "no-cache";
+		/// Entity tags of the served files <path, quoted entity tag>
+		static std::map<std::string, std::string> entityTags;
+		/// Frontend file transfer statistics
+		static httpTransferStatistics_t statistics;
+		/// Mutex protecting the entity tags and the statistics
+		static SemaphoreHandle_t mutex;
+
 		/// Logger tag
 		static constexpr const char *TAG = "HTTP server";
 
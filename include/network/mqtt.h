@@ -15,19 +15,33 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <cstdint>
 #include <cstddef>
 #include <cstring>
+#include <deque>
 #include <functional>
-#include <map>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <esp_log.h>
 #include <esp_crt_bundle.h>
+#include <esp_timer.h>
 #include <mqtt_client.h>
 
 #include "nvsManager.h"
+#include "network/mqttMetrics.h"
+#include "network/mqttOutbox.h"
+#include "network/mqttPublishProperties.h"
+#include "network/mqttTlsTransport.h"
+#include "network/mqttTopicFilter.h"
 #include "network/wifi.h"
 
 /**
@@ -79,6 +93,26 @@ class MqttLastWillAndTestament {
 		bool retain;
 };
 
+/**
+ * MQTT outbox metrics
+ */
+typedef struct MqttOutboxMetrics {
+	/// Memory used by messages waiting for acknowledgement in the client outbox
+	size_t outboxBytes;
+	/// Client outbox memory limit
+	size_t outboxLimit;
+	/// Number of telemetry messages waiting for space in the client outbox
+	size_t queuedMessages;
+	/// Memory used by telemetry messages waiting for space in the client outbox
+	size_t queuedBytes;
+	/// Number of telemetry messages replaced by a newer value of the same topic
+	uint32_t superseded;
+	/// Number of dropped telemetry messages
+	uint32_t dropped;
+	/// Number of other messages rejected due to the full client outbox
+	uint32_t rejected;
+} mqttOutboxMetrics_t;
+
 /**
  * MQTT client configuration
  */
@@ -86,8 +120,9 @@ class MqttConfig {
 	public:
 		/**
 		 * Constructor
+		 * @param nameSpace NVS namespace with the client configuration
 		 */
-		MqttConfig();
+		explicit MqttConfig(const std::string &nameSpace = "mqtt");
 
 		/**
 		 * Returns MQTT client configuration
@@ -107,21 +142,91 @@ class MqttConfig {
 		 */
 		void setClientId(const std::string &clientId);
 
+		/**
+		 * Returns the MQTT protocol version
+		 * @return MQTT protocol version
+		 */
+		esp_mqtt_protocol_ver_t getProtocolVersion() const;
+
+		/**
+		 * Returns the maximal number of topic aliases used in MQTT 5 mode
+		 * @return Maximal number of topic aliases
+		 */
+		uint16_t getTopicAliasMaximum() const;
+
+		/**
+		 * Returns the client outbox memory limit
+		 * @return Client outbox memory limit in bytes
+		 */
+		uint32_t getOutboxLimit() const;
+
+		/**
+		 * Returns QoS of published telemetry
+		 * @return QoS of published telemetry, -1 if the protocol default should be used
+		 */
+		int getTelemetryQos() const;
+
+		/**
+		 * Returns the MQTT broker URI
+		 * @return MQTT broker URI, empty if the client is not configured
+		 */
+		const std::string &getBrokerUri() const;
+
+		/**
+		 * Returns the NVS namespace with the client configuration
+		 * @return NVS namespace
+		 */
+		const std::string &getNamespace() const;
+
+		/**
+		 * Returns the pinned CA certificate
+		 * @return PEM CA certificate, empty if the certificate bundle is used
+		 */
+		const std::string &getCaCertificate() const;
+
+		/**
+		 * Should the TLS session be resumed on reconnection?
+		 * @return true TLS session resumption is enabled
+		 * @return false Every connection performs the full handshake
+		 */
+		bool isSessionResumptionEnabled() const;
+
 	private:
+		/**
+		 * Loads the pinned CA certificate from NVS (`caCert`) or from the file (`caFile`)
+		 */
+		void loadCaCertificate();
+
+		/// Logger tag
+		static constexpr const char *TAG = "MqttConfig";
 		 /// MQTT broker URI
 		std::string brokerUri;
 		/// MQTT client config
 		esp_mqtt_client_config_t config;
 		/// Last will and testament
 		MqttLastWillAndTestament* lwt = nullptr;
+		/// NVS namespace
+		std::string nameSpace;
 		/// NVS manager
-		NvsManager nvs = NvsManager("mqtt");
+		NvsManager nvs;
+		/// MQTT client ID
+		std::string clientId;
 		/// MQTT broker username
 		std::string username;
 		/// MQTT broker password
 		std::string password;
 		/// Connection keepalive interval
 		uint8_t keepalive;
+		/// Maximal number of topic aliases
+		uint16_t topicAliasMaximum = 16;
+		/// Client outbox memory limit in bytes
+		uint32_t outboxLimit = 16384;
+		/// QoS of published telemetry, -1 for the protocol default
+		int telemetryQos = -1;
+		/// Pinned PEM CA certificate, empty if the certificate bundle is used
+		std::string caCertificate;
+		/// Resume the TLS session on reconnection
+		bool sessionResumption = true;
 };
 
 /**
@@ -133,6 +238,8 @@ class Mqtt {
 		typedef std::function<void(Mqtt* client, esp_event_base_t base, esp_mqtt_event_handle_t event)> connect_callback_t;
 		/// Subscribe callback type definition
 		typedef std::function<void(esp_mqtt_event_handle_t event)> subscribe_callback_t;
+		/// Published message (QoS > 0) acknowledgement callback type definition
+		typedef std::function<void(Mqtt* client, int msgId)> published_callback_t;
 
 		/**
 		 * Constructor
@@ -161,19 +268,109 @@ class Mqtt {
 		 * @param data Data to send
 		 * @param qos QoS of published message
 		 * @param retain Retain flag
-		 * @return Message ID of the published message on success or -1 on failure
+		 * @param properties MQTT 5 publish properties, ignored in MQTT 3.1.1 mode
+		 * @return Message ID of the published message on success (0 for QoS 0), Mqtt::PUBLISH_DEFERRED if the message was deferred by an event handler or -1 on failure
 		 */
-		int publishString(const std::string &topic, const std::string &data, const int qos, const bool retain);
+		int publishString(const std::string &topic, const std::string &data, const int qos, const bool retain, const mqttPublishProperties_t *properties = nullptr);
 
 		/**
-		 * Subscibes to the topic
+		 * Publishes the binary data into the topic
+		 * All publishing is serialized by the publish lock. Event handlers run with the client API lock held and do not wait for the publish lock,
+		 * when it is held by another task the message is deferred and published by that task after unlocking.
+		 * A deferred message is not handed to the client yet, callers must not treat it as published.
 		 * @param topic Topic
+		 * @param data Data to send
+		 * @param length Data length
+		 * @param qos QoS of published message
+		 * @param retain Retain flag
+		 * @param properties MQTT 5 publish properties, ignored in MQTT 3.1.1 mode
+		 * @return Message ID of the published message on success (0 for QoS 0), Mqtt::PUBLISH_DEFERRED if the message was deferred by an event handler or -1 on failure
+		 */
+		int publish(const std::string &topic, const uint8_t *data, size_t length, const int qos, const bool retain, const mqttPublishProperties_t *properties = nullptr);
+
+		/**
+		 * Publishes the telemetry into the topic
+		 * Messages with QoS > 0 are queued while the client outbox is filled above the telemetry share,
+		 * only the newest message of each topic is kept and the oldest messages are dropped first.
+		 * @param topic Topic
+		 * @param data Data to send
+		 * @param length Data length
+		 * @param qos QoS of published message
+		 * @param retain Retain flag
+		 * @param properties MQTT 5 publish properties, ignored in MQTT 3.1.1 mode
+		 * @return Message ID of the published message on success, 0 if the message was queued, Mqtt::PUBLISH_DEFERRED if it was deferred by an event handler or -1 on failure
+		 */
+		int publishTelemetry(const std::string &topic, const uint8_t *data, size_t length, const int qos, const bool retain, const mqttPublishProperties_t *properties = nullptr);
+
+		/**
+		 * Is there space for the telemetry message in the client outbox?
+		 * @param length Message length
+		 * @return true Message fits into the telemetry share of the client outbox
+		 * @return false Client outbox is filled above the telemetry share
+		 */
+		bool hasOutboxSpace(size_t length);
+
+		/**
+		 * Returns the outbox metrics
+		 * @return Outbox metrics
+		 */
+		mqttOutboxMetrics_t getOutboxMetrics();
+
+		/**
+		 * Creates the JSON object with the connection, publish and outbox metrics
+		 * @return Diagnostics JSON object
+		 */
+		cJSON *getDiagnostics();
+
+		/**
+		 * Returns the connection statistics
+		 * @return Connection statistics
+		 */
+		mqttConnectionStatistics_t getConnectionStatistics();
+
+		/**
+		 * Returns all created MQTT clients
+		 * @return MQTT clients
+		 */
+		static const std::vector<Mqtt *> &getInstances();
+
+		/**
+		 * Returns the negotiated MQTT protocol version
+		 * @return MQTT protocol version
+		 */
+		esp_mqtt_protocol_ver_t getProtocolVersion() const;
+
+		/**
+		 * Returns QoS of published telemetry
+		 * Configured QoS or the protocol default - 0 in MQTT 5 mode (topic aliases and message expiry), 2 otherwise.
+		 * @return QoS of published telemetry
+		 */
+		int getTelemetryQos() const;
+
+		/**
+		 * Returns the name of the client (NVS namespace of its configuration)
+		 * @return Client name
+		 */
+		const std::string &getName() const;
+
+		/**
+		 * Subscibes to the topic
+		 * The subscription is (re)established on every connection to the broker.
+		 * @param topic Topic filter, may contain `+` and `#` wildcards
 		 * @param callback Callback
 		 * @param qos QoS
-		 * @return Message ID of the published message on success or -1 on failure
+		 * @return Message ID of the published message on success, 0 if the client is not connected yet or -1 on failure
 		 */
 		int subscribe(const std::string &topic, const Mqtt::subscribe_callback_t &callback, int qos);
 
+		/**
+		 * Is a message published to the topic delivered to any subscription of the client?
+		 * @param topic Topic name
+		 * @return true Topic matches a subscription
+		 * @return false Topic does not match any subscription
+		 */
+		bool isSubscribed(const std::string &topic);
+
 		/**
 		 * Unsubscibes from the topic
 		 * @param topic Topic
@@ -181,12 +378,29 @@ class Mqtt {
 		 */
 		int unsubscribe(const std::string &topic);
 
+		/**
+		 * Is the client connected to the broker?
+		 * @return true Client is connected
+		 * @return false Client is disconnected
+		 */
+		bool isConnected() const;
+
 		/**
 		 * Sets the connection callback
 		 * @param onConnect Connection callback
 		 */
 		void setOnConnect(Mqtt::connect_callback_t onConnect);
 
+		/**
+		 * Sets the callback of messages acknowledged by the broker
+		 * The callback runs in the event handler, it must not block.
+		 * @param onPublished Published message callback
+		 */
+		void setOnPublished(Mqtt::published_callback_t onPublished);
+
+
+		/// Publish status of a message deferred by an event handler, it is published after the publish lock is released
+		static constexpr int PUBLISH_DEFERRED = -2;
 
 		static void inline logErrorIfNonzero(const char *message, int errorCode) {
 			if (errorCode != ESP_OK) {
@@ -194,10 +408,115 @@ class Mqtt {
 			}
 		}
 	protected:
-		/// Subscribe callbacks
-		static std::map<std::string, Mqtt::subscribe_callback_t> callbacks;
+		/**
+		 * MQTT subscription
+		 */
+		struct Subscription {
+			/// Compiled topic filter
+			MqttTopicFilter filter;
+			/// Subscribe callback
+			Mqtt::subscribe_callback_t callback;
+			/// QoS
+			int qos;
+		};
+
+		/**
+		 * Message deferred by an event handler
+		 */
+		struct DeferredMessage {
+			/// Message
+			MqttOutbox::Message message;
+			/// Is the message telemetry? Only telemetry is evicted when the queue is full
+			bool telemetry;
+		};
+
+		/**
+		 * Dispatches the received message to the matching subscription callback
+		 * @param event MQTT event
+		 */
+		void dispatch(esp_mqtt_event_handle_t event);
+
+		/**
+		 * Publishes the binary data into the topic or defers it when called by an event handler while the publish lock is held
+		 * @param topic Topic
+		 * @param data Data to send
+		 * @param length Data length
+		 * @param qos QoS of published message
+		 * @param retain Retain flag
+		 * @param properties MQTT 5 publish properties, ignored in MQTT 3.1.1 mode
+		 * @param telemetry Is the message telemetry?
+		 * @return Message ID of the published message on success (0 for QoS 0), Mqtt::PUBLISH_DEFERRED if the message was deferred or -1 on failure
+		 */
+		int publishMessage(const std::string &topic, const uint8_t *data, size_t length, const int qos, const bool retain, const mqttPublishProperties_t *properties, bool telemetry);
+
+		/**
+		 * Sends the subscribe request to the broker
+		 * @param topic Topic filter
+		 * @param qos QoS
+		 * @return Message ID of the subscribe message on success or -1 on failure
+		 */
+		int sendSubscribe(const std::string &topic, int qos);
+
+		/**
+		 * Publishes queued telemetry while there is space in the client outbox
+		 */
+		void drainOutbox();
+
+		/**
+		 * Takes the publish lock, event handlers only try to take it
+		 * @return true Publish lock was taken
+		 * @return false Publish lock is held by another task
+		 */
+		bool lockPublishing();
+
+		/**
+		 * Publishes the data into the topic, the publish lock has to be held
+		 * @param topic Topic
+		 * @param data Data to send
+		 * @param qos QoS of published message
+		 * @param retain Retain flag
+		 * @param properties MQTT 5 publish properties, ignored in MQTT 3.1.1 mode
+		 * @return Message ID of the published message on success or -1 on failure
+		 */
+		int publishLocked(const std::string &topic, std::string_view data, const int qos, const bool retain, const mqttPublishProperties_t *properties);
+
+		/**
+		 * Publishes messages deferred by event handlers while the publish lock can be taken
+		 */
+		void publishDeferred();
+
+#ifdef CONFIG_MQTT_PROTOCOL_5
+		/**
+		 * Publishes the data into the topic with MQTT 5 properties
+		 * @param topic Topic
+		 * @param data Data to send
+		 * @param qos QoS of published message
+		 * @param retain Retain flag
+		 * @param properties MQTT 5 publish properties
+		 * @return Message ID of the published message on success or -1 on failure
+		 */
+		int publishWithProperties(const std::string &topic, std::string_view data, const int qos, const bool retain, const mqttPublishProperties_t &properties);
+
+		/**
+		 * Publishes the data with the prepared MQTT 5 publish property
+		 * @param topic Topic, empty if only the topic alias is sent
+		 * @param data Data to send
+		 * @param qos QoS of published message
+		 * @param retain Retain flag
+		 * @param property MQTT 5 publish property
+		 * @return Message ID of the published message on success or -1 on failure
+		 */
+		int publishWithProperty(const char *topic, std::string_view data, const int qos, const bool retain, const esp_mqtt5_publish_property_config_t &property);
+#endif
+
+		/// Subscriptions without wildcards <topic, subscription>
+		std::unordered_map<std::string, Mqtt::Subscription> exactSubscriptions;
+		/// Subscriptions with wildcards
+		std::vector<Mqtt::Subscription> wildcardSubscriptions;
+		/// Mutex protecting the subscriptions, the client API must not be called and callbacks must not be run while it is held
+		SemaphoreHandle_t subscriptionsMutex;
 		/// MQTT client handle
-		static esp_mqtt_client_handle_t handle;
+		esp_mqtt_client_handle_t handle = nullptr;
 
 	private:
 		/// Logger tag
@@ -205,7 +524,53 @@ class Mqtt {
 		/// MQTT client configuration manager
 		MqttConfig config;
 		/// On connect callback
-		static Mqtt::connect_callback_t onConnect;
+		Mqtt::connect_callback_t onConnect;
+		/// On published message callback
+		Mqtt::published_callback_t onPublished;
 		/// Is the client connected to the broker
-		static bool connected;
+		bool connected = false;
+		/// Client name
+		std::string name;
+		/// QoS of published telemetry
+		int telemetryQos;
+		/// MQTT protocol version
+		esp_mqtt_protocol_ver_t protocolVersion;
+		/// Maximal number of topic aliases
+		uint16_t topicAliasMaximum;
+		/// Topic aliases valid for the current connection <topic, alias>
+		std::unordered_map<std::string, uint16_t> topicAliases;
+		/// Are topic aliases accepted by the broker?
+		bool topicAliasesEnabled = true;
+		/// Number of established connections, topic aliases are reset by the next publish after it changes
+		std::atomic<uint32_t> connectionGeneration = 0;
+		/// Connection the topic aliases belong to
+		uint32_t aliasGeneration = 0;
+		/// Mutex serializing publish property setup and publishing of all messages
+		SemaphoreHandle_t publishMutex;
+		/// Messages published by event handlers while the publish lock was held by another task
+		std::deque<Mqtt::DeferredMessage> deferred;
+		/// Mutex protecting the deferred messages
+		SemaphoreHandle_t deferredMutex;
+		/// Maximal number of deferred messages, other messages than telemetry are rejected when the queue holds no telemetry to evict
+		static constexpr size_t MAX_DEFERRED = 64;
+		/// Is the current task running an MQTT event handler?
+		static thread_local bool inEventHandler;
+		/// Share of the client outbox available for telemetry in percents, the rest is reserved for other messages
+		static constexpr size_t TELEMETRY_OUTBOX_SHARE = 75;
+		/// Client outbox memory limit in bytes
+		size_t outboxLimit;
+		/// Telemetry waiting for space in the client outbox
+		MqttOutbox outbox;
+		/// Mutex protecting the telemetry queue, the client API must not be called while it is held
+		SemaphoreHandle_t outboxMutex;
+		/// Number of messages rejected due to the full client outbox
+		uint32_t rejected = 0;
+		/// Connection and publish metrics
+		MqttMetrics metrics;
+		/// Mutex protecting the metrics
+		SemaphoreHandle_t metricsMutex;
+		/// TLS transport of the `mqtts://` connection
+		MqttTlsTransport *tlsTransport = nullptr;
+		/// All created MQTT clients
+		static std::vector<Mqtt *> instances;
 };
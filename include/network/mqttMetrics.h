@@ -0,0 +1,201 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+
+#include <cJSON.h>
+
+/**
+ * MQTT connection statistics
+ */
+typedef struct MqttConnectionStatistics {
+	/// Number of lost connections
+	uint32_t disconnects;
+	/// Number of reconnections after a lost connection
+	uint32_t reconnects;
+	/// Total latency of the reconnections in microseconds
+	int64_t reconnectTime;
+	/// Number of messages deleted from the client outbox without acknowledgement
+	uint32_t expired;
+} mqttConnectionStatistics_t;
+
+/**
+ * MQTT connection and publish performance metrics
+ * Publish latency is the time between handing the message to the client and the PUBACK (QoS 1) or PUBCOMP (QoS 2)
+ * reported by the published event with the same message ID. The event may be handled before the publication is recorded,
+ * such acknowledgements are kept until the publication with the same message ID is recorded.
+ * TLS handshakes offering a saved session are tracked separately from the full handshakes.
+ */
+class MqttMetrics {
+	public:
+		/**
+		 * Records the start of the connection attempt
+		 * @param now Current time in microseconds
+		 */
+		void recordConnecting(int64_t now);
+
+		/**
+		 * Records the established connection
+		 * @param now Current time in microseconds
+		 */
+		void recordConnected(int64_t now);
+
+		/**
+		 * Records the lost connection
+		 * @param now Current time in microseconds
+		 */
+		void recordDisconnected(int64_t now);
+
+		/**
+		 * Records the completed TLS handshake
+		 * @param duration Duration of the TCP connection and the TLS handshake in microseconds
+		 * @param sessionOffered Was the saved TLS session offered to the server?
+		 */
+		void recordHandshake(int64_t duration, bool sessionOffered);
+
+		/**
+		 * Records the published message
+		 * @param msgId Message ID, negative if the message was not published
+		 * @param qos QoS of the message
+		 * @param length Payload length
+		 * @param publishedAt Time of handing the message to the client in microseconds
+		 */
+		void recordPublished(int msgId, int qos, size_t length, int64_t publishedAt);
+
+		/**
+		 * Records the acknowledgement of the message
+		 * @param msgId Message ID
+		 * @param now Current time in microseconds
+		 */
+		void recordAcknowledged(int msgId, int64_t now);
+
+		/**
+		 * Records the message deleted from the client outbox without acknowledgement
+		 * @param msgId Message ID
+		 */
+		void recordDeleted(int msgId);
+
+		/**
+		 * Returns the connection statistics
+		 * @return Connection statistics
+		 */
+		mqttConnectionStatistics_t getConnectionStatistics() const;
+
+		/**
+		 * Adds the metrics to the JSON object
+		 * @param root JSON object
+		 * @param now Current time in microseconds
+		 */
+		void toJson(cJSON *root, int64_t now) const;
+
+	private:
+		/// Upper bounds of the latency histogram buckets in milliseconds, the last bucket is unbounded
+		static constexpr uint32_t LATENCY_BOUNDS[] = {5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000};
+		/// Maximal number of messages waiting for the acknowledgement
+		static constexpr size_t MAX_PENDING = 64;
+		/// Maximal number of acknowledgements received before the publication was recorded
+		static constexpr size_t MAX_EARLY_ACKNOWLEDGEMENTS = 8;
+
+		/**
+		 * Latency histogram
+		 */
+		struct Histogram {
+			/// Number of samples in buckets
+			std::array<uint32_t, std::size(LATENCY_BOUNDS) + 1> buckets = {};
+			/// Number of samples
+			uint32_t count = 0;
+			/// Sum of the samples in microseconds
+			int64_t sum = 0;
+			/// Maximal sample in microseconds
+			int64_t max = 0;
+
+			/**
+			 * Records the sample
+			 * @param latency Latency in microseconds
+			 */
+			void record(int64_t latency);
+
+			/**
+			 * Creates the JSON object with the histogram
+			 * @return Histogram JSON object
+			 */
+			cJSON *toJson() const;
+		};
+
+		/**
+		 * Records the publish latency of the acknowledged message
+		 * @param qos QoS of the message
+		 * @param latency Latency in microseconds
+		 */
+		void recordLatency(int qos, int64_t latency);
+
+		/**
+		 * Message waiting for the acknowledgement
+		 */
+		struct Pending {
+			/// Time of the publication in microseconds
+			int64_t publishedAt;
+			/// QoS
+			int qos;
+		};
+
+		/// Number of established connections
+		uint32_t connects = 0;
+		/// Number of lost connections
+		uint32_t disconnects = 0;
+		/// Time of the current connection start in microseconds, 0 if disconnected
+		int64_t connectedAt = 0;
+		/// Time of the current connection attempt start in microseconds
+		int64_t connectingAt = 0;
+		/// Total time of closed connections in microseconds
+		int64_t connectedTime = 0;
+		/// Latency of the first connection in microseconds
+		int64_t initialConnectLatency = 0;
+		/// Latency of the last reconnection in microseconds
+		int64_t lastReconnectLatency = 0;
+		/// Total latency of the reconnections in microseconds
+		int64_t reconnectTime = 0;
+		/// Maximal reconnection latency in microseconds
+		int64_t maxReconnectLatency = 0;
+		/// Full TLS handshake latency histogram
+		Histogram fullHandshake;
+		/// TLS handshake latency histogram of connections offering the saved session
+		Histogram resumedHandshake;
+		/// Number of published messages
+		uint32_t published = 0;
+		/// Number of messages which were not published
+		uint32_t failed = 0;
+		/// Number of published payload bytes
+		uint64_t bytesSent = 0;
+		/// Number of messages deleted from the client outbox without acknowledgement
+		uint32_t expired = 0;
+		/// Number of messages whose acknowledgement was not tracked due to the pending limit
+		uint32_t untracked = 0;
+		/// Messages waiting for the acknowledgement <message ID, message>
+		std::map<int, Pending> pending;
+		/// Acknowledgements received before the publication was recorded <message ID, time in microseconds>
+		std::map<int, int64_t> earlyAcknowledgements;
+		/// PUBACK latency histogram
+		Histogram pubAck;
+		/// PUBCOMP latency histogram
+		Histogram pubComp;
+};
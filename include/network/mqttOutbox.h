@@ -0,0 +1,135 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#include "network/mqttPublishProperties.h"
+
+/**
+ * Bounded queue of telemetry messages waiting for space in the MQTT client outbox
+ * Only the newest message of each topic is kept, the oldest messages are dropped when the queue is full.
+ */
+class MqttOutbox {
+	public:
+		/**
+		 * Queued message
+		 */
+		struct Message {
+			/// Topic
+			std::string topic;
+			/// Payload
+			std::string data;
+			/// QoS
+			int qos;
+			/// Retain flag
+			bool retain;
+			/// Are the MQTT 5 publish properties set?
+			bool hasProperties = false;
+			/// MQTT 5 publish properties
+			mqttPublishProperties_t properties = {};
+		};
+
+		/**
+		 * Constructor
+		 * @param capacity Queue capacity in bytes
+		 */
+		explicit MqttOutbox(size_t capacity);
+
+		/**
+		 * Enqueues the message, an older message with the same topic is superseded
+		 * @param message Message
+		 * @return true Message was enqueued
+		 * @return false Message is larger than the queue capacity and was dropped
+		 */
+		bool push(MqttOutbox::Message &&message);
+
+		/**
+		 * Returns the oldest message
+		 * @return Oldest message, the queue must not be empty
+		 */
+		const MqttOutbox::Message &front() const;
+
+		/**
+		 * Removes the oldest message
+		 */
+		void pop();
+
+		/**
+		 * Removes and returns the oldest message
+		 * @return Oldest message, the queue must not be empty
+		 */
+		MqttOutbox::Message take();
+
+		/**
+		 * Drops all queued messages
+		 */
+		void clear();
+
+		/**
+		 * Is the queue empty?
+		 * @return true Queue is empty
+		 * @return false Queue contains messages
+		 */
+		bool empty() const;
+
+		/**
+		 * Returns number of queued messages
+		 * @return Number of queued messages
+		 */
+		size_t size() const;
+
+		/**
+		 * Returns memory used by queued messages
+		 * @return Used memory in bytes
+		 */
+		size_t getBytes() const;
+
+		/**
+		 * Returns number of messages replaced by a newer message with the same topic
+		 * @return Number of superseded messages
+		 */
+		uint32_t getSuperseded() const;
+
+		/**
+		 * Returns number of messages dropped due to the queue capacity or disconnection
+		 * @return Number of dropped messages
+		 */
+		uint32_t getDropped() const;
+
+		/**
+		 * Returns memory used by the message
+		 * @param message Message
+		 * @return Used memory in bytes
+		 */
+		static size_t getMessageSize(const MqttOutbox::Message &message);
+
+	private:
+		/// Queued messages, the oldest first
+		std::deque<MqttOutbox::Message> messages;
+		/// Queue capacity in bytes
+		size_t capacity;
+		/// Memory used by queued messages
+		size_t bytes = 0;
+		/// Number of superseded messages
+		uint32_t superseded = 0;
+		/// Number of dropped messages
+		uint32_t dropped = 0;
+};
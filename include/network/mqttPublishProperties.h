@@ -0,0 +1,39 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * MQTT 5 publish properties
+ */
+typedef struct MqttPublishProperties {
+	/// Message expiry interval in seconds, 0 disables the expiry
+	uint32_t messageExpiryInterval = 0;
+	/// Replace the topic with a topic alias, aliases are used only for QoS 0 messages
+	bool topicAlias = false;
+	/// User properties <key, value>
+	std::vector<std::pair<std::string, std::string>> userProperties = {};
+	/// Content type (MIME type) of the payload, empty if not set
+	std::string contentType = "";
+	/// Response topic of the request, empty if not set
+	std::string responseTopic = "";
+	/// Correlation data of the request or response, empty if not set
+	std::string correlationData = "";
+} mqttPublishProperties_t;
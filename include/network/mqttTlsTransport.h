@@ -0,0 +1,154 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <string>
+
+#include <sys/select.h>
+#include <esp_crt_bundle.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_tls.h>
+#include <esp_transport.h>
+
+/**
+ * MQTT over TLS transport resuming TLS sessions across reconnects
+ * esp-mqtt does not expose esp-tls client sessions, so the transport wraps esp-tls directly and is passed to the client as a custom transport.
+ * The session of the last successful handshake is offered on the next connection, the server may then skip the full handshake.
+ * Session resumption requires CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS, the transport performs the full handshake otherwise.
+ */
+class MqttTlsTransport {
+	public:
+		/// Handshake callback type definition
+		typedef std::function<void(int64_t duration, bool sessionOffered)> handshake_callback_t;
+
+		/**
+		 * Constructor
+		 * @param certificate Pinned PEM CA certificate, the certificate bundle is used if empty
+		 * @param resumeSessions Offer the session of the last successful handshake on reconnection
+		 */
+		MqttTlsTransport(const std::string &certificate, bool resumeSessions);
+
+		/**
+		 * Returns the transport handle for the MQTT client configuration
+		 * @return Transport handle
+		 */
+		esp_transport_handle_t getHandle() const;
+
+		/**
+		 * Sets the callback called after every successful TLS handshake
+		 * @param onHandshake Handshake callback
+		 */
+		void setOnHandshake(const MqttTlsTransport::handshake_callback_t &onHandshake);
+
+	private:
+		/**
+		 * Opens the TLS connection, the saved session is offered to the server
+		 * @param transport Transport handle
+		 * @param host Host name
+		 * @param port Port
+		 * @param timeoutMs Timeout in milliseconds
+		 * @return 0 on success or -1 on failure
+		 */
+		static int connect(esp_transport_handle_t transport, const char *host, int port, int timeoutMs);
+
+		/**
+		 * Reads the data
+		 * @param transport Transport handle
+		 * @param buffer Buffer
+		 * @param length Buffer length
+		 * @param timeoutMs Timeout in milliseconds
+		 * @return Number of read bytes, 0 on timeout or negative value on failure
+		 */
+		static int read(esp_transport_handle_t transport, char *buffer, int length, int timeoutMs);
+
+		/**
+		 * Writes the data
+		 * @param transport Transport handle
+		 * @param buffer Data
+		 * @param length Data length
+		 * @param timeoutMs Timeout in milliseconds
+		 * @return Number of written bytes, 0 on timeout or negative value on failure
+		 */
+		static int write(esp_transport_handle_t transport, const char *buffer, int length, int timeoutMs);
+
+		/**
+		 * Waits until the data can be read
+		 * @param transport Transport handle
+		 * @param timeoutMs Timeout in milliseconds
+		 * @return 1 if the data can be read, 0 on timeout or -1 on failure
+		 */
+		static int pollRead(esp_transport_handle_t transport, int timeoutMs);
+
+		/**
+		 * Waits until the data can be written
+		 * @param transport Transport handle
+		 * @param timeoutMs Timeout in milliseconds
+		 * @return 1 if the data can be written, 0 on timeout or -1 on failure
+		 */
+		static int pollWrite(esp_transport_handle_t transport, int timeoutMs);
+
+		/**
+		 * Closes the TLS connection, the saved session is kept
+		 * @param transport Transport handle
+		 * @return 0 on success or -1 on failure
+		 */
+		static int close(esp_transport_handle_t transport);
+
+		/**
+		 * Closes the TLS connection and frees the saved session
+		 * @param transport Transport handle
+		 * @return 0 on success or -1 on failure
+		 */
+		static int destroy(esp_transport_handle_t transport);
+
+		/**
+		 * Moves the last esp-tls error into the transport error handle
+		 * The MQTT client reports it in the error event (`esp_tls_last_esp_err`, `esp_tls_stack_err`).
+		 * @param transport Transport handle
+		 * @param tls TLS connection
+		 */
+		static void captureError(esp_transport_handle_t transport, esp_tls_t *tls);
+
+		/**
+		 * Waits until the socket is ready
+		 * @param tls TLS connection
+		 * @param timeoutMs Timeout in milliseconds
+		 * @param write Wait for writing instead of reading
+		 * @return 1 if the socket is ready, 0 on timeout or -1 on failure
+		 */
+		static int poll(esp_tls_t *tls, int timeoutMs, bool write);
+
+		/// Logger tag
+		static constexpr const char *TAG = "MqttTlsTransport";
+		/// Transport handle
+		esp_transport_handle_t handle = nullptr;
+		/// TLS connection
+		esp_tls_t *tls = nullptr;
+		/// Pinned PEM CA certificate
+		std::string certificate;
+		/// Offer the saved session on reconnection
+		bool resumeSessions;
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+		/// Session of the last successful handshake
+		esp_tls_client_session_t *session = nullptr;
+#endif
+		/// Handshake callback
+		MqttTlsTransport::handshake_callback_t onHandshake;
+};
@@ -0,0 +1,97 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Compiled MQTT topic filter with support for `+` and `#` wildcards
+ */
+class MqttTopicFilter {
+	public:
+		/**
+		 * Constructor
+		 * @param filter MQTT topic filter
+		 */
+		explicit MqttTopicFilter(const std::string &filter);
+
+		/**
+		 * Returns the MQTT topic filter
+		 * @return MQTT topic filter
+		 */
+		const std::string &getFilter() const;
+
+		/**
+		 * Does the filter contain any wildcard?
+		 * @return true Filter contains `+` or `#` wildcard
+		 * @return false Filter matches only one exact topic
+		 */
+		bool hasWildcard() const;
+
+		/**
+		 * Is the filter valid according to the MQTT specification?
+		 * @return true Filter is valid
+		 * @return false Filter is invalid
+		 */
+		bool isValid() const;
+
+		/**
+		 * Matches the topic against the filter
+		 * @param topic MQTT topic
+		 * @param wildcards Optional output vector for topic levels matched by `+` wildcards
+		 * @return true Topic matches the filter
+		 * @return false Topic does not match the filter
+		 */
+		bool match(std::string_view topic, std::vector<std::string_view> *wildcards = nullptr) const;
+
+	private:
+		/**
+		 * Topic filter level type
+		 */
+		enum class LevelType : uint8_t {
+			/// Literal topic level
+			Literal,
+			/// Single-level wildcard (`+`)
+			SingleLevel,
+			/// Multi-level wildcard (`#`)
+			MultiLevel,
+		};
+
+		/**
+		 * Compiled topic filter level
+		 */
+		struct Level {
+			/// Level type
+			LevelType type;
+			/// Offset of the literal in the filter string
+			size_t offset;
+			/// Length of the literal
+			size_t length;
+		};
+
+		/// MQTT topic filter
+		std::string filter;
+		/// Compiled topic filter levels
+		std::vector<Level> levels;
+		/// Does the filter contain any wildcard?
+		bool wildcard = false;
+		/// Is the filter valid?
+		bool valid = true;
+};
@@ -67,6 +67,14 @@ class NvsManager {
 		 */
 		esp_err_t getString(const std::string &key, std::string &value);
 
+		/**
+		 * Obtains string from given optional key, a missing key is not an error
+		 * @param key Key
+		 * @param value Obtained value, unchanged if the key is missing
+		 * @return Execution status, ESP_ERR_NVS_NOT_FOUND if the key is missing
+		 */
+		esp_err_t getOptionalString(const std::string &key, std::string &value);
+
 		/**
 		 * Obtains unsigned 8-bit integer from given key
 		 * @param key Key
@@ -75,7 +83,7 @@ class NvsManager {
 		 */
 		template<typename T>
 		esp_err_t get(const std::string &key, T &value) {
-			ESP_LOGI(LOG_TAG, "Reading \"%s\"...", key.c_str());
+			ESP_LOGD(LOG_TAG, "Reading \"%s\"...", key.c_str());
 			esp_err_t result = this->handle->get_item(key.c_str(), value);
 			if (result != ESP_OK) {
 				ESP_LOGE(LOG_TAG, "Failed to obtain %s stored in key \"%s\". Error: %s", typeid(T).name(), key.c_str(), esp_err_to_name(result));
@@ -84,6 +92,22 @@ class NvsManager {
 			return result;
 		}
 
+		/**
+		 * Obtains numeric value from given optional key, a missing key is not an error
+		 * @param key Key
+		 * @param value Obtained value, unchanged if the key is missing
+		 * @return Execution status, ESP_ERR_NVS_NOT_FOUND if the key is missing
+		 */
+		template<typename T>
+		esp_err_t getOptional(const std::string &key, T &value) {
+			ESP_LOGD(LOG_TAG, "Reading optional \"%s\"...", key.c_str());
+			esp_err_t result = this->handle->get_item(key.c_str(), value);
+			if (result != ESP_OK && result != ESP_ERR_NVS_NOT_FOUND) {
+				ESP_LOGE(LOG_TAG, "Failed to obtain %s stored in key \"%s\". Error: %s", typeid(T).name(), key.c_str(), esp_err_to_name(result));
+			}
+			return result;
+		}
+
 		/**
 		 * Sets string for given key
 		 * @param key Key
@@ -108,7 +132,7 @@ class NvsManager {
 		 */
 		template<typename T>
 		esp_err_t set(const std::string &key, const T &value) {
-			ESP_LOGI(LOG_TAG, "Writing %s \"%d\" to key \"%s\".", typeid(T).name(), value, key.c_str());
+			ESP_LOGD(LOG_TAG, "Writing %s \"%d\" to key \"%s\".", typeid(T).name(), value, key.c_str());
 			esp_err_t result = this->handle->set_item(key.c_str(), value);
 			if (result != ESP_OK) {
 				ESP_LOGE(LOG_TAG, "Failed to set %s \"%d\" to key \"%s\". Error: %s", typeid(T).name(), value, key.c_str(), esp_err_to_name(result));
@@ -124,14 +148,14 @@ class NvsManager {
 		 */
 		template<typename T>
 		esp_err_t setDefault(const std::string &key, const T &value) {
-			ESP_LOGI(LOG_TAG, "Writing default %s \"%d\" to key \"%s\".", typeid(T).name(), value, key.c_str());
+			ESP_LOGD(LOG_TAG, "Writing default %s \"%d\" to key \"%s\".", typeid(T).name(), value, key.c_str());
 			T currentValue;
 			esp_err_t result = this->handle->get_item(key.c_str(), currentValue);
 			if (result == ESP_ERR_NVS_NOT_FOUND) {
 				result = this->handle->set_item(key.c_str(), value);
 			}
 			if (result == ESP_OK) {
-				ESP_LOGI(LOG_TAG, "Key \"%s\" (%s) is alreasy set.", key.c_str(), typeid(T).name());
+				ESP_LOGD(LOG_TAG, "Key \"%s\" (%s) is alreasy set.", key.c_str(), typeid(T).name());
 			} else {
 				ESP_LOGE(LOG_TAG, "Failed to set default %s \"%d\" to key \"%s\". Error: %s", typeid(T).name(), value, key.c_str(), esp_err_to_name(result));
 			}
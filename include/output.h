@@ -15,6 +15,8 @@
  */
 #pragma once
 
+#include <functional>
+
 #include <driver/gpio.h>
 
 #include "ina3221.h"
@@ -59,8 +61,10 @@ class Output {
 		/**
 		 * Enables the output
 		 * @param enabled Output enablement
+		 * @return true Output state was applied
+		 * @return false Power-on was denied by the admission callback
 		 */
-		void enable(bool enabled);
+		bool enable(bool enabled);
 
 		/**
 		 * Returns the output index
@@ -99,10 +103,21 @@ class Output {
 		 */
 		static void buttonTask(void *arg);
 
+		/// @brief Power-on admission callback
+		typedef std::function<bool(Output *output)> admission_callback_t;
+
+		/**
+		 * Sets the callback deciding whether a disabled output may be enabled
+		 * @param callback Admission callback
+		 */
+		static void setAdmissionCallback(const admission_callback_t &callback);
+
 		/// @brief Button queue
 		static QueueHandle_t buttonQueue;
 
 	private:
+		/// @brief Power-on admission callback
+		static admission_callback_t admissionCallback;
 		/// @brief Pointer to INA3221 driver instance
 		Ina3221 *ina3221;
 		/// @brief INA3221 channel ID
@@ -0,0 +1,176 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <string_view>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <cJSON.h>
+
+#include "network/mqtt.h"
+#include "network/wifi.h"
+#include "nvsManager.h"
+#include "output.h"
+
+/**
+ * Power budget report of a PDU sharing the upstream supply
+ */
+typedef struct PowerBudgetPeer {
+	/// Measured draw in milliamps
+	uint32_t draw;
+	/// Headroom reserved for outputs being powered on in milliamps
+	uint32_t reserved;
+	/// Shared budget advertised by the PDU in milliamps
+	uint32_t total;
+	/// Time of the report reception in microseconds
+	int64_t receivedAt;
+} powerBudgetPeer_t;
+
+/**
+ * Power budget shared by PDUs on one upstream supply
+ * PDUs of the budget domain publish `{"draw": 1200, "reserved": 500, "total": 10000}` to `sbc_pdu/budget/<domain>/<MAC>`
+ * every second and subscribe to reports of the other members. The shared budget is the lowest total advertised by a member.
+ * An output is powered on only if the draw and reservations of all members including the reserve for the output fit into the budget,
+ * the reservation is published immediately and held until the measured draw reflects the output.
+ * If the broker does not echo own reports, the safe local budget is enforced instead.
+ * If the domain is not configured, power-on is not restricted and outputs are shed only when the draw exceeds the safe local budget.
+ */
+class PowerBudget {
+	public:
+		/**
+		 * Loads the budget configuration from NVS and installs the output admission callback if the budget domain is configured
+		 */
+		static void init();
+
+		/**
+		 * Binds the budget coordination to the MQTT client and subscribes to the reports of the budget domain
+		 * @param mqtt MQTT client
+		 */
+		static void attach(Mqtt *mqtt);
+
+		/**
+		 * Updates the measured draw, expires reservations and publishes the report when it is due
+		 * @param draw Measured draw of all outputs in milliamps
+		 */
+		static void update(float draw);
+
+		/**
+		 * Is the draw of this PDU over its budget and should outputs be shed?
+		 * While coordinated, only PDUs drawing more than the fair share of the budget shed their outputs.
+		 * @param draw Measured draw of all outputs in milliamps
+		 * @return true Outputs have to be shed
+		 * @return false Draw fits into the budget
+		 */
+		static bool isOverBudget(float draw);
+
+		/**
+		 * Returns the current budget limit of this PDU
+		 * @return Budget limit in milliamps
+		 */
+		static uint32_t getLimit();
+
+		/**
+		 * Is the budget coordinated with other members of the budget domain?
+		 * @return true Budget is coordinated
+		 * @return false Safe local budget is enforced
+		 */
+		static bool isCoordinated();
+
+		/**
+		 * Budget report MQTT message callback
+		 * @param event MQTT event
+		 */
+		static void reportCallback(esp_mqtt_event_handle_t event);
+
+		/**
+		 * Output power-on admission callback
+		 * @param output Output to power on
+		 * @return true Power-on is admitted
+		 * @return false Power-on would exceed the budget
+		 */
+		static bool admit(Output *output);
+
+	private:
+		/**
+		 * Returns the budget limit of this PDU, has to be called with the mutex taken
+		 * @param now Current time in microseconds
+		 * @return Budget limit in milliamps
+		 */
+		static uint32_t calculateLimit(int64_t now);
+
+		/**
+		 * Is the budget coordinated, has to be called with the mutex taken
+		 * @param now Current time in microseconds
+		 * @return true Budget is coordinated
+		 * @return false Safe local budget is enforced
+		 */
+		static bool checkCoordinated(int64_t now);
+
+		/**
+		 * Returns the amount of reserved headroom, has to be called with the mutex taken
+		 * @return Reserved headroom in milliamps
+		 */
+		static uint32_t getReserved();
+
+		/**
+		 * Publishes the budget report
+		 */
+		static void publishReport();
+
+		/// Hardware current limit of the PDU in milliamps
+		static constexpr uint32_t HARDWARE_LIMIT = 4200;
+		/// Report interval in microseconds
+		static constexpr int64_t REPORT_INTERVAL = 1000000;
+		/// Time after which a silent member is not counted in microseconds
+		static constexpr int64_t PEER_TIMEOUT = 5000000;
+		/// Time for which the reservation is held after power-on in microseconds
+		static constexpr int64_t RESERVATION_HOLD = 3000000;
+		/// Base topic of the budget domains
+		static constexpr const char *BASE_TOPIC = "sbc_pdu/budget/";
+		/// Budget domain, empty if the budget is not coordinated
+		static std::string domain;
+		/// Topic of own reports
+		static std::string reportTopic;
+		/// Shared budget of the domain in milliamps
+		static uint32_t total;
+		/// Safe local budget in milliamps
+		static uint32_t fallback;
+		/// Reserve for an output being powered on in milliamps
+		static uint32_t reserve;
+		/// Last measured draw in milliamps
+		static uint32_t draw;
+		/// Reservations <expiration time in microseconds, reserved headroom in milliamps>
+		static std::multimap<int64_t, uint32_t> reservations;
+		/// Reports of the other members <MAC address, report>
+		static std::map<std::string, powerBudgetPeer_t> peers;
+		/// Time of the last own report echoed by the broker in microseconds
+		static int64_t lastEcho;
+		/// Time of the last published report in microseconds
+		static int64_t lastReport;
+		/// Pointer to the MQTT client
+		static Mqtt *mqtt;
+		/// Mutex
+		static SemaphoreHandle_t mutex;
+		/// Logger tag
+		static constexpr const char *TAG = "PowerBudget";
+};
@@ -15,54 +15,84 @@
  */
 #pragma once
 
-#include <functional>
+#include <cstdio>
 #include <string>
-#include <vector>
 
 #include <esp_err.h>
 #include <esp_http_server.h>
 
-#include <cJSON.h>
-
 #include "restApi/basicAuthenticator.h"
-#include "restApi/cors.h"
-#include "utils/restApiUtils.h"
+#include "restApi/router.h"
 
 namespace sbc_pdu {
 	namespace restApi {
+		/**
+		 * Update HTTP auth credentials request
+		 */
+		typedef struct {
+			/// New username
+			char username[64];
+			/// Current password
+			char oldPassword[128];
+			/// New password
+			char newPassword[128];
+		} authCredentialsRequest_t;
+
+		/**
+		 * Bearer token response
+		 */
+		typedef struct {
+			/// Token
+			char token[96];
+			/// Token type
+			char type[8];
+			/// Token lifetime in seconds
+			int32_t expiresIn;
+		} authTokenResponse_t;
+
 		/**
 		 * HTTP auth manager REST API endpoints
 		 */
 		class AuthController {
 			public:
-				/**
-				 * Constructor
-				 */
-				AuthController();
-
 				/**
 				 * Registers the endpoints
 				 * @param server HTTP server handle
 				 */
 				void registerEndpoints(const httpd_handle_t &server);
 
+			private:
 				/**
 				 * Checks the HTTP auth credentials
-				 * @param request HTTP request
+				 * @param call REST API call
+				 * @return Execution status
 				 */
-				static esp_err_t get(httpd_req_t *request);
+				static esp_err_t get(restApiCall_t &call);
 
 				/**
 				 * Updates the HTTP auth credentials
-				 * @param request HTTP request
+				 * @param call REST API call
+				 * @return Execution status
 				 */
-				static esp_err_t put(httpd_req_t *request);
+				static esp_err_t put(restApiCall_t &call);
 
-			private:
-				/// Check HTTP auth credentials endpoint handler
-				httpd_uri_t getHandler;
-				/// Update HTTP auth credentials endpoint handler
-				httpd_uri_t putHandler;
+				/**
+				 * Issues the Bearer token for the HTTP Basic credentials
+				 * @param call REST API call
+				 * @return Execution status
+				 */
+				static esp_err_t issueToken(restApiCall_t &call);
+
+				/// Update credentials request fields
+				static const restApiField_t credentialsFields[];
+				/// Update credentials request schema
+				static const restApiSchema_t credentialsSchema;
+				/// Bearer token response fields
+				static const restApiField_t tokenFields[];
+				/// Bearer token response schema
+				static const restApiSchema_t tokenSchema;
+				/// Routes
+				static const restApiRoute_t routes[];
 		};
 	}
 }
@@ -15,12 +15,21 @@
  */
 #pragma once
 
+#include <array>
+#include <charconv>
+#include <cstdio>
 #include <functional>
 #include <string>
+#include <string_view>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <esp_err.h>
 #include <esp_http_server.h>
 #include <esp_log.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+#include <mbedtls/md.h>
 
 #include <cJSON.h>
 
@@ -30,7 +39,10 @@
 namespace sbc_pdu {
 	namespace restApi {
 		/**
-		 * HTTP Basic authenticator
+		 * HTTP Basic and Bearer token authenticator
+		 *
+		 * Credentials are loaded from NVS once and cached until they are changed.
+		 * Bearer tokens are signed with HMAC-SHA256 by a random key, they are revoked by reboot and by the credentials change.
 		 */
 		class BasicAuthenticator {
 			public:
@@ -39,6 +51,11 @@ namespace sbc_pdu {
 				 */
 				explicit BasicAuthenticator();
 
+				/**
+				 * Initializes the authenticator, has to be called before the HTTP server is started
+				 */
+				static void init();
+
 				/**
 				 * Returns Expected HTTP Authorization header
 				 * @return std::string Expected HTTP Authorization header
@@ -48,9 +65,33 @@ namespace sbc_pdu {
 				/**
 				 * Authenticate the user
 				 * @param request HTTP request
+				 * @param allowToken Accept the Bearer token in addition to the Basic credentials
 				 * @return bool Authentication status
 				 */
-				bool authenticate(httpd_req_t *request);
+				bool authenticate(httpd_req_t *request, bool allowToken = true);
+
+				/**
+				 * Checks the Authorization header value
+				 * @param authorization Authorization header value
+				 * @param allowToken Accept the Bearer token in addition to the Basic credentials
+				 * @return true Credentials or token are valid
+				 * @return false Credentials or token are invalid
+				 */
+				bool isAuthorized(std::string_view authorization, bool allowToken = true);
+
+				/**
+				 * Checks the current password
+				 * @param password Password
+				 * @return true Password is correct
+				 * @return false Password is incorrect
+				 */
+				bool verifyPassword(std::string_view password);
+
+				/**
+				 * Issues the signed Bearer token
+				 * @return Bearer token `<expiration>.<signature>`, expiration is the device uptime in seconds
+				 */
+				std::string issueToken();
 
 				/**
 				 * Creates Unauthorized HTTP Response
@@ -58,17 +99,58 @@ namespace sbc_pdu {
 				 */
 				void createUnauthorizedResponse(httpd_req_t *request);
 
+				/**
+				 * Reloads the credentials from NVS and revokes all issued tokens
+				 */
+				static void reload();
+
+				/// Bearer token lifetime in seconds
+				static constexpr uint32_t TOKEN_LIFETIME = 3600;
+
 			private:
+				/**
+				 * Loads the credentials if they are not cached yet, mutex has to be held
+				 */
+				static void load();
+
+				/**
+				 * Verifies the Bearer token
+				 * @param token Bearer token
+				 * @return true Token is valid and not expired
+				 * @return false Token is invalid or expired
+				 */
+				static bool verifyToken(std::string_view token);
+
+				/**
+				 * Computes the hex-encoded token signature, mutex has to be held
+				 * @param payload Signed payload
+				 * @param signature Output buffer for 64 hex digits and the null terminator
+				 */
+				static void sign(std::string_view payload, char *signature);
+
+				/**
+				 * Compares the strings in time independent of their content
+				 * @param value Received value
+				 * @param expected Expected value
+				 * @return true Strings are equal
+				 * @return false Strings differ
+				 */
+				static bool equals(std::string_view value, std::string_view expected);
+
 				/// Logger tag
 				static constexpr const char *TAG = "HTTP auth";
+				/// Maximal length of the Authorization header
+				static constexpr size_t MAX_AUTHORIZATION_LENGTH = 256;
+				/// Mutex protecting the cached credentials
+				static SemaphoreHandle_t mutex;
+				/// Are the credentials cached?
+				static bool loaded;
 				/// Expected Authorizaton HTTP header
-				std::string expectedAuthorizationHeader;
-				///  Username
-				std::string username;
+				static std::string expectedAuthorizationHeader;
 				/// Password
-				std::string password;
-				/// NVS manager
-				NvsManager nvs = NvsManager("httpCredentials");
+				static std::string password;
+				/// Token signing key
+				static std::array<uint8_t, 32> tokenKey;
 		};
 	}
 }
@@ -0,0 +1,169 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <esp_err.h>
+#include <esp_http_server.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "restApi/basicAuthenticator.h"
+#include "restApi/cors.h"
+#include "telemetryBuffer.h"
+#include "telemetryFrame.h"
+
+namespace sbc_pdu {
+	namespace restApi {
+		/**
+		 * Server-sent event kept in the replay buffer
+		 */
+		typedef struct ServerSentEvent {
+			/// Event ID, IDs are increasing since boot
+			uint32_t id;
+			/// Event type
+			const char *type;
+			/// Event data
+			char data[64];
+		} serverSentEvent_t;
+
+		/**
+		 * Server-sent events client
+		 */
+		typedef struct ServerSentEventsClient {
+			/// Asynchronous HTTP request, nullptr if the slot is free
+			httpd_req_t *request;
+			/// ID of the last sent event
+			uint32_t lastEventId;
+		} serverSentEventsClient_t;
+
+		/**
+		 * Server-sent events (text/event-stream) endpoint with measurement, output state and alert events
+		 */
+		class EventsController {
+			public:
+				/**
+				 * Constructor
+				 */
+				EventsController();
+
+				/**
+				 * Registers the endpoints
+				 * @param server HTTP server handle
+				 */
+				void registerEndpoints(const httpd_handle_t &server);
+
+				/**
+				 * Opens the event stream
+				 * The request is kept open by the sender task, the `Last-Event-ID` header resumes the stream from the replay buffer.
+				 * When the resumed events were already overwritten, the state and alert of all outputs are sent again as for a new client.
+				 * @param request HTTP request
+				 * @return Execution status
+				 */
+				static esp_err_t stream(httpd_req_t *request);
+
+				/**
+				 * Are the events recorded?
+				 * Events are recorded while a client is connected and shortly after the last client disconnected, so the client can resume the stream.
+				 * @return true Events are recorded
+				 * @return false No client can use the events
+				 */
+				static bool isActive();
+
+				/**
+				 * Records the measurement events and the output state and alert changes
+				 * @param samples Samples of all outputs from the sampling loop
+				 */
+				static void publish(const std::vector<telemetrySample_t> &samples);
+
+			private:
+				/**
+				 * Appends the event to the replay buffer, mutex has to be held
+				 * @param type Event type
+				 * @param format Event data format
+				 */
+				static void append(const char *type, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+				/**
+				 * Returns the ID of the oldest event in the replay buffer, mutex has to be held
+				 * @return Oldest event ID
+				 */
+				static uint32_t getOldestEventId();
+
+				/**
+				 * Sender task - sends the recorded events to the clients
+				 * @param arg Task argument
+				 */
+				static void senderTask(void *arg);
+
+				/**
+				 * Sends the events recorded after the last sent event to the client
+				 * @param client Client
+				 * @return Execution status, failure means the client has disconnected
+				 */
+				static esp_err_t sendEvents(serverSentEventsClient_t *client);
+
+				/**
+				 * Closes the client stream
+				 * @param client Client
+				 */
+				static void closeClient(serverSentEventsClient_t *client);
+
+				/// Number of events in the replay buffer
+				static constexpr size_t REPLAY_SIZE = 64;
+				/// Maximal number of connected clients
+				static constexpr size_t MAX_CLIENTS = 2;
+				/// Time after the last client disconnected while the events are still recorded in microseconds
+				static constexpr int64_t RESUME_WINDOW = 30000000;
+				/// Interval between keep-alive comments in milliseconds
+				static constexpr uint32_t KEEP_ALIVE_INTERVAL = 15000;
+				/// Reconnection time advertised to the clients in milliseconds
+				static constexpr uint32_t RETRY_INTERVAL = 2000;
+				/// Logger tag
+				static constexpr const char *TAG = "HTTP SSE";
+				/// Replay buffer
+				static std::array<serverSentEvent_t, REPLAY_SIZE> events;
+				/// ID of the next event
+				static uint32_t nextEventId;
+				/// Connected clients
+				static std::array<serverSentEventsClient_t, MAX_CLIENTS> clients;
+				/// Last flags of the outputs, -1 if unknown
+				static std::array<int16_t, UINT8_MAX + 1> flags;
+				/// Should the state and alert of all outputs be recorded with the next samples? Set for new clients and clients which missed overwritten events
+				static bool snapshot;
+				/// Time of the last client disconnection in microseconds
+				static int64_t lastDisconnect;
+				/// Frame buffer of the sender task
+				static char frame[160];
+				/// Mutex protecting the replay buffer and the clients
+				static SemaphoreHandle_t mutex;
+				/// Sender task handle
+				static TaskHandle_t sender;
+				/// Stream endpoint handler
+				httpd_uri_t streamHandler;
+		};
+	}
+}
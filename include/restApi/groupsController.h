@@ -0,0 +1,58 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <esp_err.h>
+#include <esp_http_server.h>
+
+#include <cJSON.h>
+
+#include "groupManager.h"
+#include "restApi/router.h"
+
+namespace sbc_pdu {
+	namespace restApi {
+		/**
+		 * Group REST API endpoints
+		 */
+		class GroupsController {
+			public:
+				/**
+				 * Registers the endpoints
+				 * @param server HTTP server handle
+				 */
+				void registerEndpoints(const httpd_handle_t &server);
+
+			private:
+				/**
+				 * Returns the group configuration
+				 * @param call REST API call
+				 * @return Execution status
+				 */
+				static esp_err_t get(restApiCall_t &call);
+
+				/**
+				 * Updates the group configuration
+				 * @param call REST API call
+				 * @return Execution status
+				 */
+				static esp_err_t put(restApiCall_t &call);
+
+				/// Routes
+				static const restApiRoute_t routes[];
+		};
+	}
+}
@@ -15,25 +15,25 @@
  */
 #pragma once
 
-#include <functional>
+#include <cstdio>
 #include <string>
 
 #include <esp_err.h>
 #include <esp_http_server.h>
 
-#include <cJSON.h>
-
 #include "network/hostname.h"
-#include "restApi/basicAuthenticator.h"
-#include "restApi/cors.h"
-#include "utils/restApiUtils.h"
-
-#ifndef MIN
-#define MIN(a, b) (((a) < (b)) ? (a) : (b))
-#endif
+#include "restApi/router.h"
 
 namespace sbc_pdu {
 	namespace restApi {
+		/**
+		 * Hostname request and response
+		 */
+		typedef struct {
+			/// Hostname
+			char hostname[64];
+		} hostnameMessage_t;
+
 		/**
 		 * Hostname manager REST API endpoints
 		 */
@@ -41,6 +41,7 @@ namespace sbc_pdu {
 			public:
 				/**
 				 * Constructor
+				 * @param hostnameManager Hostname manager
 				 */
 				explicit HostnameController(HostnameManager *hostnameManager);
 
@@ -50,23 +51,29 @@ namespace sbc_pdu {
 				 */
 				void registerEndpoints(const httpd_handle_t &server);
 
+			private:
 				/**
 				 * Returns the hostname
-				 * @param request HTTP request
+				 * @param call REST API call
+				 * @return Execution status
 				 */
-				static esp_err_t get(httpd_req_t *request);
+				static esp_err_t get(restApiCall_t &call);
 
 				/**
 				 * Updates the hostname
-				 * @param request HTTP request
+				 * @param call REST API call
+				 * @return Execution status
 				 */
-				static esp_err_t put(httpd_req_t *request);
+				static esp_err_t put(restApiCall_t &call);
 
-			private:
-				/// Retrieve hostname endpoint handler
-				httpd_uri_t getHandler;
-				/// Update hostname endpoint handler
-				httpd_uri_t putHandler;
+				/// Hostname manager
+				static HostnameManager *manager;
+				/// Hostname fields
+				static const restApiField_t fields[];
+				/// Hostname schema
+				static const restApiSchema_t schema;
+				/// Routes
+				static const restApiRoute_t routes[];
 		};
 	}
 }
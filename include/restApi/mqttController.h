@@ -15,54 +15,110 @@
  */
 #pragma once
 
-#include <functional>
+#include <cstdio>
 #include <string>
-#include <vector>
 
 #include <esp_err.h>
 #include <esp_http_server.h>
 
 #include <cJSON.h>
 
-#include "restApi/basicAuthenticator.h"
-#include "restApi/cors.h"
-#include "utils/restApiUtils.h"
+#include "homeAssistant.h"
+#include "mqttBenchmark.h"
+#include "network/http.h"
+#include "restApi/router.h"
+#include "sbcPduManagement.h"
 
 namespace sbc_pdu {
 	namespace restApi {
+		/**
+		 * MQTT config request and response
+		 */
+		typedef struct {
+			/// Broker URI
+			char uri[256];
+			/// Username
+			char username[128];
+			/// Password
+			char password[128];
+			/// MQTT protocol version (4 - MQTT 3.1.1, 5 - MQTT 5)
+			int32_t protocol;
+			/// Home Assistant discovery mode (0 - entity, 1 - device)
+			int32_t haDiscovery;
+		} mqttConfigMessage_t;
+
+		/**
+		 * Start MQTT benchmark request
+		 */
+		typedef struct {
+			/// Number of synthetic outputs
+			int32_t outputs;
+			/// Duration in seconds
+			int32_t duration;
+		} mqttBenchmarkRequest_t;
+
 		/**
 		 * MQTT manager REST API endpoints
 		 */
 		class MqttController {
 			public:
-				/**
-				 * Constructor
-				 */
-				MqttController();
-
 				/**
 				 * Registers the endpoints
 				 * @param server HTTP server handle
 				 */
 				void registerEndpoints(const httpd_handle_t &server);
 
+			private:
 				/**
 				 * Returns the MQTT config
-				 * @param request HTTP request
+				 * @param call REST API call
+				 * @return Execution status
 				 */
-				static esp_err_t get(httpd_req_t *request);
+				static esp_err_t get(restApiCall_t &call);
 
 				/**
 				 * Updates the MQTT config
-				 * @param request HTTP request
+				 * @param call REST API call
+				 * @return Execution status
 				 */
-				static esp_err_t put(httpd_req_t *request);
+				static esp_err_t put(restApiCall_t &call);
 
-			private:
-				/// Retrieve MQTT config endpoint handler
-				httpd_uri_t getHandler;
-				/// Update MQTT config endpoint handler
-				httpd_uri_t putHandler;
+				/**
+				 * Returns diagnostics of the MQTT clients
+				 * @param call REST API call
+				 * @return Execution status
+				 */
+				static esp_err_t getDiagnostics(restApiCall_t &call);
+
+				/**
+				 * Returns the result of the running or the last MQTT benchmark
+				 * The frontend file transfer statistics are included in the http property.
+				 * @param call REST API call
+				 * @return Execution status
+				 */
+				static esp_err_t getBenchmark(restApiCall_t &call);
+
+				/**
+				 * Starts the MQTT benchmark
+				 * @param call REST API call
+				 * @return Execution status
+				 */
+				static esp_err_t startBenchmark(restApiCall_t &call);
+
+				/// Index of the optional protocol field
+				static constexpr size_t PROTOCOL_FIELD = 3;
+				/// Index of the optional Home Assistant discovery mode field
+				static constexpr size_t HA_DISCOVERY_FIELD = 4;
+				/// MQTT config fields
+				static const restApiField_t configFields[];
+				/// MQTT config schema
+				static const restApiSchema_t configSchema;
+				/// Start MQTT benchmark request fields
+				static const restApiField_t benchmarkFields[];
+				/// Start MQTT benchmark request schema
+				static const restApiSchema_t benchmarkSchema;
+				/// Routes
+				static const restApiRoute_t routes[];
 		};
 	}
 }
@@ -15,9 +15,7 @@
  */
 #pragma once
 
-#include <functional>
 #include <string>
-#include <vector>
 
 #include <esp_err.h>
 #include <esp_http_server.h>
@@ -25,9 +23,7 @@
 #include <cJSON.h>
 
 #include "network/sntp.h"
-#include "restApi/basicAuthenticator.h"
-#include "restApi/cors.h"
-#include "utils/restApiUtils.h"
+#include "restApi/router.h"
 
 namespace sbc_pdu {
 	namespace restApi {
@@ -36,33 +32,39 @@ namespace sbc_pdu {
 		 */
 		class NtpController {
 			public:
-				/**
-				 * Constructor
-				 */
-				NtpController();
-
 				/**
 				 * Registers the endpoints
 				 * @param server HTTP server handle
 				 */
 				void registerEndpoints(const httpd_handle_t &server);
 
+			private:
 				/**
 				 * Returns the NTP config
-				 * @param request HTTP request
+				 * @param call REST API call
+				 * @return Execution status
 				 */
-				static esp_err_t get(httpd_req_t *request);
+				static esp_err_t get(restApiCall_t &call);
 
 				/**
 				 * Updates the NTP config
-				 * @param request HTTP request
+				 * @param call REST API call
+				 * @return Execution status
 				 */
-				static esp_err_t put(httpd_req_t *request);
-			private:
-				/// Retrieve NTP config endpoint handler
-				httpd_uri_t getHandler;
-				/// Update NTP config endpoint handler
-				httpd_uri_t putHandler;
+				static esp_err_t put(restApiCall_t &call);
+
+				/**
+				 * Validates the NTP config
+				 * @param call REST API call
+				 * @param root NTP config JSON object
+				 * @return Execution status
+				 */
+				static esp_err_t validate(restApiCall_t &call, const cJSON *root);
+
+				/// Maximal number of NTP servers
+				static constexpr int MAX_SERVERS = 2;
+				/// Routes
+				static const restApiRoute_t routes[];
 		};
 	}
 }
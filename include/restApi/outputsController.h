@@ -15,23 +15,34 @@
  */
 #pragma once
 
-#include <functional>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <map>
-#include <string>
-#include <vector>
 
 #include <esp_err.h>
 #include <esp_http_server.h>
+#include <esp_log.h>
 
-#include <cJSON.h>
-
+#include "measurementHistory.h"
 #include "output.h"
-#include "restApi/basicAuthenticator.h"
-#include "restApi/cors.h"
-#include "utils/restApiUtils.h"
+#include "restApi/router.h"
 
 namespace sbc_pdu {
 	namespace restApi {
+		/**
+		 * Switch output request
+		 */
+		typedef struct {
+			/// Output index
+			int32_t output;
+			/// Requested output state
+			bool state;
+		} outputSwitchRequest_t;
+
 		/**
 		 * Power outputs manager REST API endpoints
 		 */
@@ -48,25 +59,76 @@ namespace sbc_pdu {
 				 */
 				void registerEndpoints(const httpd_handle_t &server);
 
+			private:
 				/**
-				 * Returns information about zhe outputs
-				 * @param request HTTP request
+				 * Returns information about the outputs
+				 * @param call REST API call
+				 * @return Execution status
 				 */
-				static esp_err_t get(httpd_req_t *request);
+				static esp_err_t get(restApiCall_t &call);
 
 				/**
 				 * Switches on/off the output
+				 * @param call REST API call
+				 * @return Execution status
+				 */
+				static esp_err_t switchOutput(restApiCall_t &call);
+
+				/**
+				 * Returns the measurement history of the output
+				 * @param call REST API call
+				 * @return Execution status
+				 */
+				static esp_err_t getHistory(restApiCall_t &call);
+
+				/**
+				 * Reads the unsigned integer query parameter
+				 * @param query Query string
+				 * @param key Parameter name
+				 * @param value Parameter value, unchanged if the parameter is missing
+				 * @return true Parameter is missing or valid
+				 * @return false Parameter is not an unsigned integer
+				 */
+				static bool readQueryParameter(const char *query, const char *key, uint32_t &value);
+
+				/**
+				 * Streams the measurement history as JSON
 				 * @param request HTTP request
+				 * @param tier History tier
+				 * @param output Output index
+				 * @param from Unix timestamp of the range start in seconds
+				 * @param to Unix timestamp of the range end in seconds
+				 * @param step Step in seconds
+				 * @return Execution status
 				 */
-				static esp_err_t switchOutput(httpd_req_t *request);
+				static esp_err_t writeHistoryJson(httpd_req_t *request, history_tier_t tier, uint8_t output, uint32_t from, uint32_t to, uint32_t step);
 
-			private:
+				/**
+				 * Streams the measurement history as CSV
+				 * @param request HTTP request
+				 * @param tier History tier
+				 * @param output Output index
+				 * @param from Unix timestamp of the range start in seconds
+				 * @param to Unix timestamp of the range end in seconds
+				 * @param step Step in seconds
+				 * @return Execution status
+				 */
+				static esp_err_t writeHistoryCsv(httpd_req_t *request, history_tier_t tier, uint8_t output, uint32_t from, uint32_t to, uint32_t step);
+
+				/// Prefix of the output endpoints with the output ID in the path
+				static constexpr const char *OUTPUT_PREFIX = "/api/v1/outputs/";
+				/// Maximal length of the query string
+				static constexpr size_t MAX_QUERY_LENGTH = 96;
+				/// Maximal number of history points in one response
+				static constexpr uint32_t MAX_HISTORY_POINTS = 4096;
 				/// Outputs
 				static std::map<uint8_t, Output*> *outputs;
-				/// Retrieve information about outputs endpoint handler
-				httpd_uri_t getHandler;
-				/// Switch output endpoint handler
-				httpd_uri_t switchOutputHandler;
+				/// Switch output request fields
+				static const restApiField_t switchFields[];
+				/// Switch output request schema
+				static const restApiSchema_t switchSchema;
+				/// Routes
+				static const restApiRoute_t routes[];
 		};
 	}
 }
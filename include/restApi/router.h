@@ -0,0 +1,198 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <esp_err.h>
+#include <esp_http_server.h>
+#include <esp_log.h>
+
+#include "restApi/basicAuthenticator.h"
+#include "restApi/cors.h"
+#include "utils/jsonReader.h"
+#include "utils/jsonWriter.h"
+#include "utils/restApiUtils.h"
+
+/// Field descriptor of the structure member, the JSON property has the name of the member
+#define REST_API_FIELD(structure, member, type, required) {#member, type, offsetof(structure, member), sizeof(structure::member), required}
+/// Schema of the structure described by the array of field descriptors
+#define REST_API_SCHEMA(structure, fields) {fields, sizeof(fields) / sizeof(fields[0]), sizeof(structure)}
+
+namespace sbc_pdu {
+	namespace restApi {
+		/**
+		 * Authentication requirements of the route
+		 */
+		enum rest_api_auth_t {
+			/// No authentication
+			REST_API_AUTH_NONE,
+			/// HTTP Basic credentials or Bearer token
+			REST_API_AUTH_ANY,
+			/// HTTP Basic credentials only
+			REST_API_AUTH_CREDENTIALS,
+		};
+
+		/**
+		 * Field descriptor, the JSON property is stored in the structure member at the offset
+		 */
+		typedef struct {
+			/// Property name
+			const char *name;
+			/// Property type
+			json_field_type_t type;
+			/// Offset of the structure member
+			size_t offset;
+			/// Size of the structure member
+			size_t size;
+			/// Is the property required in the request?
+			bool required;
+		} restApiField_t;
+
+		/**
+		 * Schema of the request or response structure
+		 */
+		typedef struct {
+			/// Field descriptors
+			const restApiField_t *fields;
+			/// Number of fields
+			size_t count;
+			/// Structure size
+			size_t size;
+		} restApiSchema_t;
+
+		/**
+		 * REST API call passed to the route handler
+		 */
+		typedef struct {
+			/// HTTP request
+			httpd_req_t *request;
+			/// Request structure, nullptr if the route has no request schema
+			const void *body;
+			/// Request fields present in the body, one bit per field in the schema order
+			uint32_t present;
+			/// Response structure, nullptr if the route has no response schema
+			void *response;
+			/// JSON response writer, nullptr if the route does not respond with JSON
+			JsonWriter *writer;
+			/// Error message for the error status returned by the handler
+			const char *error;
+		} restApiCall_t;
+
+		/**
+		 * Route handler
+		 *
+		 * ESP_OK completes the JSON response, other routes have to send their own response.
+		 * ESP_ERR_INVALID_ARG, ESP_ERR_NOT_FOUND and ESP_ERR_INVALID_STATE send 400, 404 and 409 with the error message,
+		 * ESP_FAIL means the response has been sent and the connection is closed, other statuses send 500.
+		 */
+		typedef esp_err_t (*restApiHandler_t)(restApiCall_t &call);
+
+		/**
+		 * REST API route
+		 */
+		typedef struct {
+			/// URI
+			const char *uri;
+			/// HTTP method
+			httpd_method_t method;
+			/// Authentication requirements
+			rest_api_auth_t auth;
+			/// Handler
+			restApiHandler_t handler;
+			/// Request schema, nullptr if the request has no JSON object body
+			const restApiSchema_t *request;
+			/// Response schema, nullptr if the response is not serialized from a structure
+			const restApiSchema_t *response;
+			/// Does the handler write the JSON response without the response schema?
+			bool json;
+		} restApiRoute_t;
+
+		/**
+		 * REST API router dispatching the requests according to the route tables
+		 *
+		 * The dispatcher adds CORS headers, authenticates the request, parses the body into the request structure,
+		 * calls the handler, serializes the response and sends the error responses.
+		 */
+		class Router {
+			public:
+				/**
+				 * Registers the routes
+				 * @tparam N Number of routes
+				 * @param server HTTP server handle
+				 * @param routes Route table, it has to outlive the server
+				 */
+				template<size_t N>
+				static void registerRoutes(const httpd_handle_t &server, const restApiRoute_t (&routes)[N]) {
+					for (const restApiRoute_t &route : routes) {
+						Router::registerRoute(server, route);
+					}
+				}
+
+				/**
+				 * Registers the route
+				 * @param server HTTP server handle
+				 * @param route Route, it has to outlive the server
+				 */
+				static void registerRoute(const httpd_handle_t &server, const restApiRoute_t &route);
+
+			private:
+				/**
+				 * Handles the request of any route
+				 * @param request HTTP request
+				 * @return Execution status
+				 */
+				static esp_err_t dispatch(httpd_req_t *request);
+
+				/**
+				 * Parses the request body into the request structure
+				 * @param call REST API call
+				 * @param schema Request schema
+				 * @return Execution status
+				 */
+				static esp_err_t parseBody(restApiCall_t &call, const restApiSchema_t &schema);
+
+				/**
+				 * Writes the structure as a JSON object
+				 * @param writer JSON writer
+				 * @param schema Structure schema
+				 * @param data Structure
+				 */
+				static void writeObject(JsonWriter &writer, const restApiSchema_t &schema, const void *data);
+
+				/**
+				 * Sends the error response
+				 * @param request HTTP request
+				 * @param status HTTP status
+				 * @param message Error message
+				 */
+				static void sendError(httpd_req_t *request, const char *status, const char *message);
+
+				/// Maximal number of fields in the schema
+				static constexpr size_t MAX_FIELDS = 8;
+				/// Maximal size of the request or response structure
+				static constexpr size_t MAX_STRUCTURE_SIZE = 640;
+				/// Request structure, handlers run one at a time in the HTTP server task
+				alignas(8) static uint8_t body[MAX_STRUCTURE_SIZE];
+				/// Response structure
+				alignas(8) static uint8_t response[MAX_STRUCTURE_SIZE];
+				/// Logger tag
+				static constexpr const char *TAG = "HTTP router";
+		};
+	}
+}
@@ -25,9 +25,9 @@
 
 #include <cJSON.h>
 
+#include "network/http.h"
 #include "network/wifi.h"
-#include "restApi/basicAuthenticator.h"
-#include "restApi/cors.h"
+#include "restApi/router.h"
 #include "utils/interfaceUtils.h"
 
 namespace sbc_pdu {
@@ -37,11 +37,6 @@ namespace sbc_pdu {
 		 */
 		class SystemController {
 			public:
-				/**
-				 * Constructor
-				 */
-				explicit SystemController();
-
 				/**
 				 * Registers the endpoints
 				 * @param server HTTP server handle
@@ -49,48 +44,46 @@ namespace sbc_pdu {
 				void registerEndpoints(const httpd_handle_t &server);
 
 				/**
-				 * Returns the system information
-				 * @param request HTTP request
-				 * @return Execution status
+				 * Writes the chip info object to JSON response
+				 * @param writer JSON writer
 				 */
-				static esp_err_t getInfo(httpd_req_t *request);
+				static void writeChipInfo(JsonWriter &writer);
 
 				/**
-				 * Restarts the unitinsert_final_newline
-				 * @param request HTTP request
-				 * @return Execution status
+				 * Writes the network info object to JSON response
+				 * @param writer JSON writer
 				 */
-				static esp_err_t restart(httpd_req_t *request);
+				static void writeNetworkInfo(JsonWriter &writer);
 
 				/**
-				 * Sets the Chip Info object to JSON response
-				 * @param root JSON root object
+				 * Writes the heap object to JSON response
+				 * @param writer JSON writer
 				 */
-				static void setChipInfo(cJSON *root);
+				static void writeHeapInfo(JsonWriter &writer);
 
 				/**
-				 * Sets the Network Info object to JSON response
-				 * @param root JSON root object
+				 * Writes the NVS object to JSON response
+				 * @param writer JSON writer
 				 */
-				static void setNetworkInfo(cJSON *root);
+				static void writeNvsInfo(JsonWriter &writer);
 
+			private:
 				/**
-				 * Sets the Heap object to JSON response
-				 * @param root JSON root object
+				 * Returns the system information
+				 * @param call REST API call
+				 * @return Execution status
 				 */
-				static void setHeapInfo(cJSON *root);
+				static esp_err_t getInfo(restApiCall_t &call);
 
 				/**
-				 * Sets the NVS object to JSON response
-				 * @param root JSON root object
+				 * Restarts the unit
+				 * @param call REST API call
+				 * @return Execution status
 				 */
-				static void setNvsInfo(cJSON *root);
+				static esp_err_t restart(restApiCall_t &call);
 
-			private:
-				/// Get system info endpoint handler
-				httpd_uri_t getInfoHandler;
-				/// Restart endpoint handler
-				httpd_uri_t restartHandler;
+				/// Routes
+				static const restApiRoute_t routes[];
 		};
 	}
 }
@@ -0,0 +1,197 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sys/time.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_err.h>
+#include <esp_http_server.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <cJSON.h>
+
+#include "output.h"
+#include "restApi/basicAuthenticator.h"
+#include "telemetryBuffer.h"
+#include "telemetryFrame.h"
+
+namespace sbc_pdu {
+	namespace restApi {
+		/**
+		 * Live telemetry WebSocket client
+		 */
+		typedef struct WebSocketClient {
+			/// Socket descriptor
+			int fd;
+			/// Has the client sent valid credentials?
+			bool authenticated;
+			/// Does the client receive the output updates?
+			bool subscribed;
+			/// Minimal interval between updates in microseconds
+			int64_t interval;
+			/// Time of the last update in microseconds
+			int64_t lastUpdate;
+			/// Number of updates queued for sending
+			uint8_t pending;
+			/// Last samples sent to the client <output index, sample>
+			std::map<uint8_t, telemetrySample_t> sent;
+		} webSocketClient_t;
+
+		/**
+		 * Output update queued for sending on the HTTP server task
+		 */
+		typedef struct WebSocketUpdate {
+			/// Socket descriptor
+			int fd;
+			/// Frame payload
+			std::string payload;
+		} webSocketUpdate_t;
+
+		/**
+		 * Live telemetry WebSocket endpoint
+		 *
+		 * Subscribed clients receive the changed outputs from the sampling loop, the client may switch the outputs on the same socket.
+		 */
+		class WebSocketController {
+			public:
+				/**
+				 * Constructor
+				 * @param outputs Output map <index, pointer to output>
+				 */
+				explicit WebSocketController(std::map<uint8_t, Output*> *outputs);
+
+				/**
+				 * Registers the endpoints
+				 * @param server HTTP server handle
+				 */
+				void registerEndpoints(const httpd_handle_t &server);
+
+				/**
+				 * Handles the WebSocket handshake and the received frames
+				 * @param request HTTP request
+				 * @return Execution status, failure closes the socket
+				 */
+				static esp_err_t handle(httpd_req_t *request);
+
+				/**
+				 * Is any client subscribed to the output updates?
+				 * @return true At least one client is subscribed
+				 * @return false No client is subscribed
+				 */
+				static bool hasSubscribers();
+
+				/**
+				 * Sends the changed outputs to all subscribed clients whose update interval elapsed
+				 * @param samples Samples of all outputs from the sampling loop
+				 */
+				static void publish(const std::vector<telemetrySample_t> &samples);
+
+			private:
+				/**
+				 * Handles the received JSON message
+				 * @param request HTTP request
+				 * @param message Received message
+				 */
+				static void handleMessage(httpd_req_t *request, const cJSON *message);
+
+				/**
+				 * Switches the output requested by the client
+				 * @param request HTTP request
+				 * @param message Received message `{"type": "switch", "output": 1, "state": true}`
+				 */
+				static void switchOutput(httpd_req_t *request, const cJSON *message);
+
+				/**
+				 * Creates the response message
+				 * @param type Message type
+				 * @return Response JSON object
+				 */
+				static cJSON *createResponse(const char *type);
+
+				/**
+				 * Sends the response to the received message, the message ID is copied into the response
+				 * @param request HTTP request
+				 * @param message Received message, nullptr if the message could not be parsed
+				 * @param response Response JSON object, it is deleted after sending
+				 */
+				static void reply(httpd_req_t *request, const cJSON *message, cJSON *response);
+
+				/**
+				 * Sends the error response to the received message
+				 * @param request HTTP request
+				 * @param message Received message, nullptr if the message could not be parsed
+				 * @param error Error message
+				 */
+				static void replyError(httpd_req_t *request, const cJSON *message, const std::string &error);
+
+				/**
+				 * Returns the client with the socket descriptor, mutex has to be held
+				 * @param fd Socket descriptor
+				 * @return WebSocket client, nullptr if the client is not registered
+				 */
+				static webSocketClient_t *findClient(int fd);
+
+				/**
+				 * Has the sample changed enough to be sent again?
+				 * @param previous Previously sent sample
+				 * @param sample Current sample
+				 * @return true Sample has to be sent
+				 * @return false Change is below the dead band
+				 */
+				static bool hasChanged(const telemetrySample_t &previous, const telemetrySample_t &sample);
+
+				/**
+				 * Sends the queued update on the HTTP server task
+				 * @param arg Queued update
+				 */
+				static void sendUpdate(void *arg);
+
+				/// Maximal number of connected clients
+				static constexpr size_t MAX_CLIENTS = 4;
+				/// Maximal received frame length in bytes
+				static constexpr size_t MAX_FRAME_LENGTH = 256;
+				/// Default and minimal interval between updates in milliseconds
+				static constexpr uint32_t MIN_INTERVAL = 500;
+				/// Maximal interval between updates in milliseconds
+				static constexpr uint32_t MAX_INTERVAL = 60000;
+				/// Current dead band in microamps
+				static constexpr int32_t CURRENT_DEAD_BAND = 1000;
+				/// Voltage dead band in microvolts
+				static constexpr int32_t VOLTAGE_DEAD_BAND = 10000;
+				/// Logger tag
+				static constexpr const char *TAG = "HTTP WebSocket";
+				/// HTTP server handle
+				static httpd_handle_t server;
+				/// Outputs
+				static std::map<uint8_t, Output*> *outputs;
+				/// Connected clients
+				static std::vector<webSocketClient_t> clients;
+				/// Mutex protecting the clients
+				static SemaphoreHandle_t mutex;
+				/// WebSocket endpoint handler
+				httpd_uri_t handler;
+		};
+	}
+}
@@ -15,22 +15,32 @@
  */
 #pragma once
 
-#include <functional>
+#include <algorithm>
+#include <cstdio>
 #include <string>
+#include <vector>
 
 #include <esp_err.h>
 #include <esp_http_server.h>
 
-#include <cJSON.h>
-
 #include "network/wifi.h"
-#include "restApi/basicAuthenticator.h"
-#include "restApi/cors.h"
+#include "restApi/router.h"
 #include "utils/interfaceUtils.h"
-#include "utils/restApiUtils.h"
 
 namespace sbc_pdu {
 	namespace restApi {
+		/**
+		 * WiFi config request and response
+		 */
+		typedef struct {
+			/// Authentication mode
+			char authMode[32];
+			/// SSID
+			char ssid[33];
+			/// Pre-shared key
+			char psk[65];
+		} wifiConfigMessage_t;
+
 		/**
 		 * WiFi manager REST API endpoints
 		 */
@@ -38,6 +48,7 @@ namespace sbc_pdu {
 			public:
 				/**
 				 * Constructor
+				 * @param manager WiFi manager
 				 */
 				explicit WifiController(Wifi *manager);
 
@@ -47,31 +58,36 @@ namespace sbc_pdu {
 				 */
 				void registerEndpoints(const httpd_handle_t &server);
 
+			private:
 				/**
 				 * Scans the available WiFi APs
-				 * @param request HTTP request
+				 * @param call REST API call
+				 * @return Execution status
 				 */
-				static esp_err_t scan(httpd_req_t *request);
+				static esp_err_t scan(restApiCall_t &call);
 
 				/**
 				 * Returns the WiFi config
-				 * @param request HTTP request
+				 * @param call REST API call
+				 * @return Execution status
 				 */
-				static esp_err_t getConfig(httpd_req_t *request);
+				static esp_err_t getConfig(restApiCall_t &call);
 
 				/**
 				 * Updates the WiFi config
-				 * @param request HTTP request
+				 * @param call REST API call
+				 * @return Execution status
 				 */
-				static esp_err_t putConfig(httpd_req_t *request);
+				static esp_err_t putConfig(restApiCall_t &call);
 
-			private:
-				/// Retrieve WiFi config endpoint handler
-				httpd_uri_t getConfigHandler;
-				/// Update WiFi config endpoint handler
-				httpd_uri_t putConfigHandler;
-				/// Scan endpoint handler
-				httpd_uri_t scanHandler;
+				/// WiFi manager
+				static Wifi *manager;
+				/// WiFi config fields
+				static const restApiField_t configFields[];
+				/// WiFi config schema
+				static const restApiSchema_t configSchema;
+				/// Routes
+				static const restApiRoute_t routes[];
 		};
 	}
 }
@@ -15,12 +15,29 @@
  */
 #pragma once
 
+#include <atomic>
+#include <charconv>
 #include <map>
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include <ctime>
+#include <sys/time.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <cJSON.h>
+
+#include "logManager.h"
+#include "measurementHistory.h"
 #include "network/mqtt.h"
 #include "network/wifi.h"
 #include "output.h"
+#include "nvsManager.h"
+#include "telemetryBuffer.h"
+#include "telemetryFrame.h"
 
 /**
  * SBC PDU Management client
@@ -29,9 +46,12 @@ class SbcPduManagement {
 	public:
 		/**
 		 * Constructor
+		 * @param mqtt MQTT client for output state, alerts and commands
 		 * @param outputs Output map <index, pointer to output>
+		 * @param telemetryBuffer Store-and-forward buffer for telemetry measured while disconnected
+		 * @param telemetryMqtt MQTT client for telemetry frames and history, the state client is used if null
 		 */
-		explicit SbcPduManagement(Mqtt *mqtt, std::map<uint8_t, Output*> *outputs);
+		explicit SbcPduManagement(Mqtt *mqtt, std::map<uint8_t, Output*> *outputs, TelemetryBuffer *telemetryBuffer = nullptr, Mqtt *telemetryMqtt = nullptr);
 
 		/**
 		 * MQTT connect callback
@@ -43,10 +63,25 @@ class SbcPduManagement {
 
 		/**
 		 * Output enablement MQTT message callback
+		 * The output index is parsed directly from the `+` level of the `outputs/+/enable` topic.
 		 * @param event MQTT event
 		 */
 		static void enablementCallback(esp_mqtt_event_handle_t event);
 
+		/**
+		 * Bulk output command MQTT message callback
+		 * Payload: `{"action": "enable" | "disable" | "toggle", "outputs": [1, 2]}`, omitted `outputs` selects all outputs.
+		 * @param event MQTT event
+		 */
+		static void commandCallback(esp_mqtt_event_handle_t event);
+
+		/**
+		 * Log level MQTT message callback
+		 * Payload: `{"MQTT": "debug", "*": "warn"}`, the levels are persisted in NVS.
+		 * @param event MQTT event
+		 */
+		static void logCallback(esp_mqtt_event_handle_t event);
+
 		/**
 		 * Returns the base output MQTT topic
 		 * @param output Pointer to the output
@@ -54,6 +89,10 @@ class SbcPduManagement {
 		 */
 		static std::string getOutputBaseTopic(Output *output);
 
+		/**
+		 * Returns the base device MQTT topic
+		 * @return std::string Base device MQTT topic
+		 */
 		static std::string getDeviceBaseTopic();
 
 		/**
@@ -62,25 +101,143 @@ class SbcPduManagement {
 		 */
 		static void publishOutputAlert(Output *output);
 
+		/**
+		 * @brief Publishes measurements of all outputs to MQTT
+		 * Output state topics are always published by the state client, in CBOR telemetry format all outputs are additionally published in one frame to the telemetry topic.
+		 * @param samples Samples of all outputs from the sampling loop
+		 */
+		static void publishMeasurements(const std::vector<telemetrySample_t> &samples);
+
+		/**
+		 * Publishes the telemetry value
+		 * The value is published with the telemetry QoS of the client, in MQTT 5 mode with topic alias, message expiry and timestamp and unit user properties.
+		 * @param topic Topic
+		 * @param value Value
+		 * @param unit Unit of the value, empty if the value has no unit
+		 * @return Message ID of the published message on success, 0 if the telemetry was queued, Mqtt::PUBLISH_DEFERRED if it was deferred or -1 on failure
+		 */
+		static int publishTelemetry(const std::string &topic, const std::string &value, const std::string &unit);
+
+		/**
+		 * Publishes the CBOR telemetry frame
+		 * @param topic Topic
+		 * @param writer CBOR writer with the encoded frame
+		 * @param qos QoS of published message
+		 * @param expiryInterval Message expiry interval in seconds (MQTT 5 only), 0 disables the expiry
+		 * @param telemetry Publish as telemetry which may be superseded or dropped when the outbox is full
+		 * @return Message ID of the published message on success, 0 if the telemetry was queued, Mqtt::PUBLISH_DEFERRED if it was deferred or -1 on failure
+		 */
+		static int publishFrame(const std::string &topic, const CborWriter &writer, int qos, uint32_t expiryInterval, bool telemetry);
+
+		/**
+		 * Returns the telemetry payload format
+		 * @return Telemetry payload format
+		 */
+		static payload_format_t getTelemetryFormat();
+
+		/**
+		 * Returns the MQTT client for output state, alerts and commands
+		 * @return MQTT client
+		 */
+		static Mqtt *getMqtt();
+
+		/**
+		 * Returns the MQTT client for telemetry frames and history
+		 * @return MQTT client
+		 */
+		static Mqtt *getTelemetryMqtt();
+
+		/// Telemetry message expiry interval in seconds (MQTT 5 only)
+		static constexpr uint32_t TELEMETRY_EXPIRY_INTERVAL = 5;
+
+		/**
+		 * Creates the JSON object with diagnostics of all MQTT clients
+		 * @return Diagnostics JSON object `{"clients": [...]}`
+		 */
+		static cJSON *createDiagnostics();
+
 		/**
 		 * @brief Publishes output measurements to MQTT
+		 * Measurements are stored into the telemetry buffer while the client carrying the telemetry in the configured format is disconnected.
 		 * @param output Pointer to the output
+		 * @param sample Sample of the output from the sampling loop
+		 */
+		static void publishOutputMeasurements(Output *output, const telemetrySample_t &sample);
+
+		/**
+		 * History task - forwards buffered telemetry in rate-limited batches to the history topic
+		 * @param arg Task argument
 		 */
-		static void publishOutputMeasurements(Output *output);
+		static void historyTask(void *arg);
 
 		/**
-		 * Subscribes to output enablemenr
-		 * @param output Output to subscribe
+		 * Published message callback - marks the history batch in flight as delivered
+		 * @param client MQTT client
+		 * @param msgId Message ID of the acknowledged message
 		 */
-		static void subscribeOutputEnablement(Output *output);
+		static void publishedCallback(Mqtt *client, int msgId);
+
+		/**
+		 * Subscribes to output enablement, bulk command and log level topics
+		 */
+		static void subscribeCommands();
 	protected:
 		/// Base MQTT topic
 		static std::string baseTopic;
 		/// Output map <index, pointer to output>
 		static std::map<uint8_t, Output*> *outputs;
 	private:
+		/**
+		 * Publishes buffered telemetry records to the history topic
+		 * @param records Buffered telemetry records
+		 * @param count Number of records
+		 * @return Message ID of the published message on success or -1 on failure
+		 */
+		static int publishHistory(const telemetryRecord_t *records, size_t count);
+
+		/**
+		 * Stores output measurements into the telemetry buffer
+		 * @param sample Sample of the output
+		 */
+		static void bufferOutputMeasurements(const telemetrySample_t &sample);
+
+		/**
+		 * Publishes diagnostics of all MQTT clients to the diagnostics topic of every connected client when they are due
+		 */
+		static void publishDiagnostics();
+
+		/// Interval between diagnostics messages in microseconds
+		static constexpr int64_t DIAGNOSTICS_INTERVAL = 60000000;
+		/// Maximal number of buffered records in one history message
+		static constexpr size_t HISTORY_BATCH_SIZE = 32;
+		/// Interval between history messages in milliseconds
+		static constexpr uint32_t HISTORY_BATCH_INTERVAL = 250;
+		/// Time to wait for the acknowledgement of the history batch before it is published again in microseconds
+		static constexpr int64_t HISTORY_ACK_TIMEOUT = 60000000;
+		/// Minimal interval between buffered records of one output in microseconds
+		static constexpr int64_t HISTORY_SAMPLE_INTERVAL = 5000000;
+		/// CBOR payload content type
+		static constexpr const char *CBOR_CONTENT_TYPE = "application/cbor";
+		/// Telemetry payload format
+		static payload_format_t telemetryFormat;
+		/// History payload format
+		static payload_format_t historyFormat;
+		/// Preallocated CBOR telemetry frame buffer
+		static std::vector<uint8_t> frameBuffer;
 		/// Pointer to the MQTT client
 		static Mqtt *mqtt;
+		/// Pointer to the MQTT client for telemetry frames and history
+		static Mqtt *telemetryMqtt;
+		/// Store-and-forward telemetry buffer
+		static TelemetryBuffer *telemetryBuffer;
+		/// Message ID of the history batch waiting for the acknowledgement, 0 if there is none
+		static std::atomic<int> historyMessageId;
+		/// Was the history batch in flight acknowledged by the broker?
+		static std::atomic<bool> historyDelivered;
+		/// Time of the last buffered record <output index, time in microseconds>
+		static std::map<uint8_t, int64_t> lastBuffered;
+		/// Time of the last diagnostics message in microseconds
+		static int64_t lastDiagnostics;
 		/// Logger tag
 		constexpr static const char *TAG = "SbcPduManagement";
 
@@ -0,0 +1,144 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_partition.h>
+
+#include "nvsManager.h"
+
+/// Output is enabled
+#define TELEMETRY_FLAG_ENABLED (1 << 0)
+/// Output is in alert state
+#define TELEMETRY_FLAG_ALERT (1 << 1)
+
+/**
+ * Buffered telemetry record
+ */
+typedef struct __attribute__((packed)) TelemetryRecord {
+	/// Sequence number, 0xFFFFFFFF marks an erased slot
+	uint32_t sequence;
+	/// Unix timestamp in seconds
+	uint32_t timestamp;
+	/// Current in milliamps
+	float current;
+	/// Voltage in millivolts
+	uint16_t voltage;
+	/// Output index
+	uint8_t output;
+	/// Output flags (TELEMETRY_FLAG_*)
+	uint8_t flags;
+} telemetryRecord_t;
+
+/**
+ * Persistent store-and-forward telemetry ring buffer in a dedicated flash partition
+ */
+class TelemetryBuffer {
+	public:
+		/**
+		 * Constructor
+		 * @param partitionLabel Flash partition label
+		 */
+		explicit TelemetryBuffer(const std::string &partitionLabel = "telemetry");
+
+		/**
+		 * Is the buffer backed by a flash partition?
+		 * @return true Buffer is available
+		 * @return false Partition was not found
+		 */
+		bool isAvailable() const;
+
+		/**
+		 * Appends the record to the buffer, the oldest flash sector is dropped when the buffer is full
+		 * @param record Record to append, the sequence number is assigned by the buffer
+		 * @return Execution status
+		 */
+		esp_err_t append(telemetryRecord_t record);
+
+		/**
+		 * Reads the oldest records which were not acknowledged yet
+		 * @param records Output buffer
+		 * @param count Maximal number of records to read
+		 * @return Number of read records
+		 */
+		size_t peek(telemetryRecord_t *records, size_t count);
+
+		/**
+		 * Acknowledges forwarded records up to the sequence number (inclusive)
+		 * @param sequence Sequence number of the last forwarded record
+		 * @return Execution status
+		 */
+		esp_err_t acknowledge(uint32_t sequence);
+
+		/**
+		 * Returns number of records waiting for forwarding
+		 * @return Number of buffered records
+		 */
+		size_t size();
+
+		/**
+		 * Returns number of records dropped due to the buffer overflow since boot
+		 * @return Number of dropped records
+		 */
+		uint32_t getDropped();
+
+	private:
+		/**
+		 * Recovers the buffer state from the flash partition
+		 */
+		void recover();
+
+		/**
+		 * Reads the record from the slot
+		 * @param slot Slot index
+		 * @param record Read record
+		 * @return Execution status
+		 */
+		esp_err_t readSlot(uint32_t slot, telemetryRecord_t *record);
+
+		/// Erased slot sequence number
+		static constexpr uint32_t ERASED = 0xFFFFFFFF;
+		/// Logger tag
+		static constexpr const char *TAG = "TelemetryBuffer";
+		/// Flash partition
+		const esp_partition_t *partition = nullptr;
+		/// Mutex
+		SemaphoreHandle_t mutex = nullptr;
+		/// Capacity in records
+		uint32_t capacity = 0;
+		/// Number of records in one flash sector
+		uint32_t sectorRecords = 0;
+		/// Slot of the next appended record
+		uint32_t head = 0;
+		/// Slot of the oldest record waiting for forwarding
+		uint32_t tail = 0;
+		/// Number of records waiting for forwarding
+		uint32_t count = 0;
+		/// Sequence number of the next appended record
+		uint32_t nextSequence = 1;
+		/// Number of dropped records
+		uint32_t dropped = 0;
+		/// NVS manager
+		NvsManager nvs = NvsManager("telemetry");
+};
@@ -0,0 +1,97 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/cborWriter.h"
+
+/**
+ * Telemetry payload format
+ */
+typedef enum {
+	/// Text (one value per topic) or JSON payload
+	PAYLOAD_FORMAT_TEXT = 0,
+	/// CBOR telemetry frame, see README.md
+	PAYLOAD_FORMAT_CBOR = 1,
+} payload_format_t;
+
+/**
+ * Telemetry sample of one output
+ */
+typedef struct TelemetrySample {
+	/// Output index
+	uint8_t output;
+	/// Output flags (TELEMETRY_FLAG_*)
+	uint8_t flags;
+	/// Current in microamps
+	int32_t current;
+	/// Voltage in microvolts
+	int32_t voltage;
+	/// Unix timestamp in milliseconds
+	int64_t timestamp;
+} telemetrySample_t;
+
+/**
+ * CBOR telemetry frame encoder
+ */
+class TelemetryFrame {
+	public:
+		/**
+		 * Writes the frame header, the samples have to follow
+		 * @param writer CBOR writer
+		 * @param timestamp Frame Unix timestamp in milliseconds
+		 * @param historical Does the frame contain historical (store-and-forward) samples?
+		 * @param sampleCount Number of samples
+		 */
+		static void begin(CborWriter &writer, int64_t timestamp, bool historical, size_t sampleCount);
+
+		/**
+		 * Writes the sample
+		 * @param writer CBOR writer
+		 * @param sample Telemetry sample
+		 * @param frameTimestamp Frame Unix timestamp in milliseconds
+		 */
+		static void addSample(CborWriter &writer, const telemetrySample_t &sample, int64_t frameTimestamp);
+
+		/**
+		 * Converts the value in milli-units to micro-units
+		 * @param value Value in milli-units
+		 * @return Value in micro-units
+		 */
+		static inline int32_t milliToMicro(float value) {
+			return static_cast<int32_t>(lroundf(value * 1000));
+		}
+
+		/// Frame format version
+		static constexpr uint8_t VERSION = 1;
+		/// Maximal encoded size of the frame header
+		static constexpr size_t MAX_HEADER_SIZE = 24;
+		/// Maximal encoded size of one sample
+		static constexpr size_t MAX_SAMPLE_SIZE = 24;
+
+	private:
+		/// Format version key
+		static constexpr uint8_t KEY_VERSION = 0;
+		/// Frame timestamp key
+		static constexpr uint8_t KEY_TIMESTAMP = 1;
+		/// Historical flag key
+		static constexpr uint8_t KEY_HISTORICAL = 2;
+		/// Samples key
+		static constexpr uint8_t KEY_SAMPLES = 3;
+};
@@ -0,0 +1,67 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <esp_log.h>
+
+/**
+ * Fixed pool of equally sized buffers allocated once at startup
+ * Buffers are lent to concurrent users, so the memory usage does not depend on the number of requests.
+ */
+class BufferPool {
+	public:
+		/**
+		 * Constructor
+		 * @param count Number of buffers
+		 * @param size Size of one buffer in bytes
+		 */
+		BufferPool(size_t count, size_t size);
+
+		/**
+		 * Borrows the buffer from the pool
+		 * @param timeout Maximal time to wait for a returned buffer
+		 * @return Buffer, nullptr if no buffer was returned in time
+		 */
+		char *acquire(TickType_t timeout = portMAX_DELAY);
+
+		/**
+		 * Returns the buffer to the pool
+		 * @param buffer Buffer borrowed from the pool
+		 */
+		void release(char *buffer);
+
+		/**
+		 * Returns the size of one buffer
+		 * @return Size of one buffer in bytes
+		 */
+		size_t getSize() const;
+
+	private:
+		/// Logger tag
+		static constexpr const char *TAG = "BufferPool";
+		/// Memory of all buffers
+		std::vector<char> memory;
+		/// Queue of free buffers
+		QueueHandle_t free;
+		/// Size of one buffer in bytes
+		size_t size;
+};
@@ -0,0 +1,138 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+/**
+ * CBOR (RFC 8949) encoder writing definite-length items into a preallocated buffer
+ */
+class CborWriter {
+	public:
+		/**
+		 * Constructor
+		 * @param buffer Output buffer
+		 * @param size Output buffer size
+		 */
+		CborWriter(uint8_t *buffer, size_t size);
+
+		/**
+		 * Writes unsigned integer
+		 * @param value Value
+		 * @return CBOR writer
+		 */
+		CborWriter &writeUnsigned(uint64_t value);
+
+		/**
+		 * Writes signed integer
+		 * @param value Value
+		 * @return CBOR writer
+		 */
+		CborWriter &writeInteger(int64_t value);
+
+		/**
+		 * Writes boolean
+		 * @param value Value
+		 * @return CBOR writer
+		 */
+		CborWriter &writeBool(bool value);
+
+		/**
+		 * Writes null
+		 * @return CBOR writer
+		 */
+		CborWriter &writeNull();
+
+		/**
+		 * Writes UTF-8 text string
+		 * @param value Value
+		 * @return CBOR writer
+		 */
+		CborWriter &writeText(std::string_view value);
+
+		/**
+		 * Writes byte string
+		 * @param data Data
+		 * @param length Data length
+		 * @return CBOR writer
+		 */
+		CborWriter &writeBytes(const uint8_t *data, size_t length);
+
+		/**
+		 * Writes the head of an array, the items have to follow
+		 * @param length Number of items
+		 * @return CBOR writer
+		 */
+		CborWriter &beginArray(size_t length);
+
+		/**
+		 * Writes the head of a map, the key-value pairs have to follow
+		 * @param length Number of key-value pairs
+		 * @return CBOR writer
+		 */
+		CborWriter &beginMap(size_t length);
+
+		/**
+		 * Returns the encoded data
+		 * @return Encoded data
+		 */
+		const uint8_t *getData() const;
+
+		/**
+		 * Returns the length of the encoded data
+		 * @return Length of the encoded data
+		 */
+		size_t getLength() const;
+
+		/**
+		 * Did any write exceed the buffer size?
+		 * @return true Encoded data are incomplete
+		 * @return false Encoded data are complete
+		 */
+		bool hasOverflowed() const;
+
+		/**
+		 * Discards the encoded data
+		 */
+		void reset();
+
+	private:
+		/**
+		 * Writes the head of the data item
+		 * @param majorType CBOR major type
+		 * @param argument Argument of the head
+		 */
+		void writeHead(uint8_t majorType, uint64_t argument);
+
+		/**
+		 * Writes raw bytes
+		 * @param data Data
+		 * @param length Data length
+		 */
+		void writeRaw(const uint8_t *data, size_t length);
+
+		/// Output buffer
+		uint8_t *buffer;
+		/// Output buffer size
+		size_t size;
+		/// Length of the encoded data
+		size_t length = 0;
+		/// Did any write exceed the buffer size?
+		bool overflow = false;
+};
@@ -0,0 +1,309 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cctype>
+#include <cerrno>
+#include <cinttypes>
+#include <climits>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <esp_err.h>
+
+/**
+ * JSON field types
+ */
+enum json_field_type_t {
+	/// Boolean, the value is stored into bool
+	JSON_FIELD_BOOL,
+	/// Integer, the value is stored into int32_t
+	JSON_FIELD_INTEGER,
+	/// Number, the value is stored into double
+	JSON_FIELD_NUMBER,
+	/// String, the value is stored into char array
+	JSON_FIELD_STRING,
+};
+
+/**
+ * JSON object property extracted by the reader
+ */
+typedef struct {
+	/// Property name
+	const char *name;
+	/// Property type
+	json_field_type_t type;
+	/// Value destination
+	void *value;
+	/// Size of the char array for string values
+	size_t size;
+	/// Is the property required?
+	bool required;
+	/// Was the property present?
+	bool found;
+} jsonField_t;
+
+/**
+ * Incremental JSON reader extracting the top-level properties of an object into typed fields
+ *
+ * The document can be fed in arbitrary parts, so it never has to be held in memory.
+ * Unknown properties and nested values are validated and skipped.
+ */
+class JsonReader {
+	public:
+		/**
+		 * Constructor
+		 * @param fields Extracted fields
+		 * @param count Number of fields
+		 */
+		JsonReader(jsonField_t *fields, size_t count);
+
+		/**
+		 * Creates the boolean field
+		 * @param name Property name
+		 * @param value Value destination
+		 * @param required Is the property required?
+		 * @return Field
+		 */
+		static jsonField_t boolField(const char *name, bool *value, bool required = true);
+
+		/**
+		 * Creates the 32-bit integer field
+		 * @param name Property name
+		 * @param value Value destination
+		 * @param required Is the property required?
+		 * @return Field
+		 */
+		static jsonField_t integerField(const char *name, int32_t *value, bool required = true);
+
+		/**
+		 * Creates the number field
+		 * @param name Property name
+		 * @param value Value destination
+		 * @param required Is the property required?
+		 * @return Field
+		 */
+		static jsonField_t numberField(const char *name, double *value, bool required = true);
+
+		/**
+		 * Creates the string field, longer strings are rejected
+		 * @param name Property name
+		 * @param value Value destination
+		 * @param size Size of the destination including the terminating NUL
+		 * @param required Is the property required?
+		 * @return Field
+		 */
+		static jsonField_t stringField(const char *name, char *value, size_t size, bool required = true);
+
+		/**
+		 * Feeds the next part of the document
+		 * @param data Data
+		 * @param length Data length
+		 * @return Execution status, ESP_ERR_INVALID_ARG if the document is invalid
+		 */
+		esp_err_t feed(const char *data, size_t length);
+
+		/**
+		 * Checks the document is complete and contains all required properties
+		 * @return Execution status, ESP_ERR_INVALID_ARG if the document is invalid
+		 */
+		esp_err_t finish();
+
+		/**
+		 * Returns the error message
+		 * @return Error message, empty if the document is valid
+		 */
+		const char *getError() const;
+
+	private:
+		/**
+		 * Reader states
+		 */
+		enum state_t : uint8_t {
+			/// Expecting a value
+			STATE_VALUE,
+			/// Expecting an array value or the end of the array
+			STATE_VALUE_OR_END,
+			/// Expecting a key or the end of the object
+			STATE_KEY_OR_END,
+			/// Expecting a key
+			STATE_KEY,
+			/// Expecting a colon after the key
+			STATE_COLON,
+			/// Expecting a separator or the end of the container
+			STATE_AFTER_VALUE,
+			/// Inside a string
+			STATE_STRING,
+			/// After a backslash inside a string
+			STATE_ESCAPE,
+			/// Inside an \u escape sequence
+			STATE_UNICODE,
+			/// Inside a number
+			STATE_NUMBER,
+			/// Inside true, false or null
+			STATE_LITERAL,
+			/// After the document
+			STATE_DONE,
+		};
+
+		/**
+		 * Consumes the character
+		 * @param character Character
+		 */
+		void consume(char character);
+
+		/**
+		 * Consumes the first character of a value
+		 * @param character Character
+		 */
+		void beginValue(char character);
+
+		/**
+		 * Completes the value
+		 */
+		void endValue();
+
+		/**
+		 * Completes the innermost container
+		 */
+		void endContainer();
+
+		/**
+		 * Consumes the character inside a string
+		 * @param character Character
+		 */
+		void consumeString(char character);
+
+		/**
+		 * Consumes the character after a backslash
+		 * @param character Character
+		 */
+		void consumeEscape(char character);
+
+		/**
+		 * Consumes the hexadecimal digit of an \u escape sequence
+		 * @param character Character
+		 */
+		void consumeUnicode(char character);
+
+		/**
+		 * Completes the number
+		 */
+		void endNumber();
+
+		/**
+		 * Does the number match the JSON number grammar?
+		 * @param number Null-terminated number
+		 * @return true Number is valid
+		 * @return false Number is invalid
+		 */
+		static bool isValidNumber(const char *number);
+
+		/**
+		 * Completes the literal
+		 */
+		void endLiteral();
+
+		/**
+		 * Appends the character to the key or to the string field
+		 * @param character Character
+		 */
+		void append(char character);
+
+		/**
+		 * Appends the UTF-8 encoded code point to the key or to the string field, null characters are rejected
+		 * @param codePoint Unicode code point
+		 */
+		void appendCodePoint(uint32_t codePoint);
+
+		/**
+		 * Returns the field of the current key
+		 * @return Field, nullptr if the property is not extracted
+		 */
+		jsonField_t *findField();
+
+		/**
+		 * Is the innermost container an array?
+		 * @return true Innermost container is an array
+		 * @return false Innermost container is an object
+		 */
+		bool isArray() const;
+
+		/**
+		 * Fails because the value does not match the field type
+		 */
+		void failType();
+
+		/**
+		 * Fails because of the syntax error at the current offset
+		 */
+		void failSyntax();
+
+		/**
+		 * Fails with the error message
+		 * @param format Message format
+		 */
+		void fail(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+		/// Maximal nesting depth
+		static constexpr uint8_t MAX_DEPTH = 32;
+		/// Extracted fields
+		jsonField_t *fields;
+		/// Number of fields
+		size_t count;
+		/// Field of the current value, nullptr if the value is skipped
+		jsonField_t *field = nullptr;
+		/// Reader state
+		state_t state = STATE_VALUE;
+		/// Nesting depth
+		uint8_t depth = 0;
+		/// Array containers, one bit per nesting level
+		uint32_t arrays = 0;
+		/// Offset of the current character
+		size_t offset = 0;
+		/// Is the current string a key?
+		bool inKey = false;
+		/// Current key
+		char key[32];
+		/// Current key length
+		size_t keyLength = 0;
+		/// Is the current key longer than any extracted property?
+		bool keyOverflow = false;
+		/// Length of the current string field value
+		size_t stringLength = 0;
+		/// Current number
+		char number[32];
+		/// Current number length
+		size_t numberLength = 0;
+		/// Expected literal
+		const char *literal = nullptr;
+		/// Number of matched literal characters
+		size_t literalLength = 0;
+		/// Value of the current \u escape sequence
+		uint32_t unicode = 0;
+		/// Number of digits of the current \u escape sequence
+		uint8_t unicodeLength = 0;
+		/// High surrogate waiting for the low surrogate, 0 if none
+		uint32_t highSurrogate = 0;
+		/// Execution status
+		esp_err_t result = ESP_OK;
+		/// Error message
+		char error[80] = "";
+};
@@ -0,0 +1,248 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cinttypes>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#include <esp_err.h>
+#include <esp_http_server.h>
+
+#include <cJSON.h>
+
+/**
+ * Streaming JSON encoder writing the HTTP response through a fixed buffer
+ *
+ * Full buffer is sent as a response chunk, a response fitting into the buffer is sent at once with Content-Length.
+ * Values inside objects have to be written with a key.
+ */
+class JsonWriter {
+	public:
+		/**
+		 * Constructor
+		 * @param request HTTP request
+		 */
+		explicit JsonWriter(httpd_req_t *request);
+
+		/**
+		 * Writes the member key, the member value has to follow
+		 * @param key Member key
+		 * @return JSON writer
+		 */
+		JsonWriter &writeKey(std::string_view key);
+
+		/**
+		 * Writes the start of an object
+		 * @return JSON writer
+		 */
+		JsonWriter &beginObject();
+
+		/**
+		 * Writes the start of an object member object
+		 * @param key Member key
+		 * @return JSON writer
+		 */
+		JsonWriter &beginObject(std::string_view key);
+
+		/**
+		 * Writes the end of an object
+		 * @return JSON writer
+		 */
+		JsonWriter &endObject();
+
+		/**
+		 * Writes the start of an array
+		 * @return JSON writer
+		 */
+		JsonWriter &beginArray();
+
+		/**
+		 * Writes the start of an object member array
+		 * @param key Member key
+		 * @return JSON writer
+		 */
+		JsonWriter &beginArray(std::string_view key);
+
+		/**
+		 * Writes the end of an array
+		 * @return JSON writer
+		 */
+		JsonWriter &endArray();
+
+		/**
+		 * Writes the string
+		 * @param value Value
+		 * @return JSON writer
+		 */
+		JsonWriter &writeString(std::string_view value);
+
+		/**
+		 * Writes the string member
+		 * @param key Member key
+		 * @param value Value
+		 * @return JSON writer
+		 */
+		JsonWriter &writeString(std::string_view key, std::string_view value);
+
+		/**
+		 * Writes the number, non-finite numbers are written as null
+		 * @param value Value
+		 * @return JSON writer
+		 */
+		JsonWriter &writeNumber(double value);
+
+		/**
+		 * Writes the number member, non-finite numbers are written as null
+		 * @param key Member key
+		 * @param value Value
+		 * @return JSON writer
+		 */
+		JsonWriter &writeNumber(std::string_view key, double value);
+
+		/**
+		 * Writes the integer
+		 * @param value Value
+		 * @return JSON writer
+		 */
+		JsonWriter &writeInteger(int64_t value);
+
+		/**
+		 * Writes the integer member
+		 * @param key Member key
+		 * @param value Value
+		 * @return JSON writer
+		 */
+		JsonWriter &writeInteger(std::string_view key, int64_t value);
+
+		/**
+		 * Writes the boolean
+		 * @param value Value
+		 * @return JSON writer
+		 */
+		JsonWriter &writeBool(bool value);
+
+		/**
+		 * Writes the boolean member
+		 * @param key Member key
+		 * @param value Value
+		 * @return JSON writer
+		 */
+		JsonWriter &writeBool(std::string_view key, bool value);
+
+		/**
+		 * Writes null
+		 * @return JSON writer
+		 */
+		JsonWriter &writeNull();
+
+		/**
+		 * Writes the null member
+		 * @param key Member key
+		 * @return JSON writer
+		 */
+		JsonWriter &writeNull(std::string_view key);
+
+		/**
+		 * Writes the cJSON item without printing it into a temporary string
+		 * @param item cJSON item
+		 * @return JSON writer
+		 */
+		JsonWriter &writeJson(const cJSON *item);
+
+		/**
+		 * Writes the cJSON item member without printing it into a temporary string
+		 * @param key Member key
+		 * @param item cJSON item
+		 * @return JSON writer
+		 */
+		JsonWriter &writeJson(std::string_view key, const cJSON *item);
+
+		/**
+		 * Sends the rest of the buffer and completes the response
+		 * @return Execution status
+		 */
+		esp_err_t finish();
+
+		/**
+		 * Did sending fail or was the nesting too deep?
+		 * @return true Response is incomplete
+		 * @return false Response is complete so far
+		 */
+		bool hasFailed() const;
+
+	private:
+		/**
+		 * Writes the value separator if the value is not the first one in its container
+		 */
+		void beginValue();
+
+		/**
+		 * Writes the start of a container
+		 * @param bracket Opening bracket
+		 */
+		void beginContainer(char bracket);
+
+		/**
+		 * Writes the end of a container
+		 * @param bracket Closing bracket
+		 */
+		void endContainer(char bracket);
+
+		/**
+		 * Writes the quoted and escaped string
+		 * @param value String
+		 */
+		void writeEscaped(std::string_view value);
+
+		/**
+		 * Writes raw bytes
+		 * @param data Data
+		 * @param length Data length
+		 */
+		void writeRaw(const char *data, size_t length);
+
+		/**
+		 * Sends the buffer as a response chunk
+		 */
+		void flush();
+
+		/// Buffer size
+		static constexpr size_t BUFFER_SIZE = 256;
+		/// Maximal nesting depth
+		static constexpr uint8_t MAX_DEPTH = 31;
+		/// HTTP request
+		httpd_req_t *request;
+		/// Output buffer
+		char buffer[BUFFER_SIZE];
+		/// Length of the buffered data
+		size_t length = 0;
+		/// Containers with at least one value, one bit per nesting level
+		uint32_t nonEmpty = 0;
+		/// Nesting depth
+		uint8_t depth = 0;
+		/// Was the member key written without its value?
+		bool afterKey = false;
+		/// Was any chunk sent?
+		bool chunked = false;
+		/// Execution status of sending
+		esp_err_t result = ESP_OK;
+};
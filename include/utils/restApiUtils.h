@@ -15,12 +15,15 @@
  */
 #pragma once
 
+#include <cstdio>
 #include <string>
 
 #include <esp_err.h>
 #include <esp_http_server.h>
 #include <cJSON.h>
 
+#include "utils/jsonReader.h"
+
 #ifndef MIN
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #endif
@@ -42,30 +45,135 @@ class RestApiUtils {
 		}
 
 		/**
-		 * Parses JSON request
+		 * Creates payload too large (error code 413) HTTP response
+		 * @param request HTTP request
+		 * @param maxLength Maximal request body length
+		 */
+		static void createPayloadTooLargeResponse(httpd_req_t *request, size_t maxLength) {
+			char reason[64];
+			snprintf(reason, sizeof(reason), "Request body is larger than %u bytes.", static_cast<unsigned>(maxLength));
+			httpd_resp_set_status(request, "413 Payload Too Large");
+			httpd_resp_set_type(request, "text/plain");
+			// The body is not read, so the connection cannot be reused
+			httpd_resp_set_hdr(request, "Connection", "close");
+			httpd_resp_sendstr(request, reason);
+		}
+
+		/**
+		 * Parses JSON request into the cJSON tree, the whole body is held in memory
 		 *
+		 * Error response is sent if the body is too large or not valid JSON.
 		 * @param request HTTP request
 		 * @param response JSON root
+		 * @param maxLength Maximal request body length
 		 * @return Execution status
 		 */
-		static esp_err_t parseJsonRequest(httpd_req_t *request, cJSON **response) {
-			char content[1024];
-
-			// Truncate if content length larger than the buffer
-			size_t recvSize = MIN(request->content_len, sizeof(content));
-
-			int ret = httpd_req_recv(request, content, recvSize);
-			if (ret <= 0) {
-				// Check if timeout occurred
-				if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-					httpd_resp_send_408(request);
+		static esp_err_t parseJsonRequest(httpd_req_t *request, cJSON **response, size_t maxLength = MAX_REQUEST_LENGTH) {
+			*response = nullptr;
+			if (request->content_len > maxLength) {
+				RestApiUtils::createPayloadTooLargeResponse(request, maxLength);
+				return ESP_FAIL;
+			}
+			char *content = new char[request->content_len + 1];
+			size_t length = 0;
+			while (length < request->content_len) {
+				int ret = RestApiUtils::receive(request, content + length, request->content_len - length);
+				if (ret <= 0) {
+					delete[] content;
+					return ESP_FAIL;
 				}
-				// In case of error, returning ESP_FAIL will ensure that the underlying socket is closed
+				length += ret;
+			}
+			content[length] = '\0';
+			*response = cJSON_ParseWithLength(content, length);
+			delete[] content;
+			if (*response == nullptr) {
+				RestApiUtils::createInvalidBodyResponse(request, "Request body is not valid JSON.");
 				return ESP_FAIL;
 			}
+			return ESP_OK;
+		}
 
-			*response = cJSON_Parse(content);
+		/**
+		 * Parses JSON object request into the typed fields
+		 *
+		 * The body is read in small parts, so its length is limited only by the maximal length.
+		 * Error response is sent if the body is too large, not valid JSON or does not match the fields.
+		 * @param request HTTP request
+		 * @param fields Extracted fields
+		 * @param count Number of fields
+		 * @param maxLength Maximal request body length
+		 * @return Execution status
+		 */
+		static esp_err_t parseJsonRequest(httpd_req_t *request, jsonField_t *fields, size_t count, size_t maxLength = MAX_REQUEST_LENGTH) {
+			if (request->content_len > maxLength) {
+				RestApiUtils::createPayloadTooLargeResponse(request, maxLength);
+				return ESP_FAIL;
+			}
+			JsonReader reader(fields, count);
+			char content[128];
+			size_t remaining = request->content_len;
+			while (remaining > 0) {
+				int ret = RestApiUtils::receive(request, content, MIN(remaining, sizeof(content)));
+				if (ret <= 0) {
+					return ESP_FAIL;
+				}
+				remaining -= ret;
+				// Reading stops at the first error
+				if (reader.feed(content, ret) != ESP_OK) {
+					break;
+				}
+			}
+			if (reader.finish() != ESP_OK) {
+				RestApiUtils::createInvalidBodyResponse(request, reader.getError());
+				return ESP_FAIL;
+			}
 			return ESP_OK;
 		}
 
+		/**
+		 * Parses JSON object request into the typed fields
+		 * @tparam N Number of fields
+		 * @param request HTTP request
+		 * @param fields Extracted fields
+		 * @param maxLength Maximal request body length
+		 * @return Execution status
+		 */
+		template<size_t N>
+		static esp_err_t parseJsonRequest(httpd_req_t *request, jsonField_t (&fields)[N], size_t maxLength = MAX_REQUEST_LENGTH) {
+			return RestApiUtils::parseJsonRequest(request, fields, N, maxLength);
+		}
+
+		/// Default maximal request body length
+		static constexpr size_t MAX_REQUEST_LENGTH = 4096;
+
+	private:
+		/**
+		 * Creates bad request (error code 400) HTTP response for the request body that cannot be processed
+		 * The handler fails after this response, so the connection is closed.
+		 * @param request HTTP request
+		 * @param reason Reason
+		 */
+		static void createInvalidBodyResponse(httpd_req_t *request, const char *reason) {
+			httpd_resp_set_type(request, "text/plain");
+			httpd_resp_set_hdr(request, "Connection", "close");
+			httpd_resp_send_err(request, HTTPD_400_BAD_REQUEST, reason);
+		}
+
+		/**
+		 * Receives the part of the request body, 408 response is sent on timeout
+		 * @param request HTTP request
+		 * @param buffer Buffer
+		 * @param length Maximal length
+		 * @return Number of received bytes, zero or negative on error
+		 */
+		static int receive(httpd_req_t *request, char *buffer, size_t length) {
+			int ret = httpd_req_recv(request, buffer, length);
+			// Check if timeout occurred
+			if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+				httpd_resp_send_408(request);
+			}
+			// In case of error, returning ESP_FAIL will ensure that the underlying socket is closed
+			return ret;
+		}
 };
@@ -0,0 +1,323 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "groupManager.h"
+#include "sbcPduManagement.h"
+
+std::vector<std::string> GroupManager::tags = {};
+groupStagger_t GroupManager::stagger = {GROUP_STAGGER_NONE, 0, 0};
+Mqtt *GroupManager::mqtt = nullptr;
+std::map<uint8_t, Output*> *GroupManager::outputs = nullptr;
+SemaphoreHandle_t GroupManager::mutex = nullptr;
+
+void GroupManager::init() {
+	GroupManager::mutex = xSemaphoreCreateMutex();
+	NvsManager nvs("groups");
+	std::string stored;
+	if (nvs.getString("tags", stored) == ESP_OK) {
+		std::string_view entries(stored);
+		while (!entries.empty()) {
+			size_t end = entries.find(',');
+			std::string_view tag = entries.substr(0, end);
+			entries = end == std::string_view::npos ? std::string_view() : entries.substr(end + 1);
+			if (!GroupManager::isValidTag(tag) || GroupManager::tags.size() >= GroupManager::MAX_TAGS) {
+				ESP_LOGW(TAG, "Ignoring invalid group tag \"%.*s\".", tag.length(), tag.data());
+				continue;
+			}
+			GroupManager::tags.emplace_back(tag);
+		}
+	}
+	uint8_t mode = GROUP_STAGGER_NONE;
+	nvs.get("staggerMode", mode);
+	GroupManager::stagger.mode = mode <= GROUP_STAGGER_SLOTTED ? static_cast<group_stagger_mode_t>(mode) : GROUP_STAGGER_NONE;
+	nvs.get("stagger", GroupManager::stagger.interval);
+	GroupManager::stagger.interval = std::min(GroupManager::stagger.interval, GroupManager::MAX_STAGGER_INTERVAL);
+	nvs.get("slot", GroupManager::stagger.slot);
+}
+
+void GroupManager::attach(Mqtt *mqtt, std::map<uint8_t, Output*> *outputs) {
+	xSemaphoreTake(GroupManager::mutex, portMAX_DELAY);
+	GroupManager::mqtt = mqtt;
+	GroupManager::outputs = outputs;
+	std::vector<std::string> tags = GroupManager::tags;
+	xSemaphoreGive(GroupManager::mutex);
+	mqtt->subscribe(SbcPduManagement::getDeviceBaseTopic() + "/groups", GroupManager::configCallback, 1);
+	GroupManager::updateSubscriptions({}, tags);
+}
+
+esp_err_t GroupManager::configure(const cJSON *config) {
+	if (!cJSON_IsObject(config)) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	const cJSON *tagsItem = cJSON_GetObjectItem(config, "tags");
+	std::vector<std::string> parsedTags;
+	if (tagsItem != nullptr) {
+		if (!cJSON_IsArray(tagsItem) || cJSON_GetArraySize(tagsItem) > static_cast<int>(GroupManager::MAX_TAGS)) {
+			return ESP_ERR_INVALID_ARG;
+		}
+		const cJSON *tag = nullptr;
+		cJSON_ArrayForEach(tag, tagsItem) {
+			if (!cJSON_IsString(tag) || !GroupManager::isValidTag(tag->valuestring)) {
+				return ESP_ERR_INVALID_ARG;
+			}
+			if (std::find(parsedTags.begin(), parsedTags.end(), tag->valuestring) == parsedTags.end()) {
+				parsedTags.emplace_back(tag->valuestring);
+			}
+		}
+	}
+	const cJSON *staggerItem = cJSON_GetObjectItem(config, "stagger");
+	groupStagger_t parsedStagger = GroupManager::getStagger();
+	if (staggerItem != nullptr) {
+		if (!cJSON_IsObject(staggerItem)) {
+			return ESP_ERR_INVALID_ARG;
+		}
+		const cJSON *mode = cJSON_GetObjectItem(staggerItem, "mode");
+		if (mode != nullptr) {
+			if (!cJSON_IsString(mode)) {
+				return ESP_ERR_INVALID_ARG;
+			}
+			auto name = std::find_if(std::begin(GroupManager::STAGGER_MODE_NAMES), std::end(GroupManager::STAGGER_MODE_NAMES), [mode](const char *name) {
+				return std::string_view(name) == mode->valuestring;
+			});
+			if (name == std::end(GroupManager::STAGGER_MODE_NAMES)) {
+				return ESP_ERR_INVALID_ARG;
+			}
+			parsedStagger.mode = static_cast<group_stagger_mode_t>(name - std::begin(GroupManager::STAGGER_MODE_NAMES));
+		}
+		const cJSON *interval = cJSON_GetObjectItem(staggerItem, "interval");
+		if (interval != nullptr) {
+			if (!cJSON_IsNumber(interval) || interval->valuedouble < 0 || interval->valuedouble > GroupManager::MAX_STAGGER_INTERVAL) {
+				return ESP_ERR_INVALID_ARG;
+			}
+			parsedStagger.interval = static_cast<uint32_t>(interval->valuedouble);
+		}
+		const cJSON *slot = cJSON_GetObjectItem(staggerItem, "slot");
+		if (slot != nullptr) {
+			if (!cJSON_IsNumber(slot) || slot->valuedouble < 0 || slot->valuedouble > UINT8_MAX) {
+				return ESP_ERR_INVALID_ARG;
+			}
+			parsedStagger.slot = static_cast<uint8_t>(slot->valuedouble);
+		}
+	}
+	std::vector<std::string> removedTags;
+	std::vector<std::string> addedTags;
+	xSemaphoreTake(GroupManager::mutex, portMAX_DELAY);
+	if (tagsItem != nullptr) {
+		std::copy_if(GroupManager::tags.begin(), GroupManager::tags.end(), std::back_inserter(removedTags), [&parsedTags](const std::string &tag) {
+			return std::find(parsedTags.begin(), parsedTags.end(), tag) == parsedTags.end();
+		});
+		std::copy_if(parsedTags.begin(), parsedTags.end(), std::back_inserter(addedTags), [](const std::string &tag) {
+			return std::find(GroupManager::tags.begin(), GroupManager::tags.end(), tag) == GroupManager::tags.end();
+		});
+		GroupManager::tags = parsedTags;
+	}
+	GroupManager::stagger = parsedStagger;
+	esp_err_t result = GroupManager::store();
+	xSemaphoreGive(GroupManager::mutex);
+	// The client API waits for the MQTT task, whose handlers take the mutex
+	GroupManager::updateSubscriptions(removedTags, addedTags);
+	return result;
+}
+
+void GroupManager::writeJson(JsonWriter &writer) {
+	std::vector<std::string> tags = GroupManager::getTags();
+	groupStagger_t stagger = GroupManager::getStagger();
+	writer.beginObject();
+	writer.beginArray("tags");
+	for (const std::string &tag : tags) {
+		writer.writeString(tag);
+	}
+	writer.endArray();
+	writer.beginObject("stagger");
+	writer.writeString("mode", GroupManager::STAGGER_MODE_NAMES[stagger.mode]);
+	writer.writeInteger("interval", stagger.interval);
+	writer.writeInteger("slot", stagger.slot);
+	writer.endObject();
+	writer.endObject();
+}
+
+std::vector<std::string> GroupManager::getTags() {
+	xSemaphoreTake(GroupManager::mutex, portMAX_DELAY);
+	std::vector<std::string> tags = GroupManager::tags;
+	xSemaphoreGive(GroupManager::mutex);
+	return tags;
+}
+
+groupStagger_t GroupManager::getStagger() {
+	xSemaphoreTake(GroupManager::mutex, portMAX_DELAY);
+	groupStagger_t stagger = GroupManager::stagger;
+	xSemaphoreGive(GroupManager::mutex);
+	return stagger;
+}
+
+void GroupManager::configCallback(esp_mqtt_event_handle_t event) {
+	cJSON *root = cJSON_ParseWithLength(event->data, event->data_len);
+	if (root == nullptr) {
+		ESP_LOGE(TAG, "Invalid group configuration payload.");
+		return;
+	}
+	if (GroupManager::configure(root) != ESP_OK) {
+		ESP_LOGE(TAG, "Failed to set the group configuration.");
+	}
+	cJSON_Delete(root);
+}
+
+void GroupManager::commandCallback(esp_mqtt_event_handle_t event) {
+	if (event->retain) {
+		ESP_LOGW(TAG, "Ignoring retained group command.");
+		return;
+	}
+	cJSON *root = cJSON_ParseWithLength(event->data, event->data_len);
+	if (root == nullptr) {
+		ESP_LOGE(TAG, "Invalid group command payload.");
+		return;
+	}
+	cJSON *action = cJSON_GetObjectItem(root, "action");
+	if (!cJSON_IsString(action)) {
+		ESP_LOGE(TAG, "Missing \"action\" property in the group command.");
+		cJSON_Delete(root);
+		return;
+	}
+	std::string_view actionName(action->valuestring);
+	if (actionName != "enable" && actionName != "disable" && actionName != "toggle" && actionName != "powerCycle") {
+		ESP_LOGE(TAG, "Unknown group command action \"%s\".", action->valuestring);
+		cJSON_Delete(root);
+		return;
+	}
+	uint32_t delay = GroupManager::DEFAULT_POWER_CYCLE_DELAY;
+	cJSON *delayItem = cJSON_GetObjectItem(root, "delay");
+	if (delayItem != nullptr) {
+		if (!cJSON_IsNumber(delayItem) || delayItem->valuedouble < 0 || delayItem->valuedouble > GroupManager::MAX_POWER_CYCLE_DELAY) {
+			ESP_LOGE(TAG, "Invalid power cycle delay in the group command.");
+			cJSON_Delete(root);
+			return;
+		}
+		delay = static_cast<uint32_t>(delayItem->valuedouble);
+	}
+	GroupManager::Command *command = new GroupManager::Command{{}, action->valuestring, delay, 0};
+	cJSON *indices = cJSON_GetObjectItem(root, "outputs");
+	if (cJSON_IsArray(indices)) {
+		cJSON *index = nullptr;
+		cJSON_ArrayForEach(index, indices) {
+			if (!cJSON_IsNumber(index) || index->valuedouble < 0 || index->valuedouble > UINT8_MAX) {
+				continue;
+			}
+			auto output = GroupManager::outputs->find(index->valueint);
+			if (output != GroupManager::outputs->end()) {
+				command->outputs.push_back(output->second);
+			}
+		}
+	} else {
+		for (const auto &[index, output] : *GroupManager::outputs) {
+			command->outputs.push_back(output);
+		}
+	}
+	cJSON_Delete(root);
+	// Disabling does not draw inrush current, only the enabling edge is staggered
+	if (command->action == "powerCycle") {
+		for (Output *output : command->outputs) {
+			output->enable(false);
+		}
+	}
+	if (command->action != "disable") {
+		command->stagger = GroupManager::getStaggerDelay();
+	}
+	if (command->action != "powerCycle" && command->stagger == 0) {
+		GroupManager::execute(*command);
+		delete command;
+		return;
+	}
+	ESP_LOGI(TAG, "Group command \"%s\" scheduled in %lu ms.", command->action.c_str(), (command->action == "powerCycle" ? command->delay : 0) + command->stagger);
+	if (xTaskCreate(GroupManager::commandTask, "groupCommandTask", 4096, command, 5, nullptr) != pdPASS) {
+		ESP_LOGE(TAG, "Unable to schedule the group command, executing immediately.");
+		GroupManager::execute(*command);
+		delete command;
+	}
+}
+
+void GroupManager::execute(const Command &command) {
+	for (Output *output : command.outputs) {
+		if (command.action == "toggle") {
+			output->enable(!output->isEnabled());
+		} else {
+			output->enable(command.action != "disable");
+		}
+	}
+}
+
+void GroupManager::commandTask(void *arg) {
+	GroupManager::Command *command = static_cast<GroupManager::Command *>(arg);
+	uint32_t delay = command->stagger;
+	if (command->action == "powerCycle") {
+		delay += command->delay;
+	}
+	vTaskDelay(pdMS_TO_TICKS(delay));
+	GroupManager::execute(*command);
+	delete command;
+	vTaskDelete(nullptr);
+}
+
+uint32_t GroupManager::getStaggerDelay() {
+	groupStagger_t stagger = GroupManager::getStagger();
+	switch (stagger.mode) {
+		case GROUP_STAGGER_RANDOM:
+			return stagger.interval == 0 ? 0 : esp_random() % (stagger.interval + 1);
+		case GROUP_STAGGER_SLOTTED:
+			return stagger.slot * stagger.interval;
+		default:
+			return 0;
+	}
+}
+
+bool GroupManager::isValidTag(std::string_view tag) {
+	if (tag.empty() || tag.length() > GroupManager::MAX_TAG_LENGTH) {
+		return false;
+	}
+	return std::all_of(tag.begin(), tag.end(), [](char character) {
+		return isalnum(static_cast<unsigned char>(character)) || character == '-' || character == '_';
+	});
+}
+
+std::string GroupManager::getCommandTopic(const std::string &tag) {
+	return GroupManager::BASE_TOPIC + tag + "/command";
+}
+
+void GroupManager::updateSubscriptions(const std::vector<std::string> &removedTags, const std::vector<std::string> &addedTags) {
+	if (GroupManager::mqtt == nullptr) {
+		return;
+	}
+	for (const std::string &tag : removedTags) {
+		GroupManager::mqtt->unsubscribe(GroupManager::getCommandTopic(tag));
+	}
+	for (const std::string &tag : addedTags) {
+		GroupManager::mqtt->subscribe(GroupManager::getCommandTopic(tag), GroupManager::commandCallback, 2);
+	}
+}
+
+esp_err_t GroupManager::store() {
+	std::string stored;
+	for (const std::string &tag : GroupManager::tags) {
+		if (!stored.empty()) {
+			stored += ',';
+		}
+		stored += tag;
+	}
+	NvsManager nvs("groups");
+	nvs.setString("tags", stored);
+	nvs.set("staggerMode", static_cast<uint8_t>(GroupManager::stagger.mode));
+	nvs.set("stagger", GroupManager::stagger.interval);
+	nvs.set("slot", GroupManager::stagger.slot);
+	return nvs.commit();
+}
@@ -18,15 +18,57 @@
 std::string HomeAssistant::baseTopic = "homeassistant/";
 
 std::map<uint8_t, Output*> *HomeAssistant::outputs = nullptr;
+Mqtt *HomeAssistant::mqtt = nullptr;
+SemaphoreHandle_t HomeAssistant::mutex = nullptr;
+std::vector<haDiscovery_t> HomeAssistant::discoveryCache = {};
+ha_discovery_mode_t HomeAssistant::mode = HA_DISCOVERY_ENTITY;
+std::vector<std::string> HomeAssistant::obsoleteTopics = {};
+const std::vector<haSensor_t> HomeAssistant::sensors = {
+	{
+		.name = "current",
+		.icon = "mdi:current-dc",
+		.deviceClass = "current",
+		.unitOfMeasurement = "mA"
+	},
+	{
+		.name = "voltage",
+		.icon = "mdi:current-dc",
+		.deviceClass = "voltage",
+		.unitOfMeasurement = "V"
+	},
+};
 
-HomeAssistant::HomeAssistant(Mqtt *mqtt, std::map<uint8_t, Output*> *outputs): mqtt(mqtt) {
+HomeAssistant::HomeAssistant(Mqtt *mqtt, std::map<uint8_t, Output*> *outputs) {
+	this->mqtt = mqtt;
 	this->outputs = outputs;
+	this->mutex = xSemaphoreCreateMutex();
+	NvsManager nvs("mqtt");
+	uint8_t discoveryMode = HA_DISCOVERY_ENTITY;
+	nvs.get("haDiscovery", discoveryMode);
+	this->mode = discoveryMode == HA_DISCOVERY_DEVICE ? HA_DISCOVERY_DEVICE : HA_DISCOVERY_ENTITY;
+	// Firmware without the device discovery mode advertised entities and did not store the advertised mode
+	uint8_t advertisedMode = HA_DISCOVERY_ENTITY;
+	nvs.getOptional("haAdvertised", advertisedMode);
+	if (advertisedMode != this->mode) {
+		HomeAssistant::collectObsoleteTopics(this->mode == HA_DISCOVERY_DEVICE ? HA_DISCOVERY_ENTITY : HA_DISCOVERY_DEVICE);
+	}
+	HomeAssistant::render();
+	// Retained messages of the unchanged payloads published before the reboot are still on the broker
+	uint32_t publishedDigest = 0;
+	nvs.getOptional("haPublished", publishedDigest);
+	if (publishedDigest != 0 && publishedDigest == HomeAssistant::getDigest()) {
+		for (haDiscovery_t &discovery : HomeAssistant::discoveryCache) {
+			discovery.publishedHash = discovery.hash;
+		}
+	}
+	HostnameManager::setOnChange(HomeAssistant::hostnameCallback);
+	mqtt->subscribe(HomeAssistant::STATUS_TOPIC, HomeAssistant::statusCallback, 1);
 }
 
-void HomeAssistant::advertiseAlert(Mqtt *mqtt, Output *output, cJSON *device) {
+void HomeAssistant::renderAlert(Output *output, cJSON *device) {
 	cJSON *root = cJSON_CreateObject();
 	std::string baseUniqueId = "sbc-pdu_" + Wifi::getPrimaryMacAddress() + "_output_" + std::to_string(output->getIndex()) + "_alert";
-	std::string topic = HomeAssistant::baseTopic + "binary_sensor/sbc-pdu_" + Wifi::getPrimaryMacAddress() + "_output_" + std::to_string(output->getIndex()) + "_alert/config";
+	std::string topic = HomeAssistant::getEntityTopic("binary_sensor", output, "alert");
 	std::string name = "Output #" + std::to_string(output->getIndex()) + " alert";
 	cJSON_AddStringToObject(root, "name", name.c_str());
 	cJSON_AddStringToObject(root, "availability_topic", (SbcPduManagement::getDeviceBaseTopic() + "/status").c_str());
@@ -39,34 +81,14 @@ void HomeAssistant::advertiseAlert(Mqtt *mqtt, Output *output, cJSON *device) {
 	cJSON_AddStringToObject(root, "payload_off", "0");
 	cJSON_AddStringToObject(root, "unique_id", baseUniqueId.c_str());
 	cJSON_AddStringToObject(root, "state_class", "measurement");
-	const char *response = cJSON_PrintUnformatted(root);
-	mqtt->publishString(topic, std::string(response), 2, true);
-	delete response;
-	cJSON_DetachItemFromObject(root, "device");
-	cJSON_Delete(root);
+	HomeAssistant::cache(topic, root);
 }
 
-void HomeAssistant::advertiseSensors(Mqtt *mqtt, Output *output, cJSON *device) {
-	std::vector<haSensor_t> sensors = {
-		{
-			{
-				.name = "current",
-				.icon = "mdi:current-dc",
-				.deviceClass = "current",
-				.unitOfMeasurement = "mA"
-			},
-			{
-				.name = "voltage",
-				.icon = "mdi:current-dc",
-				.deviceClass = "voltage",
-				.unitOfMeasurement = "V"
-			}
-		},
-	};
-	for (auto const &sensor : sensors) {
+void HomeAssistant::renderSensors(Output *output, cJSON *device) {
+	for (auto const &sensor : HomeAssistant::sensors) {
 		cJSON *root = cJSON_CreateObject();
 		std::string baseUniqueId = "sbc-pdu_" + Wifi::getPrimaryMacAddress() + "_output_" + std::to_string(output->getIndex()) + "_" + sensor.deviceClass;
-		std::string topic = HomeAssistant::baseTopic + "sensor/sbc-pdu_" + Wifi::getPrimaryMacAddress() + "_output_" + std::to_string(output->getIndex()) + "_" + sensor.deviceClass + "/config";
+		std::string topic = HomeAssistant::getEntityTopic("sensor", output, sensor.deviceClass);
 		std::string name = "Output #" + std::to_string(output->getIndex()) + " " + sensor.name;
 		cJSON_AddStringToObject(root, "name", name.c_str());
 		cJSON_AddStringToObject(root, "availability_topic", (SbcPduManagement::getDeviceBaseTopic() + "/status").c_str());
@@ -78,39 +100,190 @@ void HomeAssistant::advertiseSensors(Mqtt *mqtt, Output *output, cJSON *device)
 		cJSON_AddStringToObject(root, "unique_id", baseUniqueId.c_str());
 		cJSON_AddStringToObject(root, "unit_of_measurement", sensor.unitOfMeasurement.c_str());
 		cJSON_AddStringToObject(root, "state_class", "measurement");
-		const char *response = cJSON_PrintUnformatted(root);
-		mqtt->publishString(topic, std::string(response), 2, true);
-		delete response;
-		cJSON_DetachItemFromObject(root, "device");
-		cJSON_Delete(root);
+		HomeAssistant::cache(topic, root);
 	}
 }
 
-void HomeAssistant::advertiseSwitch(Mqtt *mqtt, Output *output, cJSON *device) {
-		cJSON *root = cJSON_CreateObject();
-		std::string baseUniqueId = "sbc-pdu_" + Wifi::getPrimaryMacAddress() + "_output_" + std::to_string(output->getIndex()) + "_switch";
-		std::string topic = HomeAssistant::baseTopic + "switch/sbc-pdu_" + Wifi::getPrimaryMacAddress() + "_output_" + std::to_string(output->getIndex()) + "_switch/config";
+void HomeAssistant::renderSwitch(Output *output, cJSON *device) {
+	cJSON *root = cJSON_CreateObject();
+	std::string baseUniqueId = "sbc-pdu_" + Wifi::getPrimaryMacAddress() + "_output_" + std::to_string(output->getIndex()) + "_switch";
+	std::string topic = HomeAssistant::getEntityTopic("switch", output, "switch");
+	std::string outputTopic = SbcPduManagement::getOutputBaseTopic(output);
+	std::string name = "Output #" + std::to_string(output->getIndex());
+	cJSON_AddStringToObject(root, "name", name.c_str());
+	cJSON_AddStringToObject(root, "availability_topic", (SbcPduManagement::getDeviceBaseTopic() + "/status").c_str());
+	cJSON_AddItemToObject(root, "device", device);
+	cJSON_AddStringToObject(root, "state_topic", (outputTopic + "/enabled").c_str());
+	cJSON_AddStringToObject(root, "command_topic", (outputTopic + "/enable").c_str());
+	cJSON_AddStringToObject(root, "payload_on", "1");
+	cJSON_AddStringToObject(root, "payload_off", "0");
+	cJSON_AddNumberToObject(root, "qos", 2);
+	cJSON_AddTrueToObject(root, "enabled_by_default");
+	cJSON_AddStringToObject(root, "icon", "mdi:power");
+	cJSON_AddStringToObject(root, "unique_id", baseUniqueId.c_str());
+	HomeAssistant::cache(topic, root);
+}
+
+void HomeAssistant::renderDevice() {
+	std::string macAddress = Wifi::getPrimaryMacAddress();
+	const esp_app_desc_t *appDescription = esp_app_get_description();
+	HostnameManager hostnameManager;
+	cJSON *root = cJSON_CreateObject();
+	cJSON *device = cJSON_AddObjectToObject(root, "dev");
+	cJSON_AddStringToObject(device, "ids", macAddress.c_str());
+	cJSON_AddStringToObject(device, "cu", ("http://" + hostnameManager.get() + ".local").c_str());
+	cJSON_AddStringToObject(device, "name", ("SBC PDU #" + macAddress).c_str());
+	cJSON_AddStringToObject(device, "mdl", "SBC PDU");
+	cJSON_AddStringToObject(device, "mf", "Roman Ondráček");
+	cJSON_AddStringToObject(device, "sw", appDescription->version);
+	cJSON_AddStringToObject(device, "hw", ("1.0 rev. " + std::to_string(REVISION)).c_str());
+	cJSON *origin = cJSON_AddObjectToObject(root, "o");
+	cJSON_AddStringToObject(origin, "name", "SBC PDU firmware");
+	cJSON_AddStringToObject(origin, "sw", appDescription->version);
+	cJSON_AddStringToObject(root, "avty_t", (SbcPduManagement::getDeviceBaseTopic() + "/status").c_str());
+	cJSON_AddNumberToObject(root, "qos", 2);
+	cJSON *components = cJSON_AddObjectToObject(root, "cmps");
+	for (auto const& [index, output] : *HomeAssistant::outputs) {
+		std::string baseId = "sbc-pdu_" + macAddress + "_output_" + std::to_string(output->getIndex());
+		std::string baseName = "Output #" + std::to_string(output->getIndex());
 		std::string outputTopic = SbcPduManagement::getOutputBaseTopic(output);
-		std::string name = "Output #" + std::to_string(output->getIndex());
-		cJSON_AddStringToObject(root, "name", name.c_str());
-		cJSON_AddStringToObject(root, "availability_topic", (SbcPduManagement::getDeviceBaseTopic() + "/status").c_str());
-		cJSON_AddItemToObject(root, "device", device);
-		cJSON_AddStringToObject(root, "state_topic", (outputTopic + "/enabled").c_str());
-		cJSON_AddStringToObject(root, "command_topic", (outputTopic + "/enable").c_str());
-		cJSON_AddStringToObject(root, "payload_on", "1");
-		cJSON_AddStringToObject(root, "payload_off", "0");
-		cJSON_AddNumberToObject(root, "qos", 2);
-		cJSON_AddTrueToObject(root, "enabled_by_default");
-		cJSON_AddStringToObject(root, "icon", "mdi:power");
-		cJSON_AddStringToObject(root, "unique_id", baseUniqueId.c_str());
-		const char *response = cJSON_PrintUnformatted(root);
-		mqtt->publishString(topic, std::string(response), 2, true);
-		delete response;
-		cJSON_DetachItemFromObject(root, "device");
-		cJSON_Delete(root);
+		cJSON *alert = cJSON_AddObjectToObject(components, (baseId + "_alert").c_str());
+		cJSON_AddStringToObject(alert, "p", "binary_sensor");
+		cJSON_AddStringToObject(alert, "name", (baseName + " alert").c_str());
+		cJSON_AddStringToObject(alert, "dev_cla", "problem");
+		cJSON_AddStringToObject(alert, "ic", "mdi:fuse-alert");
+		cJSON_AddStringToObject(alert, "stat_t", (outputTopic + "/alert").c_str());
+		cJSON_AddStringToObject(alert, "pl_on", "1");
+		cJSON_AddStringToObject(alert, "pl_off", "0");
+		cJSON_AddStringToObject(alert, "uniq_id", (baseId + "_alert").c_str());
+		for (auto const &sensor : HomeAssistant::sensors) {
+			cJSON *component = cJSON_AddObjectToObject(components, (baseId + "_" + sensor.deviceClass).c_str());
+			cJSON_AddStringToObject(component, "p", "sensor");
+			cJSON_AddStringToObject(component, "name", (baseName + " " + sensor.name).c_str());
+			cJSON_AddStringToObject(component, "dev_cla", sensor.deviceClass.c_str());
+			cJSON_AddStringToObject(component, "ic", sensor.icon.c_str());
+			cJSON_AddStringToObject(component, "stat_t", (outputTopic + "/" + sensor.deviceClass).c_str());
+			cJSON_AddStringToObject(component, "unit_of_meas", sensor.unitOfMeasurement.c_str());
+			cJSON_AddStringToObject(component, "stat_cla", "measurement");
+			cJSON_AddStringToObject(component, "uniq_id", (baseId + "_" + sensor.deviceClass).c_str());
+		}
+		cJSON *outputSwitch = cJSON_AddObjectToObject(components, (baseId + "_switch").c_str());
+		cJSON_AddStringToObject(outputSwitch, "p", "switch");
+		cJSON_AddStringToObject(outputSwitch, "name", baseName.c_str());
+		cJSON_AddStringToObject(outputSwitch, "ic", "mdi:power");
+		cJSON_AddStringToObject(outputSwitch, "stat_t", (outputTopic + "/enabled").c_str());
+		cJSON_AddStringToObject(outputSwitch, "cmd_t", (outputTopic + "/enable").c_str());
+		cJSON_AddStringToObject(outputSwitch, "pl_on", "1");
+		cJSON_AddStringToObject(outputSwitch, "pl_off", "0");
+		cJSON_AddStringToObject(outputSwitch, "uniq_id", (baseId + "_switch").c_str());
+	}
+	HomeAssistant::cache(HomeAssistant::getDeviceTopic(), root);
+}
+
+std::string HomeAssistant::getEntityTopic(const std::string &component, Output *output, const std::string &entity) {
+	return HomeAssistant::baseTopic + component + "/sbc-pdu_" + Wifi::getPrimaryMacAddress() + "_output_" + std::to_string(output->getIndex()) + "_" + entity + "/config";
+}
+
+std::string HomeAssistant::getDeviceTopic() {
+	return HomeAssistant::baseTopic + "device/sbc-pdu_" + Wifi::getPrimaryMacAddress() + "/config";
+}
+
+void HomeAssistant::collectObsoleteTopics(ha_discovery_mode_t mode) {
+	if (mode == HA_DISCOVERY_DEVICE) {
+		HomeAssistant::obsoleteTopics.push_back(HomeAssistant::getDeviceTopic());
+		return;
+	}
+	for (auto const& [index, output] : *HomeAssistant::outputs) {
+		HomeAssistant::obsoleteTopics.push_back(HomeAssistant::getEntityTopic("binary_sensor", output, "alert"));
+		for (auto const &sensor : HomeAssistant::sensors) {
+			HomeAssistant::obsoleteTopics.push_back(HomeAssistant::getEntityTopic("sensor", output, sensor.deviceClass));
+		}
+		HomeAssistant::obsoleteTopics.push_back(HomeAssistant::getEntityTopic("switch", output, "switch"));
+	}
+}
+
+void HomeAssistant::removeObsolete(Mqtt *mqtt) {
+	xSemaphoreTake(HomeAssistant::mutex, portMAX_DELAY);
+	// Topics advertised again after switching the mode back are not obsolete
+	std::erase_if(HomeAssistant::obsoleteTopics, [](const std::string &topic) {
+		return std::any_of(HomeAssistant::discoveryCache.begin(), HomeAssistant::discoveryCache.end(), [&topic](const haDiscovery_t &discovery) {
+			return discovery.topic == topic;
+		});
+	});
+	std::vector<std::string> topics = HomeAssistant::obsoleteTopics;
+	xSemaphoreGive(HomeAssistant::mutex);
+	if (topics.empty()) {
+		return;
+	}
+	// Empty retained message removes the entities discovered in the previous mode
+	std::vector<std::string> removed;
+	for (const std::string &topic : topics) {
+		if (mqtt->publishString(topic, "", 2, true) >= 0) {
+			removed.push_back(topic);
+		}
+	}
+	xSemaphoreTake(HomeAssistant::mutex, portMAX_DELAY);
+	std::erase_if(HomeAssistant::obsoleteTopics, [&removed](const std::string &topic) {
+		return std::find(removed.begin(), removed.end(), topic) != removed.end();
+	});
+	bool done = HomeAssistant::obsoleteTopics.empty();
+	ha_discovery_mode_t mode = HomeAssistant::mode;
+	xSemaphoreGive(HomeAssistant::mutex);
+	if (!done) {
+		return;
+	}
+	ESP_LOGI(TAG, "Removed discovery messages of the previous discovery mode.");
+	NvsManager nvs("mqtt");
+	nvs.set("haAdvertised", static_cast<uint8_t>(mode));
+	nvs.commit();
+}
+
+void HomeAssistant::cache(const std::string &topic, cJSON *root) {
+	char *payload = cJSON_PrintUnformatted(root);
+	cJSON_DetachItemFromObject(root, "device");
+	cJSON_Delete(root);
+	if (payload == nullptr) {
+		ESP_LOGE(TAG, "Unable to render discovery message for topic \"%s\".", topic.c_str());
+		return;
+	}
+	std::string_view rendered(payload);
+	uint32_t hash = HomeAssistant::hash(rendered);
+	auto entry = std::find_if(HomeAssistant::discoveryCache.begin(), HomeAssistant::discoveryCache.end(), [&topic](const haDiscovery_t &discovery) {
+		return discovery.topic == topic;
+	});
+	if (entry == HomeAssistant::discoveryCache.end()) {
+		HomeAssistant::discoveryCache.push_back({topic, std::string(rendered), hash, 0});
+	} else if (entry->hash != hash) {
+		entry->payload = rendered;
+		entry->hash = hash;
+	}
+	cJSON_free(payload);
 }
 
-void HomeAssistant::advertise(Mqtt *mqtt) {
+uint32_t HomeAssistant::getDigest() {
+	std::string data;
+	for (const haDiscovery_t &discovery : HomeAssistant::discoveryCache) {
+		data += discovery.topic + ":" + std::to_string(discovery.hash) + "\n";
+	}
+	return HomeAssistant::hash(data);
+}
+
+uint32_t HomeAssistant::hash(std::string_view data) {
+	uint32_t hash = 2166136261;
+	for (char character : data) {
+		hash ^= static_cast<uint8_t>(character);
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+void HomeAssistant::render() {
+	xSemaphoreTake(HomeAssistant::mutex, portMAX_DELAY);
+	if (HomeAssistant::mode == HA_DISCOVERY_DEVICE) {
+		HomeAssistant::renderDevice();
+		xSemaphoreGive(HomeAssistant::mutex);
+		return;
+	}
 	cJSON *device = cJSON_CreateObject();
 	HostnameManager hostnameManager;
 	cJSON_AddStringToObject(device, "identifiers", Wifi::getPrimaryMacAddress().c_str());
@@ -122,13 +295,105 @@ void HomeAssistant::advertise(Mqtt *mqtt) {
 	cJSON_AddStringToObject(device, "sw_version", appDescription->version);
 	cJSON_AddStringToObject(device, "hw_version", ("1.0 rev. " + std::to_string(REVISION)).c_str());
 	for (auto const& [index, output] : *HomeAssistant::outputs) {
-		HomeAssistant::advertiseAlert(mqtt, output, device);
-		HomeAssistant::advertiseSensors(mqtt, output, device);
-		HomeAssistant::advertiseSwitch(mqtt, output, device);
+		HomeAssistant::renderAlert(output, device);
+		HomeAssistant::renderSensors(output, device);
+		HomeAssistant::renderSwitch(output, device);
 	}
 	cJSON_Delete(device);
+	xSemaphoreGive(HomeAssistant::mutex);
+}
+
+void HomeAssistant::advertise(Mqtt *mqtt, bool force) {
+	HomeAssistant::removeObsolete(mqtt);
+	// Messages are copied, the client must not be called while the mutex is held
+	std::vector<haDiscovery_t> pending;
+	xSemaphoreTake(HomeAssistant::mutex, portMAX_DELAY);
+	for (const haDiscovery_t &discovery : HomeAssistant::discoveryCache) {
+		if (force || discovery.publishedHash != discovery.hash) {
+			pending.push_back(discovery);
+		}
+	}
+	xSemaphoreGive(HomeAssistant::mutex);
+	std::erase_if(pending, [mqtt](const haDiscovery_t &discovery) {
+		return mqtt->publishString(discovery.topic, discovery.payload, 2, true) < 0;
+	});
+	xSemaphoreTake(HomeAssistant::mutex, portMAX_DELAY);
+	for (haDiscovery_t &discovery : HomeAssistant::discoveryCache) {
+		auto published = std::find_if(pending.begin(), pending.end(), [&discovery](const haDiscovery_t &item) {
+			return item.topic == discovery.topic && item.hash == discovery.hash;
+		});
+		if (published != pending.end()) {
+			discovery.publishedHash = discovery.hash;
+		}
+	}
+	bool complete = std::all_of(HomeAssistant::discoveryCache.begin(), HomeAssistant::discoveryCache.end(), [](const haDiscovery_t &discovery) {
+		return discovery.publishedHash == discovery.hash;
+	});
+	uint32_t digest = HomeAssistant::getDigest();
+	size_t total = HomeAssistant::discoveryCache.size();
+	xSemaphoreGive(HomeAssistant::mutex);
+	ESP_LOGI(TAG, "Published %u of %u discovery messages.", pending.size(), total);
+	if (!complete || pending.empty()) {
+		return;
+	}
+	NvsManager nvs("mqtt");
+	nvs.set("haPublished", digest);
+	nvs.commit();
+}
+
+void HomeAssistant::update() {
+	HomeAssistant::render();
+	if (HomeAssistant::mqtt->isConnected()) {
+		HomeAssistant::advertise(HomeAssistant::mqtt);
+	}
+}
+
+ha_discovery_mode_t HomeAssistant::getMode() {
+	return HomeAssistant::mode;
+}
+
+void HomeAssistant::setMode(ha_discovery_mode_t mode) {
+	NvsManager nvs("mqtt");
+	nvs.set("haDiscovery", static_cast<uint8_t>(mode));
+	nvs.commit();
+	if (HomeAssistant::mutex == nullptr) {
+		HomeAssistant::mode = mode;
+		return;
+	}
+	xSemaphoreTake(HomeAssistant::mutex, portMAX_DELAY);
+	if (mode == HomeAssistant::mode) {
+		xSemaphoreGive(HomeAssistant::mutex);
+		return;
+	}
+	// Messages of the previous mode are removed by the next advertisement
+	for (const haDiscovery_t &discovery : HomeAssistant::discoveryCache) {
+		HomeAssistant::obsoleteTopics.push_back(discovery.topic);
+	}
+	HomeAssistant::discoveryCache.clear();
+	HomeAssistant::mode = mode;
+	xSemaphoreGive(HomeAssistant::mutex);
+	HomeAssistant::update();
+}
+
+void HomeAssistant::hostnameCallback(const std::string &hostname) {
+	// Configuration URL of the device contains the hostname
+	HomeAssistant::update();
 }
 
 void HomeAssistant::connectCallback(Mqtt* client, esp_event_base_t base, esp_mqtt_event_handle_t event) {
+	if (client != HomeAssistant::mqtt) {
+		return;
+	}
 	HomeAssistant::advertise(client);
 }
+
+void HomeAssistant::statusCallback(esp_mqtt_event_handle_t event) {
+	// Retained status is delivered on every subscription, changed messages are published by the connect callback
+	if (event->retain) {
+		return;
+	}
+	std::string_view status(event->data, event->data_len);
+	if (status == "online") {
+		HomeAssistant::advertise(HomeAssistant::mqtt, true);
+	}
+}
@@ -0,0 +1,137 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "logManager.h"
+
+std::map<std::string, esp_log_level_t> LogManager::levels = {};
+SemaphoreHandle_t LogManager::mutex = nullptr;
+
+void LogManager::init() {
+	LogManager::mutex = xSemaphoreCreateMutex();
+	NvsManager nvs("log");
+	std::string stored;
+	if (nvs.getOptionalString("levels", stored) != ESP_OK) {
+		return;
+	}
+	std::string_view entries(stored);
+	while (!entries.empty()) {
+		size_t end = entries.find(';');
+		std::string_view entry = entries.substr(0, end);
+		entries = end == std::string_view::npos ? std::string_view() : entries.substr(end + 1);
+		size_t separator = entry.find('=');
+		esp_log_level_t level;
+		if (separator == std::string_view::npos || !LogManager::parseLevel(entry.substr(separator + 1), level)) {
+			ESP_LOGW(TAG, "Ignoring invalid log level entry \"%.*s\".", entry.length(), entry.data());
+			continue;
+		}
+		LogManager::setLevel(std::string(entry.substr(0, separator)), level, false);
+	}
+}
+
+esp_err_t LogManager::setLevel(const std::string &tag, esp_log_level_t level, bool persist) {
+	if (tag.empty() || tag.length() > LogManager::MAX_TAG_LENGTH || tag.find_first_of("=;") != std::string::npos) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	xSemaphoreTake(LogManager::mutex, portMAX_DELAY);
+	// The default level has to be set first, it resets levels of all tags
+	if (tag == "*") {
+		esp_log_level_set("*", level);
+		for (const auto &[levelTag, tagLevel] : LogManager::levels) {
+			if (levelTag != "*") {
+				esp_log_level_set(levelTag.c_str(), tagLevel);
+			}
+		}
+	} else {
+		esp_log_level_set(tag.c_str(), level);
+	}
+	LogManager::levels[tag] = level;
+	esp_err_t result = persist ? LogManager::store() : ESP_OK;
+	xSemaphoreGive(LogManager::mutex);
+	return result;
+}
+
+esp_err_t LogManager::setLevels(const cJSON *levels) {
+	if (!cJSON_IsObject(levels)) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	std::map<std::string, esp_log_level_t> parsedLevels;
+	const cJSON *item = nullptr;
+	cJSON_ArrayForEach(item, levels) {
+		esp_log_level_t level;
+		if (!cJSON_IsString(item) || !LogManager::parseLevel(item->valuestring, level)) {
+			return ESP_ERR_INVALID_ARG;
+		}
+		std::string tag(item->string);
+		if (tag.empty() || tag.length() > LogManager::MAX_TAG_LENGTH || tag.find_first_of("=;") != std::string::npos) {
+			return ESP_ERR_INVALID_ARG;
+		}
+		parsedLevels[tag] = level;
+	}
+	esp_err_t result = ESP_OK;
+	for (const auto &[tag, level] : parsedLevels) {
+		result = LogManager::setLevel(tag, level, false);
+		if (result != ESP_OK) {
+			return result;
+		}
+	}
+	xSemaphoreTake(LogManager::mutex, portMAX_DELAY);
+	result = LogManager::store();
+	xSemaphoreGive(LogManager::mutex);
+	return result;
+}
+
+std::map<std::string, esp_log_level_t> LogManager::getLevels() {
+	xSemaphoreTake(LogManager::mutex, portMAX_DELAY);
+	std::map<std::string, esp_log_level_t> levels = LogManager::levels;
+	xSemaphoreGive(LogManager::mutex);
+	if (levels.find("*") == levels.end()) {
+		levels["*"] = static_cast<esp_log_level_t>(CONFIG_LOG_DEFAULT_LEVEL);
+	}
+	return levels;
+}
+
+bool LogManager::parseLevel(std::string_view name, esp_log_level_t &level) {
+	for (size_t i = 0; i < sizeof(LogManager::LEVEL_NAMES) / sizeof(LogManager::LEVEL_NAMES[0]); ++i) {
+		if (name == LogManager::LEVEL_NAMES[i]) {
+			level = static_cast<esp_log_level_t>(i);
+			return level <= LogManager::MAXIMUM_LEVEL;
+		}
+	}
+	return false;
+}
+
+const char *LogManager::getLevelName(esp_log_level_t level) {
+	if (level > ESP_LOG_VERBOSE) {
+		return "verbose";
+	}
+	return LogManager::LEVEL_NAMES[level];
+}
+
+esp_err_t LogManager::store() {
+	std::string stored;
+	for (const auto &[tag, level] : LogManager::levels) {
+		if (!stored.empty()) {
+			stored.push_back(';');
+		}
+		stored.append(tag).push_back('=');
+		stored.append(LogManager::getLevelName(level));
+	}
+	NvsManager nvs("log");
+	esp_err_t result = nvs.setString("levels", stored);
+	if (result != ESP_OK) {
+		return result;
+	}
+	return nvs.commit();
+}
@@ -24,9 +24,11 @@
 #include <vector>
 #include <cJSON.h>
 
+#include "groupManager.h"
 #include "homeAssistant.h"
 #include "i2c_master.h"
 #include "ina3221.h"
+#include "logManager.h"
 #if REVISION == 2
 #include "network/ethernet.h"
 #endif
@@ -37,18 +39,27 @@
 #include "network/sntp.h"
 #include "network/wifi.h"
 #include "nvsManager.h"
+#include "powerBudget.h"
 #include "mcp7940n.h"
+#include "measurementHistory.h"
+#include "mqttBenchmark.h"
+#include "mqttRpc.h"
 #include "restApi/authController.h"
 #include "restApi/basicAuthenticator.h"
+#include "restApi/eventsController.h"
+#include "restApi/groupsController.h"
 #include "restApi/hostnameController.h"
+#include "restApi/logController.h"
 #include "restApi/mqttController.h"
 #include "restApi/ntpController.h"
 #include "restApi/outputsController.h"
 #include "restApi/systemController.h"
+#include "restApi/webSocketController.h"
 #include "restApi/wifiController.h"
 #include "sbcPduManagement.h"
 #include "output.h"
 #include "spiffs.h"
+#include "telemetryBuffer.h"
 
 extern "C" void app_main();
 
@@ -126,8 +137,16 @@ void initHttp(Wifi *wifi, HostnameManager *hostnameManager) {
 	ntp.registerEndpoints(httpdHandle);
 	restApi::MqttController mqtt = restApi::MqttController();
 	mqtt.registerEndpoints(httpdHandle);
+	restApi::LogController logController = restApi::LogController();
+	logController.registerEndpoints(httpdHandle);
+	restApi::GroupsController groupsController = restApi::GroupsController();
+	groupsController.registerEndpoints(httpdHandle);
 	restApi::OutputsController outputsController = restApi::OutputsController(&outputs);
 	outputsController.registerEndpoints(httpdHandle);
+	restApi::WebSocketController webSocketController = restApi::WebSocketController(&outputs);
+	webSocketController.registerEndpoints(httpdHandle);
+	restApi::EventsController eventsController = restApi::EventsController();
+	eventsController.registerEndpoints(httpdHandle);
 	httpServer.registerFrontendHandler();
 	httpServer.registerCorsHandler();
 }
@@ -136,14 +155,29 @@ void initHttp(Wifi *wifi, HostnameManager *hostnameManager) {
  * Initializes MQTT client
  */
 void initMqtt() {
-	MqttConfig config = MqttConfig();
 	MqttLastWillAndTestament lwt = MqttLastWillAndTestament(SbcPduManagement::getDeviceBaseTopic() + "/status", "offline", 2, true);
+	MqttConfig config = MqttConfig("mqtt");
 	config.setLastWillAndTestament(&lwt);
 	Mqtt *mqtt = new Mqtt(config);
 	mqtt->setOnConnect(mqttConnectCallback);
+	// Optional fleet broker receives telemetry frames, history and RPC, Home Assistant discovery and output state stay on the primary broker
+	Mqtt *fleetMqtt = mqtt;
+	MqttConfig fleetConfig = MqttConfig("mqttFleet");
+	if (!fleetConfig.getBrokerUri().empty()) {
+		fleetConfig.setLastWillAndTestament(&lwt);
+		fleetConfig.setClientId("sbc_pdu-" + Wifi::getPrimaryMacAddress() + "-fleet");
+		fleetMqtt = new Mqtt(fleetConfig);
+		fleetMqtt->setOnConnect(mqttConnectCallback);
+	}
 	homeAssistant = new HomeAssistant(mqtt, &outputs);
-	pduManagement = new SbcPduManagement(mqtt, &outputs);
+	pduManagement = new SbcPduManagement(mqtt, &outputs, new TelemetryBuffer(), fleetMqtt);
+	new MqttRpc(fleetMqtt, &outputs);
+	GroupManager::attach(fleetMqtt, &outputs);
+	PowerBudget::attach(fleetMqtt);
 	mqtt->connect();
+	if (fleetMqtt != mqtt) {
+		fleetMqtt->connect();
+	}
 }
 
 /**
@@ -162,7 +196,42 @@ void initNvs() {
 	mqttNvs.setStringDefault("uri", "mqtts://mqtt.romanondracek.cz:8883");
 	mqttNvs.setStringDefault("username", "sbc_pdu");
 	mqttNvs.setStringDefault("password", "password");
+	mqttNvs.setDefault("protocol", static_cast<uint8_t>(4));
+	mqttNvs.setDefault("aliasMax", static_cast<uint16_t>(16));
+	mqttNvs.setDefault("outboxMax", static_cast<uint32_t>(16384));
+	mqttNvs.setDefault("telemetryFmt", static_cast<uint8_t>(PAYLOAD_FORMAT_TEXT));
+	mqttNvs.setDefault("historyFmt", static_cast<uint8_t>(PAYLOAD_FORMAT_TEXT));
+	mqttNvs.setDefault("haDiscovery", static_cast<uint8_t>(HA_DISCOVERY_ENTITY));
+	mqttNvs.setDefault("tlsResume", static_cast<uint8_t>(1));
+	mqttNvs.setStringDefault("caCert", "");
+	mqttNvs.setStringDefault("caFile", "");
 	mqttNvs.commit();
+	// MQTT fleet broker NVS
+	NvsManager mqttFleetNvs("mqttFleet");
+	mqttFleetNvs.setStringDefault("uri", "");
+	mqttFleetNvs.setStringDefault("username", "");
+	mqttFleetNvs.setStringDefault("password", "");
+	mqttFleetNvs.setDefault("protocol", static_cast<uint8_t>(4));
+	mqttFleetNvs.setDefault("aliasMax", static_cast<uint16_t>(16));
+	mqttFleetNvs.setDefault("outboxMax", static_cast<uint32_t>(16384));
+	mqttFleetNvs.setDefault("tlsResume", static_cast<uint8_t>(1));
+	mqttFleetNvs.setStringDefault("caCert", "");
+	mqttFleetNvs.setStringDefault("caFile", "");
+	mqttFleetNvs.commit();
+	// PDU groups NVS
+	NvsManager groupsNvs("groups");
+	groupsNvs.setStringDefault("tags", "");
+	groupsNvs.setDefault("staggerMode", static_cast<uint8_t>(GROUP_STAGGER_NONE));
+	groupsNvs.setDefault("stagger", static_cast<uint32_t>(500));
+	groupsNvs.setDefault("slot", static_cast<uint8_t>(0));
+	groupsNvs.commit();
+	// Power budget NVS
+	NvsManager budgetNvs("budget");
+	budgetNvs.setStringDefault("domain", "");
+	budgetNvs.setDefault("total", static_cast<uint32_t>(0));
+	budgetNvs.setDefault("fallback", static_cast<uint32_t>(4200));
+	budgetNvs.setDefault("reserve", static_cast<uint32_t>(500));
+	budgetNvs.commit();
 	// SNTP NVS
 	NvsManager ntpNvs("ntp");
 	uint8_t ntpServers = 2;
@@ -228,6 +297,12 @@ void app_main() {
 	ESP_ERROR_CHECK(esp_event_loop_create_default());
 	ESP_ERROR_CHECK(esp_tls_init_global_ca_store());
 	initNvs();
+	LogManager::init();
+	GroupManager::init();
+	PowerBudget::init();
+	MeasurementHistory::init();
+	MqttBenchmark::init();
+	sbc_pdu::restApi::BasicAuthenticator::init();
 	// Install GPIO ISR service
 	gpio_install_isr_service(0);
 	I2C *i2c = new I2C(I2C_NUM_0, GPIO_NUM_4, GPIO_NUM_5);
@@ -244,9 +319,15 @@ void app_main() {
 	Ntp ntp = Ntp(rtc);
 	initHttp(wifi, hostname);
 	initMqtt();
+	// Samples for the live telemetry and the measurement history, the capacity is reused between the iterations
+	std::vector<telemetrySample_t> samples;
+	samples.reserve(outputs.size());
 	while (1) {
 		float totalCurrent = 0;
 		std::pair<float, Output*> maxCurrent = {0, nullptr};
+		bool liveTelemetry = sbc_pdu::restApi::WebSocketController::hasSubscribers();
+		bool eventStream = sbc_pdu::restApi::EventsController::isActive();
+		samples.clear();
 		for (const auto& outputPair : outputs) {
 			Output *output = outputPair.second;
 			float current = fabs(output->readCurrent());
@@ -254,13 +335,28 @@ void app_main() {
 			if (current > maxCurrent.first) {
 				maxCurrent = {current, output};
 			}
-			if (pduManagement != nullptr) {
-				pduManagement->publishOutputMeasurements(output);
-			}
+			samples.push_back({
+				.output = static_cast<uint8_t>(output->getIndex()),
+				.flags = static_cast<uint8_t>((output->isEnabled() ? TELEMETRY_FLAG_ENABLED : 0) | (output->hasAlert() ? TELEMETRY_FLAG_ALERT : 0)),
+				.current = TelemetryFrame::milliToMicro(current),
+				.voltage = TelemetryFrame::milliToMicro(output->readVoltage() * 1000),
+				.timestamp = 0,
+			});
+		}
+		MeasurementHistory::record(samples);
+		if (liveTelemetry) {
+			sbc_pdu::restApi::WebSocketController::publish(samples);
+		}
+		if (eventStream) {
+			sbc_pdu::restApi::EventsController::publish(samples);
+		}
+		if (pduManagement != nullptr) {
+			pduManagement->publishMeasurements(samples);
 		}
-		if (totalCurrent > 4200) {
+		PowerBudget::update(totalCurrent);
+		if (PowerBudget::isOverBudget(totalCurrent)) {
 			uint32_t index = maxCurrent.second->getIndex();
-			ESP_LOGE("Output", "Total current %f mA is too high, disabling output %lu", totalCurrent, index);
+			ESP_LOGE("Output", "Total current %f mA is over the power budget, disabling output %lu", totalCurrent, index);
 			maxCurrent.second->enable(false);
 		}
 		vTaskDelay(pdMS_TO_TICKS(500));
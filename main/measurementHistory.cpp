@@ -0,0 +1,547 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "measurementHistory.h"
+
+const esp_partition_t *MeasurementHistory::partition = nullptr;
+historyRegion_t MeasurementHistory::regions[HISTORY_TIER_COUNT - 1] = {};
+historyPoint_t *MeasurementHistory::seconds[MeasurementHistory::MAX_OUTPUTS] = {};
+size_t MeasurementHistory::secondsHead[MeasurementHistory::MAX_OUTPUTS] = {};
+size_t MeasurementHistory::secondsCount[MeasurementHistory::MAX_OUTPUTS] = {};
+historyAccumulator_t MeasurementHistory::accumulators[HISTORY_TIER_COUNT][MeasurementHistory::MAX_OUTPUTS] = {};
+uint32_t MeasurementHistory::periods[HISTORY_TIER_COUNT] = {};
+SemaphoreHandle_t MeasurementHistory::mutex = nullptr;
+
+/**
+ * Writes the ZigZag encoded varint
+ * @param buffer Output buffer, at least 5 bytes long
+ * @param value Value
+ * @return Length of the varint
+ */
+static size_t writeVarint(uint8_t *buffer, int32_t value) {
+	uint32_t zigzag = (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+	size_t length = 0;
+	while (zigzag >= 0x80) {
+		buffer[length++] = (zigzag & 0x7f) | 0x80;
+		zigzag >>= 7;
+	}
+	buffer[length++] = zigzag;
+	return length;
+}
+
+/**
+ * Reads the ZigZag encoded varint
+ * @param data Data
+ * @param size Data size
+ * @param offset Offset of the varint, moved behind the varint
+ * @param value Value
+ * @return true Varint was read
+ * @return false Varint is truncated or longer than 5 bytes
+ */
+static bool readVarint(const uint8_t *data, size_t size, size_t &offset, int32_t &value) {
+	uint32_t zigzag = 0;
+	for (uint8_t shift = 0; shift < 35 && offset < size; shift += 7) {
+		uint8_t byte = data[offset++];
+		zigzag |= static_cast<uint32_t>(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) {
+			value = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Subtracts the values with wrap-around, the delta of any two values fits into the varint
+ * @param value Value
+ * @param previous Previous value
+ * @return Delta
+ */
+static inline int32_t wrappingDelta(int32_t value, int32_t previous) {
+	return static_cast<int32_t>(static_cast<uint32_t>(value) - static_cast<uint32_t>(previous));
+}
+
+/**
+ * Adds the delta with wrap-around
+ * @param previous Previous value
+ * @param delta Delta
+ * @return Value
+ */
+static inline int32_t wrappingAdd(int32_t previous, int32_t delta) {
+	return static_cast<int32_t>(static_cast<uint32_t>(previous) + static_cast<uint32_t>(delta));
+}
+
+void MeasurementHistory::init(const char *partitionLabel) {
+	if (MeasurementHistory::mutex == nullptr) {
+		MeasurementHistory::mutex = xSemaphoreCreateMutex();
+	}
+	for (historyRegion_t &region : MeasurementHistory::regions) {
+		region.oldest = UINT32_MAX;
+	}
+	MeasurementHistory::partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partitionLabel);
+	if (MeasurementHistory::partition == nullptr) {
+		ESP_LOGE(TAG, "Unable to find partition \"%s\", only 1 s points will be kept.", partitionLabel);
+		return;
+	}
+	uint32_t sectors = MeasurementHistory::partition->size / MeasurementHistory::partition->erase_size;
+	uint32_t minuteSectors = sectors * MeasurementHistory::MINUTE_SHARE / 100;
+	if (minuteSectors < 2 || sectors - minuteSectors < 2) {
+		ESP_LOGE(TAG, "Partition \"%s\" has to contain at least 8 sectors.", partitionLabel);
+		MeasurementHistory::partition = nullptr;
+		return;
+	}
+	uint8_t *buffer = new (std::nothrow) uint8_t[MeasurementHistory::partition->erase_size];
+	if (buffer == nullptr) {
+		ESP_LOGE(TAG, "Unable to allocate the sector buffer, only 1 s points will be kept.");
+		MeasurementHistory::partition = nullptr;
+		return;
+	}
+	uint32_t firstSector = 0;
+	for (size_t i = 0; i < HISTORY_TIER_COUNT - 1; ++i) {
+		historyRegion_t &region = MeasurementHistory::regions[i];
+		region.resolution = MeasurementHistory::RESOLUTIONS[i + 1];
+		region.firstSector = firstSector;
+		region.sectors = i == 0 ? minuteSectors : sectors - minuteSectors;
+		firstSector += region.sectors;
+		MeasurementHistory::recover(region, buffer);
+		ESP_LOGI(TAG, "%lu s tier: %lu sectors, oldest record: %lu", region.resolution, region.sectors, region.oldest);
+	}
+	delete[] buffer;
+}
+
+void MeasurementHistory::recover(historyRegion_t &region, uint8_t *buffer) {
+	size_t sectorSize = MeasurementHistory::partition->erase_size;
+	// Next record opens the first sector unless a written sector is found
+	region.head = region.sectors - 1;
+	region.sequence = 0;
+	region.offset = sectorSize;
+	region.oldest = UINT32_MAX;
+	historySectorHeader_t header;
+	for (uint32_t sector = 0; sector < region.sectors; ++sector) {
+		if (esp_partition_read(MeasurementHistory::partition, MeasurementHistory::getAddress(region, sector), &header, sizeof(header)) != ESP_OK) {
+			continue;
+		}
+		if (header.magic != MeasurementHistory::MAGIC || header.resolution != region.resolution || header.sequence == UINT32_MAX) {
+			continue;
+		}
+		if (header.sequence > region.sequence) {
+			region.head = sector;
+			region.sequence = header.sequence;
+		}
+	}
+	if (region.sequence == 0) {
+		return;
+	}
+	if (esp_partition_read(MeasurementHistory::partition, MeasurementHistory::getAddress(region, region.head), buffer, sectorSize) != ESP_OK) {
+		return;
+	}
+	memcpy(&header, buffer, sizeof(header));
+	historyCodec_t codec = MeasurementHistory::createCodec(header);
+	size_t offset = sizeof(header);
+	uint8_t mask;
+	while (MeasurementHistory::decode(codec, buffer, sectorSize, offset, mask)) {}
+	region.codec = codec;
+	region.offset = offset;
+	// Record interrupted by a reset is not overwritten, the next record opens a new sector
+	if (offset < sectorSize && buffer[offset] != 0xff) {
+		region.offset = sectorSize;
+	}
+	MeasurementHistory::updateOldest(region);
+}
+
+void MeasurementHistory::record(const std::vector<telemetrySample_t> &samples) {
+	uint32_t now = static_cast<uint32_t>(time(nullptr));
+	if (now < MeasurementHistory::MIN_TIMESTAMP || MeasurementHistory::mutex == nullptr) {
+		return;
+	}
+	xSemaphoreTake(MeasurementHistory::mutex, portMAX_DELAY);
+	for (size_t tier = 0; tier < HISTORY_TIER_COUNT; ++tier) {
+		uint32_t period = now - now % MeasurementHistory::RESOLUTIONS[tier];
+		if (MeasurementHistory::periods[tier] != period) {
+			if (MeasurementHistory::periods[tier] != 0) {
+				MeasurementHistory::completePeriod(static_cast<history_tier_t>(tier));
+			}
+			MeasurementHistory::periods[tier] = period;
+		}
+	}
+	for (const telemetrySample_t &sample : samples) {
+		if (sample.output == 0 || sample.output > MeasurementHistory::MAX_OUTPUTS) {
+			continue;
+		}
+		historyPoint_t point = {
+			.timestamp = now,
+			.current = sample.current,
+			.currentMax = sample.current,
+			.voltage = sample.voltage / 1000,
+		};
+		for (size_t tier = 0; tier < HISTORY_TIER_COUNT; ++tier) {
+			MeasurementHistory::accumulate(MeasurementHistory::accumulators[tier][sample.output - 1], point);
+		}
+	}
+	xSemaphoreGive(MeasurementHistory::mutex);
+}
+
+void MeasurementHistory::accumulate(historyAccumulator_t &accumulator, const historyPoint_t &point) {
+	accumulator.currentSum += point.current;
+	accumulator.voltageSum += point.voltage;
+	accumulator.currentMax = accumulator.count == 0 ? point.currentMax : std::max(accumulator.currentMax, point.currentMax);
+	++accumulator.count;
+}
+
+historyPoint_t MeasurementHistory::toPoint(const historyAccumulator_t &accumulator, uint32_t timestamp) {
+	return {
+		.timestamp = timestamp,
+		.current = static_cast<int32_t>(accumulator.currentSum / accumulator.count),
+		.currentMax = accumulator.currentMax,
+		.voltage = static_cast<int32_t>(accumulator.voltageSum / accumulator.count),
+	};
+}
+
+void MeasurementHistory::completePeriod(history_tier_t tier) {
+	historyPoint_t points[MeasurementHistory::MAX_OUTPUTS];
+	uint8_t mask = 0;
+	for (uint8_t i = 0; i < MeasurementHistory::MAX_OUTPUTS; ++i) {
+		historyAccumulator_t &accumulator = MeasurementHistory::accumulators[tier][i];
+		if (accumulator.count == 0) {
+			continue;
+		}
+		points[i] = MeasurementHistory::toPoint(accumulator, MeasurementHistory::periods[tier]);
+		mask |= 1 << i;
+		accumulator = {};
+	}
+	if (mask == 0) {
+		return;
+	}
+	if (tier != HISTORY_TIER_SECOND) {
+		if (MeasurementHistory::partition != nullptr) {
+			MeasurementHistory::append(MeasurementHistory::regions[tier - 1], MeasurementHistory::periods[tier], mask, points);
+		}
+		return;
+	}
+	for (uint8_t i = 0; i < MeasurementHistory::MAX_OUTPUTS; ++i) {
+		if ((mask & (1 << i)) == 0) {
+			continue;
+		}
+		if (MeasurementHistory::seconds[i] == nullptr) {
+			MeasurementHistory::seconds[i] = new (std::nothrow) historyPoint_t[MeasurementHistory::SECONDS_CAPACITY];
+			if (MeasurementHistory::seconds[i] == nullptr) {
+				ESP_LOGE(TAG, "Unable to allocate 1 s points of output %u.", i + 1);
+				continue;
+			}
+		}
+		MeasurementHistory::seconds[i][MeasurementHistory::secondsHead[i]] = points[i];
+		MeasurementHistory::secondsHead[i] = (MeasurementHistory::secondsHead[i] + 1) % MeasurementHistory::SECONDS_CAPACITY;
+		MeasurementHistory::secondsCount[i] = std::min(MeasurementHistory::secondsCount[i] + 1, MeasurementHistory::SECONDS_CAPACITY);
+	}
+}
+
+esp_err_t MeasurementHistory::append(historyRegion_t &region, uint32_t timestamp, uint8_t mask, const historyPoint_t *points) {
+	size_t sectorSize = MeasurementHistory::partition->erase_size;
+	uint8_t buffer[MeasurementHistory::MAX_RECORD_SIZE];
+	historyCodec_t codec = region.codec;
+	size_t length = MeasurementHistory::encode(codec, timestamp, mask, points, buffer);
+	if (region.offset + length > sectorSize) {
+		esp_err_t result = MeasurementHistory::openSector(region, timestamp);
+		if (result != ESP_OK) {
+			return result;
+		}
+		codec = region.codec;
+		length = MeasurementHistory::encode(codec, timestamp, mask, points, buffer);
+	}
+	esp_err_t result = esp_partition_write(MeasurementHistory::partition, MeasurementHistory::getAddress(region, region.head) + region.offset, buffer, length);
+	if (result != ESP_OK) {
+		ESP_LOGE(TAG, "Failed to write record. Error: %s", esp_err_to_name(result));
+		// Partially written record cannot be decoded, the next record opens a new sector
+		region.offset = sectorSize;
+		return result;
+	}
+	region.codec = codec;
+	region.offset += length;
+	return ESP_OK;
+}
+
+esp_err_t MeasurementHistory::openSector(historyRegion_t &region, uint32_t timestamp) {
+	uint32_t sector = (region.head + 1) % region.sectors;
+	size_t address = MeasurementHistory::getAddress(region, sector);
+	esp_err_t result = esp_partition_erase_range(MeasurementHistory::partition, address, MeasurementHistory::partition->erase_size);
+	if (result != ESP_OK) {
+		ESP_LOGE(TAG, "Failed to erase sector. Error: %s", esp_err_to_name(result));
+		return result;
+	}
+	historySectorHeader_t header = {
+		.magic = MeasurementHistory::MAGIC,
+		.sequence = region.sequence + 1,
+		.timestamp = timestamp,
+		.resolution = region.resolution,
+	};
+	result = esp_partition_write(MeasurementHistory::partition, address, &header, sizeof(header));
+	if (result != ESP_OK) {
+		ESP_LOGE(TAG, "Failed to write sector header. Error: %s", esp_err_to_name(result));
+		return result;
+	}
+	region.head = sector;
+	region.sequence = header.sequence;
+	region.offset = sizeof(header);
+	region.codec = MeasurementHistory::createCodec(header);
+	MeasurementHistory::updateOldest(region);
+	return ESP_OK;
+}
+
+void MeasurementHistory::updateOldest(historyRegion_t &region) {
+	historySectorHeader_t header;
+	for (uint32_t i = 1; i <= region.sectors; ++i) {
+		if (MeasurementHistory::readHeader(region, (region.head + i) % region.sectors, &header)) {
+			region.oldest = header.timestamp;
+			return;
+		}
+	}
+	region.oldest = UINT32_MAX;
+}
+
+bool MeasurementHistory::readHeader(const historyRegion_t &region, uint32_t sector, historySectorHeader_t *header) {
+	if (esp_partition_read(MeasurementHistory::partition, MeasurementHistory::getAddress(region, sector), header, sizeof(historySectorHeader_t)) != ESP_OK) {
+		return false;
+	}
+	// Sectors are written in a ring, so the sequence number is given by the distance from the head sector
+	uint32_t distance = (region.head + region.sectors - sector) % region.sectors;
+	return header->magic == MeasurementHistory::MAGIC && header->resolution == region.resolution &&
+		distance < region.sequence && header->sequence == region.sequence - distance;
+}
+
+size_t MeasurementHistory::getAddress(const historyRegion_t &region, uint32_t sector) {
+	return (region.firstSector + sector) * MeasurementHistory::partition->erase_size;
+}
+
+historyCodec_t MeasurementHistory::createCodec(const historySectorHeader_t &header) {
+	historyCodec_t codec = {};
+	// Regular period gives zero delta-of-delta already for the first record
+	codec.timestamp = header.timestamp - header.resolution;
+	codec.delta = header.resolution;
+	return codec;
+}
+
+size_t MeasurementHistory::encode(historyCodec_t &codec, uint32_t timestamp, uint8_t mask, const historyPoint_t *points, uint8_t *buffer) {
+	size_t length = 0;
+	buffer[length++] = mask;
+	int32_t delta = static_cast<int32_t>(timestamp - codec.timestamp);
+	length += writeVarint(buffer + length, wrappingDelta(delta, codec.delta));
+	codec.timestamp = timestamp;
+	codec.delta = delta;
+	for (uint8_t i = 0; i < MeasurementHistory::MAX_OUTPUTS; ++i) {
+		if ((mask & (1 << i)) == 0) {
+			continue;
+		}
+		const int32_t values[3] = {points[i].current, points[i].currentMax, points[i].voltage};
+		for (uint8_t j = 0; j < 3; ++j) {
+			length += writeVarint(buffer + length, wrappingDelta(values[j], codec.values[i][j]));
+			codec.values[i][j] = values[j];
+		}
+	}
+	return length;
+}
+
+bool MeasurementHistory::decode(historyCodec_t &codec, const uint8_t *data, size_t size, size_t &offset, uint8_t &mask) {
+	// Erased flash reads as 0xff, which is not a valid bitmap of present outputs
+	if (offset >= size || data[offset] == 0 || data[offset] >= (1 << MeasurementHistory::MAX_OUTPUTS)) {
+		return false;
+	}
+	size_t position = offset + 1;
+	historyCodec_t next = codec;
+	int32_t value;
+	if (!readVarint(data, size, position, value)) {
+		return false;
+	}
+	next.delta = wrappingAdd(codec.delta, value);
+	next.timestamp = codec.timestamp + next.delta;
+	for (uint8_t i = 0; i < MeasurementHistory::MAX_OUTPUTS; ++i) {
+		if ((data[offset] & (1 << i)) == 0) {
+			continue;
+		}
+		for (uint8_t j = 0; j < 3; ++j) {
+			if (!readVarint(data, size, position, value)) {
+				return false;
+			}
+			next.values[i][j] = wrappingAdd(codec.values[i][j], value);
+		}
+	}
+	mask = data[offset];
+	codec = next;
+	offset = position;
+	return true;
+}
+
+history_tier_t MeasurementHistory::selectTier(uint8_t output, uint32_t from, uint32_t step) {
+	history_tier_t tier = HISTORY_TIER_SECOND;
+	if (step >= MeasurementHistory::RESOLUTIONS[HISTORY_TIER_HOUR]) {
+		tier = HISTORY_TIER_HOUR;
+	} else if (step >= MeasurementHistory::RESOLUTIONS[HISTORY_TIER_MINUTE]) {
+		tier = HISTORY_TIER_MINUTE;
+	}
+	// Coarser tier is used when the finer one does not reach back to the range start
+	while (tier != HISTORY_TIER_HOUR) {
+		uint32_t oldest = MeasurementHistory::getOldest(tier, output);
+		history_tier_t coarser = static_cast<history_tier_t>(tier + 1);
+		if (oldest <= from || MeasurementHistory::getOldest(coarser, output) >= oldest) {
+			break;
+		}
+		tier = coarser;
+	}
+	return tier;
+}
+
+uint32_t MeasurementHistory::getResolution(history_tier_t tier) {
+	return MeasurementHistory::RESOLUTIONS[tier];
+}
+
+uint32_t MeasurementHistory::getOldest(history_tier_t tier, uint8_t output) {
+	if (output == 0 || output > MeasurementHistory::MAX_OUTPUTS || MeasurementHistory::mutex == nullptr) {
+		return UINT32_MAX;
+	}
+	xSemaphoreTake(MeasurementHistory::mutex, portMAX_DELAY);
+	uint32_t oldest = UINT32_MAX;
+	if (tier != HISTORY_TIER_SECOND) {
+		oldest = MeasurementHistory::regions[tier - 1].oldest;
+	} else if (MeasurementHistory::secondsCount[output - 1] > 0) {
+		size_t tail = (MeasurementHistory::secondsHead[output - 1] + MeasurementHistory::SECONDS_CAPACITY - MeasurementHistory::secondsCount[output - 1]) % MeasurementHistory::SECONDS_CAPACITY;
+		oldest = MeasurementHistory::seconds[output - 1][tail].timestamp;
+	}
+	xSemaphoreGive(MeasurementHistory::mutex);
+	return oldest;
+}
+
+esp_err_t MeasurementHistory::query(history_tier_t tier, uint8_t output, uint32_t from, uint32_t to, uint32_t step, const callback_t &callback) {
+	if (output == 0 || output > MeasurementHistory::MAX_OUTPUTS || step == 0 || MeasurementHistory::mutex == nullptr) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	historyAccumulator_t bucket = {};
+	uint32_t bucketStart = 0;
+	bool stopped = false;
+	callback_t aggregate = [&](const historyPoint_t &point) {
+		uint32_t start = point.timestamp - point.timestamp % step;
+		if (bucket.count > 0 && start != bucketStart) {
+			if (!callback(MeasurementHistory::toPoint(bucket, bucketStart))) {
+				stopped = true;
+				return false;
+			}
+			bucket = {};
+		}
+		bucketStart = start;
+		MeasurementHistory::accumulate(bucket, point);
+		return true;
+	};
+	esp_err_t result;
+	if (tier == HISTORY_TIER_SECOND) {
+		result = MeasurementHistory::querySeconds(output, from, to, aggregate);
+	} else {
+		result = MeasurementHistory::queryRegion(MeasurementHistory::regions[tier - 1], output, from, to, aggregate);
+	}
+	if (result == ESP_OK && !stopped && bucket.count > 0) {
+		callback(MeasurementHistory::toPoint(bucket, bucketStart));
+	}
+	return result;
+}
+
+esp_err_t MeasurementHistory::querySeconds(uint8_t output, uint32_t from, uint32_t to, const callback_t &callback) {
+	size_t index = output - 1;
+	// Points are copied so the callback does not block the sampling
+	historyPoint_t *points = new (std::nothrow) historyPoint_t[MeasurementHistory::SECONDS_CAPACITY];
+	if (points == nullptr) {
+		return ESP_ERR_NO_MEM;
+	}
+	size_t count = 0;
+	xSemaphoreTake(MeasurementHistory::mutex, portMAX_DELAY);
+	if (MeasurementHistory::seconds[index] != nullptr) {
+		size_t tail = (MeasurementHistory::secondsHead[index] + MeasurementHistory::SECONDS_CAPACITY - MeasurementHistory::secondsCount[index]) % MeasurementHistory::SECONDS_CAPACITY;
+		for (size_t i = 0; i < MeasurementHistory::secondsCount[index]; ++i) {
+			const historyPoint_t &point = MeasurementHistory::seconds[index][(tail + i) % MeasurementHistory::SECONDS_CAPACITY];
+			if (point.timestamp >= from && point.timestamp <= to) {
+				points[count++] = point;
+			}
+		}
+	}
+	xSemaphoreGive(MeasurementHistory::mutex);
+	for (size_t i = 0; i < count; ++i) {
+		if (!callback(points[i])) {
+			break;
+		}
+	}
+	delete[] points;
+	return ESP_OK;
+}
+
+esp_err_t MeasurementHistory::queryRegion(historyRegion_t &region, uint8_t output, uint32_t from, uint32_t to, const callback_t &callback) {
+	if (MeasurementHistory::partition == nullptr) {
+		return ESP_OK;
+	}
+	xSemaphoreTake(MeasurementHistory::mutex, portMAX_DELAY);
+	// Sectors opened during the query are not read, the sectors overwritten during the query are skipped
+	historyRegion_t snapshot = region;
+	xSemaphoreGive(MeasurementHistory::mutex);
+	if (snapshot.sequence == 0) {
+		return ESP_OK;
+	}
+	size_t sectorSize = MeasurementHistory::partition->erase_size;
+	uint8_t *buffer = new (std::nothrow) uint8_t[sectorSize];
+	if (buffer == nullptr) {
+		return ESP_ERR_NO_MEM;
+	}
+	esp_err_t result = ESP_OK;
+	bool done = false;
+	historySectorHeader_t header;
+	for (uint32_t i = 1; i <= snapshot.sectors && !done; ++i) {
+		uint32_t sector = (snapshot.head + i) % snapshot.sectors;
+		xSemaphoreTake(MeasurementHistory::mutex, portMAX_DELAY);
+		// Records of the sector are older than the first record of the following sector
+		bool skip = i < snapshot.sectors && MeasurementHistory::readHeader(snapshot, (sector + 1) % snapshot.sectors, &header) && header.timestamp <= from;
+		bool valid = !skip && MeasurementHistory::readHeader(snapshot, sector, &header);
+		if (valid && header.timestamp <= to) {
+			result = esp_partition_read(MeasurementHistory::partition, MeasurementHistory::getAddress(snapshot, sector), buffer, sectorSize);
+		}
+		xSemaphoreGive(MeasurementHistory::mutex);
+		if (result != ESP_OK) {
+			break;
+		}
+		if (!valid) {
+			continue;
+		}
+		if (header.timestamp > to) {
+			break;
+		}
+		historyCodec_t codec = MeasurementHistory::createCodec(header);
+		size_t offset = sizeof(header);
+		uint8_t mask;
+		while (MeasurementHistory::decode(codec, buffer, sectorSize, offset, mask)) {
+			if (codec.timestamp > to) {
+				done = true;
+				break;
+			}
+			if (codec.timestamp < from || (mask & (1 << (output - 1))) == 0) {
+				continue;
+			}
+			historyPoint_t point = {
+				.timestamp = codec.timestamp,
+				.current = codec.values[output - 1][0],
+				.currentMax = codec.values[output - 1][1],
+				.voltage = codec.values[output - 1][2],
+			};
+			if (!callback(point)) {
+				done = true;
+				break;
+			}
+		}
+	}
+	delete[] buffer;
+	return result;
+}
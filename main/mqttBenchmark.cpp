@@ -0,0 +1,253 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mqttBenchmark.h"
+
+mqttBenchmarkResult_t MqttBenchmark::result = {};
+bool MqttBenchmark::running = false;
+SemaphoreHandle_t MqttBenchmark::mutex = nullptr;
+
+void MqttBenchmark::init() {
+	MqttBenchmark::mutex = xSemaphoreCreateMutex();
+}
+
+esp_err_t MqttBenchmark::start(size_t outputs, uint32_t duration) {
+	if (outputs < MqttBenchmark::MIN_OUTPUTS || outputs > MqttBenchmark::MAX_OUTPUTS || duration == 0 || duration > MqttBenchmark::MAX_DURATION) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	xSemaphoreTake(MqttBenchmark::mutex, portMAX_DELAY);
+	if (MqttBenchmark::running) {
+		xSemaphoreGive(MqttBenchmark::mutex);
+		return ESP_ERR_INVALID_STATE;
+	}
+	uint32_t freeHeap = esp_get_free_heap_size();
+	MqttBenchmark::result = {
+		.outputs = outputs,
+		.duration = duration,
+		.format = SbcPduManagement::getTelemetryFormat(),
+		.startedAt = esp_timer_get_time(),
+		.elapsed = 0,
+		.messages = 0,
+		.bytes = 0,
+		.failed = 0,
+		.lost = 0,
+		.disconnects = 0,
+		.reconnects = 0,
+		.reconnectTime = 0,
+		.maxReconnectLatency = 0,
+		.dropped = 0,
+		.expired = 0,
+		.heapStart = freeHeap,
+		.heapMinimum = freeHeap,
+		.stackHighWater = 0,
+	};
+	MqttBenchmark::running = true;
+	xSemaphoreGive(MqttBenchmark::mutex);
+	if (xTaskCreate(MqttBenchmark::task, "mqttBenchmarkTask", 4096, nullptr, 5, nullptr) != pdPASS) {
+		ESP_LOGE(TAG, "Unable to create benchmark task.");
+		xSemaphoreTake(MqttBenchmark::mutex, portMAX_DELAY);
+		MqttBenchmark::running = false;
+		xSemaphoreGive(MqttBenchmark::mutex);
+		return ESP_ERR_NO_MEM;
+	}
+	ESP_LOGI(TAG, "Benchmark with %u synthetic outputs started for %lu s.", outputs, duration);
+	return ESP_OK;
+}
+
+bool MqttBenchmark::isRunning() {
+	xSemaphoreTake(MqttBenchmark::mutex, portMAX_DELAY);
+	bool running = MqttBenchmark::running;
+	xSemaphoreGive(MqttBenchmark::mutex);
+	return running;
+}
+
+void MqttBenchmark::writeJson(JsonWriter &writer) {
+	writer.beginObject();
+	MqttBenchmark::writeProperties(writer);
+	writer.endObject();
+}
+
+void MqttBenchmark::writeProperties(JsonWriter &writer) {
+	xSemaphoreTake(MqttBenchmark::mutex, portMAX_DELAY);
+	mqttBenchmarkResult_t result = MqttBenchmark::result;
+	bool running = MqttBenchmark::running;
+	xSemaphoreGive(MqttBenchmark::mutex);
+	if (running) {
+		result.elapsed = esp_timer_get_time() - result.startedAt;
+	}
+	double elapsed = result.elapsed / 1000000.0;
+	writer.writeBool("running", running);
+	writer.writeInteger("outputs", result.outputs);
+	writer.writeInteger("duration", result.duration);
+	writer.writeString("format", result.format == PAYLOAD_FORMAT_CBOR ? "cbor" : "text");
+	writer.writeNumber("elapsed", elapsed);
+	writer.writeInteger("messages", result.messages);
+	writer.writeInteger("bytes", result.bytes);
+	writer.writeInteger("failed", result.failed);
+	writer.writeNumber("messagesPerSecond", elapsed > 0 ? result.messages / elapsed : 0);
+	writer.writeNumber("bytesPerSecond", elapsed > 0 ? result.bytes / elapsed : 0);
+	writer.writeInteger("disconnects", result.disconnects);
+	writer.writeInteger("reconnects", result.reconnects);
+	writer.beginObject("reconnectLatency");
+	writer.writeNumber("average", result.reconnects > 0 ? result.reconnectTime / 1000.0 / result.reconnects : 0);
+	writer.writeNumber("max", result.maxReconnectLatency / 1000.0);
+	writer.endObject();
+	writer.writeInteger("lost", result.lost);
+	writer.writeInteger("dropped", result.dropped);
+	writer.writeInteger("expired", result.expired);
+	writer.beginObject("heap");
+	writer.writeInteger("start", result.heapStart);
+	writer.writeInteger("minimum", result.heapMinimum);
+	writer.endObject();
+	writer.writeInteger("stackHighWater", result.stackHighWater);
+}
+
+void MqttBenchmark::task(void *arg) {
+	xSemaphoreTake(MqttBenchmark::mutex, portMAX_DELAY);
+	size_t outputs = MqttBenchmark::result.outputs;
+	int64_t end = MqttBenchmark::result.startedAt + static_cast<int64_t>(MqttBenchmark::result.duration) * 1000000;
+	xSemaphoreGive(MqttBenchmark::mutex);
+	std::vector<uint8_t> frameBuffer(TelemetryFrame::MAX_HEADER_SIZE + outputs * TelemetryFrame::MAX_SAMPLE_SIZE);
+	mqttConnectionStatistics_t start = MqttBenchmark::getConnectionStatistics();
+	mqttConnectionStatistics_t previous = start;
+	uint32_t dropped = MqttBenchmark::countDropped();
+	TickType_t lastWake = xTaskGetTickCount();
+	for (uint32_t period = 0; esp_timer_get_time() < end; ++period) {
+		MqttBenchmark::publishPeriod(frameBuffer, outputs, period);
+		uint32_t freeHeap = esp_get_free_heap_size();
+		mqttConnectionStatistics_t current = MqttBenchmark::getConnectionStatistics();
+		uint32_t currentDropped = MqttBenchmark::countDropped();
+		xSemaphoreTake(MqttBenchmark::mutex, portMAX_DELAY);
+		MqttBenchmark::result.heapMinimum = std::min(MqttBenchmark::result.heapMinimum, freeHeap);
+		MqttBenchmark::recordConnection(start, previous, current);
+		MqttBenchmark::result.dropped = currentDropped - dropped;
+		xSemaphoreGive(MqttBenchmark::mutex);
+		previous = current;
+		vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(MqttBenchmark::PERIOD));
+	}
+	mqttConnectionStatistics_t current = MqttBenchmark::getConnectionStatistics();
+	uint32_t currentDropped = MqttBenchmark::countDropped();
+	xSemaphoreTake(MqttBenchmark::mutex, portMAX_DELAY);
+	MqttBenchmark::result.elapsed = esp_timer_get_time() - MqttBenchmark::result.startedAt;
+	MqttBenchmark::recordConnection(start, previous, current);
+	MqttBenchmark::result.dropped = currentDropped - dropped;
+	MqttBenchmark::result.stackHighWater = uxTaskGetStackHighWaterMark(nullptr);
+	MqttBenchmark::running = false;
+	ESP_LOGI(TAG, "Benchmark finished, %lu messages and %llu bytes published, %lu failed, %lu lost while disconnected.", MqttBenchmark::result.messages, MqttBenchmark::result.bytes, MqttBenchmark::result.failed, MqttBenchmark::result.lost);
+	xSemaphoreGive(MqttBenchmark::mutex);
+	vTaskDelete(nullptr);
+}
+
+void MqttBenchmark::publishPeriod(std::vector<uint8_t> &frameBuffer, size_t outputs, uint32_t period) {
+	Mqtt *mqtt = SbcPduManagement::getMqtt();
+	Mqtt *telemetryMqtt = SbcPduManagement::getTelemetryMqtt();
+	std::string baseTopic = SbcPduManagement::getDeviceBaseTopic() + "/benchmark";
+	bool cbor = SbcPduManagement::getTelemetryFormat() == PAYLOAD_FORMAT_CBOR && telemetryMqtt->isConnected();
+	struct timeval now;
+	gettimeofday(&now, nullptr);
+	int64_t timestamp = static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_usec / 1000;
+	CborWriter writer(frameBuffer.data(), frameBuffer.size());
+	if (cbor) {
+		TelemetryFrame::begin(writer, timestamp, false, outputs);
+	}
+	for (size_t index = 0; index < outputs; ++index) {
+		// Synthetic measurements vary every period, so the payloads are not deduplicated by the broker or the outbox
+		float current = 100 + index * 10 + esp_random() % 50;
+		float voltage = 5 + (esp_random() % 100) / 1000.0f;
+		std::string topic = baseTopic + "/" + std::to_string(index);
+		std::string alert = std::to_string((period + index) % 100 == 0);
+		if (mqtt->isConnected()) {
+			MqttBenchmark::record(mqtt->publishString(topic + "/alert", alert, 2, false), alert.length());
+		} else {
+			MqttBenchmark::recordLost(1);
+		}
+		if (cbor) {
+			telemetrySample_t sample = {
+				.output = static_cast<uint8_t>(index),
+				.flags = TELEMETRY_FLAG_ENABLED,
+				.current = TelemetryFrame::milliToMicro(current),
+				.voltage = TelemetryFrame::milliToMicro(voltage * 1000),
+				.timestamp = timestamp,
+			};
+			TelemetryFrame::addSample(writer, sample, timestamp);
+			continue;
+		}
+		if (!mqtt->isConnected()) {
+			// Enabled state, current and voltage
+			MqttBenchmark::recordLost(3);
+			continue;
+		}
+		std::string enabled = std::to_string(true);
+		std::string currentValue = std::to_string(current);
+		std::string voltageValue = std::to_string(voltage);
+		MqttBenchmark::record(SbcPduManagement::publishTelemetry(topic + "/enabled", enabled, ""), enabled.length());
+		MqttBenchmark::record(SbcPduManagement::publishTelemetry(topic + "/current", currentValue, "mA"), currentValue.length());
+		MqttBenchmark::record(SbcPduManagement::publishTelemetry(topic + "/voltage", voltageValue, "V"), voltageValue.length());
+	}
+	if (cbor) {
+		int msgId = SbcPduManagement::publishFrame(baseTopic + "/telemetry", writer, telemetryMqtt->getTelemetryQos(), SbcPduManagement::TELEMETRY_EXPIRY_INTERVAL, true);
+		MqttBenchmark::record(msgId, writer.getLength());
+	}
+}
+
+void MqttBenchmark::record(int msgId, size_t length) {
+	xSemaphoreTake(MqttBenchmark::mutex, portMAX_DELAY);
+	if (msgId < 0 && msgId != Mqtt::PUBLISH_DEFERRED) {
+		++MqttBenchmark::result.failed;
+	} else {
+		++MqttBenchmark::result.messages;
+		MqttBenchmark::result.bytes += length;
+	}
+	xSemaphoreGive(MqttBenchmark::mutex);
+}
+
+void MqttBenchmark::recordLost(uint32_t count) {
+	xSemaphoreTake(MqttBenchmark::mutex, portMAX_DELAY);
+	MqttBenchmark::result.lost += count;
+	xSemaphoreGive(MqttBenchmark::mutex);
+}
+
+mqttConnectionStatistics_t MqttBenchmark::getConnectionStatistics() {
+	mqttConnectionStatistics_t statistics = SbcPduManagement::getMqtt()->getConnectionStatistics();
+	if (SbcPduManagement::getTelemetryMqtt() != SbcPduManagement::getMqtt()) {
+		mqttConnectionStatistics_t telemetry = SbcPduManagement::getTelemetryMqtt()->getConnectionStatistics();
+		statistics.disconnects += telemetry.disconnects;
+		statistics.reconnects += telemetry.reconnects;
+		statistics.reconnectTime += telemetry.reconnectTime;
+		statistics.expired += telemetry.expired;
+	}
+	return statistics;
+}
+
+uint32_t MqttBenchmark::countDropped() {
+	uint32_t dropped = SbcPduManagement::getMqtt()->getOutboxMetrics().dropped;
+	if (SbcPduManagement::getTelemetryMqtt() != SbcPduManagement::getMqtt()) {
+		dropped += SbcPduManagement::getTelemetryMqtt()->getOutboxMetrics().dropped;
+	}
+	return dropped;
+}
+
+void MqttBenchmark::recordConnection(const mqttConnectionStatistics_t &start, const mqttConnectionStatistics_t &previous, const mqttConnectionStatistics_t &current) {
+	// ESP-MQTT waits for the reconnect timeout before reconnecting, so a period contains at most one reconnection of each client
+	uint32_t reconnects = current.reconnects - previous.reconnects;
+	if (reconnects > 0) {
+		int64_t latency = (current.reconnectTime - previous.reconnectTime) / reconnects;
+		MqttBenchmark::result.maxReconnectLatency = std::max(MqttBenchmark::result.maxReconnectLatency, latency);
+	}
+	MqttBenchmark::result.disconnects = current.disconnects - start.disconnects;
+	MqttBenchmark::result.reconnects = current.reconnects - start.reconnects;
+	MqttBenchmark::result.reconnectTime = current.reconnectTime - start.reconnectTime;
+	MqttBenchmark::result.expired = current.expired - start.expired;
+}
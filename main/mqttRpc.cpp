@@ -0,0 +1,259 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mqttRpc.h"
+
+std::string MqttRpc::requestTopic = "";
+std::string MqttRpc::responseTopic = "";
+Mqtt *MqttRpc::mqtt = nullptr;
+std::map<uint8_t, Output*> *MqttRpc::outputs = nullptr;
+
+MqttRpc::MqttRpc(Mqtt *mqtt, std::map<uint8_t, Output*> *outputs) {
+	this->mqtt = mqtt;
+	this->outputs = outputs;
+	this->requestTopic = SbcPduManagement::getDeviceBaseTopic() + "/rpc";
+	this->responseTopic = SbcPduManagement::getDeviceBaseTopic() + "/rpc/response";
+	mqtt->subscribe(MqttRpc::requestTopic, MqttRpc::requestCallback, 1);
+}
+
+void MqttRpc::requestCallback(esp_mqtt_event_handle_t event) {
+	mqttRpcRequest_t request = {
+		.id = "",
+		.responseTopic = MqttRpc::responseTopic,
+		.correlationData = "",
+		.receivedAt = esp_timer_get_time(),
+	};
+	bool hasResponseTopic = false;
+	bool invalidResponseTopic = false;
+#ifdef CONFIG_MQTT_PROTOCOL_5
+	if (event->protocol_ver == MQTT_PROTOCOL_V_5 && event->property != nullptr) {
+		if (event->property->response_topic != nullptr && event->property->response_topic_len > 0) {
+			std::string responseTopic(event->property->response_topic, event->property->response_topic_len);
+			hasResponseTopic = true;
+			if (MqttRpc::isValidResponseTopic(responseTopic)) {
+				request.responseTopic = responseTopic;
+			} else {
+				invalidResponseTopic = true;
+			}
+		}
+		if (event->property->correlation_data != nullptr && event->property->correlation_data_len > 0) {
+			request.correlationData.assign(event->property->correlation_data, event->property->correlation_data_len);
+		}
+	}
+#endif
+	if (event->data_len != event->total_data_len) {
+		MqttRpc::respondError(request, "Request is too large.");
+		return;
+	}
+	cJSON *root = cJSON_ParseWithLength(event->data, event->data_len);
+	if (root == nullptr) {
+		MqttRpc::respondError(request, "Invalid JSON payload.");
+		return;
+	}
+	cJSON *id = cJSON_GetObjectItem(root, "id");
+	if (cJSON_IsString(id)) {
+		request.id = id->valuestring;
+	}
+	cJSON *replyTo = cJSON_GetObjectItem(root, "replyTo");
+	if (!hasResponseTopic && cJSON_IsString(replyTo) && replyTo->valuestring[0] != '\0') {
+		if (MqttRpc::isValidResponseTopic(replyTo->valuestring)) {
+			request.responseTopic = replyTo->valuestring;
+		} else {
+			invalidResponseTopic = true;
+		}
+	}
+	if (invalidResponseTopic) {
+		MqttRpc::respondError(request, "Invalid response topic.");
+		cJSON_Delete(root);
+		return;
+	}
+	cJSON *method = cJSON_GetObjectItem(root, "method");
+	const cJSON *params = cJSON_GetObjectItem(root, "params");
+	if (!cJSON_IsString(method)) {
+		MqttRpc::respondError(request, "Missing \"method\" property.");
+	} else if (std::string_view(method->valuestring) == "switch") {
+		MqttRpc::switchOutput(request, params);
+	} else if (std::string_view(method->valuestring) == "powerCycle") {
+		MqttRpc::powerCycle(request, params);
+	} else if (std::string_view(method->valuestring) == "stats") {
+		MqttRpc::readStats(request, params);
+	} else if (std::string_view(method->valuestring) == "getConfig") {
+		MqttRpc::getConfig(request);
+	} else {
+		MqttRpc::respondError(request, "Unknown method \"" + std::string(method->valuestring) + "\".");
+	}
+	cJSON_Delete(root);
+}
+
+bool MqttRpc::isValidResponseTopic(const std::string &topic) {
+	if (topic == MqttRpc::responseTopic) {
+		return true;
+	}
+	if (topic.find_first_of("+#") != std::string::npos) {
+		return false;
+	}
+	// Responses must not be delivered as commands or state of this device or its groups
+	std::string deviceTopic = SbcPduManagement::getDeviceBaseTopic();
+	if (topic == deviceTopic || topic.starts_with(deviceTopic + "/") || topic.starts_with(GroupManager::BASE_TOPIC)) {
+		return false;
+	}
+	return !MqttRpc::mqtt->isSubscribed(topic);
+}
+
+void MqttRpc::switchOutput(const mqttRpcRequest_t &request, const cJSON *params) {
+	Output *output = MqttRpc::findOutput(request, params);
+	if (output == nullptr) {
+		return;
+	}
+	const cJSON *enabled = cJSON_GetObjectItem(params, "enabled");
+	if (!cJSON_IsBool(enabled)) {
+		MqttRpc::respondError(request, "Param \"enabled\" is not a boolean.");
+		return;
+	}
+	if (!output->enable(cJSON_IsTrue(enabled))) {
+		MqttRpc::respondError(request, "Power-on of the output exceeds the power budget.");
+		return;
+	}
+	MqttRpc::respond(request, MqttRpc::createOutputState(output, false));
+}
+
+void MqttRpc::powerCycle(const mqttRpcRequest_t &request, const cJSON *params) {
+	Output *output = MqttRpc::findOutput(request, params);
+	if (output == nullptr) {
+		return;
+	}
+	uint32_t delay = MqttRpc::DEFAULT_POWER_CYCLE_DELAY;
+	const cJSON *delayParam = cJSON_GetObjectItem(params, "delay");
+	if (delayParam != nullptr) {
+		if (!cJSON_IsNumber(delayParam) || delayParam->valuedouble < 0 || delayParam->valuedouble > MqttRpc::MAX_POWER_CYCLE_DELAY) {
+			MqttRpc::respondError(request, "Param \"delay\" has to be a number between 0 and " + std::to_string(MqttRpc::MAX_POWER_CYCLE_DELAY) + " ms.");
+			return;
+		}
+		delay = static_cast<uint32_t>(delayParam->valuedouble);
+	}
+	MqttRpc::PowerCycle *context = new MqttRpc::PowerCycle{request, output, delay};
+	output->enable(false);
+	if (xTaskCreate(MqttRpc::powerCycleTask, "powerCycleTask", 4096, context, 5, nullptr) != pdPASS) {
+		output->enable(true);
+		delete context;
+		MqttRpc::respondError(request, "Unable to schedule the power cycle.");
+	}
+}
+
+void MqttRpc::powerCycleTask(void *arg) {
+	MqttRpc::PowerCycle *context = static_cast<MqttRpc::PowerCycle *>(arg);
+	vTaskDelay(pdMS_TO_TICKS(context->delay));
+	if (context->output->enable(true)) {
+		cJSON *result = MqttRpc::createOutputState(context->output, false);
+		cJSON_AddNumberToObject(result, "delay", context->delay);
+		MqttRpc::respond(context->request, result);
+	} else {
+		MqttRpc::respondError(context->request, "Power-on of the output exceeds the power budget.");
+	}
+	delete context;
+	vTaskDelete(nullptr);
+}
+
+void MqttRpc::readStats(const mqttRpcRequest_t &request, const cJSON *params) {
+	cJSON *result = cJSON_CreateObject();
+	cJSON *states = cJSON_AddArrayToObject(result, "outputs");
+	if (cJSON_GetObjectItem(params, "output") != nullptr) {
+		Output *output = MqttRpc::findOutput(request, params);
+		if (output == nullptr) {
+			cJSON_Delete(result);
+			return;
+		}
+		cJSON_AddItemToArray(states, MqttRpc::createOutputState(output, true));
+	} else {
+		for (const auto &[index, output] : *MqttRpc::outputs) {
+			cJSON_AddItemToArray(states, MqttRpc::createOutputState(output, true));
+		}
+	}
+	MqttRpc::respond(request, result);
+}
+
+void MqttRpc::getConfig(const mqttRpcRequest_t &request) {
+	cJSON *result = cJSON_CreateObject();
+	cJSON_AddStringToObject(result, "macAddress", Wifi::getPrimaryMacAddress().c_str());
+	cJSON_AddStringToObject(result, "firmware", esp_app_get_description()->version);
+	cJSON_AddNumberToObject(result, "revision", REVISION);
+	cJSON_AddNumberToObject(result, "protocol", MqttRpc::mqtt->getProtocolVersion() == MQTT_PROTOCOL_V_5 ? 5 : 4);
+	cJSON *indices = cJSON_AddArrayToObject(result, "outputs");
+	for (const auto &[index, output] : *MqttRpc::outputs) {
+		cJSON_AddItemToArray(indices, cJSON_CreateNumber(index));
+	}
+	MqttRpc::respond(request, result);
+}
+
+Output *MqttRpc::findOutput(const mqttRpcRequest_t &request, const cJSON *params) {
+	const cJSON *index = cJSON_GetObjectItem(params, "output");
+	if (!cJSON_IsNumber(index)) {
+		MqttRpc::respondError(request, "Param \"output\" is not a number.");
+		return nullptr;
+	}
+	auto output = MqttRpc::outputs->end();
+	if (index->valuedouble >= 0 && index->valuedouble <= UINT8_MAX) {
+		output = MqttRpc::outputs->find(index->valueint);
+	}
+	if (output == MqttRpc::outputs->end()) {
+		MqttRpc::respondError(request, "Output with ID " + std::to_string(index->valueint) + " does not exist.");
+		return nullptr;
+	}
+	return output->second;
+}
+
+cJSON *MqttRpc::createOutputState(Output *output, bool measure) {
+	cJSON *state = cJSON_CreateObject();
+	cJSON_AddNumberToObject(state, "output", output->getIndex());
+	cJSON_AddBoolToObject(state, "enabled", output->isEnabled());
+	cJSON_AddBoolToObject(state, "alert", output->hasAlert());
+	if (measure) {
+		cJSON_AddNumberToObject(state, "current", fabs(output->readCurrent()));
+		cJSON_AddNumberToObject(state, "voltage", output->readVoltage());
+	}
+	return state;
+}
+
+void MqttRpc::respond(const mqttRpcRequest_t &request, cJSON *result) {
+	cJSON *response = cJSON_CreateObject();
+	cJSON_AddTrueToObject(response, "ok");
+	cJSON_AddItemToObject(response, "result", result);
+	MqttRpc::publish(request, response);
+}
+
+void MqttRpc::respondError(const mqttRpcRequest_t &request, const std::string &error) {
+	cJSON *response = cJSON_CreateObject();
+	cJSON_AddFalseToObject(response, "ok");
+	cJSON_AddStringToObject(response, "error", error.c_str());
+	MqttRpc::publish(request, response);
+}
+
+void MqttRpc::publish(const mqttRpcRequest_t &request, cJSON *response) {
+	if (!request.id.empty()) {
+		cJSON_AddStringToObject(response, "id", request.id.c_str());
+	}
+	cJSON_AddNumberToObject(response, "duration", esp_timer_get_time() - request.receivedAt);
+	char *payload = cJSON_PrintUnformatted(response);
+	cJSON_Delete(response);
+	if (payload == nullptr) {
+		ESP_LOGE(TAG, "Unable to serialize the response.");
+		return;
+	}
+	mqttPublishProperties_t properties = {
+		.correlationData = request.correlationData,
+	};
+	MqttRpc::mqtt->publishString(request.responseTopic, std::string(payload), 1, false, &properties);
+	cJSON_free(payload);
+}
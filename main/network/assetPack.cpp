@@ -0,0 +1,111 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "network/assetPack.h"
+
+AssetPack::AssetPack(const std::string &partitionLabel) {
+	const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partitionLabel.c_str());
+	if (partition == nullptr) {
+		ESP_LOGI(TAG, "Partition \"%s\" not found, assets are served from the filesystem.", partitionLabel.c_str());
+		return;
+	}
+	assetPackHeader_t header;
+	esp_err_t result = esp_partition_read(partition, 0, &header, sizeof(header));
+	if (result != ESP_OK || memcmp(header.magic, "SPAK", sizeof(header.magic)) != 0 || header.version != AssetPack::VERSION) {
+		ESP_LOGW(TAG, "Partition \"%s\" does not contain an asset pack, assets are served from the filesystem.", partitionLabel.c_str());
+		return;
+	}
+	if (header.size < sizeof(assetPackHeader_t) + header.count * sizeof(assetPackEntry_t) || header.size > partition->size) {
+		ESP_LOGE(TAG, "Asset pack has invalid size %lu B.", header.size);
+		return;
+	}
+	const void *mapped = nullptr;
+	result = esp_partition_mmap(partition, 0, header.size, ESP_PARTITION_MMAP_DATA, &mapped, &this->handle);
+	if (result != ESP_OK) {
+		ESP_LOGE(TAG, "Unable to map asset pack. Error: %s", esp_err_to_name(result));
+		return;
+	}
+	this->data = static_cast<const uint8_t *>(mapped);
+	this->entries = reinterpret_cast<const assetPackEntry_t *>(this->data + sizeof(assetPackHeader_t));
+	this->count = header.count;
+	this->size = header.size;
+	if (!this->validate()) {
+		ESP_LOGE(TAG, "Asset pack is corrupted, assets are served from the filesystem.");
+		esp_partition_munmap(this->handle);
+		this->data = nullptr;
+		return;
+	}
+	ESP_LOGI(TAG, "Asset pack with %u assets (%u B) mapped.", this->count, this->size);
+}
+
+bool AssetPack::isAvailable() const {
+	return this->data != nullptr;
+}
+
+const assetPackEntry_t *AssetPack::find(std::string_view path) const {
+	if (!this->isAvailable()) {
+		return nullptr;
+	}
+	size_t low = 0;
+	size_t high = this->count;
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		int comparison = path.compare(this->getString(this->entries[middle].path));
+		if (comparison == 0) {
+			return &this->entries[middle];
+		}
+		if (comparison < 0) {
+			high = middle;
+		} else {
+			low = middle + 1;
+		}
+	}
+	return nullptr;
+}
+
+const char *AssetPack::getString(uint32_t offset) const {
+	return reinterpret_cast<const char *>(this->data + offset);
+}
+
+const uint8_t *AssetPack::getData(const assetPackVariant_t &variant) const {
+	return this->data + variant.offset;
+}
+
+bool AssetPack::validate() const {
+	for (size_t i = 0; i < this->count; ++i) {
+		const assetPackEntry_t &entry = this->entries[i];
+		if (!this->isStringValid(entry.path) || !this->isStringValid(entry.contentType)) {
+			return false;
+		}
+		// Binary search requires the paths in byte order
+		if (i > 0 && strcmp(this->getString(this->entries[i - 1].path), this->getString(entry.path)) >= 0) {
+			return false;
+		}
+		for (const assetPackVariant_t &variant : entry.variants) {
+			// Uncompressed variant is always present, it may be empty
+			if (variant.length == 0 && &variant != &entry.variants[ASSET_ENCODING_IDENTITY]) {
+				continue;
+			}
+			if (variant.offset > this->size || variant.length > this->size - variant.offset || !this->isStringValid(variant.entityTag)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool AssetPack::isStringValid(uint32_t offset) const {
+	return offset < this->size && memchr(this->data + offset, '\0', this->size - offset) != nullptr;
+}
@@ -16,16 +16,26 @@
 #include "network/hostname.h"
 #include "network/wifi.h"
 
+HostnameManager::change_callback_t HostnameManager::onChange = nullptr;
+
 std::string HostnameManager::get() {
 	std::string hostname;
-	esp_err_t result = this->nvs.getString("hostname", hostname);
+	esp_err_t result = this->nvs.getOptionalString("hostname", hostname);
 	if (result != ESP_OK) {
 		hostname = "sbc-pdu_" + Wifi::getPrimaryMacAddress();
-		this->set(hostname);
+		// The default hostname is not a change
+		ESP_ERROR_CHECK(this->nvs.setString("hostname", hostname));
 	}
 	return hostname;
 }
 
 void HostnameManager::set(const std::string &hostname) {
 	ESP_ERROR_CHECK(this->nvs.setString("hostname", hostname));
+	if (HostnameManager::onChange) {
+		HostnameManager::onChange(hostname);
+	}
+}
+
+void HostnameManager::setOnChange(const HostnameManager::change_callback_t &onChange) {
+	HostnameManager::onChange = onChange;
 }
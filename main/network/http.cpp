@@ -19,6 +19,10 @@
 
 #define CHECK_FILE_EXTENSION(filename, ext) (strcasecmp(&filename[strlen(filename) - strlen(ext)], ext) == 0)
 
+std::map<std::string, std::string> HttpServer::entityTags = {};
+httpTransferStatistics_t HttpServer::statistics = {};
+SemaphoreHandle_t HttpServer::mutex = nullptr;
+
 esp_err_t HttpServer::setContentTypeFromFileExtension(httpd_req_t *request, const char *filePath) {
 	const char *type = "text/plain";
 	if (CHECK_FILE_EXTENSION(filePath, ".html")) {
@@ -38,6 +42,21 @@ esp_err_t HttpServer::setContentTypeFromFileExtension(httpd_req_t *request, cons
 }
 
 esp_err_t HttpServer::getFrontendFiles(httpd_req_t *request) {
+	rest_server_context_t *context = reinterpret_cast<rest_server_context_t *>(request->user_ctx);
+	if (context->requests != nullptr && xSemaphoreTake(context->idleWorkers, 0) == pdTRUE) {
+		httpd_req_t *asyncRequest = nullptr;
+		if (httpd_req_async_handler_begin(request, &asyncRequest) == ESP_OK) {
+			if (xQueueSend(context->requests, &asyncRequest, 0) == pdTRUE) {
+				return ESP_OK;
+			}
+			httpd_req_async_handler_complete(asyncRequest);
+		}
+		xSemaphoreGive(context->idleWorkers);
+	}
+	return HttpServer::sendFrontendFiles(request);
+}
+
+esp_err_t HttpServer::sendFrontendFiles(httpd_req_t *request) {
 	rest_server_context_t *context = reinterpret_cast<rest_server_context_t *>(request->user_ctx);
 	std::string path(context->basePath);
 	std::string uri(request->uri);
@@ -52,6 +71,20 @@ esp_err_t HttpServer::getFrontendFiles(httpd_req_t *request) {
 		path += uri;
 	}
 
+	if (context->assets->isAvailable()) {
+		std::string assetPath = uri == "/" ? "/index.html" : uri.substr(0, uri.find('?'));
+		const assetPackEntry_t *entry = context->assets->find(assetPath);
+		if (entry == nullptr && !uri.starts_with("/api/")) {
+			entry = context->assets->find("/index.html");
+		}
+		if (entry == nullptr) {
+			ESP_LOGE(TAG, "Asset \"%s\" not found", assetPath.c_str());
+			httpd_resp_send_err(request, HTTPD_404_NOT_FOUND, "File not found");
+			return ESP_FAIL;
+		}
+		return HttpServer::sendAsset(request, context->assets, entry);
+	}
+
 	int fd = open(path.c_str(), O_RDONLY, 0);
 	if (fd == -1) {
 		if (uri.rfind("/api/", 0) == 0) {
@@ -69,8 +102,39 @@ esp_err_t HttpServer::getFrontendFiles(httpd_req_t *request) {
 	}
 
 	HttpServer::setContentTypeFromFileExtension(request, path.c_str());
+	// Header values are referenced until the response is sent
+	std::string encoding = HttpServer::selectEncoding(request, [&path](const std::string &encoding) {
+		struct stat variant;
+		return stat((path + (encoding == "br" ? ".br" : ".gz")).c_str(), &variant) == 0;
+	});
+	if (!encoding.empty()) {
+		std::string variantPath = path + (encoding == "br" ? ".br" : ".gz");
+		int variantFd = open(variantPath.c_str(), O_RDONLY, 0);
+		if (variantFd != -1) {
+			close(fd);
+			fd = variantFd;
+			path = variantPath;
+			httpd_resp_set_hdr(request, "Content-Encoding", encoding.c_str());
+		}
+	}
+	httpd_resp_set_hdr(request, "Vary", "Accept-Encoding");
+	httpd_resp_set_hdr(request, "Cache-Control", HttpServer::CACHE_CONTROL);
+	// Every worker and the server task has its own buffer, so the pool never runs dry
+	char *chunk = context->buffers->acquire();
+	std::string entityTag = HttpServer::getEntityTag(fd, path, chunk);
+	if (!entityTag.empty()) {
+		httpd_resp_set_hdr(request, "ETag", entityTag.c_str());
+		if (HttpServer::isNotModified(request, entityTag)) {
+			context->buffers->release(chunk);
+			close(fd);
+			httpd_resp_set_status(request, "304 Not Modified");
+			httpd_resp_send(request, nullptr, 0);
+			return ESP_OK;
+		}
+	}
 
-	char *chunk = context->scratch;
+	HttpServer::beginTransfer();
+	size_t sentBytes = 0;
 	ssize_t readBytes;
 	do {
 		// Read file in chunks into the scratch buffer
@@ -80,6 +144,8 @@ esp_err_t HttpServer::getFrontendFiles(httpd_req_t *request) {
 		} else if (readBytes > 0) {
 			/* Send the buffer contents as HTTP response chunk */
 			if (httpd_resp_send_chunk(request, chunk, readBytes) != ESP_OK) {
+				HttpServer::endTransfer(sentBytes);
+				context->buffers->release(chunk);
 				close(fd);
 				ESP_LOGE(TAG, "File sending failed!");
 				// Abort sending file
@@ -88,8 +154,11 @@ esp_err_t HttpServer::getFrontendFiles(httpd_req_t *request) {
 				httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send file");
 				return ESP_FAIL;
 			}
+			sentBytes += readBytes;
 		}
 	} while (readBytes > 0);
+	HttpServer::endTransfer(sentBytes);
+	context->buffers->release(chunk);
 	// Close file after sending complete
 	close(fd);
 	ESP_LOGI(TAG, "File \"%s\" sending complete", path.c_str());
@@ -98,10 +167,33 @@ esp_err_t HttpServer::getFrontendFiles(httpd_req_t *request) {
 	return ESP_OK;
 }
 
+void HttpServer::fileWorkerTask(void *arg) {
+	rest_server_context_t *context = reinterpret_cast<rest_server_context_t *>(arg);
+	httpd_req_t *request = nullptr;
+	while (true) {
+		if (xQueueReceive(context->requests, &request, portMAX_DELAY) != pdTRUE) {
+			continue;
+		}
+		HttpServer::sendFrontendFiles(request);
+		httpd_req_async_handler_complete(request);
+		xSemaphoreGive(context->idleWorkers);
+	}
+}
+
 HttpServer::HttpServer(const std::string &basePath) {
 	this->context->basePath = basePath;
+	this->context->assets = new AssetPack();
+	this->context->buffers = nullptr;
+	this->context->requests = nullptr;
+	this->context->idleWorkers = nullptr;
+	if (HttpServer::mutex == nullptr) {
+		HttpServer::mutex = xSemaphoreCreateMutex();
+	}
 	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-	config.max_uri_handlers = 24;
+	config.max_uri_handlers = 32;
+	// Sockets left over by the browsers are reclaimed instead of refusing new connections
+	config.max_open_sockets = 8;
+	config.lru_purge_enable = true;
 	config.uri_match_fn = httpd_uri_match_wildcard;
 
 	ESP_LOGI(TAG, "Starting HTTP Server");
@@ -111,6 +203,203 @@ HttpServer::HttpServer(const std::string &basePath) {
 		delete context;
 		throw std::exception();
 	}
+	if (this->context->assets->isAvailable()) {
+		// Memory-mapped files are sent without copying, the workers and their buffers are needed only for SPIFFS
+		return;
+	}
+	this->context->buffers = new BufferPool(HTTP_FILE_WORKERS + 1, SCRATCH_BUFSIZE);
+	this->context->requests = xQueueCreate(HTTP_FILE_WORKERS, sizeof(httpd_req_t *));
+	this->context->idleWorkers = xSemaphoreCreateCounting(HTTP_FILE_WORKERS, 0);
+	for (size_t i = 0; i < HTTP_FILE_WORKERS; ++i) {
+		if (xTaskCreate(&HttpServer::fileWorkerTask, "httpFileWorker", 4096, this->context, config.task_priority, nullptr) == pdPASS) {
+			xSemaphoreGive(this->context->idleWorkers);
+			xSemaphoreTake(HttpServer::mutex, portMAX_DELAY);
+			HttpServer::statistics.workers++;
+			xSemaphoreGive(HttpServer::mutex);
+		} else {
+			ESP_LOGW(TAG, "Failed to start file transfer worker %zu.", i);
+		}
+	}
+}
+
+void HttpServer::writeStatistics(JsonWriter &writer) {
+	xSemaphoreTake(HttpServer::mutex, portMAX_DELAY);
+	httpTransferStatistics_t current = HttpServer::statistics;
+	xSemaphoreGive(HttpServer::mutex);
+	if (current.active > 0) {
+		current.busyTime += esp_timer_get_time() - current.busySince;
+	}
+	double throughput = current.busyTime > 0 ? current.bytes * 1000000.0 / current.busyTime : 0;
+	writer.beginObject()
+		.writeInteger("transfers", current.transfers)
+		.writeInteger("bytes", current.bytes)
+		.writeInteger("active", current.active)
+		.writeInteger("peakActive", current.peakActive)
+		.writeInteger("workers", current.workers)
+		.writeNumber("throughput", throughput)
+		.endObject();
+}
+
+void HttpServer::beginTransfer() {
+	xSemaphoreTake(HttpServer::mutex, portMAX_DELAY);
+	if (HttpServer::statistics.active++ == 0) {
+		HttpServer::statistics.busySince = esp_timer_get_time();
+	}
+	HttpServer::statistics.peakActive = std::max(HttpServer::statistics.peakActive, HttpServer::statistics.active);
+	xSemaphoreGive(HttpServer::mutex);
+}
+
+void HttpServer::endTransfer(size_t bytes) {
+	xSemaphoreTake(HttpServer::mutex, portMAX_DELAY);
+	HttpServer::statistics.transfers++;
+	HttpServer::statistics.bytes += bytes;
+	if (--HttpServer::statistics.active == 0) {
+		HttpServer::statistics.busyTime += esp_timer_get_time() - HttpServer::statistics.busySince;
+	}
+	xSemaphoreGive(HttpServer::mutex);
+}
+
+std::string HttpServer::selectEncoding(httpd_req_t *request, const std::function<bool(const std::string &encoding)> &isAvailable) {
+	size_t length = httpd_req_get_hdr_value_len(request, "Accept-Encoding");
+	if (length == 0) {
+		return "";
+	}
+	std::string acceptEncoding(length + 1, '\0');
+	if (httpd_req_get_hdr_value_str(request, "Accept-Encoding", acceptEncoding.data(), acceptEncoding.size()) != ESP_OK) {
+		return "";
+	}
+	acceptEncoding.resize(length);
+	for (const std::string encoding : {"br", "gzip"}) {
+		if (HttpServer::isEncodingAccepted(acceptEncoding, encoding) && isAvailable(encoding)) {
+			return encoding;
+		}
+	}
+	return "";
+}
+
+esp_err_t HttpServer::sendAsset(httpd_req_t *request, const AssetPack *assets, const assetPackEntry_t *entry) {
+	std::string encoding = HttpServer::selectEncoding(request, [entry](const std::string &encoding) {
+		return entry->variants[encoding == "br" ? ASSET_ENCODING_BROTLI : ASSET_ENCODING_GZIP].length > 0;
+	});
+	asset_encoding_t index = ASSET_ENCODING_IDENTITY;
+	if (!encoding.empty()) {
+		index = encoding == "br" ? ASSET_ENCODING_BROTLI : ASSET_ENCODING_GZIP;
+		httpd_resp_set_hdr(request, "Content-Encoding", encoding.c_str());
+	}
+	const assetPackVariant_t &variant = entry->variants[index];
+	httpd_resp_set_type(request, assets->getString(entry->contentType));
+	httpd_resp_set_hdr(request, "Vary", "Accept-Encoding");
+	httpd_resp_set_hdr(request, "Cache-Control", HttpServer::CACHE_CONTROL);
+	const char *entityTag = assets->getString(variant.entityTag);
+	httpd_resp_set_hdr(request, "ETag", entityTag);
+	if (HttpServer::isNotModified(request, entityTag)) {
+		httpd_resp_set_status(request, "304 Not Modified");
+		return httpd_resp_send(request, nullptr, 0);
+	}
+	HttpServer::beginTransfer();
+	esp_err_t result = httpd_resp_send(request, reinterpret_cast<const char *>(assets->getData(variant)), variant.length);
+	HttpServer::endTransfer(result == ESP_OK ? variant.length : 0);
+	return result;
+}
+
+bool HttpServer::isEncodingAccepted(std::string_view acceptEncoding, std::string_view encoding) {
+	// The wildcard applies only to the content codings which are not listed
+	bool wildcardAccepted = false;
+	size_t start = 0;
+	while (start < acceptEncoding.length()) {
+		size_t end = acceptEncoding.find(',', start);
+		if (end == std::string_view::npos) {
+			end = acceptEncoding.length();
+		}
+		std::string_view item = acceptEncoding.substr(start, end - start);
+		start = end + 1;
+		size_t parameters = item.find(';');
+		std::string_view coding = item.substr(0, parameters);
+		size_t first = coding.find_first_not_of(" \t");
+		if (first == std::string_view::npos) {
+			continue;
+		}
+		coding = coding.substr(first, coding.find_last_not_of(" \t") - first + 1);
+		if (coding != encoding && coding != "*") {
+			continue;
+		}
+		// Coding with zero quality value is explicitly refused
+		bool accepted = true;
+		if (parameters != std::string_view::npos) {
+			std::string_view quality = item.substr(parameters + 1);
+			size_t value = quality.find("q=");
+			if (value != std::string_view::npos) {
+				accepted = std::strtod(std::string(quality.substr(value + 2)).c_str(), nullptr) > 0;
+			}
+		}
+		if (coding == encoding) {
+			return accepted;
+		}
+		wildcardAccepted = accepted;
+	}
+	return wildcardAccepted;
+}
+
+std::string HttpServer::getEntityTag(int fd, const std::string &path, char *buffer) {
+	xSemaphoreTake(HttpServer::mutex, portMAX_DELAY);
+	auto cached = HttpServer::entityTags.find(path);
+	if (cached != HttpServer::entityTags.end()) {
+		std::string entityTag = cached->second;
+		xSemaphoreGive(HttpServer::mutex);
+		return entityTag;
+	}
+	xSemaphoreGive(HttpServer::mutex);
+	mbedtls_sha256_context context;
+	mbedtls_sha256_init(&context);
+	mbedtls_sha256_starts(&context, 0);
+	ssize_t readBytes;
+	while ((readBytes = read(fd, buffer, SCRATCH_BUFSIZE)) > 0) {
+		mbedtls_sha256_update(&context, reinterpret_cast<const unsigned char *>(buffer), readBytes);
+	}
+	unsigned char digest[32];
+	mbedtls_sha256_finish(&context, digest);
+	mbedtls_sha256_free(&context);
+	lseek(fd, 0, SEEK_SET);
+	if (readBytes == -1) {
+		ESP_LOGE(TAG, "Failed to read file \"%s\"", path.c_str());
+		return "";
+	}
+	// Truncated digest is unique enough to identify the file content
+	char entityTag[35] = "\"";
+	for (size_t i = 0; i < 16; ++i) {
+		snprintf(entityTag + 1 + i * 2, 3, "%02x", digest[i]);
+	}
+	entityTag[33] = '"';
+	entityTag[34] = '\0';
+	xSemaphoreTake(HttpServer::mutex, portMAX_DELAY);
+	HttpServer::entityTags.emplace(path, entityTag);
+	xSemaphoreGive(HttpServer::mutex);
+	return entityTag;
+}
+
+bool HttpServer::isNotModified(httpd_req_t *request, const std::string &entityTag) {
+	size_t length = httpd_req_get_hdr_value_len(request, "If-None-Match");
+	if (length == 0) {
+		return false;
+	}
+	std::string ifNoneMatch(length + 1, '\0');
+	if (httpd_req_get_hdr_value_str(request, "If-None-Match", ifNoneMatch.data(), ifNoneMatch.size()) != ESP_OK) {
+		return false;
+	}
+	ifNoneMatch.resize(length);
+	if (ifNoneMatch == "*") {
+		return true;
+	}
+	// If-None-Match uses the weak comparison, the W/ prefix is ignored
+	size_t position = 0;
+	while ((position = ifNoneMatch.find(entityTag, position)) != std::string::npos) {
+		size_t end = position + entityTag.length();
+		if (end == ifNoneMatch.length() || ifNoneMatch[end] == ',' || ifNoneMatch[end] == ' ') {
+			return true;
+		}
+		position = end;
+	}
+	return false;
 }
 
 httpd_handle_t HttpServer::getHandle() {
@@ -15,6 +15,9 @@
  */
 #include "network/mqtt.h"
 
+std::vector<Mqtt *> Mqtt::instances = {};
+thread_local bool Mqtt::inEventHandler = false;
+
 MqttLastWillAndTestament::MqttLastWillAndTestament(const std::string &topic, const std::string &message, const int qos, const bool retain): topic(topic), message(message), qos(qos), retain(retain) {}
 
 const std::string &MqttLastWillAndTestament::getTopic() {
@@ -33,7 +36,7 @@ bool MqttLastWillAndTestament::getRetain() const {
 	return this->retain;
 }
 
-MqttConfig::MqttConfig() {
+MqttConfig::MqttConfig(const std::string &nameSpace): nameSpace(nameSpace), nvs(nameSpace) {
 	memset(&this->config, 0, sizeof(esp_mqtt_client_config_t));
 	nvs.getString("uri", this->brokerUri);
 	this->config.broker.address.uri = this->brokerUri.c_str();
@@ -42,9 +45,78 @@ MqttConfig::MqttConfig() {
 	nvs.getString("password", this->password);
 	this->config.credentials.authentication.password = this->password.c_str();
 	if (this->brokerUri.starts_with("mqtts://") || this->brokerUri.starts_with("wss://")) {
-		this->config.broker.verification.crt_bundle_attach = esp_crt_bundle_attach;
+		this->loadCaCertificate();
+		// Pinned certificate replaces the certificate bundle, it is attached by the client
+		if (this->caCertificate.empty()) {
+			this->config.broker.verification.crt_bundle_attach = esp_crt_bundle_attach;
+		}
 	}
+	uint8_t sessionResumption = 1;
+	nvs.get("tlsResume", sessionResumption);
+	this->sessionResumption = sessionResumption != 0;
 	this->config.session.keepalive = 30;
+	uint8_t protocol = 4;
+	nvs.get("protocol", protocol);
+#ifdef CONFIG_MQTT_PROTOCOL_5
+	this->config.session.protocol_ver = protocol == 5 ? MQTT_PROTOCOL_V_5 : MQTT_PROTOCOL_V_3_1_1;
+#else
+	this->config.session.protocol_ver = MQTT_PROTOCOL_V_3_1_1;
+#endif
+	nvs.get("aliasMax", this->topicAliasMaximum);
+	nvs.get("outboxMax", this->outboxLimit);
+	this->config.outbox.limit = this->outboxLimit;
+	uint8_t telemetryQos;
+	if (nvs.getOptional("telemetryQos", telemetryQos) == ESP_OK && telemetryQos <= 2) {
+		this->telemetryQos = telemetryQos;
+	}
+}
+
+uint32_t MqttConfig::getOutboxLimit() const {
+	return this->outboxLimit;
+}
+
+int MqttConfig::getTelemetryQos() const {
+	return this->telemetryQos;
+}
+
+const std::string &MqttConfig::getBrokerUri() const {
+	return this->brokerUri;
+}
+
+const std::string &MqttConfig::getNamespace() const {
+	return this->nameSpace;
+}
+
+const std::string &MqttConfig::getCaCertificate() const {
+	return this->caCertificate;
+}
+
+bool MqttConfig::isSessionResumptionEnabled() const {
+	return this->sessionResumption;
+}
+
+void MqttConfig::loadCaCertificate() {
+	if (nvs.getString("caCert", this->caCertificate) == ESP_OK && !this->caCertificate.empty()) {
+		ESP_LOGI(TAG, "Using pinned CA certificate from NVS namespace \"%s\".", this->nameSpace.c_str());
+		return;
+	}
+	this->caCertificate.clear();
+	std::string path;
+	if (nvs.getString("caFile", path) != ESP_OK || path.empty()) {
+		return;
+	}
+	FILE *file = fopen(path.c_str(), "r");
+	if (file == nullptr) {
+		ESP_LOGE(TAG, "Unable to open CA certificate file \"%s\", the certificate bundle is used.", path.c_str());
+		return;
+	}
+	char buffer[256];
+	size_t length;
+	while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		this->caCertificate.append(buffer, length);
+	}
+	fclose(file);
+	ESP_LOGI(TAG, "Using pinned CA certificate from file \"%s\".", path.c_str());
 }
 
 const esp_mqtt_client_config_t &MqttConfig::get() {
@@ -64,33 +136,67 @@ void MqttConfig::setLastWillAndTestament(MqttLastWillAndTestament *lwt) {
 }
 
 void MqttConfig::setClientId(const std::string &clientId) {
-	this->config.credentials.client_id = clientId.c_str();
+	this->clientId = clientId;
+	this->config.credentials.client_id = this->clientId.c_str();
+}
+
+esp_mqtt_protocol_ver_t MqttConfig::getProtocolVersion() const {
+	return this->config.session.protocol_ver;
 }
 
-std::map<std::string, Mqtt::subscribe_callback_t> Mqtt::callbacks = std::map<std::string, Mqtt::subscribe_callback_t>();
-esp_mqtt_client_handle_t Mqtt::handle = nullptr;
-Mqtt::connect_callback_t Mqtt::onConnect;
-bool Mqtt::connected = false;
+uint16_t MqttConfig::getTopicAliasMaximum() const {
+	return this->topicAliasMaximum;
+}
 
-Mqtt::Mqtt(const MqttConfig &mqttConfig): config(mqttConfig) {
-	esp_log_level_set("MQTT_CLIENT", ESP_LOG_VERBOSE);
-	esp_log_level_set("MQTT", ESP_LOG_VERBOSE);
-	esp_log_level_set("TRANSPORT_BASE", ESP_LOG_VERBOSE);
-	esp_log_level_set("esp-tls", ESP_LOG_VERBOSE);
-	esp_log_level_set("TRANSPORT", ESP_LOG_VERBOSE);
-	esp_log_level_set("OUTBOX", ESP_LOG_VERBOSE);
+Mqtt::Mqtt(const MqttConfig &mqttConfig): config(mqttConfig), protocolVersion(mqttConfig.getProtocolVersion()), topicAliasMaximum(mqttConfig.getTopicAliasMaximum()), publishMutex(xSemaphoreCreateMutex()), deferredMutex(xSemaphoreCreateMutex()), outboxLimit(mqttConfig.getOutboxLimit()), outbox(mqttConfig.getOutboxLimit() * Mqtt::TELEMETRY_OUTBOX_SHARE / 100), outboxMutex(xSemaphoreCreateMutex()) {
+	this->name = mqttConfig.getNamespace();
+	this->metricsMutex = xSemaphoreCreateMutex();
+	this->subscriptionsMutex = xSemaphoreCreateMutex();
+	Mqtt::instances.push_back(this);
+	if (mqttConfig.getTelemetryQos() >= 0) {
+		this->telemetryQos = mqttConfig.getTelemetryQos();
+	} else {
+		this->telemetryQos = this->protocolVersion == MQTT_PROTOCOL_V_5 ? 0 : 2;
+	}
 	esp_mqtt_client_config_t config = this->config.get();
-	Mqtt::handle = esp_mqtt_client_init(&config);
-	if (Mqtt::handle == nullptr) {
+	// The client keeps the pointer to the certificate, the copy owned by the client has to be referenced
+	const std::string &caCertificate = this->config.getCaCertificate();
+	if (!caCertificate.empty()) {
+		config.broker.verification.certificate = caCertificate.c_str();
+		config.broker.verification.certificate_len = caCertificate.length() + 1;
+	}
+	if (this->config.getBrokerUri().starts_with("mqtts://")) {
+		this->tlsTransport = new MqttTlsTransport(caCertificate, this->config.isSessionResumptionEnabled());
+		this->tlsTransport->setOnHandshake([this](int64_t duration, bool sessionOffered) {
+			xSemaphoreTake(this->metricsMutex, portMAX_DELAY);
+			this->metrics.recordHandshake(duration, sessionOffered);
+			xSemaphoreGive(this->metricsMutex);
+		});
+		config.network.transport = this->tlsTransport->getHandle();
+	}
+	this->handle = esp_mqtt_client_init(&config);
+	if (this->handle == nullptr) {
 		ESP_LOGE(TAG, "Unable to create client handle.");
 	}
+#ifdef CONFIG_MQTT_PROTOCOL_5
+	if (this->protocolVersion == MQTT_PROTOCOL_V_5) {
+		esp_mqtt5_connection_property_config_t connectProperty = {};
+		connectProperty.request_problem_info = true;
+		// Incoming messages are consumed rarely, aliases are used only for outgoing telemetry
+		connectProperty.topic_alias_maximum = 0;
+		ESP_ERROR_CHECK_WITHOUT_ABORT(esp_mqtt5_client_set_connect_property(this->handle, &connectProperty));
+	}
+#endif
 	/* The last argument may be used to pass data to the event handler, in this example mqtt_event_handler */
-	ESP_ERROR_CHECK(esp_mqtt_client_register_event(Mqtt::handle, static_cast<esp_mqtt_event_id_t>(ESP_EVENT_ANY_ID), &Mqtt::eventHandler, reinterpret_cast<void*>(this)));
+	ESP_ERROR_CHECK(esp_mqtt_client_register_event(this->handle, static_cast<esp_mqtt_event_id_t>(ESP_EVENT_ANY_ID), &Mqtt::eventHandler, reinterpret_cast<void*>(this)));
 }
 
 void Mqtt::connect() {
-	esp_mqtt_client_start(Mqtt::handle);
-	if (Mqtt::handle == nullptr) {
+	xSemaphoreTake(this->metricsMutex, portMAX_DELAY);
+	this->metrics.recordConnecting(esp_timer_get_time());
+	xSemaphoreGive(this->metricsMutex);
+	esp_mqtt_client_start(this->handle);
+	if (this->handle == nullptr) {
 		ESP_LOGE(TAG, "MQTT client handle in NULL");
 	}
 }
@@ -104,40 +210,70 @@ void Mqtt::eventHandler(void *handler_args, esp_event_base_t base, int32_t event
 		ESP_LOGE(TAG, "MQTT client handle in NULL");
 	}
 
+	// The handler runs with the client API lock held, publishing must not wait for the publish lock here
+	Mqtt::inEventHandler = true;
 	switch (static_cast<esp_mqtt_event_id_t>(event_id)) {
 		case MQTT_EVENT_CONNECTED:
-			ESP_LOGI(TAG, "Connected to the MQTT broker.");
-			for (std::map<std::string, Mqtt::subscribe_callback_t>::iterator it = Mqtt::callbacks.begin(); it != Mqtt::callbacks.end(); ++it) {
-				mqtt->subscribe(it->first, it->second, 1);
+			ESP_LOGI(TAG, "Client \"%s\" connected to the MQTT broker.", mqtt->name.c_str());
+			// Topic aliases are valid only within one network connection, they are reset by the next publish
+			++mqtt->connectionGeneration;
+			mqtt->connected = true;
+			mqtt->handle = event->client;
+			xSemaphoreTake(mqtt->metricsMutex, portMAX_DELAY);
+			mqtt->metrics.recordConnected(esp_timer_get_time());
+			xSemaphoreGive(mqtt->metricsMutex);
+			{
+				std::vector<std::pair<std::string, int>> topics;
+				xSemaphoreTake(mqtt->subscriptionsMutex, portMAX_DELAY);
+				for (const auto &[topic, subscription] : mqtt->exactSubscriptions) {
+					topics.emplace_back(topic, subscription.qos);
+				}
+				for (const Mqtt::Subscription &subscription : mqtt->wildcardSubscriptions) {
+					topics.emplace_back(subscription.filter.getFilter(), subscription.qos);
+				}
+				xSemaphoreGive(mqtt->subscriptionsMutex);
+				for (const auto &[topic, qos] : topics) {
+					mqtt->sendSubscribe(topic, qos);
+				}
 			}
-			Mqtt::connected = true;
-			Mqtt::handle = event->client;
-			if (Mqtt::onConnect) {
-				Mqtt::onConnect(mqtt, base, event);
+			if (mqtt->onConnect) {
+				mqtt->onConnect(mqtt, base, event);
 			}
+			mqtt->drainOutbox();
 			break;
 		case MQTT_EVENT_DISCONNECTED:
-			Mqtt::connected = false;
-			ESP_LOGE(TAG, "Disconnected from the MQTT broker.");
+			mqtt->connected = false;
+			ESP_LOGE(TAG, "Client \"%s\" disconnected from the MQTT broker.", mqtt->name.c_str());
+			xSemaphoreTake(mqtt->metricsMutex, portMAX_DELAY);
+			mqtt->metrics.recordDisconnected(esp_timer_get_time());
+			xSemaphoreGive(mqtt->metricsMutex);
+			// Queued telemetry is outdated after reconnection
+			xSemaphoreTake(mqtt->outboxMutex, portMAX_DELAY);
+			mqtt->outbox.clear();
+			xSemaphoreGive(mqtt->outboxMutex);
 			break;
 		case MQTT_EVENT_SUBSCRIBED:
 			break;
 		case MQTT_EVENT_UNSUBSCRIBED:
 			break;
 		case MQTT_EVENT_PUBLISHED:
-			break;
-		case MQTT_EVENT_DATA: {
-			std::string topic(event->topic, event->topic_len);
-			ESP_LOGI(TAG, "Received data from topic \"%s\":", topic.c_str());
-			ESP_LOG_BUFFER_HEXDUMP(TAG, event->data, event->data_len, ESP_LOG_INFO);
-			if (Mqtt::callbacks.find(topic) != Mqtt::callbacks.end()) {
-				Mqtt::subscribe_callback_t callback = Mqtt::callbacks[topic];
-				callback(event);
-			} else {
-				ESP_LOGE(TAG, "Unable to find callback for topic: \"%s\".", topic.c_str());
+			xSemaphoreTake(mqtt->metricsMutex, portMAX_DELAY);
+			mqtt->metrics.recordAcknowledged(event->msg_id, esp_timer_get_time());
+			xSemaphoreGive(mqtt->metricsMutex);
+			if (mqtt->onPublished) {
+				mqtt->onPublished(mqtt, event->msg_id);
 			}
+			mqtt->drainOutbox();
+			break;
+		case MQTT_EVENT_DELETED:
+			xSemaphoreTake(mqtt->metricsMutex, portMAX_DELAY);
+			mqtt->metrics.recordDeleted(event->msg_id);
+			xSemaphoreGive(mqtt->metricsMutex);
+			mqtt->drainOutbox();
+			break;
+		case MQTT_EVENT_DATA:
+			mqtt->dispatch(event);
 			break;
-		}
 		case MQTT_EVENT_ERROR:
 			ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
 			if (event->error_handle->error_type == MQTT_ERROR_TYPE_TCP_TRANSPORT) {
@@ -148,38 +284,385 @@ void Mqtt::eventHandler(void *handler_args, esp_event_base_t base, int32_t event
 			}
 			break;
 		default:
-			ESP_LOGI(TAG, "Other event id: %d", event->event_id);
+			ESP_LOGD(TAG, "Other event id: %d", event->event_id);
 			break;
 	}
+	Mqtt::inEventHandler = false;
 }
 
-int Mqtt::publishString(const std::string &topic, const std::string &data, const int qos, const bool retain) {
-	if (Mqtt::handle == nullptr) {
+void Mqtt::dispatch(esp_mqtt_event_handle_t event) {
+	// Continuation of a fragmented message does not carry the topic
+	if (event->topic_len == 0) {
+		return;
+	}
+	std::string topic(event->topic, event->topic_len);
+	ESP_LOGD(TAG, "Received data from topic \"%s\":", topic.c_str());
+	ESP_LOG_BUFFER_HEXDUMP(TAG, event->data, event->data_len, ESP_LOG_DEBUG);
+	// Callbacks may (un)subscribe, the callback is copied and run without the lock
+	Mqtt::subscribe_callback_t callback;
+	xSemaphoreTake(this->subscriptionsMutex, portMAX_DELAY);
+	auto exact = this->exactSubscriptions.find(topic);
+	if (exact != this->exactSubscriptions.end()) {
+		callback = exact->second.callback;
+	} else {
+		for (const Mqtt::Subscription &subscription : this->wildcardSubscriptions) {
+			if (subscription.filter.match(topic)) {
+				callback = subscription.callback;
+				break;
+			}
+		}
+	}
+	xSemaphoreGive(this->subscriptionsMutex);
+	if (!callback) {
+		ESP_LOGE(TAG, "Unable to find callback for topic: \"%s\".", topic.c_str());
+		return;
+	}
+	callback(event);
+}
+
+int Mqtt::publishString(const std::string &topic, const std::string &data, const int qos, const bool retain, const mqttPublishProperties_t *properties) {
+	return this->publish(topic, reinterpret_cast<const uint8_t *>(data.data()), data.length(), qos, retain, properties);
+}
+
+int Mqtt::publish(const std::string &topic, const uint8_t *data, size_t length, const int qos, const bool retain, const mqttPublishProperties_t *properties) {
+	return this->publishMessage(topic, data, length, qos, retain, properties, false);
+}
+
+int Mqtt::publishMessage(const std::string &topic, const uint8_t *data, size_t length, const int qos, const bool retain, const mqttPublishProperties_t *properties, bool telemetry) {
+	if (this->handle == nullptr) {
 		ESP_LOGE(TAG, "MQTT client handle in NULL");
 		return -1;
 	}
-	if (!Mqtt::connected) {
+	if (!this->connected) {
 		return -1;
 	}
-	int msgId = esp_mqtt_client_publish(Mqtt::handle, topic.c_str(), data.c_str(), data.length(), qos, retain);
-	ESP_LOGI(TAG, "Published \"%s\" to the topic \"%s\" with QoS %d. Message ID: %d", data.c_str(), topic.c_str(), qos, msgId);
+	std::string_view payload(reinterpret_cast<const char *>(data), length);
+	if (!this->lockPublishing()) {
+		// The lock holder waits for the client API lock held by this event handler, it publishes the message after unlocking
+		MqttOutbox::Message message = {topic, std::string(payload), qos, retain};
+		if (properties != nullptr) {
+			message.hasProperties = true;
+			message.properties = *properties;
+		}
+		xSemaphoreTake(this->deferredMutex, portMAX_DELAY);
+		if (this->deferred.size() >= Mqtt::MAX_DEFERRED) {
+			// Only telemetry is evicted, the event handler must not block waiting for space
+			auto evicted = std::find_if(this->deferred.begin(), this->deferred.end(), [](const Mqtt::DeferredMessage &item) {
+				return item.telemetry;
+			});
+			if (evicted == this->deferred.end()) {
+				xSemaphoreGive(this->deferredMutex);
+				ESP_LOGE(TAG, "Too many deferred messages, failed to publish the message for the topic \"%s\".", topic.c_str());
+				return -1;
+			}
+			ESP_LOGW(TAG, "Too many deferred messages, dropping the telemetry for the topic \"%s\".", evicted->message.topic.c_str());
+			this->deferred.erase(evicted);
+		}
+		this->deferred.push_back({std::move(message), telemetry});
+		xSemaphoreGive(this->deferredMutex);
+		// The lock may have been released before the message was deferred
+		this->publishDeferred();
+		return Mqtt::PUBLISH_DEFERRED;
+	}
+	int msgId = this->publishLocked(topic, payload, qos, retain, properties);
+	xSemaphoreGive(this->publishMutex);
+	this->publishDeferred();
+	return msgId;
+}
+
+bool Mqtt::lockPublishing() {
+	return xSemaphoreTake(this->publishMutex, Mqtt::inEventHandler ? 0 : portMAX_DELAY) == pdTRUE;
+}
+
+int Mqtt::publishLocked(const std::string &topic, std::string_view payload, const int qos, const bool retain, const mqttPublishProperties_t *properties) {
+	// The acknowledgement may be handled before the publication is recorded, the latency is measured from this time
+	int64_t publishedAt = esp_timer_get_time();
+	int msgId;
+#ifdef CONFIG_MQTT_PROTOCOL_5
+	if (this->protocolVersion == MQTT_PROTOCOL_V_5) {
+		// The publish property is sent with the next message, it is set for every message so no property of a previous message is reused
+		msgId = this->publishWithProperties(topic, payload, qos, retain, properties != nullptr ? *properties : mqttPublishProperties_t{});
+	} else {
+#endif
+		msgId = esp_mqtt_client_publish(this->handle, topic.c_str(), payload.data(), payload.length(), qos, retain);
+		ESP_LOGD(TAG, "Published %u bytes to the topic \"%s\" with QoS %d. Message ID: %d", payload.length(), topic.c_str(), qos, msgId);
+		if (msgId == -2) {
+			++this->rejected;
+		}
+		if (msgId < 0) {
+			ESP_LOGE(TAG, "Failed to publish %u bytes to the topic \"%s\" with QoS %d.", payload.length(), topic.c_str(), qos);
+			msgId = -1;
+		}
+#ifdef CONFIG_MQTT_PROTOCOL_5
+	}
+#endif
+	xSemaphoreTake(this->metricsMutex, portMAX_DELAY);
+	this->metrics.recordPublished(msgId, qos, payload.length(), publishedAt);
+	xSemaphoreGive(this->metricsMutex);
+	return msgId;
+}
+
+void Mqtt::publishDeferred() {
+	while (true) {
+		xSemaphoreTake(this->deferredMutex, portMAX_DELAY);
+		bool empty = this->deferred.empty();
+		xSemaphoreGive(this->deferredMutex);
+		if (empty || !this->lockPublishing()) {
+			return;
+		}
+		xSemaphoreTake(this->deferredMutex, portMAX_DELAY);
+		if (this->deferred.empty()) {
+			xSemaphoreGive(this->deferredMutex);
+			xSemaphoreGive(this->publishMutex);
+			return;
+		}
+		MqttOutbox::Message message = std::move(this->deferred.front().message);
+		this->deferred.pop_front();
+		xSemaphoreGive(this->deferredMutex);
+		if (this->connected) {
+			this->publishLocked(message.topic, message.data, message.qos, message.retain, message.hasProperties ? &message.properties : nullptr);
+		}
+		xSemaphoreGive(this->publishMutex);
+	}
+}
+
+int Mqtt::publishTelemetry(const std::string &topic, const uint8_t *data, size_t length, const int qos, const bool retain, const mqttPublishProperties_t *properties) {
+	if (!this->connected) {
+		return -1;
+	}
+	// Messages with QoS 0 are not stored in the client outbox
+	if (qos == 0) {
+		return this->publishMessage(topic, data, length, qos, retain, properties, true);
+	}
+	// The client API takes its own lock, it must not be called while the queue is locked
+	bool hasSpace = this->hasOutboxSpace(length);
+	xSemaphoreTake(this->outboxMutex, portMAX_DELAY);
+	bool publishNow = this->outbox.empty() && hasSpace;
+	if (!publishNow) {
+		MqttOutbox::Message message = {topic, std::string(reinterpret_cast<const char *>(data), length), qos, retain};
+		if (properties != nullptr) {
+			message.hasProperties = true;
+			message.properties = *properties;
+		}
+		this->outbox.push(std::move(message));
+	}
+	xSemaphoreGive(this->outboxMutex);
+	if (!publishNow) {
+		return 0;
+	}
+	return this->publishMessage(topic, data, length, qos, retain, properties, true);
+}
+
+void Mqtt::drainOutbox() {
+	while (this->connected) {
+		xSemaphoreTake(this->outboxMutex, portMAX_DELAY);
+		bool empty = this->outbox.empty();
+		size_t length = empty ? 0 : this->outbox.front().data.length();
+		xSemaphoreGive(this->outboxMutex);
+		if (empty || !this->hasOutboxSpace(length)) {
+			return;
+		}
+		xSemaphoreTake(this->outboxMutex, portMAX_DELAY);
+		if (this->outbox.empty()) {
+			xSemaphoreGive(this->outboxMutex);
+			return;
+		}
+		MqttOutbox::Message message = this->outbox.take();
+		xSemaphoreGive(this->outboxMutex);
+		this->publishMessage(message.topic, reinterpret_cast<const uint8_t *>(message.data.data()), message.data.length(), message.qos, message.retain, message.hasProperties ? &message.properties : nullptr, true);
+	}
+}
+
+bool Mqtt::hasOutboxSpace(size_t length) {
+	if (this->outboxLimit == 0) {
+		return true;
+	}
+	int outboxSize = esp_mqtt_client_get_outbox_size(this->handle);
+	return static_cast<size_t>(std::max(outboxSize, 0)) + length <= this->outboxLimit * Mqtt::TELEMETRY_OUTBOX_SHARE / 100;
+}
+
+mqttOutboxMetrics_t Mqtt::getOutboxMetrics() {
+	size_t outboxBytes = static_cast<size_t>(std::max(esp_mqtt_client_get_outbox_size(this->handle), 0));
+	xSemaphoreTake(this->outboxMutex, portMAX_DELAY);
+	mqttOutboxMetrics_t metrics = {
+		.outboxBytes = outboxBytes,
+		.outboxLimit = this->outboxLimit,
+		.queuedMessages = this->outbox.size(),
+		.queuedBytes = this->outbox.getBytes(),
+		.superseded = this->outbox.getSuperseded(),
+		.dropped = this->outbox.getDropped(),
+		.rejected = this->rejected,
+	};
+	xSemaphoreGive(this->outboxMutex);
+	return metrics;
+}
+
+cJSON *Mqtt::getDiagnostics() {
+	mqttOutboxMetrics_t outboxMetrics = this->getOutboxMetrics();
+	cJSON *root = cJSON_CreateObject();
+	cJSON_AddStringToObject(root, "name", this->name.c_str());
+	cJSON_AddBoolToObject(root, "connected", this->connected);
+	xSemaphoreTake(this->metricsMutex, portMAX_DELAY);
+	this->metrics.toJson(root, esp_timer_get_time());
+	xSemaphoreGive(this->metricsMutex);
+	cJSON *outbox = cJSON_AddObjectToObject(root, "outbox");
+	cJSON_AddNumberToObject(outbox, "bytes", outboxMetrics.outboxBytes);
+	cJSON_AddNumberToObject(outbox, "limit", outboxMetrics.outboxLimit);
+	cJSON_AddNumberToObject(outbox, "queuedMessages", outboxMetrics.queuedMessages);
+	cJSON_AddNumberToObject(outbox, "queuedBytes", outboxMetrics.queuedBytes);
+	cJSON_AddNumberToObject(outbox, "superseded", outboxMetrics.superseded);
+	cJSON_AddNumberToObject(outbox, "dropped", outboxMetrics.dropped);
+	cJSON_AddNumberToObject(outbox, "rejected", outboxMetrics.rejected);
+	return root;
+}
+
+mqttConnectionStatistics_t Mqtt::getConnectionStatistics() {
+	xSemaphoreTake(this->metricsMutex, portMAX_DELAY);
+	mqttConnectionStatistics_t statistics = this->metrics.getConnectionStatistics();
+	xSemaphoreGive(this->metricsMutex);
+	return statistics;
+}
+
+const std::vector<Mqtt *> &Mqtt::getInstances() {
+	return Mqtt::instances;
+}
+
+#ifdef CONFIG_MQTT_PROTOCOL_5
+int Mqtt::publishWithProperties(const std::string &topic, std::string_view data, const int qos, const bool retain, const mqttPublishProperties_t &properties) {
+	esp_mqtt5_publish_property_config_t property = {};
+	property.message_expiry_interval = properties.messageExpiryInterval;
+	if (!properties.contentType.empty()) {
+		property.content_type = properties.contentType.c_str();
+	}
+	if (!properties.responseTopic.empty()) {
+		property.response_topic = properties.responseTopic.c_str();
+	}
+	if (!properties.correlationData.empty()) {
+		property.correlation_data = properties.correlationData.data();
+		property.correlation_data_len = properties.correlationData.length();
+	}
+	std::vector<esp_mqtt5_user_property_item_t> userProperties;
+	userProperties.reserve(properties.userProperties.size());
+	for (const auto &[key, value] : properties.userProperties) {
+		userProperties.push_back({key.c_str(), value.c_str()});
+	}
+	if (!userProperties.empty()) {
+		esp_mqtt5_client_set_user_property(&property.user_property, userProperties.data(), userProperties.size());
+	}
+	// Topic aliases are valid only within one network connection
+	uint32_t generation = this->connectionGeneration;
+	if (this->aliasGeneration != generation) {
+		this->topicAliases.clear();
+		this->topicAliasesEnabled = true;
+		this->aliasGeneration = generation;
+	}
+	int msgId = -1;
+	// Messages with QoS > 0 may be retransmitted on a new connection where the alias is unknown
+	if (properties.topicAlias && qos == 0 && this->topicAliasesEnabled) {
+		auto alias = this->topicAliases.find(topic);
+		if (alias != this->topicAliases.end()) {
+			property.topic_alias = alias->second;
+			msgId = this->publishWithProperty("", data, qos, retain, property);
+			if (msgId == -1) {
+				// Re-establish the alias with the full topic name
+				msgId = this->publishWithProperty(topic.c_str(), data, qos, retain, property);
+			}
+		} else if (this->topicAliases.size() < this->topicAliasMaximum) {
+			property.topic_alias = this->topicAliases.size() + 1;
+			msgId = this->publishWithProperty(topic.c_str(), data, qos, retain, property);
+			if (msgId != -1) {
+				this->topicAliases.emplace(topic, property.topic_alias);
+			}
+		}
+		if (msgId == -1 && property.topic_alias != 0) {
+			ESP_LOGW(TAG, "Broker does not accept topic aliases, disabling them for this connection.");
+			this->topicAliasesEnabled = false;
+			this->topicAliases.clear();
+		}
+		property.topic_alias = 0;
+	}
+	if (msgId == -1) {
+		msgId = this->publishWithProperty(topic.c_str(), data, qos, retain, property);
+	}
+	if (property.user_property != nullptr) {
+		esp_mqtt5_client_delete_user_property(property.user_property);
+	}
+	ESP_LOGD(TAG, "Published %u bytes to the topic \"%s\" with QoS %d. Message ID: %d", data.length(), topic.c_str(), qos, msgId);
 	if (msgId == -1) {
-		ESP_LOGE(TAG, "Failed to publish \"%s\" to the topic \"%s\" with QoS %d.", data.c_str(), topic.c_str(), qos);
+		ESP_LOGE(TAG, "Failed to publish %u bytes to the topic \"%s\" with QoS %d.", data.length(), topic.c_str(), qos);
 	}
 	return msgId;
 }
 
+int Mqtt::publishWithProperty(const char *topic, std::string_view data, const int qos, const bool retain, const esp_mqtt5_publish_property_config_t &property) {
+	if (esp_mqtt5_client_set_publish_property(this->handle, &property) != ESP_OK) {
+		return -1;
+	}
+	int msgId = esp_mqtt_client_publish(this->handle, topic, data.data(), data.length(), qos, retain);
+	if (msgId == -2) {
+		++this->rejected;
+	}
+	return msgId < 0 ? -1 : msgId;
+}
+#endif
+
+int Mqtt::getTelemetryQos() const {
+	return this->telemetryQos;
+}
+
+const std::string &Mqtt::getName() const {
+	return this->name;
+}
+
+esp_mqtt_protocol_ver_t Mqtt::getProtocolVersion() const {
+	return this->protocolVersion;
+}
+
+bool Mqtt::isConnected() const {
+	return this->connected;
+}
+
 void Mqtt::setOnConnect(Mqtt::connect_callback_t onConnect) {
-	Mqtt::onConnect = onConnect;
+	this->onConnect = onConnect;
+}
+
+void Mqtt::setOnPublished(Mqtt::published_callback_t onPublished) {
+	this->onPublished = onPublished;
 }
 
 int Mqtt::subscribe(const std::string &topic, const Mqtt::subscribe_callback_t &callback, int qos) {
-	if (Mqtt::handle == nullptr) {
+	if (this->handle == nullptr) {
 		ESP_LOGE(TAG, "MQTT client handle in NULL");
 		return -1;
 	}
-	Mqtt::callbacks[topic] = callback;
-	int msgId = esp_mqtt_client_subscribe(Mqtt::handle, topic.c_str(), qos);
+	MqttTopicFilter filter(topic);
+	if (!filter.isValid()) {
+		ESP_LOGE(TAG, "Invalid topic filter \"%s\".", topic.c_str());
+		return -1;
+	}
+	xSemaphoreTake(this->subscriptionsMutex, portMAX_DELAY);
+	if (!filter.hasWildcard()) {
+		this->exactSubscriptions.insert_or_assign(topic, Mqtt::Subscription{filter, callback, qos});
+	} else {
+		auto it = std::find_if(this->wildcardSubscriptions.begin(), this->wildcardSubscriptions.end(), [&topic](const Mqtt::Subscription &subscription) {
+			return subscription.filter.getFilter() == topic;
+		});
+		if (it != this->wildcardSubscriptions.end()) {
+			*it = Mqtt::Subscription{filter, callback, qos};
+		} else {
+			this->wildcardSubscriptions.push_back(Mqtt::Subscription{filter, callback, qos});
+		}
+	}
+	xSemaphoreGive(this->subscriptionsMutex);
+	if (!this->connected) {
+		// The subscription will be established after connecting to the broker
+		return 0;
+	}
+	return this->sendSubscribe(topic, qos);
+}
+
+int Mqtt::sendSubscribe(const std::string &topic, int qos) {
+	int msgId = esp_mqtt_client_subscribe(this->handle, topic.c_str(), qos);
 	ESP_LOGI(TAG, "Subscribed to the topic \"%s\" with QoS %d. Mesasge ID: %d", topic.c_str(), qos, msgId);
 	if (msgId == -1) {
 		ESP_LOGE(TAG, "Failed to suscribe to the topic \"%s\" with QoS %d.", topic.c_str(), qos);
@@ -187,13 +670,27 @@ int Mqtt::subscribe(const std::string &topic, const Mqtt::subscribe_callback_t &
 	return msgId;
 }
 
+bool Mqtt::isSubscribed(const std::string &topic) {
+	xSemaphoreTake(this->subscriptionsMutex, portMAX_DELAY);
+	bool subscribed = this->exactSubscriptions.contains(topic) || std::any_of(this->wildcardSubscriptions.begin(), this->wildcardSubscriptions.end(), [&topic](const Mqtt::Subscription &subscription) {
+		return subscription.filter.match(topic);
+	});
+	xSemaphoreGive(this->subscriptionsMutex);
+	return subscribed;
+}
+
 int Mqtt::unsubscribe(const std::string &topic) {
-	if (Mqtt::handle == nullptr) {
+	if (this->handle == nullptr) {
 		ESP_LOGE(TAG, "MQTT client handle in NULL");
 		return -1;
 	}
-	Mqtt::callbacks.erase(topic);
-	int msgId = esp_mqtt_client_unsubscribe(Mqtt::handle, topic.c_str());
+	xSemaphoreTake(this->subscriptionsMutex, portMAX_DELAY);
+	this->exactSubscriptions.erase(topic);
+	std::erase_if(this->wildcardSubscriptions, [&topic](const Mqtt::Subscription &subscription) {
+		return subscription.filter.getFilter() == topic;
+	});
+	xSemaphoreGive(this->subscriptionsMutex);
+	int msgId = esp_mqtt_client_unsubscribe(this->handle, topic.c_str());
 	ESP_LOGI(TAG, "Unsubscribed from the topic \"%s\". Mesasge ID: %d", topic.c_str(), msgId);
 	if (msgId == -1) {
 		ESP_LOGE(TAG, "Failed to unsuscribe from the topic \"%s\".", topic.c_str());
@@ -0,0 +1,173 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "network/mqttMetrics.h"
+
+void MqttMetrics::recordConnecting(int64_t now) {
+	this->connectingAt = now;
+}
+
+void MqttMetrics::recordConnected(int64_t now) {
+	int64_t latency = now - this->connectingAt;
+	if (this->connects == 0) {
+		this->initialConnectLatency = latency;
+	} else {
+		this->lastReconnectLatency = latency;
+		this->reconnectTime += latency;
+		this->maxReconnectLatency = std::max(this->maxReconnectLatency, latency);
+	}
+	++this->connects;
+	this->connectedAt = now;
+}
+
+void MqttMetrics::recordDisconnected(int64_t now) {
+	// Failed connection attempts are reported as disconnections too
+	if (this->connectedAt == 0) {
+		return;
+	}
+	++this->disconnects;
+	this->connectedTime += now - this->connectedAt;
+	this->connectedAt = 0;
+	this->connectingAt = now;
+}
+
+void MqttMetrics::recordHandshake(int64_t duration, bool sessionOffered) {
+	if (sessionOffered) {
+		this->resumedHandshake.record(duration);
+	} else {
+		this->fullHandshake.record(duration);
+	}
+}
+
+void MqttMetrics::recordPublished(int msgId, int qos, size_t length, int64_t publishedAt) {
+	if (msgId < 0) {
+		++this->failed;
+		return;
+	}
+	++this->published;
+	this->bytesSent += length;
+	if (qos == 0) {
+		return;
+	}
+	auto acknowledgement = this->earlyAcknowledgements.find(msgId);
+	if (acknowledgement != this->earlyAcknowledgements.end()) {
+		int64_t acknowledgedAt = acknowledgement->second;
+		this->earlyAcknowledgements.erase(acknowledgement);
+		// Acknowledgement of an older message with the reused message ID is ignored
+		if (acknowledgedAt >= publishedAt) {
+			this->recordLatency(qos, acknowledgedAt - publishedAt);
+			return;
+		}
+	}
+	if (this->pending.size() >= MqttMetrics::MAX_PENDING) {
+		auto oldest = std::min_element(this->pending.begin(), this->pending.end(), [](const auto &a, const auto &b) {
+			return a.second.publishedAt < b.second.publishedAt;
+		});
+		this->pending.erase(oldest);
+		++this->untracked;
+	}
+	this->pending.insert_or_assign(msgId, MqttMetrics::Pending{publishedAt, qos});
+}
+
+void MqttMetrics::recordAcknowledged(int msgId, int64_t now) {
+	auto message = this->pending.find(msgId);
+	if (message == this->pending.end()) {
+		// The publishing task has not recorded the publication yet
+		if (this->earlyAcknowledgements.size() >= MqttMetrics::MAX_EARLY_ACKNOWLEDGEMENTS) {
+			auto oldest = std::min_element(this->earlyAcknowledgements.begin(), this->earlyAcknowledgements.end(), [](const auto &a, const auto &b) {
+				return a.second < b.second;
+			});
+			this->earlyAcknowledgements.erase(oldest);
+		}
+		this->earlyAcknowledgements.insert_or_assign(msgId, now);
+		return;
+	}
+	this->recordLatency(message->second.qos, now - message->second.publishedAt);
+	this->pending.erase(message);
+}
+
+void MqttMetrics::recordLatency(int qos, int64_t latency) {
+	if (qos == 1) {
+		this->pubAck.record(latency);
+	} else {
+		this->pubComp.record(latency);
+	}
+}
+
+void MqttMetrics::recordDeleted(int msgId) {
+	if (this->pending.erase(msgId) > 0) {
+		++this->expired;
+	}
+}
+
+mqttConnectionStatistics_t MqttMetrics::getConnectionStatistics() const {
+	return {
+		.disconnects = this->disconnects,
+		.reconnects = this->connects > 0 ? this->connects - 1 : 0,
+		.reconnectTime = this->reconnectTime,
+		.expired = this->expired,
+	};
+}
+
+void MqttMetrics::toJson(cJSON *root, int64_t now) const {
+	cJSON *connection = cJSON_AddObjectToObject(root, "connection");
+	cJSON_AddNumberToObject(connection, "connects", this->connects);
+	cJSON_AddNumberToObject(connection, "disconnects", this->disconnects);
+	int64_t connectedTime = this->connectedTime + (this->connectedAt != 0 ? now - this->connectedAt : 0);
+	cJSON_AddNumberToObject(connection, "connectedTime", connectedTime / 1000000);
+	cJSON_AddNumberToObject(connection, "initialConnectLatency", this->initialConnectLatency / 1000.0);
+	cJSON *reconnectLatency = cJSON_AddObjectToObject(connection, "reconnectLatency");
+	cJSON_AddNumberToObject(reconnectLatency, "last", this->lastReconnectLatency / 1000.0);
+	cJSON_AddNumberToObject(reconnectLatency, "max", this->maxReconnectLatency / 1000.0);
+	cJSON *tls = cJSON_AddObjectToObject(connection, "tlsHandshake");
+	cJSON_AddItemToObject(tls, "full", this->fullHandshake.toJson());
+	cJSON_AddItemToObject(tls, "resumed", this->resumedHandshake.toJson());
+	cJSON *publish = cJSON_AddObjectToObject(root, "publish");
+	cJSON_AddNumberToObject(publish, "messages", this->published);
+	cJSON_AddNumberToObject(publish, "bytes", this->bytesSent);
+	cJSON_AddNumberToObject(publish, "failed", this->failed);
+	cJSON_AddNumberToObject(publish, "pending", this->pending.size());
+	cJSON_AddNumberToObject(publish, "expired", this->expired);
+	cJSON_AddNumberToObject(publish, "untracked", this->untracked);
+	cJSON_AddItemToObject(publish, "puback", this->pubAck.toJson());
+	cJSON_AddItemToObject(publish, "pubcomp", this->pubComp.toJson());
+}
+
+void MqttMetrics::Histogram::record(int64_t latency) {
+	size_t bucket = 0;
+	while (bucket < std::size(MqttMetrics::LATENCY_BOUNDS) && latency > static_cast<int64_t>(MqttMetrics::LATENCY_BOUNDS[bucket]) * 1000) {
+		++bucket;
+	}
+	++this->buckets[bucket];
+	++this->count;
+	this->sum += latency;
+	this->max = std::max(this->max, latency);
+}
+
+cJSON *MqttMetrics::Histogram::toJson() const {
+	cJSON *root = cJSON_CreateObject();
+	cJSON_AddNumberToObject(root, "count", this->count);
+	cJSON_AddNumberToObject(root, "average", this->count > 0 ? this->sum / 1000.0 / this->count : 0);
+	cJSON_AddNumberToObject(root, "max", this->max / 1000.0);
+	cJSON *bounds = cJSON_AddArrayToObject(root, "bounds");
+	for (uint32_t bound : MqttMetrics::LATENCY_BOUNDS) {
+		cJSON_AddItemToArray(bounds, cJSON_CreateNumber(bound));
+	}
+	cJSON *buckets = cJSON_AddArrayToObject(root, "buckets");
+	for (uint32_t bucket : this->buckets) {
+		cJSON_AddItemToArray(buckets, cJSON_CreateNumber(bucket));
+	}
+	return root;
+}
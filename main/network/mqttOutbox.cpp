@@ -0,0 +1,95 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "network/mqttOutbox.h"
+
+MqttOutbox::MqttOutbox(size_t capacity): capacity(capacity) {}
+
+bool MqttOutbox::push(MqttOutbox::Message &&message) {
+	size_t messageSize = MqttOutbox::getMessageSize(message);
+	auto queued = std::find_if(this->messages.begin(), this->messages.end(), [&message](const MqttOutbox::Message &item) {
+		return item.topic == message.topic;
+	});
+	if (queued != this->messages.end()) {
+		this->bytes -= MqttOutbox::getMessageSize(*queued);
+		this->messages.erase(queued);
+		++this->superseded;
+	}
+	if (messageSize > this->capacity) {
+		++this->dropped;
+		return false;
+	}
+	while (this->bytes + messageSize > this->capacity) {
+		this->pop();
+		++this->dropped;
+	}
+	this->messages.push_back(std::move(message));
+	this->bytes += messageSize;
+	return true;
+}
+
+const MqttOutbox::Message &MqttOutbox::front() const {
+	return this->messages.front();
+}
+
+void MqttOutbox::pop() {
+	this->bytes -= MqttOutbox::getMessageSize(this->messages.front());
+	this->messages.pop_front();
+}
+
+MqttOutbox::Message MqttOutbox::take() {
+	MqttOutbox::Message message = std::move(this->messages.front());
+	this->bytes -= MqttOutbox::getMessageSize(message);
+	this->messages.pop_front();
+	return message;
+}
+
+void MqttOutbox::clear() {
+	this->dropped += this->messages.size();
+	this->messages.clear();
+	this->bytes = 0;
+}
+
+bool MqttOutbox::empty() const {
+	return this->messages.empty();
+}
+
+size_t MqttOutbox::size() const {
+	return this->messages.size();
+}
+
+size_t MqttOutbox::getBytes() const {
+	return this->bytes;
+}
+
+uint32_t MqttOutbox::getSuperseded() const {
+	return this->superseded;
+}
+
+uint32_t MqttOutbox::getDropped() const {
+	return this->dropped;
+}
+
+size_t MqttOutbox::getMessageSize(const MqttOutbox::Message &message) {
+	size_t size = sizeof(MqttOutbox::Message) + message.topic.length() + message.data.length();
+	if (message.hasProperties) {
+		const mqttPublishProperties_t &properties = message.properties;
+		size += properties.contentType.length() + properties.responseTopic.length() + properties.correlationData.length();
+		for (const auto &[key, value] : properties.userProperties) {
+			size += sizeof(std::pair<std::string, std::string>) + key.length() + value.length();
+		}
+	}
+	return size;
+}
@@ -0,0 +1,207 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "network/mqttTlsTransport.h"
+
+MqttTlsTransport::MqttTlsTransport(const std::string &certificate, bool resumeSessions): certificate(certificate), resumeSessions(resumeSessions) {
+	this->handle = esp_transport_init();
+	if (this->handle == nullptr) {
+		ESP_LOGE(TAG, "Unable to create transport handle.");
+		return;
+	}
+	esp_transport_set_func(this->handle, MqttTlsTransport::connect, MqttTlsTransport::read, MqttTlsTransport::write, MqttTlsTransport::close, MqttTlsTransport::pollRead, MqttTlsTransport::pollWrite, MqttTlsTransport::destroy);
+	esp_transport_set_default_port(this->handle, 8883);
+	esp_transport_set_context_data(this->handle, this);
+}
+
+esp_transport_handle_t MqttTlsTransport::getHandle() const {
+	return this->handle;
+}
+
+void MqttTlsTransport::setOnHandshake(const MqttTlsTransport::handshake_callback_t &onHandshake) {
+	this->onHandshake = onHandshake;
+}
+
+int MqttTlsTransport::connect(esp_transport_handle_t transport, const char *host, int port, int timeoutMs) {
+	MqttTlsTransport *self = static_cast<MqttTlsTransport *>(esp_transport_get_context_data(transport));
+	esp_tls_cfg_t config = {};
+	config.timeout_ms = timeoutMs;
+	if (!self->certificate.empty()) {
+		config.cacert_buf = reinterpret_cast<const unsigned char *>(self->certificate.c_str());
+		// PEM certificate length includes the terminating null character
+		config.cacert_bytes = self->certificate.length() + 1;
+	} else {
+		config.crt_bundle_attach = esp_crt_bundle_attach;
+	}
+	bool sessionOffered = false;
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+	if (self->resumeSessions) {
+		config.client_session = self->session;
+		sessionOffered = self->session != nullptr;
+	}
+#endif
+	self->tls = esp_tls_init();
+	if (self->tls == nullptr) {
+		ESP_LOGE(TAG, "Unable to allocate TLS connection.");
+		return -1;
+	}
+	int64_t start = esp_timer_get_time();
+	if (esp_tls_conn_new_sync(host, strlen(host), port, &config, self->tls) <= 0) {
+		ESP_LOGE(TAG, "TLS connection to %s:%d failed.", host, port);
+		MqttTlsTransport::captureError(transport, self->tls);
+		esp_tls_conn_destroy(self->tls);
+		self->tls = nullptr;
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+		// The server may reject the saved session, the next connection starts with a full handshake
+		esp_tls_free_client_session(self->session);
+		self->session = nullptr;
+#endif
+		return -1;
+	}
+	int64_t duration = esp_timer_get_time() - start;
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+	if (self->resumeSessions) {
+		esp_tls_free_client_session(self->session);
+		self->session = esp_tls_get_client_session(self->tls);
+	}
+#endif
+	ESP_LOGI(TAG, "TLS connection to %s:%d established in %lld ms.", host, port, duration / 1000);
+	if (self->onHandshake) {
+		self->onHandshake(duration, sessionOffered);
+	}
+	return 0;
+}
+
+int MqttTlsTransport::read(esp_transport_handle_t transport, char *buffer, int length, int timeoutMs) {
+	MqttTlsTransport *self = static_cast<MqttTlsTransport *>(esp_transport_get_context_data(transport));
+	if (self->tls == nullptr) {
+		return -1;
+	}
+	if (esp_tls_get_bytes_avail(self->tls) <= 0) {
+		int ready = MqttTlsTransport::poll(self->tls, timeoutMs, false);
+		if (ready <= 0) {
+			return ready == 0 ? ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT : ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+		}
+	}
+	ssize_t result = esp_tls_conn_read(self->tls, buffer, length);
+	if (result == ESP_TLS_ERR_SSL_WANT_READ || result == ESP_TLS_ERR_SSL_WANT_WRITE) {
+		return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+	}
+	if (result == 0) {
+		return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+	}
+	if (result < 0) {
+		MqttTlsTransport::captureError(transport, self->tls);
+		return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+	}
+	return result;
+}
+
+int MqttTlsTransport::write(esp_transport_handle_t transport, const char *buffer, int length, int timeoutMs) {
+	MqttTlsTransport *self = static_cast<MqttTlsTransport *>(esp_transport_get_context_data(transport));
+	if (self->tls == nullptr) {
+		return -1;
+	}
+	int ready = MqttTlsTransport::poll(self->tls, timeoutMs, true);
+	if (ready <= 0) {
+		ESP_LOGW(TAG, "Poll timeout or error while writing.");
+		return ready;
+	}
+	ssize_t result = esp_tls_conn_write(self->tls, buffer, length);
+	if (result < 0) {
+		ESP_LOGE(TAG, "TLS write failed. Error: -0x%x", static_cast<unsigned int>(-result));
+		MqttTlsTransport::captureError(transport, self->tls);
+	}
+	return result;
+}
+
+int MqttTlsTransport::pollRead(esp_transport_handle_t transport, int timeoutMs) {
+	MqttTlsTransport *self = static_cast<MqttTlsTransport *>(esp_transport_get_context_data(transport));
+	if (self->tls == nullptr) {
+		return -1;
+	}
+	if (esp_tls_get_bytes_avail(self->tls) > 0) {
+		return 1;
+	}
+	return MqttTlsTransport::poll(self->tls, timeoutMs, false);
+}
+
+int MqttTlsTransport::pollWrite(esp_transport_handle_t transport, int timeoutMs) {
+	MqttTlsTransport *self = static_cast<MqttTlsTransport *>(esp_transport_get_context_data(transport));
+	if (self->tls == nullptr) {
+		return -1;
+	}
+	return MqttTlsTransport::poll(self->tls, timeoutMs, true);
+}
+
+int MqttTlsTransport::close(esp_transport_handle_t transport) {
+	MqttTlsTransport *self = static_cast<MqttTlsTransport *>(esp_transport_get_context_data(transport));
+	if (self->tls == nullptr) {
+		return 0;
+	}
+	int result = esp_tls_conn_destroy(self->tls);
+	self->tls = nullptr;
+	return result;
+}
+
+int MqttTlsTransport::destroy(esp_transport_handle_t transport) {
+	int result = MqttTlsTransport::close(transport);
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+	MqttTlsTransport *self = static_cast<MqttTlsTransport *>(esp_transport_get_context_data(transport));
+	esp_tls_free_client_session(self->session);
+	self->session = nullptr;
+#endif
+	return result;
+}
+
+void MqttTlsTransport::captureError(esp_transport_handle_t transport, esp_tls_t *tls) {
+	esp_tls_error_handle_t transportError = esp_transport_get_error_handle(transport);
+	esp_tls_error_handle_t tlsError = nullptr;
+	if (transportError == nullptr || esp_tls_get_error_handle(tls, &tlsError) != ESP_OK || tlsError == nullptr) {
+		return;
+	}
+	int code = 0;
+	int flags = 0;
+	esp_err_t error = esp_tls_get_and_clear_last_error(tlsError, &code, &flags);
+	if (error == ESP_OK && code == 0) {
+		return;
+	}
+	transportError->last_error = error;
+	transportError->esp_tls_error_code = code;
+	transportError->esp_tls_flags = flags;
+}
+
+int MqttTlsTransport::poll(esp_tls_t *tls, int timeoutMs, bool write) {
+	int socket = -1;
+	if (esp_tls_get_conn_sockfd(tls, &socket) != ESP_OK || socket < 0) {
+		return -1;
+	}
+	fd_set readySet;
+	fd_set errorSet;
+	FD_ZERO(&readySet);
+	FD_ZERO(&errorSet);
+	FD_SET(socket, &readySet);
+	FD_SET(socket, &errorSet);
+	struct timeval timeout = {
+		.tv_sec = timeoutMs / 1000,
+		.tv_usec = (timeoutMs % 1000) * 1000,
+	};
+	int result = select(socket + 1, write ? nullptr : &readySet, write ? &readySet : nullptr, &errorSet, timeoutMs < 0 ? nullptr : &timeout);
+	if (result > 0 && FD_ISSET(socket, &errorSet)) {
+		ESP_LOGE(TAG, "Socket error while polling: %s", strerror(errno));
+		return -1;
+	}
+	return result;
+}
@@ -0,0 +1,94 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "network/mqttTopicFilter.h"
+
+MqttTopicFilter::MqttTopicFilter(const std::string &filter): filter(filter) {
+	size_t start = 0;
+	while (true) {
+		size_t end = this->filter.find('/', start);
+		size_t length = (end == std::string::npos ? this->filter.length() : end) - start;
+		std::string_view level(this->filter.data() + start, length);
+		if (level == "+") {
+			this->levels.push_back({LevelType::SingleLevel, start, length});
+			this->wildcard = true;
+		} else if (level == "#") {
+			this->levels.push_back({LevelType::MultiLevel, start, length});
+			this->wildcard = true;
+			// Multi-level wildcard has to be the last level of the filter
+			this->valid = end == std::string::npos;
+		} else {
+			if (level.find_first_of("+#") != std::string_view::npos) {
+				this->valid = false;
+			}
+			this->levels.push_back({LevelType::Literal, start, length});
+		}
+		if (end == std::string::npos || !this->valid) {
+			break;
+		}
+		start = end + 1;
+	}
+}
+
+const std::string &MqttTopicFilter::getFilter() const {
+	return this->filter;
+}
+
+bool MqttTopicFilter::hasWildcard() const {
+	return this->wildcard;
+}
+
+bool MqttTopicFilter::isValid() const {
+	return this->valid;
+}
+
+bool MqttTopicFilter::match(std::string_view topic, std::vector<std::string_view> *wildcards) const {
+	if (!this->valid) {
+		return false;
+	}
+	if (!this->wildcard) {
+		return topic == this->filter;
+	}
+	// Topics beginning with `$` are not matched by wildcards on the first level
+	if (!topic.empty() && topic.front() == '$' && this->levels.front().type != LevelType::Literal) {
+		return false;
+	}
+	if (wildcards != nullptr) {
+		wildcards->clear();
+	}
+	size_t start = 0;
+	for (const Level &level : this->levels) {
+		if (level.type == LevelType::MultiLevel) {
+			return true;
+		}
+		if (start > topic.length()) {
+			return false;
+		}
+		size_t end = topic.find('/', start);
+		if (end == std::string_view::npos) {
+			end = topic.length();
+		}
+		std::string_view topicLevel = topic.substr(start, end - start);
+		if (level.type == LevelType::SingleLevel) {
+			if (wildcards != nullptr) {
+				wildcards->push_back(topicLevel);
+			}
+		} else if (topicLevel != std::string_view(this->filter.data() + level.offset, level.length)) {
+			return false;
+		}
+		start = end + 1;
+	}
+	return start > topic.length();
+}
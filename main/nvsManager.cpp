@@ -27,21 +27,21 @@ esp_err_t NvsManager::init() {
 }
 
 NvsManager::NvsManager(const std::string &nameSpace) {
-	ESP_LOGI(LOG_TAG, "Opening Non-Volatile Storage (NVS) handle (%s)...", nameSpace.c_str());
+	ESP_LOGD(LOG_TAG, "Opening Non-Volatile Storage (NVS) handle (%s)...", nameSpace.c_str());
 	esp_err_t result;
 	this->handle = nvs::open_nvs_handle(nameSpace.c_str(), NVS_READWRITE, &result);
 	if (result != ESP_OK) {
 		ESP_LOGE(LOG_TAG, "Error (%s) opening NVS handle!", esp_err_to_name(result));
 		return;
 	}
-	ESP_LOGI(LOG_TAG, "Done");
+	ESP_LOGD(LOG_TAG, "Done");
 }
 
 esp_err_t NvsManager::commit() {
-	ESP_LOGI(LOG_TAG, "Committing updates...");
+	ESP_LOGD(LOG_TAG, "Committing updates...");
 	esp_err_t result = this->handle->commit();
 	if (result == ESP_OK) {
-		ESP_LOGI(LOG_TAG, "Updates comitted.");
+		ESP_LOGD(LOG_TAG, "Updates comitted.");
 	} else {
 		ESP_LOGE(LOG_TAG, "Failed to commit updates. Error: %s", esp_err_to_name(result));
 	}
@@ -49,7 +49,7 @@ esp_err_t NvsManager::commit() {
 }
 
 esp_err_t NvsManager::getString(const std::string &key, std::string &value) {
-	ESP_LOGI(LOG_TAG, "Reading \"%s\"...", key.c_str());
+	ESP_LOGD(LOG_TAG, "Reading \"%s\"...", key.c_str());
 	size_t size;
 	esp_err_t result = this->handle->get_item_size(nvs::ItemType::SZ, key.c_str(), size);
 	if (result != ESP_OK) {
@@ -68,8 +68,18 @@ esp_err_t NvsManager::getString(const std::string &key, std::string &value) {
 	return result;
 }
 
+esp_err_t NvsManager::getOptionalString(const std::string &key, std::string &value) {
+	size_t size;
+	esp_err_t result = this->handle->get_item_size(nvs::ItemType::SZ, key.c_str(), size);
+	if (result == ESP_ERR_NVS_NOT_FOUND) {
+		ESP_LOGD(LOG_TAG, "Optional key \"%s\" is not set.", key.c_str());
+		return result;
+	}
+	return this->getString(key, value);
+}
+
 esp_err_t NvsManager::setString(const std::string &key, const std::string &value) {
-	ESP_LOGI(LOG_TAG, "Writing string \"%s\" to key \"%s\".", value.c_str(), key.c_str());
+	ESP_LOGD(LOG_TAG, "Writing string \"%s\" to key \"%s\".", value.c_str(), key.c_str());
 	esp_err_t result = this->handle->set_string(key.c_str(), value.c_str());
 	if (result != ESP_OK) {
 		ESP_LOGE(LOG_TAG, "Failed to set string \"%s\" to key \"%s\". Error: %s", value.c_str(), key.c_str(), esp_err_to_name(result));
@@ -78,14 +88,14 @@ esp_err_t NvsManager::setString(const std::string &key, const std::string &value
 }
 
 esp_err_t NvsManager::setStringDefault(const std::string &key, const std::string &value) {
-	ESP_LOGI(LOG_TAG, "Writing default string \"%s\" to key \"%s\".", value.c_str(), key.c_str());
+	ESP_LOGD(LOG_TAG, "Writing default string \"%s\" to key \"%s\".", value.c_str(), key.c_str());
 	size_t size;
 	esp_err_t result = this->handle->get_item_size(nvs::ItemType::SZ, key.c_str(), size);
 	if (result == ESP_ERR_NVS_NOT_FOUND) {
 		result = this->handle->set_string(key.c_str(), value.c_str());
 	}
 	if (result == ESP_OK) {
-		ESP_LOGI(LOG_TAG, "Key \"%s\" is already set.", key.c_str());
+		ESP_LOGD(LOG_TAG, "Key \"%s\" is already set.", key.c_str());
 	} else {
 		ESP_LOGE(LOG_TAG, "Failed to set default string \"%s\" to key \"%s\". Error: %s", value.c_str(), key.c_str(), esp_err_to_name(result));
 	}
@@ -93,7 +103,7 @@ esp_err_t NvsManager::setStringDefault(const std::string &key, const std::string
 }
 
 esp_err_t NvsManager::remove(const std::string &key) {
-	ESP_LOGI(LOG_TAG, "Removing key \"%s\"...", key.c_str());
+	ESP_LOGD(LOG_TAG, "Removing key \"%s\"...", key.c_str());
 	esp_err_t result = this->handle->erase_item(key.c_str());
 	if (result != ESP_OK) {
 		ESP_LOGE(LOG_TAG, "Failed to remove key \"%s\". Error: %s", key.c_str(), esp_err_to_name(result));
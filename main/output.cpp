@@ -16,6 +16,7 @@
 #include "output.h"
 
 QueueHandle_t Output::buttonQueue = nullptr;
+Output::admission_callback_t Output::admissionCallback = nullptr;
 
 Output::Output(Ina3221 *ina3221, ina3221_channel_t channel, gpio_num_t enable, gpio_num_t alert, gpio_num_t button, uint8_t index): ina3221(ina3221), channel(channel), alertPin(alert), buttonPin(button), enablePin(enable), index(index) {
 	gpio_config_t alertConfig = {
@@ -80,9 +81,17 @@ esp_err_t Output::removeAlertHandler() {
 	return gpio_isr_handler_remove(this->alertPin);
 }
 
-void Output::enable(bool enabled) {
+bool Output::enable(bool enabled) {
+	if (enabled && !this->enabled && Output::admissionCallback && !Output::admissionCallback(this)) {
+		return false;
+	}
 	this->enabled = enabled;
 	ESP_ERROR_CHECK(gpio_set_level(this->enablePin, static_cast<uint32_t>(!enabled)));
+	return true;
+}
+
+void Output::setAdmissionCallback(const Output::admission_callback_t &callback) {
+	Output::admissionCallback = callback;
 }
 
 bool Output::isEnabled() {
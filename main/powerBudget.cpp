@@ -0,0 +1,213 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "powerBudget.h"
+
+std::string PowerBudget::domain = "";
+std::string PowerBudget::reportTopic = "";
+uint32_t PowerBudget::total = 0;
+uint32_t PowerBudget::fallback = PowerBudget::HARDWARE_LIMIT;
+uint32_t PowerBudget::reserve = 500;
+uint32_t PowerBudget::draw = 0;
+std::multimap<int64_t, uint32_t> PowerBudget::reservations = {};
+std::map<std::string, powerBudgetPeer_t> PowerBudget::peers = {};
+int64_t PowerBudget::lastEcho = 0;
+int64_t PowerBudget::lastReport = 0;
+Mqtt *PowerBudget::mqtt = nullptr;
+SemaphoreHandle_t PowerBudget::mutex = nullptr;
+
+void PowerBudget::init() {
+	PowerBudget::mutex = xSemaphoreCreateMutex();
+	NvsManager nvs("budget");
+	nvs.getString("domain", PowerBudget::domain);
+	nvs.get("total", PowerBudget::total);
+	nvs.get("fallback", PowerBudget::fallback);
+	PowerBudget::fallback = std::min(PowerBudget::fallback, PowerBudget::HARDWARE_LIMIT);
+	nvs.get("reserve", PowerBudget::reserve);
+	PowerBudget::reportTopic = PowerBudget::BASE_TOPIC + PowerBudget::domain + "/" + Wifi::getPrimaryMacAddress();
+	if (PowerBudget::domain.empty()) {
+		// Local-only budget does not restrict power-on, outputs are shed only when the draw exceeds the safe local budget
+		return;
+	}
+	Output::setAdmissionCallback(PowerBudget::admit);
+}
+
+void PowerBudget::attach(Mqtt *mqtt) {
+	if (PowerBudget::domain.empty()) {
+		return;
+	}
+	PowerBudget::mqtt = mqtt;
+	mqtt->subscribe(PowerBudget::BASE_TOPIC + PowerBudget::domain + "/+", PowerBudget::reportCallback, 0);
+}
+
+void PowerBudget::update(float draw) {
+	int64_t now = esp_timer_get_time();
+	xSemaphoreTake(PowerBudget::mutex, portMAX_DELAY);
+	PowerBudget::draw = static_cast<uint32_t>(std::lround(draw));
+	PowerBudget::reservations.erase(PowerBudget::reservations.begin(), PowerBudget::reservations.upper_bound(now));
+	std::erase_if(PowerBudget::peers, [now](const auto &peer) {
+		return now - peer.second.receivedAt > PowerBudget::PEER_TIMEOUT;
+	});
+	bool due = now - PowerBudget::lastReport >= PowerBudget::REPORT_INTERVAL;
+	xSemaphoreGive(PowerBudget::mutex);
+	if (due) {
+		PowerBudget::publishReport();
+	}
+}
+
+bool PowerBudget::isOverBudget(float draw) {
+	if (draw > PowerBudget::HARDWARE_LIMIT) {
+		return true;
+	}
+	int64_t now = esp_timer_get_time();
+	xSemaphoreTake(PowerBudget::mutex, portMAX_DELAY);
+	if (!PowerBudget::checkCoordinated(now)) {
+		xSemaphoreGive(PowerBudget::mutex);
+		return draw > PowerBudget::fallback;
+	}
+	uint32_t shared = PowerBudget::total;
+	uint32_t othersDraw = 0;
+	for (const auto &[mac, peer] : PowerBudget::peers) {
+		if (peer.total > 0) {
+			shared = std::min(shared, peer.total);
+		}
+		othersDraw += peer.draw;
+	}
+	float fairShare = static_cast<float>(shared) / (PowerBudget::peers.size() + 1);
+	xSemaphoreGive(PowerBudget::mutex);
+	// Members drawing less than the fair share keep their outputs, so the overload is resolved by the largest consumers
+	return draw + othersDraw > shared && draw > fairShare;
+}
+
+uint32_t PowerBudget::getLimit() {
+	xSemaphoreTake(PowerBudget::mutex, portMAX_DELAY);
+	uint32_t limit = PowerBudget::calculateLimit(esp_timer_get_time());
+	xSemaphoreGive(PowerBudget::mutex);
+	return limit;
+}
+
+bool PowerBudget::isCoordinated() {
+	xSemaphoreTake(PowerBudget::mutex, portMAX_DELAY);
+	bool coordinated = PowerBudget::checkCoordinated(esp_timer_get_time());
+	xSemaphoreGive(PowerBudget::mutex);
+	return coordinated;
+}
+
+void PowerBudget::reportCallback(esp_mqtt_event_handle_t event) {
+	std::string_view topic(event->topic, event->topic_len);
+	std::string mac(topic.substr(topic.rfind('/') + 1));
+	int64_t now = esp_timer_get_time();
+	if (topic == PowerBudget::reportTopic) {
+		xSemaphoreTake(PowerBudget::mutex, portMAX_DELAY);
+		PowerBudget::lastEcho = now;
+		xSemaphoreGive(PowerBudget::mutex);
+		return;
+	}
+	cJSON *root = cJSON_ParseWithLength(event->data, event->data_len);
+	if (root == nullptr) {
+		ESP_LOGW(TAG, "Invalid budget report of \"%s\".", mac.c_str());
+		return;
+	}
+	cJSON *draw = cJSON_GetObjectItem(root, "draw");
+	cJSON *reserved = cJSON_GetObjectItem(root, "reserved");
+	cJSON *total = cJSON_GetObjectItem(root, "total");
+	if (!cJSON_IsNumber(draw) || draw->valuedouble < 0 || (reserved != nullptr && (!cJSON_IsNumber(reserved) || reserved->valuedouble < 0)) || (total != nullptr && (!cJSON_IsNumber(total) || total->valuedouble < 0))) {
+		ESP_LOGW(TAG, "Invalid budget report of \"%s\".", mac.c_str());
+		cJSON_Delete(root);
+		return;
+	}
+	powerBudgetPeer_t peer = {
+		.draw = static_cast<uint32_t>(draw->valuedouble),
+		.reserved = reserved != nullptr ? static_cast<uint32_t>(reserved->valuedouble) : 0,
+		.total = total != nullptr ? static_cast<uint32_t>(total->valuedouble) : 0,
+		.receivedAt = now,
+	};
+	cJSON_Delete(root);
+	xSemaphoreTake(PowerBudget::mutex, portMAX_DELAY);
+	PowerBudget::peers.insert_or_assign(mac, peer);
+	xSemaphoreGive(PowerBudget::mutex);
+}
+
+bool PowerBudget::admit(Output *output) {
+	int64_t now = esp_timer_get_time();
+	xSemaphoreTake(PowerBudget::mutex, portMAX_DELAY);
+	PowerBudget::reservations.erase(PowerBudget::reservations.begin(), PowerBudget::reservations.upper_bound(now));
+	uint32_t limit = PowerBudget::calculateLimit(now);
+	uint32_t needed = PowerBudget::draw + PowerBudget::getReserved() + PowerBudget::reserve;
+	if (needed > limit) {
+		xSemaphoreGive(PowerBudget::mutex);
+		ESP_LOGW(TAG, "Power-on of output %lu denied, %lu mA needed, %lu mA available.", output->getIndex(), needed, limit);
+		return false;
+	}
+	PowerBudget::reservations.emplace(now + PowerBudget::RESERVATION_HOLD, PowerBudget::reserve);
+	xSemaphoreGive(PowerBudget::mutex);
+	// Other members have to see the reservation before they admit their own outputs
+	PowerBudget::publishReport();
+	return true;
+}
+
+uint32_t PowerBudget::calculateLimit(int64_t now) {
+	if (!PowerBudget::checkCoordinated(now)) {
+		return PowerBudget::fallback;
+	}
+	uint32_t shared = PowerBudget::total;
+	uint32_t others = 0;
+	for (const auto &[mac, peer] : PowerBudget::peers) {
+		if (now - peer.receivedAt > PowerBudget::PEER_TIMEOUT) {
+			continue;
+		}
+		if (peer.total > 0) {
+			shared = std::min(shared, peer.total);
+		}
+		others += peer.draw + peer.reserved;
+	}
+	return std::min(shared > others ? shared - others : 0, PowerBudget::HARDWARE_LIMIT);
+}
+
+bool PowerBudget::checkCoordinated(int64_t now) {
+	// The coordination is reachable only while the broker echoes own reports
+	return !PowerBudget::domain.empty() && PowerBudget::total > 0 && PowerBudget::mqtt != nullptr && PowerBudget::mqtt->isConnected() && PowerBudget::lastEcho != 0 && now - PowerBudget::lastEcho <= PowerBudget::PEER_TIMEOUT;
+}
+
+uint32_t PowerBudget::getReserved() {
+	uint32_t reserved = 0;
+	for (const auto &[expiration, amount] : PowerBudget::reservations) {
+		reserved += amount;
+	}
+	return reserved;
+}
+
+void PowerBudget::publishReport() {
+	if (PowerBudget::mqtt == nullptr || !PowerBudget::mqtt->isConnected()) {
+		return;
+	}
+	xSemaphoreTake(PowerBudget::mutex, portMAX_DELAY);
+	cJSON *root = cJSON_CreateObject();
+	cJSON_AddNumberToObject(root, "draw", PowerBudget::draw);
+	cJSON_AddNumberToObject(root, "reserved", PowerBudget::getReserved());
+	cJSON_AddNumberToObject(root, "total", PowerBudget::total);
+	PowerBudget::lastReport = esp_timer_get_time();
+	xSemaphoreGive(PowerBudget::mutex);
+	char *payload = cJSON_PrintUnformatted(root);
+	cJSON_Delete(root);
+	if (payload == nullptr) {
+		return;
+	}
+	mqttPublishProperties_t properties = {
+		.messageExpiryInterval = static_cast<uint32_t>(PowerBudget::PEER_TIMEOUT / 1000000),
+	};
+	PowerBudget::mqtt->publishString(PowerBudget::reportTopic, std::string(payload), 0, false, &properties);
+	cJSON_free(payload);
+}
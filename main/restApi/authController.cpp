@@ -17,100 +17,85 @@
 
 using namespace sbc_pdu::restApi;
 
-AuthController::AuthController() {
-	this->getHandler = {
+const restApiField_t AuthController::credentialsFields[] = {
+	REST_API_FIELD(authCredentialsRequest_t, username, JSON_FIELD_STRING, true),
+	REST_API_FIELD(authCredentialsRequest_t, oldPassword, JSON_FIELD_STRING, true),
+	REST_API_FIELD(authCredentialsRequest_t, newPassword, JSON_FIELD_STRING, true),
+};
+
+const restApiSchema_t AuthController::credentialsSchema = REST_API_SCHEMA(authCredentialsRequest_t, AuthController::credentialsFields);
+
+const restApiField_t AuthController::tokenFields[] = {
+	REST_API_FIELD(authTokenResponse_t, token, JSON_FIELD_STRING, true),
+	REST_API_FIELD(authTokenResponse_t, type, JSON_FIELD_STRING, true),
+	REST_API_FIELD(authTokenResponse_t, expiresIn, JSON_FIELD_INTEGER, true),
+};
+
+const restApiSchema_t AuthController::tokenSchema = REST_API_SCHEMA(authTokenResponse_t, AuthController::tokenFields);
+
+const restApiRoute_t AuthController::routes[] = {
+	{
 		.uri = "/api/v1/auth",
 		.method = HTTP_GET,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &AuthController::get,
-		.user_ctx = nullptr,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
-	this->putHandler = {
+		.request = nullptr,
+		.response = nullptr,
+		.json = false,
+	},
+	{
 		.uri = "/api/v1/auth",
 		.method = HTTP_PUT,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &AuthController::put,
-		.user_ctx = nullptr,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
-}
+		.request = &AuthController::credentialsSchema,
+		.response = nullptr,
+		.json = false,
+	},
+	{
+		// Tokens cannot prolong themselves, the credentials are required
+		.uri = "/api/v1/auth/token",
+		.method = HTTP_POST,
+		.auth = REST_API_AUTH_CREDENTIALS,
+		.handler = &AuthController::issueToken,
+		.request = nullptr,
+		.response = &AuthController::tokenSchema,
+		.json = false,
+	},
+};
 
 void AuthController::registerEndpoints(const httpd_handle_t &server) {
-	httpd_register_uri_handler(server, &this->getHandler);
-	httpd_register_uri_handler(server, &this->putHandler);
+	Router::registerRoutes(server, AuthController::routes);
 }
 
-esp_err_t AuthController::get(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
-	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
-	}
-	httpd_resp_set_type(request, "text/plain");
-	httpd_resp_sendstr(request, "OK");
+esp_err_t AuthController::get(restApiCall_t &call) {
+	httpd_resp_set_type(call.request, "text/plain");
+	httpd_resp_sendstr(call.request, "OK");
 	return ESP_OK;
 }
 
-esp_err_t AuthController::put(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
+esp_err_t AuthController::put(restApiCall_t &call) {
+	const authCredentialsRequest_t *body = static_cast<const authCredentialsRequest_t *>(call.body);
 	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
-	}
-	cJSON *root = nullptr;
-	esp_err_t result = RestApiUtils::parseJsonRequest(request, &root);
-	if (result != ESP_OK) {
-		return result;
+	if (!authenticator.verifyPassword(body->oldPassword)) {
+		call.error = "Incorrect current password.";
+		return ESP_ERR_INVALID_ARG;
 	}
-	bool valid = true;
 	NvsManager nvs = NvsManager("httpCredentials");
-	cJSON *username = cJSON_GetObjectItem(root, "username");
-	if (username == nullptr) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Missing \"username\" property.");
-	}
-	if (!cJSON_IsString(username)) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"username\" is not a string.");
-	}
-	cJSON *oldPassword = cJSON_GetObjectItem(root, "oldPassword");
-	if (oldPassword == nullptr) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Missing \"oldPassword\" property.");
-	}
-	if (!cJSON_IsString(oldPassword)) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"oldPassword\" is not a string.");
-	}
-	std::string oldPasswordString = std::string(oldPassword->valuestring);
-	std::string currentPassword;
-	nvs.getString("password", currentPassword);
-	if (oldPasswordString != currentPassword) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Incorrect current password.");
-	}
-	cJSON *newPassword = cJSON_GetObjectItem(root, "newPassword");
-	if (newPassword == nullptr) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Missing \"newPassword\" property.");
-	}
-	if (!cJSON_IsString(newPassword)) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"newPassword\" is not a string.");
-	}
-	if (valid) {
-		nvs.setString("username", std::string(username->valuestring));
-		nvs.setString("password", std::string(newPassword->valuestring));
-		nvs.commit();
-	}
-	httpd_resp_sendstr(request, nullptr);
-	cJSON_Delete(root);
+	nvs.setString("username", std::string(body->username));
+	nvs.setString("password", std::string(body->newPassword));
+	nvs.commit();
+	restApi::BasicAuthenticator::reload();
+	httpd_resp_sendstr(call.request, nullptr);
+	return ESP_OK;
+}
+
+esp_err_t AuthController::issueToken(restApiCall_t &call) {
+	authTokenResponse_t *response = static_cast<authTokenResponse_t *>(call.response);
+	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
+	httpd_resp_set_hdr(call.request, "Cache-Control", "no-store");
+	snprintf(response->token, sizeof(response->token), "%s", authenticator.issueToken().c_str());
+	snprintf(response->type, sizeof(response->type), "Bearer");
+	response->expiresIn = restApi::BasicAuthenticator::TOKEN_LIFETIME;
 	return ESP_OK;
 }
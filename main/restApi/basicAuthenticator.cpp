@@ -17,45 +17,71 @@
 
 using namespace sbc_pdu::restApi;
 
-BasicAuthenticator::BasicAuthenticator() {
-	this->nvs.getString("username", this->username);
-	this->nvs.getString("password", this->password);
-	this->expectedAuthorizationHeader = this->getExpectedAuthorizationHeader();
+SemaphoreHandle_t BasicAuthenticator::mutex = nullptr;
+bool BasicAuthenticator::loaded = false;
+std::string BasicAuthenticator::expectedAuthorizationHeader = "";
+std::string BasicAuthenticator::password = "";
+std::array<uint8_t, 32> BasicAuthenticator::tokenKey = {};
+
+BasicAuthenticator::BasicAuthenticator() {}
+
+void BasicAuthenticator::init() {
+	BasicAuthenticator::mutex = xSemaphoreCreateMutex();
 }
 
-bool BasicAuthenticator::authenticate(httpd_req_t *request) {
+bool BasicAuthenticator::authenticate(httpd_req_t *request, bool allowToken) {
 	const char headerName[] = "Authorization";
-	size_t bufferLength = httpd_req_get_hdr_value_len(request, headerName);
-	if (bufferLength == 0) {
-		ESP_LOGE(TAG, "No Authorization header received");
+	size_t length = httpd_req_get_hdr_value_len(request, headerName);
+	if (length == 0) {
+		ESP_LOGW(TAG, "No Authorization header received");
 		this->createUnauthorizedResponse(request);
 		return false;
 	}
-	char *buffer = new char[bufferLength + 1];
-	if (!buffer) {
-		ESP_LOGE(TAG, "No enough memory for basic authorization");
-		httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Server Error");
-		return false;
-	}
-
-	if (httpd_req_get_hdr_value_str(request, headerName, buffer, bufferLength + 1) == ESP_OK) {
-		ESP_LOGI(TAG, "Found header => Authorization: %s", buffer);
-	} else {
-		ESP_LOGE(TAG, "No Authorization header received");
+	char buffer[MAX_AUTHORIZATION_LENGTH];
+	if (length >= sizeof(buffer) || httpd_req_get_hdr_value_str(request, headerName, buffer, sizeof(buffer)) != ESP_OK) {
+		ESP_LOGW(TAG, "Invalid Authorization header received");
 		this->createUnauthorizedResponse(request);
-		delete[] buffer;
 		return false;
 	}
-	if (std::string(buffer) != this->expectedAuthorizationHeader) {
+	if (!this->isAuthorized(std::string_view(buffer, length), allowToken)) {
+		ESP_LOGW(TAG, "Invalid credentials received");
 		this->createUnauthorizedResponse(request);
-		delete[] buffer;
 		return false;
 	}
-	ESP_LOGI(TAG, "Authenticated!");
-	delete[] buffer;
+	ESP_LOGD(TAG, "Authenticated!");
 	return true;
 }
 
+bool BasicAuthenticator::isAuthorized(std::string_view authorization, bool allowToken) {
+	if (allowToken && authorization.starts_with("Bearer ")) {
+		return BasicAuthenticator::verifyToken(authorization.substr(7));
+	}
+	xSemaphoreTake(BasicAuthenticator::mutex, portMAX_DELAY);
+	BasicAuthenticator::load();
+	bool authorized = BasicAuthenticator::equals(authorization, BasicAuthenticator::expectedAuthorizationHeader);
+	xSemaphoreGive(BasicAuthenticator::mutex);
+	return authorized;
+}
+
+bool BasicAuthenticator::verifyPassword(std::string_view password) {
+	xSemaphoreTake(BasicAuthenticator::mutex, portMAX_DELAY);
+	BasicAuthenticator::load();
+	bool correct = BasicAuthenticator::equals(password, BasicAuthenticator::password);
+	xSemaphoreGive(BasicAuthenticator::mutex);
+	return correct;
+}
+
+std::string BasicAuthenticator::issueToken() {
+	uint32_t expiration = esp_timer_get_time() / 1000000 + BasicAuthenticator::TOKEN_LIFETIME;
+	std::string token = std::to_string(expiration);
+	char signature[65];
+	xSemaphoreTake(BasicAuthenticator::mutex, portMAX_DELAY);
+	BasicAuthenticator::load();
+	BasicAuthenticator::sign(token, signature);
+	xSemaphoreGive(BasicAuthenticator::mutex);
+	return token + "." + signature;
+}
+
 void BasicAuthenticator::createUnauthorizedResponse(httpd_req_t *request) {
 	httpd_resp_set_status(request, "401 Unauthorized");
 	httpd_resp_set_type(request, "text/plain");
@@ -65,6 +91,73 @@ void BasicAuthenticator::createUnauthorizedResponse(httpd_req_t *request) {
 }
 
 std::string BasicAuthenticator::getExpectedAuthorizationHeader() {
-	std::string credentials = this->username + ":" + this->password;
-	return std::string("Basic ") + Base64::encode(credentials);
+	xSemaphoreTake(BasicAuthenticator::mutex, portMAX_DELAY);
+	BasicAuthenticator::load();
+	std::string header = BasicAuthenticator::expectedAuthorizationHeader;
+	xSemaphoreGive(BasicAuthenticator::mutex);
+	return header;
+}
+
+void BasicAuthenticator::reload() {
+	xSemaphoreTake(BasicAuthenticator::mutex, portMAX_DELAY);
+	BasicAuthenticator::loaded = false;
+	BasicAuthenticator::load();
+	xSemaphoreGive(BasicAuthenticator::mutex);
+}
+
+void BasicAuthenticator::load() {
+	if (BasicAuthenticator::loaded) {
+		return;
+	}
+	NvsManager nvs = NvsManager("httpCredentials");
+	std::string username;
+	nvs.getString("username", username);
+	nvs.getString("password", BasicAuthenticator::password);
+	BasicAuthenticator::expectedAuthorizationHeader = std::string("Basic ") + Base64::encode(username + ":" + BasicAuthenticator::password);
+	// New key revokes the tokens issued for the previous credentials
+	esp_fill_random(BasicAuthenticator::tokenKey.data(), BasicAuthenticator::tokenKey.size());
+	BasicAuthenticator::loaded = true;
+	ESP_LOGI(TAG, "Credentials loaded");
+}
+
+bool BasicAuthenticator::verifyToken(std::string_view token) {
+	size_t separator = token.find('.');
+	if (separator == std::string_view::npos || token.length() - separator - 1 != 64) {
+		return false;
+	}
+	std::string_view payload = token.substr(0, separator);
+	uint32_t expiration = 0;
+	auto [end, error] = std::from_chars(payload.data(), payload.data() + payload.length(), expiration);
+	if (error != std::errc() || end != payload.data() + payload.length()) {
+		return false;
+	}
+	char signature[65];
+	xSemaphoreTake(BasicAuthenticator::mutex, portMAX_DELAY);
+	BasicAuthenticator::load();
+	BasicAuthenticator::sign(payload, signature);
+	xSemaphoreGive(BasicAuthenticator::mutex);
+	if (!BasicAuthenticator::equals(token.substr(separator + 1), std::string_view(signature, 64))) {
+		return false;
+	}
+	return esp_timer_get_time() / 1000000 < expiration;
+}
+
+void BasicAuthenticator::sign(std::string_view payload, char *signature) {
+	unsigned char digest[32];
+	mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), BasicAuthenticator::tokenKey.data(), BasicAuthenticator::tokenKey.size(), reinterpret_cast<const unsigned char *>(payload.data()), payload.length(), digest);
+	for (size_t i = 0; i < sizeof(digest); ++i) {
+		snprintf(signature + i * 2, 3, "%02x", digest[i]);
+	}
+}
+
+bool BasicAuthenticator::equals(std::string_view value, std::string_view expected) {
+	if (expected.empty()) {
+		return value.empty();
+	}
+	// Whole received value is always compared, so the time depends only on its length
+	uint8_t difference = value.length() != expected.length();
+	for (size_t i = 0; i < value.length(); ++i) {
+		difference |= value[i] ^ expected[i % expected.length()];
+	}
+	return difference == 0;
 }
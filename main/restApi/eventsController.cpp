@@ -0,0 +1,218 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "restApi/eventsController.h"
+
+using namespace sbc_pdu::restApi;
+
+std::array<serverSentEvent_t, EventsController::REPLAY_SIZE> EventsController::events = {};
+uint32_t EventsController::nextEventId = 1;
+std::array<serverSentEventsClient_t, EventsController::MAX_CLIENTS> EventsController::clients = {};
+std::array<int16_t, UINT8_MAX + 1> EventsController::flags = {};
+bool EventsController::snapshot = false;
+int64_t EventsController::lastDisconnect = INT64_MIN / 2;
+char EventsController::frame[160] = {};
+SemaphoreHandle_t EventsController::mutex = nullptr;
+TaskHandle_t EventsController::sender = nullptr;
+
+EventsController::EventsController() {
+	if (EventsController::mutex == nullptr) {
+		EventsController::mutex = xSemaphoreCreateMutex();
+		EventsController::flags.fill(-1);
+		xTaskCreate(&EventsController::senderTask, "sseSender", 4096, nullptr, 5, &EventsController::sender);
+	}
+	this->streamHandler = {
+		.uri = "/api/v1/events",
+		.method = HTTP_GET,
+		.handler = &EventsController::stream,
+		.user_ctx = nullptr,
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = nullptr,
+#endif
+	};
+}
+
+void EventsController::registerEndpoints(const httpd_handle_t &server) {
+	httpd_register_uri_handler(server, &this->streamHandler);
+}
+
+esp_err_t EventsController::stream(httpd_req_t *request) {
+	sbc_pdu::restApi::Cors::addHeaders(request);
+	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
+	if (!authenticator.authenticate(request)) {
+		return ESP_OK;
+	}
+	bool resume = false;
+	uint32_t lastEventId = 0;
+	char header[16];
+	if (httpd_req_get_hdr_value_str(request, "Last-Event-ID", header, sizeof(header)) == ESP_OK) {
+		char *end = nullptr;
+		lastEventId = strtoul(header, &end, 10);
+		resume = end != header && *end == '\0';
+	}
+	// Only the HTTP server task occupies the free slots, the slot stays free until it is assigned below
+	xSemaphoreTake(EventsController::mutex, portMAX_DELAY);
+	serverSentEventsClient_t *client = nullptr;
+	for (serverSentEventsClient_t &slot : EventsController::clients) {
+		if (slot.request == nullptr) {
+			client = &slot;
+			break;
+		}
+	}
+	xSemaphoreGive(EventsController::mutex);
+	if (client == nullptr) {
+		httpd_resp_set_status(request, "503 Service Unavailable");
+		httpd_resp_set_type(request, "text/plain");
+		httpd_resp_sendstr(request, "Too many event stream clients.");
+		return ESP_OK;
+	}
+	httpd_req_t *asyncRequest = nullptr;
+	esp_err_t result = httpd_req_async_handler_begin(request, &asyncRequest);
+	if (result != ESP_OK) {
+		ESP_LOGE(TAG, "Failed to keep the request open: %s", esp_err_to_name(result));
+		httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to open the event stream.");
+		return ESP_OK;
+	}
+	sbc_pdu::restApi::Cors::addHeaders(asyncRequest);
+	httpd_resp_set_type(asyncRequest, "text/event-stream");
+	httpd_resp_set_hdr(asyncRequest, "Cache-Control", "no-cache");
+	// Frame buffer belongs to the sender task
+	char retry[24];
+	int length = snprintf(retry, sizeof(retry), "retry: %lu\n\n", static_cast<unsigned long>(EventsController::RETRY_INTERVAL));
+	if (httpd_resp_send_chunk(asyncRequest, retry, length) != ESP_OK) {
+		httpd_req_async_handler_complete(asyncRequest);
+		return ESP_FAIL;
+	}
+	xSemaphoreTake(EventsController::mutex, portMAX_DELAY);
+	uint32_t newestEventId = EventsController::nextEventId - 1;
+	// IDs from before the reboot are newer than the recorded events, such client starts with the live events
+	if (!resume || lastEventId > newestEventId) {
+		lastEventId = newestEventId;
+		EventsController::snapshot = true;
+	} else if (lastEventId + 1 < EventsController::getOldestEventId()) {
+		// State and alert changes may have been overwritten in the replay buffer
+		EventsController::snapshot = true;
+	}
+	client->request = asyncRequest;
+	client->lastEventId = lastEventId;
+	xSemaphoreGive(EventsController::mutex);
+	ESP_LOGI(TAG, "Client connected, resuming after event %lu.", static_cast<unsigned long>(lastEventId));
+	xTaskNotifyGive(EventsController::sender);
+	return ESP_OK;
+}
+
+bool EventsController::isActive() {
+	if (EventsController::mutex == nullptr) {
+		return false;
+	}
+	xSemaphoreTake(EventsController::mutex, portMAX_DELAY);
+	bool active = esp_timer_get_time() - EventsController::lastDisconnect < EventsController::RESUME_WINDOW;
+	for (const serverSentEventsClient_t &client : EventsController::clients) {
+		active |= client.request != nullptr;
+	}
+	xSemaphoreGive(EventsController::mutex);
+	return active;
+}
+
+void EventsController::publish(const std::vector<telemetrySample_t> &samples) {
+	if (EventsController::mutex == nullptr) {
+		return;
+	}
+	xSemaphoreTake(EventsController::mutex, portMAX_DELAY);
+	bool snapshot = EventsController::snapshot;
+	EventsController::snapshot = false;
+	for (const telemetrySample_t &sample : samples) {
+		int16_t previous = EventsController::flags[sample.output];
+		bool enabled = sample.flags & TELEMETRY_FLAG_ENABLED;
+		bool alert = sample.flags & TELEMETRY_FLAG_ALERT;
+		if (snapshot || previous == -1 || ((previous ^ sample.flags) & TELEMETRY_FLAG_ENABLED)) {
+			EventsController::append("state", "{\"output\":%u,\"enabled\":%s}", sample.output, enabled ? "true" : "false");
+		}
+		if (snapshot || previous == -1 || ((previous ^ sample.flags) & TELEMETRY_FLAG_ALERT)) {
+			EventsController::append("alert", "{\"output\":%u,\"alert\":%s}", sample.output, alert ? "true" : "false");
+		}
+		EventsController::flags[sample.output] = sample.flags;
+		EventsController::append("measurement", "{\"output\":%u,\"current\":%.2f,\"voltage\":%.3f}", sample.output, sample.current / 1000.0, sample.voltage / 1000000.0);
+	}
+	xSemaphoreGive(EventsController::mutex);
+	xTaskNotifyGive(EventsController::sender);
+}
+
+void EventsController::append(const char *type, const char *format, ...) {
+	serverSentEvent_t &event = EventsController::events[EventsController::nextEventId % EventsController::REPLAY_SIZE];
+	event.id = EventsController::nextEventId++;
+	event.type = type;
+	va_list arguments;
+	va_start(arguments, format);
+	vsnprintf(event.data, sizeof(event.data), format, arguments);
+	va_end(arguments);
+}
+
+uint32_t EventsController::getOldestEventId() {
+	return EventsController::nextEventId > EventsController::REPLAY_SIZE ? EventsController::nextEventId - EventsController::REPLAY_SIZE : 1;
+}
+
+void EventsController::senderTask(void *arg) {
+	while (true) {
+		bool keepAlive = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(EventsController::KEEP_ALIVE_INTERVAL)) == 0;
+		for (serverSentEventsClient_t &client : EventsController::clients) {
+			// Only this task modifies the used slots, the request stays valid outside of the mutex
+			if (client.request == nullptr) {
+				continue;
+			}
+			esp_err_t result = keepAlive ? httpd_resp_send_chunk(client.request, ": keep-alive\n\n", 14) : EventsController::sendEvents(&client);
+			if (result != ESP_OK) {
+				EventsController::closeClient(&client);
+			}
+		}
+	}
+}
+
+esp_err_t EventsController::sendEvents(serverSentEventsClient_t *client) {
+	while (true) {
+		xSemaphoreTake(EventsController::mutex, portMAX_DELAY);
+		uint32_t oldestEventId = EventsController::getOldestEventId();
+		// Events overwritten in the replay buffer are skipped, the skipped state and alert changes are replaced by the snapshot
+		if (client->lastEventId + 1 < oldestEventId) {
+			EventsController::snapshot = true;
+		}
+		uint32_t eventId = std::max(client->lastEventId + 1, oldestEventId);
+		if (eventId >= EventsController::nextEventId) {
+			xSemaphoreGive(EventsController::mutex);
+			return ESP_OK;
+		}
+		const serverSentEvent_t &event = EventsController::events[eventId % EventsController::REPLAY_SIZE];
+		int length = snprintf(EventsController::frame, sizeof(EventsController::frame), "id: %lu\nevent: %s\ndata: %s\n\n", static_cast<unsigned long>(event.id), event.type, event.data);
+		xSemaphoreGive(EventsController::mutex);
+		client->lastEventId = eventId;
+		esp_err_t result = httpd_resp_send_chunk(client->request, EventsController::frame, std::min<int>(length, sizeof(EventsController::frame) - 1));
+		if (result != ESP_OK) {
+			return result;
+		}
+	}
+}
+
+void EventsController::closeClient(serverSentEventsClient_t *client) {
+	ESP_LOGI(TAG, "Client disconnected after event %lu.", static_cast<unsigned long>(client->lastEventId));
+	httpd_req_t *request = client->request;
+	httpd_sess_trigger_close(request->handle, httpd_req_to_sockfd(request));
+	httpd_req_async_handler_complete(request);
+	xSemaphoreTake(EventsController::mutex, portMAX_DELAY);
+	client->request = nullptr;
+	EventsController::lastDisconnect = esp_timer_get_time();
+	xSemaphoreGive(EventsController::mutex);
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "restApi/groupsController.h"
+
+using namespace sbc_pdu::restApi;
+
+const restApiRoute_t GroupsController::routes[] = {
+	{
+		.uri = "/api/v1/groups",
+		.method = HTTP_GET,
+		.auth = REST_API_AUTH_ANY,
+		.handler = &GroupsController::get,
+		.request = nullptr,
+		.response = nullptr,
+		.json = true,
+	},
+	{
+		// Tags and stagger are nested, the body is parsed by the group manager
+		.uri = "/api/v1/groups",
+		.method = HTTP_PUT,
+		.auth = REST_API_AUTH_ANY,
+		.handler = &GroupsController::put,
+		.request = nullptr,
+		.response = nullptr,
+		.json = false,
+	},
+};
+
+void GroupsController::registerEndpoints(const httpd_handle_t &server) {
+	Router::registerRoutes(server, GroupsController::routes);
+}
+
+esp_err_t GroupsController::get(restApiCall_t &call) {
+	GroupManager::writeJson(*call.writer);
+	return ESP_OK;
+}
+
+esp_err_t GroupsController::put(restApiCall_t &call) {
+	cJSON *root = nullptr;
+	esp_err_t result = RestApiUtils::parseJsonRequest(call.request, &root);
+	if (result != ESP_OK) {
+		return result;
+	}
+	if (GroupManager::configure(root) == ESP_ERR_INVALID_ARG) {
+		call.error = "Property \"tags\" has to be an array of up to 8 alphanumeric tags and property \"stagger\" an object with mode (none, random, slotted), interval (0-10000 ms) and slot (0-255).";
+		cJSON_Delete(root);
+		return ESP_ERR_INVALID_ARG;
+	}
+	httpd_resp_sendstr(call.request, nullptr);
+	cJSON_Delete(root);
+	return ESP_OK;
+}
@@ -17,80 +17,52 @@
 
 using namespace sbc_pdu::restApi;
 
-HostnameController::HostnameController(HostnameManager *manager) {
-	this->getHandler = {
+HostnameManager *HostnameController::manager = nullptr;
+
+const restApiField_t HostnameController::fields[] = {
+	REST_API_FIELD(hostnameMessage_t, hostname, JSON_FIELD_STRING, true),
+};
+
+const restApiSchema_t HostnameController::schema = REST_API_SCHEMA(hostnameMessage_t, HostnameController::fields);
+
+const restApiRoute_t HostnameController::routes[] = {
+	{
 		.uri = "/api/v1/hostname",
 		.method = HTTP_GET,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &HostnameController::get,
-		.user_ctx = manager,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
-	this->putHandler = {
+		.request = nullptr,
+		.response = &HostnameController::schema,
+		.json = false,
+	},
+	{
 		.uri = "/api/v1/hostname",
 		.method = HTTP_PUT,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &HostnameController::put,
-		.user_ctx = manager,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
+		.request = &HostnameController::schema,
+		.response = nullptr,
+		.json = false,
+	},
+};
+
+HostnameController::HostnameController(HostnameManager *hostnameManager) {
+	HostnameController::manager = hostnameManager;
 }
 
 void HostnameController::registerEndpoints(const httpd_handle_t &server) {
-	httpd_register_uri_handler(server, &this->getHandler);
-	httpd_register_uri_handler(server, &this->putHandler);
+	Router::registerRoutes(server, HostnameController::routes);
 }
 
-esp_err_t HostnameController::get(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
-	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
-	}
-	HostnameManager *manager = reinterpret_cast<HostnameManager*>(request->user_ctx);
-	httpd_resp_set_type(request, "application/json");
-	cJSON *root = cJSON_CreateObject();
-	std::string hostname = manager->get();
-	cJSON_AddStringToObject(root, "hostname", hostname.c_str());
-	const char *response = cJSON_PrintUnformatted(root);
-	httpd_resp_sendstr(request, response);
-	delete response;
-	cJSON_Delete(root);
+esp_err_t HostnameController::get(restApiCall_t &call) {
+	hostnameMessage_t *response = static_cast<hostnameMessage_t *>(call.response);
+	snprintf(response->hostname, sizeof(response->hostname), "%s", HostnameController::manager->get().c_str());
 	return ESP_OK;
 }
 
-esp_err_t HostnameController::put(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
-	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
-	}
-	cJSON *root = nullptr;
-	esp_err_t result = RestApiUtils::parseJsonRequest(request, &root);
-	if (result != ESP_OK) {
-		return result;
-	}
-	bool valid = true;
-	cJSON *hostname = cJSON_GetObjectItem(root, "hostname");
-	if (hostname == nullptr) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Missing \"hostname\" property.");
-	}
-	if (!cJSON_IsString(hostname)) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"hostname\" is not a string.");
-	}
-	if (valid) {
-		HostnameManager *manager = reinterpret_cast<HostnameManager*>(request->user_ctx);
-		manager->set(std::string(hostname->valuestring));
-	}
-	httpd_resp_sendstr(request, nullptr);
-	cJSON_Delete(root);
+esp_err_t HostnameController::put(restApiCall_t &call) {
+	const hostnameMessage_t *body = static_cast<const hostnameMessage_t *>(call.body);
+	HostnameController::manager->set(std::string(body->hostname));
+	httpd_resp_sendstr(call.request, nullptr);
 	return ESP_OK;
 }
@@ -0,0 +1,79 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "restApi/logController.h"
+
+using namespace sbc_pdu::restApi;
+
+const restApiRoute_t LogController::routes[] = {
+	{
+		.uri = "/api/v1/log",
+		.method = HTTP_GET,
+		.auth = REST_API_AUTH_ANY,
+		.handler = &LogController::get,
+		.request = nullptr,
+		.response = nullptr,
+		.json = true,
+	},
+	{
+		// Levels are keyed by logger tags, the body is parsed by the handler
+		.uri = "/api/v1/log",
+		.method = HTTP_PUT,
+		.auth = REST_API_AUTH_ANY,
+		.handler = &LogController::put,
+		.request = nullptr,
+		.response = nullptr,
+		.json = false,
+	},
+};
+
+void LogController::registerEndpoints(const httpd_handle_t &server) {
+	Router::registerRoutes(server, LogController::routes);
+}
+
+esp_err_t LogController::get(restApiCall_t &call) {
+	JsonWriter &writer = *call.writer;
+	writer.beginObject();
+	writer.beginObject("levels");
+	for (const auto &[tag, level] : LogManager::getLevels()) {
+		writer.writeString(tag, LogManager::getLevelName(level));
+	}
+	writer.endObject();
+	writer.writeString("maximum", LogManager::getLevelName(LogManager::MAXIMUM_LEVEL));
+	writer.endObject();
+	return ESP_OK;
+}
+
+esp_err_t LogController::put(restApiCall_t &call) {
+	cJSON *root = nullptr;
+	esp_err_t result = RestApiUtils::parseJsonRequest(call.request, &root);
+	if (result != ESP_OK) {
+		return result;
+	}
+	cJSON *levels = cJSON_GetObjectItem(root, "levels");
+	if (!cJSON_IsObject(levels)) {
+		call.error = "Property \"levels\" is not an object.";
+		cJSON_Delete(root);
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (LogManager::setLevels(levels) == ESP_ERR_INVALID_ARG) {
+		call.error = "Property \"levels\" has to map logger tags to one of levels: none, error, warn, info, debug, verbose. Levels above \"maximum\" are not compiled into the firmware.";
+		cJSON_Delete(root);
+		return ESP_ERR_INVALID_ARG;
+	}
+	httpd_resp_sendstr(call.request, nullptr);
+	cJSON_Delete(root);
+	return ESP_OK;
+}
@@ -17,114 +17,158 @@
 
 using namespace sbc_pdu::restApi;
 
-MqttController::MqttController() {
-	this->getHandler = {
+const restApiField_t MqttController::configFields[] = {
+	REST_API_FIELD(mqttConfigMessage_t, uri, JSON_FIELD_STRING, true),
+	REST_API_FIELD(mqttConfigMessage_t, username, JSON_FIELD_STRING, true),
+	REST_API_FIELD(mqttConfigMessage_t, password, JSON_FIELD_STRING, true),
+	REST_API_FIELD(mqttConfigMessage_t, protocol, JSON_FIELD_INTEGER, false),
+	REST_API_FIELD(mqttConfigMessage_t, haDiscovery, JSON_FIELD_INTEGER, false),
+};
+
+const restApiSchema_t MqttController::configSchema = REST_API_SCHEMA(mqttConfigMessage_t, MqttController::configFields);
+
+const restApiField_t MqttController::benchmarkFields[] = {
+	REST_API_FIELD(mqttBenchmarkRequest_t, outputs, JSON_FIELD_INTEGER, true),
+	REST_API_FIELD(mqttBenchmarkRequest_t, duration, JSON_FIELD_INTEGER, true),
+};
+
+const restApiSchema_t MqttController::benchmarkSchema = REST_API_SCHEMA(mqttBenchmarkRequest_t, MqttController::benchmarkFields);
+
+const restApiRoute_t MqttController::routes[] = {
+	{
 		.uri = "/api/v1/mqtt",
 		.method = HTTP_GET,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &MqttController::get,
-		.user_ctx = nullptr,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
-	this->putHandler = {
+		.request = nullptr,
+		.response = &MqttController::configSchema,
+		.json = false,
+	},
+	{
 		.uri = "/api/v1/mqtt",
 		.method = HTTP_PUT,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &MqttController::put,
-		.user_ctx = nullptr,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
-}
+		.request = &MqttController::configSchema,
+		.response = nullptr,
+		.json = false,
+	},
+	{
+		.uri = "/api/v1/mqtt/diagnostics",
+		.method = HTTP_GET,
+		.auth = REST_API_AUTH_ANY,
+		.handler = &MqttController::getDiagnostics,
+		.request = nullptr,
+		.response = nullptr,
+		.json = true,
+	},
+	{
+		.uri = "/api/v1/mqtt/benchmark",
+		.method = HTTP_GET,
+		.auth = REST_API_AUTH_ANY,
+		.handler = &MqttController::getBenchmark,
+		.request = nullptr,
+		.response = nullptr,
+		.json = true,
+	},
+	{
+		.uri = "/api/v1/mqtt/benchmark",
+		.method = HTTP_POST,
+		.auth = REST_API_AUTH_ANY,
+		.handler = &MqttController::startBenchmark,
+		.request = &MqttController::benchmarkSchema,
+		.response = nullptr,
+		.json = true,
+	},
+};
 
 void MqttController::registerEndpoints(const httpd_handle_t &server) {
-	httpd_register_uri_handler(server, &this->getHandler);
-	httpd_register_uri_handler(server, &this->putHandler);
+	Router::registerRoutes(server, MqttController::routes);
 }
 
-esp_err_t MqttController::get(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
-	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
-	}
+esp_err_t MqttController::get(restApiCall_t &call) {
+	mqttConfigMessage_t *response = static_cast<mqttConfigMessage_t *>(call.response);
 	NvsManager nvs = NvsManager("mqtt");
-	httpd_resp_set_type(request, "application/json");
-	cJSON *root = cJSON_CreateObject();
-	std::string uri;
-	if (nvs.getString("uri", uri) != ESP_OK) {
-		uri = "";
+	std::string value;
+	if (nvs.getString("uri", value) == ESP_OK) {
+		snprintf(response->uri, sizeof(response->uri), "%s", value.c_str());
 	}
-	cJSON_AddStringToObject(root, "uri", uri.c_str());
-	std::string username;
-	if (nvs.getString("username", username) != ESP_OK) {
-		username = "";
+	if (nvs.getString("username", value) == ESP_OK) {
+		snprintf(response->username, sizeof(response->username), "%s", value.c_str());
 	}
-	cJSON_AddStringToObject(root, "username", username.c_str());
-	std::string password;
-	if (nvs.getString("password", password) != ESP_OK) {
-		password = "";
+	if (nvs.getString("password", value) == ESP_OK) {
+		snprintf(response->password, sizeof(response->password), "%s", value.c_str());
 	}
-	cJSON_AddStringToObject(root, "password", password.c_str());
-	const char *response = cJSON_PrintUnformatted(root);
-	httpd_resp_sendstr(request, response);
-	delete response;
-	cJSON_Delete(root);
+	uint8_t protocol = 4;
+	nvs.get("protocol", protocol);
+	response->protocol = protocol;
+	response->haDiscovery = HomeAssistant::getMode();
 	return ESP_OK;
 }
 
-esp_err_t MqttController::put(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
-	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
+esp_err_t MqttController::put(restApiCall_t &call) {
+	const mqttConfigMessage_t *body = static_cast<const mqttConfigMessage_t *>(call.body);
+	bool hasProtocol = call.present & (1UL << MqttController::PROTOCOL_FIELD);
+	if (hasProtocol && body->protocol != 4 && body->protocol != 5) {
+		call.error = "Property \"protocol\" has to be 4 (MQTT 3.1.1) or 5 (MQTT 5).";
+		return ESP_ERR_INVALID_ARG;
 	}
-	cJSON *root = nullptr;
-	esp_err_t result = RestApiUtils::parseJsonRequest(request, &root);
-	if (result != ESP_OK) {
-		return result;
+	bool hasHaDiscovery = call.present & (1UL << MqttController::HA_DISCOVERY_FIELD);
+	if (hasHaDiscovery && body->haDiscovery != HA_DISCOVERY_ENTITY && body->haDiscovery != HA_DISCOVERY_DEVICE) {
+		call.error = "Property \"haDiscovery\" has to be 0 (entity) or 1 (device).";
+		return ESP_ERR_INVALID_ARG;
 	}
-	bool valid = true;
 	NvsManager nvs = NvsManager("mqtt");
-	cJSON *uri = cJSON_GetObjectItem(root, "uri");
-	if (uri == nullptr) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Missing \"uri\" property.");
+	if (hasProtocol) {
+		nvs.set("protocol", static_cast<uint8_t>(body->protocol));
 	}
-	if (!cJSON_IsString(uri)) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"uri\" is not a string.");
+	nvs.setString("uri", std::string(body->uri));
+	nvs.setString("username", std::string(body->username));
+	nvs.setString("password", std::string(body->password));
+	nvs.commit();
+	// Discovery messages are switched immediately, the connection settings are applied after restart
+	if (hasHaDiscovery) {
+		HomeAssistant::setMode(static_cast<ha_discovery_mode_t>(body->haDiscovery));
 	}
-	cJSON *username = cJSON_GetObjectItem(root, "username");
-	if (username == nullptr) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Missing \"username\" property.");
-	}
-	if (!cJSON_IsString(username)) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"username\" is not a string.");
+	httpd_resp_sendstr(call.request, nullptr);
+	return ESP_OK;
+}
+
+esp_err_t MqttController::getDiagnostics(restApiCall_t &call) {
+	cJSON *root = SbcPduManagement::createDiagnostics();
+	// Diagnostics are collected from several modules into the tree, only the printed copy is avoided
+	call.writer->writeJson(root);
+	cJSON_Delete(root);
+	return ESP_OK;
+}
+
+esp_err_t MqttController::getBenchmark(restApiCall_t &call) {
+	JsonWriter &writer = *call.writer;
+	writer.beginObject();
+	MqttBenchmark::writeProperties(writer);
+	writer.writeKey("http");
+	HttpServer::writeStatistics(writer);
+	writer.endObject();
+	return ESP_OK;
+}
+
+esp_err_t MqttController::startBenchmark(restApiCall_t &call) {
+	const mqttBenchmarkRequest_t *body = static_cast<const mqttBenchmarkRequest_t *>(call.body);
+	esp_err_t result = ESP_ERR_INVALID_ARG;
+	if (body->outputs >= 0 && body->duration >= 0) {
+		result = MqttBenchmark::start(body->outputs, body->duration);
 	}
-	cJSON *password = cJSON_GetObjectItem(root, "password");
-	if (password == nullptr) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Missing \"password\" property.");
+	if (result == ESP_ERR_INVALID_ARG) {
+		call.error = "Property \"outputs\" has to be in range 3-64 and property \"duration\" in range 1-300 s.";
+		return result;
 	}
-	if (!cJSON_IsString(password)) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"password\" is not a string.");
+	if (result == ESP_ERR_INVALID_STATE) {
+		call.error = "Benchmark is already running.";
+		return result;
 	}
-	if (valid) {
-		nvs.setString("uri", std::string(uri->valuestring));
-		nvs.setString("username", std::string(username->valuestring));
-		nvs.setString("password", std::string(password->valuestring));
-		nvs.commit();
+	if (result != ESP_OK) {
+		return result;
 	}
-	httpd_resp_sendstr(request, nullptr);
-	cJSON_Delete(root);
+	MqttBenchmark::writeJson(*call.writer);
 	return ESP_OK;
 }
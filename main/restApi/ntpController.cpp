@@ -17,144 +17,132 @@
 
 using namespace sbc_pdu::restApi;
 
-NtpController::NtpController() {
-	this->getHandler = {
+const restApiRoute_t NtpController::routes[] = {
+	{
 		.uri = "/api/v1/ntp",
 		.method = HTTP_GET,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &NtpController::get,
-		.user_ctx = nullptr,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
-	this->putHandler = {
+		.request = nullptr,
+		.response = nullptr,
+		.json = true,
+	},
+	{
+		// Server list is an array, the body is parsed by the handler
 		.uri = "/api/v1/ntp",
 		.method = HTTP_PUT,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &NtpController::put,
-		.user_ctx = nullptr,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
-}
+		.request = nullptr,
+		.response = nullptr,
+		.json = false,
+	},
+};
 
 void NtpController::registerEndpoints(const httpd_handle_t &server) {
-	httpd_register_uri_handler(server, &this->getHandler);
-	httpd_register_uri_handler(server, &this->putHandler);
+	Router::registerRoutes(server, NtpController::routes);
 }
 
-esp_err_t NtpController::get(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
-	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
-	}
+esp_err_t NtpController::get(restApiCall_t &call) {
+	JsonWriter &writer = *call.writer;
 	NvsManager nvs = NvsManager("ntp");
-	httpd_resp_set_type(request, "application/json");
-	cJSON *root = cJSON_CreateObject();
-	std::vector<std::string> serversVector;
-	uint8_t serverCount = 2;
+	writer.beginObject();
+	uint8_t serverCount = NtpController::MAX_SERVERS;
 	nvs.get("servers", serverCount);
-	cJSON *servers = cJSON_AddArrayToObject(root, "servers");
+	writer.beginArray("servers");
+	std::string server;
+	std::string key = "server0";
 	for (uint8_t i = 0; i < serverCount; ++i) {
-		std::string server;
-		std::string key = "server";
-		key.push_back('0' + i);
+		key.back() = '0' + i;
 		if(nvs.getString(key, server) != ESP_OK) {
 			continue;
 		}
-		serversVector.push_back(server);
-		cJSON_AddItemToArray(servers, cJSON_CreateString(serversVector[i].c_str()));
+		writer.writeString(server);
 	}
+	writer.endArray();
 	std::string timezone;
 	if (nvs.getString("timezone", timezone) != ESP_OK) {
 		timezone = "";
 	}
-	cJSON_AddStringToObject(root, "timezone", timezone.c_str());
-	const char *response = cJSON_PrintUnformatted(root);
-	httpd_resp_sendstr(request, response);
-	delete response;
-	cJSON_Delete(root);
+	writer.writeString("timezone", timezone);
+	writer.endObject();
 	return ESP_OK;
 }
 
-esp_err_t NtpController::put(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
-	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
-	}
+esp_err_t NtpController::put(restApiCall_t &call) {
 	cJSON *root = nullptr;
-	esp_err_t result = RestApiUtils::parseJsonRequest(request, &root);
+	esp_err_t result = RestApiUtils::parseJsonRequest(call.request, &root);
 	if (result != ESP_OK) {
 		return result;
 	}
-	bool valid = true;
+	result = NtpController::validate(call, root);
+	if (result != ESP_OK) {
+		cJSON_Delete(root);
+		return result;
+	}
 	NvsManager nvs = NvsManager("ntp");
 	cJSON *servers = cJSON_GetObjectItem(root, "servers");
+	int serversSize = cJSON_GetArraySize(servers);
+	uint8_t currentServers = NtpController::MAX_SERVERS;
+	nvs.get("servers", currentServers);
+	// Remove old servers
+	for (uint8_t i = serversSize; i < currentServers; ++i) {
+		std::string key = "server";
+		key.push_back('0' + i);
+		nvs.remove(key);
+	}
+	// Set new servers
+	for (int i = 0; i < serversSize; ++i) {
+		cJSON *server = cJSON_GetArrayItem(servers, i);
+		std::string key = "server";
+		key.push_back('0' + i);
+		nvs.setString(key, std::string(server->valuestring));
+	}
+	nvs.setString("timezone", std::string(cJSON_GetObjectItem(root, "timezone")->valuestring));
+	nvs.commit();
+	cJSON_Delete(root);
+	httpd_resp_sendstr(call.request, nullptr);
+	return ESP_OK;
+}
+
+esp_err_t NtpController::validate(restApiCall_t &call, const cJSON *root) {
+	const cJSON *servers = cJSON_GetObjectItem(root, "servers");
 	if (servers == nullptr) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Missing \"servers\" property.");
+		call.error = "Missing \"servers\" property.";
+		return ESP_ERR_INVALID_ARG;
 	}
 	if (!cJSON_IsArray(servers)) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"servers\" is not an array.");
+		call.error = "Property \"servers\" is not an array.";
+		return ESP_ERR_INVALID_ARG;
 	}
 	int serversSize = cJSON_GetArraySize(servers);
 	if (serversSize == 0) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"servers\" is an empty array.");
+		call.error = "Property \"servers\" is an empty array.";
+		return ESP_ERR_INVALID_ARG;
 	}
-	if (serversSize > 2) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Array \"servers\" is longer than 2 entries.");
+	if (serversSize > NtpController::MAX_SERVERS) {
+		call.error = "Array \"servers\" is longer than 2 entries.";
+		return ESP_ERR_INVALID_ARG;
 	}
-	uint8_t currentServers = 2;
-	nvs.get("servers", currentServers);
-	// Validate new servers
-	for (int i = 0; i < serversSize; ++i) {
-		cJSON *server = cJSON_GetArrayItem(servers, i);
+	const cJSON *server = nullptr;
+	cJSON_ArrayForEach(server, servers) {
 		if (!cJSON_IsString(server)) {
-			valid = false;
-			RestApiUtils::createBadRequestResponse(request, "Property \"servers\" is not array of strings.");
+			call.error = "Property \"servers\" is not array of strings.";
+			return ESP_ERR_INVALID_ARG;
 		}
 	}
-	cJSON *timezone = cJSON_GetObjectItem(root, "timezone");
+	const cJSON *timezone = cJSON_GetObjectItem(root, "timezone");
 	if (timezone == nullptr) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Missing \"timezone\" property.");
+		call.error = "Missing \"timezone\" property.";
+		return ESP_ERR_INVALID_ARG;
 	}
 	if (!cJSON_IsString(timezone)) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"timezone\" is not a string.");
+		call.error = "Property \"timezone\" is not a string.";
+		return ESP_ERR_INVALID_ARG;
 	}
 	if (Ntp::timezones.find(std::string(timezone->valuestring)) == Ntp::timezones.end()) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"timezone\" is not a valid timezone.");
+		call.error = "Property \"timezone\" is not a valid timezone.";
+		return ESP_ERR_INVALID_ARG;
 	}
-	if (valid) {
-		// Remove old servers
-		for (uint8_t i = serversSize; i < currentServers; ++i) {
-			std::string server;
-			std::string key = "server";
-			key.push_back('0' + i);
-			nvs.remove(key);
-		}
-		// Set new servers
-		for (int i = 0; i < serversSize; ++i) {
-			cJSON *server = cJSON_GetArrayItem(servers, i);
-			std::string key = "server";
-			key.push_back('0' + i);
-			nvs.setString(key, std::string(server->valuestring));
-		}
-		nvs.setString("timezone", std::string(timezone->valuestring));
-		nvs.commit();
-	}
-	httpd_resp_sendstr(request, nullptr);
-	cJSON_Delete(root);
 	return ESP_OK;
 }
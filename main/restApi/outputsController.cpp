@@ -19,105 +19,222 @@ using namespace sbc_pdu::restApi;
 
 std::map<uint8_t, Output*> *OutputsController::outputs = nullptr;
 
-OutputsController::OutputsController(std::map<uint8_t, Output*> *outputs) {
-	OutputsController::outputs = outputs;
-	this->getHandler = {
+const restApiField_t OutputsController::switchFields[] = {
+	REST_API_FIELD(outputSwitchRequest_t, output, JSON_FIELD_INTEGER, true),
+	REST_API_FIELD(outputSwitchRequest_t, state, JSON_FIELD_BOOL, true),
+};
+
+const restApiSchema_t OutputsController::switchSchema = REST_API_SCHEMA(outputSwitchRequest_t, OutputsController::switchFields);
+
+const restApiRoute_t OutputsController::routes[] = {
+	{
 		.uri = "/api/v1/outputs",
 		.method = HTTP_GET,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &OutputsController::get,
-		.user_ctx = nullptr,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
-	this->switchOutputHandler = {
+		.request = nullptr,
+		.response = nullptr,
+		.json = true,
+	},
+	{
 		.uri = "/api/v1/outputs/switch",
 		.method = HTTP_POST,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &OutputsController::switchOutput,
-		.user_ctx = nullptr,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
+		.request = &OutputsController::switchSchema,
+		.response = nullptr,
+		.json = false,
+	},
+	{
+		// Output ID is a path segment, the URI is parsed by the handler
+		.uri = "/api/v1/outputs/*",
+		.method = HTTP_GET,
+		.auth = REST_API_AUTH_ANY,
+		.handler = &OutputsController::getHistory,
+		.request = nullptr,
+		.response = nullptr,
+		.json = false,
+	},
+};
+
+OutputsController::OutputsController(std::map<uint8_t, Output*> *outputs) {
+	OutputsController::outputs = outputs;
 }
 
 void OutputsController::registerEndpoints(const httpd_handle_t &server) {
-	httpd_register_uri_handler(server, &this->getHandler);
-	httpd_register_uri_handler(server, &this->switchOutputHandler);
+	Router::registerRoutes(server, OutputsController::routes);
 }
 
-esp_err_t OutputsController::get(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
-	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
-	}
-	httpd_resp_set_type(request, "application/json");
-	cJSON *root = cJSON_CreateArray();
+esp_err_t OutputsController::get(restApiCall_t &call) {
+	JsonWriter &writer = *call.writer;
+	writer.beginArray();
 	for (const auto& outputPair : *OutputsController::outputs) {
-		cJSON *outputObject = cJSON_CreateObject();
 		Output *output = outputPair.second;
 		if (output == nullptr) {
 			ESP_LOGE("HTTP Outputs", "Output with ID %d is null.", outputPair.first);
 			continue;
 		}
-		cJSON_AddNumberToObject(outputObject, "index", output->getIndex());
-		cJSON_AddBoolToObject(outputObject, "alert", output->hasAlert());
-		cJSON_AddBoolToObject(outputObject, "enabled", output->isEnabled());
-		cJSON_AddNumberToObject(outputObject, "current", fabs(output->readCurrent()));
-		cJSON_AddNumberToObject(outputObject, "voltage", output->readVoltage());
-		cJSON_AddItemToArray(root, outputObject);
-	}
-	const char *response = cJSON_PrintUnformatted(root);
-	httpd_resp_sendstr(request, response);
-	delete response;
-	cJSON_Delete(root);
+		writer.beginObject()
+			.writeInteger("index", output->getIndex())
+			.writeBool("alert", output->hasAlert())
+			.writeBool("enabled", output->isEnabled())
+			.writeNumber("current", fabs(output->readCurrent()))
+			.writeNumber("voltage", output->readVoltage())
+			.endObject();
+	}
+	writer.endArray();
 	return ESP_OK;
 }
 
-esp_err_t OutputsController::switchOutput(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
-	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
-	}
-	cJSON *root = nullptr;
-	esp_err_t result = RestApiUtils::parseJsonRequest(request, &root);
-	if (result != ESP_OK) {
-		return result;
+esp_err_t OutputsController::switchOutput(restApiCall_t &call) {
+	const outputSwitchRequest_t *body = static_cast<const outputSwitchRequest_t *>(call.body);
+	auto output = OutputsController::outputs->end();
+	if (body->output >= 0 && body->output <= UINT8_MAX) {
+		output = OutputsController::outputs->find(body->output);
 	}
-	bool valid = true;
-	cJSON *outputId = cJSON_GetObjectItem(root, "output");
-	if (outputId == nullptr) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Missing \"output\" property.");
+	if (output == OutputsController::outputs->end()) {
+		call.error = "Output with given ID does not exist.";
+		return ESP_ERR_INVALID_ARG;
 	}
-	if (!cJSON_IsNumber(outputId)) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"output\" is not a number.");
+	if (!output->second->enable(body->state)) {
+		call.error = "Power-on of the output exceeds the power budget.";
+		return ESP_ERR_INVALID_ARG;
 	}
-	auto output = OutputsController::outputs->find(outputId->valueint);
-	if (output == OutputsController::outputs->end()) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Output with given ID does not exist.");
+	httpd_resp_sendstr(call.request, nullptr);
+	return ESP_OK;
+}
+
+esp_err_t OutputsController::getHistory(restApiCall_t &call) {
+	const char *path = call.request->uri + strlen(OutputsController::OUTPUT_PREFIX);
+	char *end = nullptr;
+	unsigned long id = strtoul(path, &end, 10);
+	if (end == path || !isdigit(static_cast<unsigned char>(*path)) || strncmp(end, "/history", 8) != 0 || (end[8] != '\0' && end[8] != '?')) {
+		call.error = "Endpoint does not exist.";
+		return ESP_ERR_NOT_FOUND;
 	}
-	cJSON *state = cJSON_GetObjectItem(root, "state");
-	if (state == nullptr) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Missing \"state\" property.");
+	if (id > UINT8_MAX || OutputsController::outputs->find(id) == OutputsController::outputs->end()) {
+		call.error = "Output with given ID does not exist.";
+		return ESP_ERR_NOT_FOUND;
 	}
-	if (!cJSON_IsBool(state)) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"state\" is not a boolean.");
+	uint32_t now = static_cast<uint32_t>(time(nullptr));
+	if (now < MeasurementHistory::MIN_TIMESTAMP) {
+		call.error = "Time is not synchronized yet.";
+		return ESP_ERR_INVALID_STATE;
 	}
-	if (valid) {
-		output->second->enable(state->valueint);
+	uint32_t to = now;
+	uint32_t from = now - 3600;
+	uint32_t step = 60;
+	char format[8] = "json";
+	size_t queryLength = httpd_req_get_url_query_len(call.request);
+	if (queryLength > 0) {
+		char query[OutputsController::MAX_QUERY_LENGTH];
+		if (queryLength >= sizeof(query)) {
+			call.error = "Query string is too long.";
+			return ESP_ERR_INVALID_ARG;
+		}
+		httpd_req_get_url_query_str(call.request, query, sizeof(query));
+		if (!OutputsController::readQueryParameter(query, "from", from) || !OutputsController::readQueryParameter(query, "to", to) ||
+			!OutputsController::readQueryParameter(query, "step", step)) {
+			call.error = "Parameters \"from\", \"to\" and \"step\" have to be unsigned integers.";
+			return ESP_ERR_INVALID_ARG;
+		}
+		esp_err_t result = httpd_query_key_value(query, "format", format, sizeof(format));
+		if (result == ESP_ERR_NOT_FOUND) {
+			strcpy(format, "json");
+		} else if (result != ESP_OK) {
+			format[0] = '\0';
+		}
 	}
-	httpd_resp_sendstr(request, nullptr);
-	cJSON_Delete(root);
-	return ESP_OK;
+	if (from > to || step == 0) {
+		call.error = "Parameter \"from\" has to be lower than or equal to \"to\" and parameter \"step\" has to be positive.";
+		return ESP_ERR_INVALID_ARG;
+	}
+	bool csv = strcmp(format, "csv") == 0;
+	if (!csv && strcmp(format, "json") != 0) {
+		call.error = "Parameter \"format\" has to be json or csv.";
+		return ESP_ERR_INVALID_ARG;
+	}
+	history_tier_t tier = MeasurementHistory::selectTier(id, from, step);
+	// Step is rounded up to a multiple of the tier resolution
+	uint32_t resolution = MeasurementHistory::getResolution(tier);
+	step = (step + resolution - 1) / resolution * resolution;
+	if ((to - from) / step >= OutputsController::MAX_HISTORY_POINTS) {
+		call.error = "Requested range has more than 4096 points, increase the step.";
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (csv) {
+		return OutputsController::writeHistoryCsv(call.request, tier, id, from, to, step);
+	}
+	return OutputsController::writeHistoryJson(call.request, tier, id, from, to, step);
+}
+
+bool OutputsController::readQueryParameter(const char *query, const char *key, uint32_t &value) {
+	char buffer[12];
+	esp_err_t result = httpd_query_key_value(query, key, buffer, sizeof(buffer));
+	if (result == ESP_ERR_NOT_FOUND) {
+		return true;
+	}
+	if (result != ESP_OK || !isdigit(static_cast<unsigned char>(buffer[0]))) {
+		return false;
+	}
+	char *end = nullptr;
+	unsigned long long parsed = strtoull(buffer, &end, 10);
+	if (*end != '\0' || parsed > UINT32_MAX) {
+		return false;
+	}
+	value = parsed;
+	return true;
+}
+
+esp_err_t OutputsController::writeHistoryJson(httpd_req_t *request, history_tier_t tier, uint8_t output, uint32_t from, uint32_t to, uint32_t step) {
+	httpd_resp_set_type(request, "application/json");
+	JsonWriter writer(request);
+	writer.beginObject()
+		.writeInteger("output", output)
+		.writeInteger("from", from)
+		.writeInteger("to", to)
+		.writeInteger("step", step)
+		.beginArray("points");
+	esp_err_t result = MeasurementHistory::query(tier, output, from, to, step, [&writer](const historyPoint_t &point) {
+		writer.beginObject()
+			.writeInteger("timestamp", point.timestamp)
+			.writeNumber("current", point.current / 1000.0)
+			.writeNumber("currentMax", point.currentMax / 1000.0)
+			.writeNumber("voltage", point.voltage / 1000.0)
+			.endObject();
+		return !writer.hasFailed();
+	});
+	if (result != ESP_OK) {
+		return result;
+	}
+	writer.endArray().endObject();
+	// Session of the disconnected client is closed
+	return writer.finish() == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t OutputsController::writeHistoryCsv(httpd_req_t *request, history_tier_t tier, uint8_t output, uint32_t from, uint32_t to, uint32_t step) {
+	httpd_resp_set_type(request, "text/csv");
+	char buffer[256] = "timestamp,current,currentMax,voltage\n";
+	size_t length = strlen(buffer);
+	esp_err_t sendResult = ESP_OK;
+	esp_err_t result = MeasurementHistory::query(tier, output, from, to, step, [&](const historyPoint_t &point) {
+		// Longest line has 10 + 3 * 15 characters
+		if (length + 56 > sizeof(buffer)) {
+			sendResult = httpd_resp_send_chunk(request, buffer, length);
+			length = 0;
+		}
+		length += snprintf(buffer + length, sizeof(buffer) - length, "%lu,%.3f,%.3f,%.3f\n", static_cast<unsigned long>(point.timestamp),
+			point.current / 1000.0, point.currentMax / 1000.0, point.voltage / 1000.0);
+		return sendResult == ESP_OK;
+	});
+	if (result != ESP_OK) {
+		return result;
+	}
+	if (sendResult == ESP_OK) {
+		sendResult = httpd_resp_send_chunk(request, buffer, length);
+	}
+	if (sendResult == ESP_OK) {
+		sendResult = httpd_resp_send_chunk(request, nullptr, 0);
+	}
+	return sendResult == ESP_OK ? ESP_OK : ESP_FAIL;
 }
@@ -0,0 +1,161 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "restApi/router.h"
+
+using namespace sbc_pdu::restApi;
+
+alignas(8) uint8_t Router::body[Router::MAX_STRUCTURE_SIZE];
+alignas(8) uint8_t Router::response[Router::MAX_STRUCTURE_SIZE];
+
+void Router::registerRoute(const httpd_handle_t &server, const restApiRoute_t &route) {
+	for (const restApiSchema_t *schema : {route.request, route.response}) {
+		if (schema != nullptr && (schema->count > Router::MAX_FIELDS || schema->size > Router::MAX_STRUCTURE_SIZE)) {
+			ESP_LOGE(TAG, "Schema of the route %s is too large.", route.uri);
+			return;
+		}
+	}
+	httpd_uri_t handler = {
+		.uri = route.uri,
+		.method = route.method,
+		.handler = &Router::dispatch,
+		.user_ctx = const_cast<restApiRoute_t *>(&route),
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = nullptr,
+#endif
+	};
+	httpd_register_uri_handler(server, &handler);
+}
+
+esp_err_t Router::dispatch(httpd_req_t *request) {
+	const restApiRoute_t *route = static_cast<const restApiRoute_t *>(request->user_ctx);
+	Cors::addHeaders(request);
+	if (route->auth != REST_API_AUTH_NONE) {
+		BasicAuthenticator authenticator = BasicAuthenticator();
+		if (!authenticator.authenticate(request, route->auth == REST_API_AUTH_ANY)) {
+			return ESP_OK;
+		}
+	}
+	restApiCall_t call = {
+		.request = request,
+		.body = nullptr,
+		.present = 0,
+		.response = nullptr,
+		.writer = nullptr,
+		.error = nullptr,
+	};
+	if (route->request != nullptr) {
+		esp_err_t result = Router::parseBody(call, *route->request);
+		if (result != ESP_OK) {
+			return result;
+		}
+	}
+	JsonWriter writer(request);
+	if (route->response != nullptr) {
+		memset(Router::response, 0, route->response->size);
+		call.response = Router::response;
+	}
+	if (route->response != nullptr || route->json) {
+		// Large responses are sent in chunks while the handler writes them
+		httpd_resp_set_type(request, "application/json");
+		call.writer = &writer;
+	}
+	esp_err_t result = route->handler(call);
+	switch (result) {
+		case ESP_OK:
+			break;
+		case ESP_FAIL:
+			return ESP_FAIL;
+		case ESP_ERR_INVALID_ARG:
+			RestApiUtils::createBadRequestResponse(request, call.error != nullptr ? call.error : "Invalid request.");
+			return ESP_OK;
+		case ESP_ERR_NOT_FOUND:
+			Router::sendError(request, "404 Not Found", call.error);
+			return ESP_OK;
+		case ESP_ERR_INVALID_STATE:
+			Router::sendError(request, "409 Conflict", call.error);
+			return ESP_OK;
+		default:
+			ESP_LOGE(TAG, "Handler of the route %s failed: %s", route->uri, esp_err_to_name(result));
+			httpd_resp_send_500(request);
+			return ESP_OK;
+	}
+	if (call.writer == nullptr) {
+		return ESP_OK;
+	}
+	if (route->response != nullptr) {
+		Router::writeObject(writer, *route->response, call.response);
+	}
+	writer.finish();
+	return ESP_OK;
+}
+
+esp_err_t Router::parseBody(restApiCall_t &call, const restApiSchema_t &schema) {
+	memset(Router::body, 0, schema.size);
+	jsonField_t fields[Router::MAX_FIELDS];
+	for (size_t i = 0; i < schema.count; ++i) {
+		const restApiField_t &field = schema.fields[i];
+		fields[i] = {
+			.name = field.name,
+			.type = field.type,
+			.value = Router::body + field.offset,
+			.size = field.size,
+			.required = field.required,
+			.found = false,
+		};
+	}
+	esp_err_t result = RestApiUtils::parseJsonRequest(call.request, fields, schema.count);
+	if (result != ESP_OK) {
+		return result;
+	}
+	for (size_t i = 0; i < schema.count; ++i) {
+		if (fields[i].found) {
+			call.present |= 1UL << i;
+		}
+	}
+	call.body = Router::body;
+	return ESP_OK;
+}
+
+void Router::writeObject(JsonWriter &writer, const restApiSchema_t &schema, const void *data) {
+	writer.beginObject();
+	for (size_t i = 0; i < schema.count; ++i) {
+		const restApiField_t &field = schema.fields[i];
+		const uint8_t *value = static_cast<const uint8_t *>(data) + field.offset;
+		switch (field.type) {
+			case JSON_FIELD_BOOL:
+				writer.writeBool(field.name, *reinterpret_cast<const bool *>(value));
+				break;
+			case JSON_FIELD_INTEGER:
+				writer.writeInteger(field.name, *reinterpret_cast<const int32_t *>(value));
+				break;
+			case JSON_FIELD_NUMBER:
+				writer.writeNumber(field.name, *reinterpret_cast<const double *>(value));
+				break;
+			case JSON_FIELD_STRING:
+				writer.writeString(field.name, reinterpret_cast<const char *>(value));
+				break;
+		}
+	}
+	writer.endObject();
+}
+
+void Router::sendError(httpd_req_t *request, const char *status, const char *message) {
+	httpd_resp_set_status(request, status);
+	httpd_resp_set_type(request, "text/plain");
+	httpd_resp_sendstr(request, message != nullptr ? message : status);
+}
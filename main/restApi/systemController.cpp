@@ -17,100 +17,118 @@
 
 using namespace sbc_pdu::restApi;
 
-SystemController::SystemController() {
-	this->getInfoHandler = {
+const restApiRoute_t SystemController::routes[] = {
+	{
 		.uri = "/api/v1/system/info",
 		.method = HTTP_GET,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &SystemController::getInfo,
-		.user_ctx = nullptr,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
-	this->restartHandler = {
+		.request = nullptr,
+		.response = nullptr,
+		.json = true,
+	},
+	{
 		.uri = "/api/v1/system/restart",
 		.method = HTTP_POST,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &SystemController::restart,
-		.user_ctx = nullptr,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
-}
+		.request = nullptr,
+		.response = nullptr,
+		.json = false,
+	},
+};
 
 void SystemController::registerEndpoints(const httpd_handle_t &server) {
-	httpd_register_uri_handler(server, &this->getInfoHandler);
-	httpd_register_uri_handler(server, &this->restartHandler);
+	Router::registerRoutes(server, SystemController::routes);
 }
 
-void SystemController::setChipInfo(cJSON *root) {
+void SystemController::writeChipInfo(JsonWriter &writer) {
 	esp_chip_info_t chip_info;
 	esp_chip_info(&chip_info);
-	cJSON *chipInfo = cJSON_AddObjectToObject(root, "chip");
-	cJSON_AddNumberToObject(chipInfo, "cores", chip_info.cores);
-	std::map<esp_chip_model_t, std::string> modelMap = {
-		{CHIP_ESP32, "ESP32"},
-		{CHIP_ESP32S2, "ESP32-S2"},
-		{CHIP_ESP32S3, "ESP32-S3"},
-		{CHIP_ESP32C3, "ESP32-C3"},
-		{CHIP_ESP32C2, "ESP32-C2"},
-		{CHIP_ESP32C6, "ESP32-C6"},
-		{CHIP_ESP32H2, "ESP32-H2"},
-	};
-	auto foundModel = modelMap.find(chip_info.model);
-	std::string model = foundModel != modelMap.end() ? foundModel->second : "UNKNOWN";
-	cJSON_AddStringToObject(chipInfo, "model", model.c_str());
-	std::stringstream revision;
-	revision << chip_info.revision / 100 << "." << std::setw(2) << std::setfill('0') << chip_info.revision % 100;
-	cJSON_AddStringToObject(chipInfo, "revision", revision.str().c_str());
-	cJSON *features = cJSON_AddObjectToObject(chipInfo, "features");
-	cJSON *wifiFeature = cJSON_AddObjectToObject(features, "wifi");
-	cJSON_AddBoolToObject(wifiFeature, "bgn", chip_info.features & CHIP_FEATURE_WIFI_BGN);
-	cJSON *bluetoothFeature = cJSON_AddObjectToObject(features, "bluetooth");
-	cJSON_AddBoolToObject(bluetoothFeature, "classic", chip_info.features & CHIP_FEATURE_BT);
-	cJSON_AddBoolToObject(bluetoothFeature, "lowEnergy", chip_info.features & CHIP_FEATURE_BLE);
-	cJSON_AddBoolToObject(features, "ieee802.15.4", chip_info.features & CHIP_FEATURE_IEEE802154);
+	const char *model;
+	switch (chip_info.model) {
+		case CHIP_ESP32:
+			model = "ESP32";
+			break;
+		case CHIP_ESP32S2:
+			model = "ESP32-S2";
+			break;
+		case CHIP_ESP32S3:
+			model = "ESP32-S3";
+			break;
+		case CHIP_ESP32C3:
+			model = "ESP32-C3";
+			break;
+		case CHIP_ESP32C2:
+			model = "ESP32-C2";
+			break;
+		case CHIP_ESP32C6:
+			model = "ESP32-C6";
+			break;
+		case CHIP_ESP32H2:
+			model = "ESP32-H2";
+			break;
+		default:
+			model = "UNKNOWN";
+			break;
+	}
+	char revision[12];
+	snprintf(revision, sizeof(revision), "%d.%02d", chip_info.revision / 100, chip_info.revision % 100);
+	writer.beginObject("chip");
+	writer.writeInteger("cores", chip_info.cores);
+	writer.writeString("model", model);
+	writer.writeString("revision", revision);
+	writer.beginObject("features");
+	writer.beginObject("wifi");
+	writer.writeBool("bgn", chip_info.features & CHIP_FEATURE_WIFI_BGN);
+	writer.endObject();
+	writer.beginObject("bluetooth");
+	writer.writeBool("classic", chip_info.features & CHIP_FEATURE_BT);
+	writer.writeBool("lowEnergy", chip_info.features & CHIP_FEATURE_BLE);
+	writer.endObject();
+	writer.writeBool("ieee802.15.4", chip_info.features & CHIP_FEATURE_IEEE802154);
+	writer.endObject();
+	writer.endObject();
 }
 
-void SystemController::setNetworkInfo(cJSON *root) {
-	cJSON *networkInterfaces = cJSON_AddArrayToObject(root, "network");
+void SystemController::writeNetworkInfo(JsonWriter &writer) {
+	writer.beginArray("network");
 	esp_netif_t *netif = nullptr;
 	for (size_t i = 0; i < esp_netif_get_nr_of_ifs(); ++i) {
 		netif = esp_netif_next(netif);
-		cJSON *networkInterface = cJSON_CreateObject();
-		cJSON_AddStringToObject(networkInterface, "name", esp_netif_get_desc(netif));
+		writer.beginObject();
+		writer.writeString("name", esp_netif_get_desc(netif));
 		uint8_t mac[6] = {0,};
 		if (esp_netif_get_mac(netif, mac) == ESP_OK) {
-			cJSON_AddStringToObject(networkInterface, "macAddress", InterfaceUtils::macToString(mac, ":").c_str());
+			char macAddress[18];
+			snprintf(macAddress, sizeof(macAddress), "%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+			writer.writeString("macAddress", macAddress);
 		}
-		cJSON *ipv4 = cJSON_AddObjectToObject(networkInterface, "ipv4");
+		writer.beginObject("ipv4");
 		esp_netif_ip_info_t ip;
 		if (esp_netif_get_ip_info(netif, &ip) == ESP_OK) {
 			char address[40] = "";
 			snprintf(address, sizeof(address), IPSTR, IP2STR(&ip.ip));
-			cJSON_AddStringToObject(ipv4, "address", address);
+			writer.writeString("address", address);
 			snprintf(address, sizeof(address), IPSTR, IP2STR(&ip.netmask));
-			cJSON_AddStringToObject(ipv4, "netmask", address);
+			writer.writeString("netmask", address);
 			snprintf(address, sizeof(address), IPSTR, IP2STR(&ip.gw));
-			cJSON_AddStringToObject(ipv4, "gateway", address);
+			writer.writeString("gateway", address);
 		}
+		writer.endObject();
 #if CONFIG_LWIP_IPV6
-		cJSON *ipv6 = cJSON_AddObjectToObject(networkInterface, "ipv6");
-		cJSON *addresses = cJSON_AddArrayToObject(ipv6, "addresses");
+		writer.beginObject("ipv6").beginArray("addresses");
 		esp_ip6_addr_t ips[CONFIG_LWIP_IPV6_NUM_ADDRESSES];
 		int ipCount = esp_netif_get_all_ip6(netif, ips);
 		for (int j = 0; j< ipCount; ++j) {
 			char address[40] = "";
 			snprintf(address, sizeof(address), IPV6STR, IPV62STR(ips[j]));
-			cJSON_AddItemToArray(addresses, cJSON_CreateString(address));
+			writer.writeString(address);
 		}
+		writer.endArray().endObject();
 #endif
 		esp_netif_dns_info_t dnsInfo;
-		cJSON *dns = cJSON_AddArrayToObject(networkInterface, "dns");
+		writer.beginArray("dns");
 		for (int j = ESP_NETIF_DNS_MAIN; j < ESP_NETIF_DNS_MAX; ++j) {
 			if (esp_netif_get_dns_info(netif, static_cast<esp_netif_dns_type_t>(j), &dnsInfo) == ESP_OK) {
 				char address[40] = "";
@@ -124,67 +142,59 @@ void SystemController::setNetworkInfo(cJSON *root) {
 				if (strcmp(address, "0.0.0.0") == 0) {
 					continue;
 				}
-				cJSON_AddItemToArray(dns, cJSON_CreateString(address));
+				writer.writeString(address);
 			}
 		}
+		writer.endArray();
 		const char *hostname;
 		if (esp_netif_get_hostname(netif, &hostname) == ESP_OK) {
-			cJSON_AddStringToObject(networkInterface, "hostname", hostname);
+			writer.writeString("hostname", hostname);
 		}
-		cJSON_AddBoolToObject(networkInterface, "isUp", esp_netif_is_netif_up(netif));
-		cJSON_AddItemToArray(networkInterfaces, networkInterface);
+		writer.writeBool("isUp", esp_netif_is_netif_up(netif));
+		writer.endObject();
 	}
+	writer.endArray();
 }
 
-void SystemController::setHeapInfo(cJSON *root) {
-	cJSON *heap = cJSON_AddObjectToObject(root, "heap");
-	cJSON_AddNumberToObject(heap, "total", heap_caps_get_total_size(MALLOC_CAP_8BIT));
-	cJSON_AddNumberToObject(heap, "free", heap_caps_get_free_size(MALLOC_CAP_8BIT));
+void SystemController::writeHeapInfo(JsonWriter &writer) {
+	writer.beginObject("heap")
+		.writeInteger("total", heap_caps_get_total_size(MALLOC_CAP_8BIT))
+		.writeInteger("free", heap_caps_get_free_size(MALLOC_CAP_8BIT))
+		.endObject();
 }
 
-void SystemController::setNvsInfo(cJSON *root) {
+void SystemController::writeNvsInfo(JsonWriter &writer) {
 	nvs_stats_t nvs_stats;
 	if (nvs_get_stats(NULL, &nvs_stats) != ESP_OK) {
 		return;
 	}
-	cJSON *heap = cJSON_AddObjectToObject(root, "nvs");
-	cJSON_AddNumberToObject(heap, "total", nvs_stats.total_entries);
-	cJSON_AddNumberToObject(heap, "used", nvs_stats.used_entries);
-	cJSON_AddNumberToObject(heap, "free", nvs_stats.free_entries);
+	writer.beginObject("nvs")
+		.writeInteger("total", nvs_stats.total_entries)
+		.writeInteger("used", nvs_stats.used_entries)
+		.writeInteger("free", nvs_stats.free_entries)
+		.endObject();
 }
 
-esp_err_t SystemController::getInfo(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
-	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
-	}
-	httpd_resp_set_type(request, "application/json");
-	cJSON *root = cJSON_CreateObject();
-	SystemController::setChipInfo(root);
-	SystemController::setNetworkInfo(root);
-	SystemController::setHeapInfo(root);
-	SystemController::setNvsInfo(root);
-
-	cJSON_AddStringToObject(root, "idfVersion", IDF_VER);
+esp_err_t SystemController::getInfo(restApiCall_t &call) {
+	JsonWriter &writer = *call.writer;
+	writer.beginObject();
+	SystemController::writeChipInfo(writer);
+	SystemController::writeNetworkInfo(writer);
+	SystemController::writeHeapInfo(writer);
+	SystemController::writeNvsInfo(writer);
+	writer.writeKey("http");
+	HttpServer::writeStatistics(writer);
+	writer.writeString("idfVersion", IDF_VER);
 	uint64_t uptime = esp_timer_get_time() / 1000000.0;
-	cJSON_AddNumberToObject(root, "uptime", uptime);
+	writer.writeInteger("uptime", uptime);
 	const esp_app_desc_t *appDescription = esp_app_get_description();
-	cJSON_AddStringToObject(root, "version", appDescription->version);
-	const char *json = cJSON_PrintUnformatted(root);
-	httpd_resp_sendstr(request, json);
-	delete json;
-	cJSON_Delete(root);
+	writer.writeString("version", appDescription->version);
+	writer.endObject();
 	return ESP_OK;
 }
 
-esp_err_t SystemController::restart(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
-	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
-	}
-	httpd_resp_sendstr(request, "");
+esp_err_t SystemController::restart(restApiCall_t &call) {
+	httpd_resp_sendstr(call.request, "");
 	esp_restart();
 	return ESP_OK;
 }
@@ -0,0 +1,348 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "restApi/webSocketController.h"
+
+using namespace sbc_pdu::restApi;
+
+httpd_handle_t WebSocketController::server = nullptr;
+std::map<uint8_t, Output*> *WebSocketController::outputs = nullptr;
+std::vector<webSocketClient_t> WebSocketController::clients = {};
+SemaphoreHandle_t WebSocketController::mutex = nullptr;
+
+WebSocketController::WebSocketController(std::map<uint8_t, Output*> *outputs) {
+	WebSocketController::outputs = outputs;
+	if (WebSocketController::mutex == nullptr) {
+		WebSocketController::mutex = xSemaphoreCreateMutex();
+	}
+	this->handler = {
+		.uri = "/api/v1/ws",
+		.method = HTTP_GET,
+		.handler = &WebSocketController::handle,
+		.user_ctx = nullptr,
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = true,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = nullptr,
+#endif
+	};
+}
+
+void WebSocketController::registerEndpoints(const httpd_handle_t &server) {
+	WebSocketController::server = server;
+	httpd_register_uri_handler(server, &this->handler);
+}
+
+esp_err_t WebSocketController::handle(httpd_req_t *request) {
+	int fd = httpd_req_to_sockfd(request);
+	if (request->method == HTTP_GET) {
+		// Browsers cannot set the Authorization header of the handshake, they authenticate with the first message instead
+		bool authenticated = false;
+		size_t length = httpd_req_get_hdr_value_len(request, "Authorization");
+		if (length > 0) {
+			std::string authorization(length + 1, '\0');
+			if (httpd_req_get_hdr_value_str(request, "Authorization", authorization.data(), authorization.size()) == ESP_OK) {
+				authorization.resize(length);
+				authenticated = BasicAuthenticator().isAuthorized(authorization);
+			}
+		}
+		xSemaphoreTake(WebSocketController::mutex, portMAX_DELAY);
+		std::erase_if(WebSocketController::clients, [fd](const webSocketClient_t &client) {
+			return client.fd == fd || httpd_ws_get_fd_info(WebSocketController::server, client.fd) != HTTPD_WS_CLIENT_WEBSOCKET;
+		});
+		if (WebSocketController::clients.size() >= WebSocketController::MAX_CLIENTS) {
+			xSemaphoreGive(WebSocketController::mutex);
+			ESP_LOGW(TAG, "Too many clients, closing the socket %d.", fd);
+			return ESP_FAIL;
+		}
+		WebSocketController::clients.push_back({
+			.fd = fd,
+			.authenticated = authenticated,
+			.subscribed = false,
+			.interval = WebSocketController::MIN_INTERVAL * 1000,
+			.lastUpdate = 0,
+			.pending = 0,
+			.sent = {},
+		});
+		xSemaphoreGive(WebSocketController::mutex);
+		ESP_LOGI(TAG, "Client %d connected.", fd);
+		return ESP_OK;
+	}
+	httpd_ws_frame_t frame = {};
+	esp_err_t result = httpd_ws_recv_frame(request, &frame, 0);
+	if (result != ESP_OK) {
+		ESP_LOGE(TAG, "Failed to receive the frame length: %s", esp_err_to_name(result));
+		return result;
+	}
+	if (frame.len > WebSocketController::MAX_FRAME_LENGTH) {
+		ESP_LOGW(TAG, "Frame of %zu bytes is too long, closing the socket %d.", frame.len, fd);
+		return ESP_FAIL;
+	}
+	std::string payload(frame.len, '\0');
+	frame.payload = reinterpret_cast<uint8_t *>(payload.data());
+	result = httpd_ws_recv_frame(request, &frame, frame.len);
+	if (result != ESP_OK) {
+		ESP_LOGE(TAG, "Failed to receive the frame: %s", esp_err_to_name(result));
+		return result;
+	}
+	if (frame.type != HTTPD_WS_TYPE_TEXT) {
+		return ESP_OK;
+	}
+	cJSON *message = cJSON_ParseWithLength(payload.data(), payload.length());
+	if (!cJSON_IsObject(message)) {
+		WebSocketController::replyError(request, nullptr, "Message is not a JSON object.");
+	} else {
+		WebSocketController::handleMessage(request, message);
+	}
+	cJSON_Delete(message);
+	return ESP_OK;
+}
+
+void WebSocketController::handleMessage(httpd_req_t *request, const cJSON *message) {
+	int fd = httpd_req_to_sockfd(request);
+	const cJSON *type = cJSON_GetObjectItem(message, "type");
+	if (!cJSON_IsString(type)) {
+		WebSocketController::replyError(request, message, "Missing \"type\" property.");
+		return;
+	}
+	std::string messageType(type->valuestring);
+	if (messageType == "auth") {
+		const cJSON *authorization = cJSON_GetObjectItem(message, "authorization");
+		bool authenticated = cJSON_IsString(authorization) && BasicAuthenticator().isAuthorized(authorization->valuestring);
+		xSemaphoreTake(WebSocketController::mutex, portMAX_DELAY);
+		webSocketClient_t *client = WebSocketController::findClient(fd);
+		if (client != nullptr) {
+			client->authenticated = authenticated;
+		}
+		xSemaphoreGive(WebSocketController::mutex);
+		if (!authenticated) {
+			WebSocketController::replyError(request, message, "Unauthorized");
+			return;
+		}
+		WebSocketController::reply(request, message, WebSocketController::createResponse("auth"));
+		return;
+	}
+	xSemaphoreTake(WebSocketController::mutex, portMAX_DELAY);
+	webSocketClient_t *client = WebSocketController::findClient(fd);
+	bool authenticated = client != nullptr && client->authenticated;
+	xSemaphoreGive(WebSocketController::mutex);
+	if (!authenticated) {
+		WebSocketController::replyError(request, message, "Unauthorized");
+		return;
+	}
+	if (messageType == "subscribe") {
+		uint32_t interval = WebSocketController::MIN_INTERVAL;
+		const cJSON *intervalItem = cJSON_GetObjectItem(message, "interval");
+		if (cJSON_IsNumber(intervalItem)) {
+			interval = std::clamp<double>(intervalItem->valuedouble, WebSocketController::MIN_INTERVAL, WebSocketController::MAX_INTERVAL);
+		}
+		xSemaphoreTake(WebSocketController::mutex, portMAX_DELAY);
+		client = WebSocketController::findClient(fd);
+		if (client != nullptr) {
+			client->subscribed = true;
+			client->interval = static_cast<int64_t>(interval) * 1000;
+			client->lastUpdate = 0;
+			// The first update contains all outputs
+			client->sent.clear();
+		}
+		xSemaphoreGive(WebSocketController::mutex);
+		cJSON *response = WebSocketController::createResponse("subscribe");
+		cJSON_AddNumberToObject(response, "interval", interval);
+		WebSocketController::reply(request, message, response);
+	} else if (messageType == "unsubscribe") {
+		xSemaphoreTake(WebSocketController::mutex, portMAX_DELAY);
+		client = WebSocketController::findClient(fd);
+		if (client != nullptr) {
+			client->subscribed = false;
+		}
+		xSemaphoreGive(WebSocketController::mutex);
+		WebSocketController::reply(request, message, WebSocketController::createResponse("unsubscribe"));
+	} else if (messageType == "switch") {
+		WebSocketController::switchOutput(request, message);
+	} else {
+		WebSocketController::replyError(request, message, "Unknown message type \"" + messageType + "\".");
+	}
+}
+
+void WebSocketController::switchOutput(httpd_req_t *request, const cJSON *message) {
+	const cJSON *outputId = cJSON_GetObjectItem(message, "output");
+	if (!cJSON_IsNumber(outputId)) {
+		WebSocketController::replyError(request, message, "Property \"output\" is not a number.");
+		return;
+	}
+	auto output = WebSocketController::outputs->end();
+	if (outputId->valuedouble >= 0 && outputId->valuedouble <= UINT8_MAX) {
+		output = WebSocketController::outputs->find(outputId->valueint);
+	}
+	if (output == WebSocketController::outputs->end()) {
+		WebSocketController::replyError(request, message, "Output with given ID does not exist.");
+		return;
+	}
+	const cJSON *state = cJSON_GetObjectItem(message, "state");
+	if (!cJSON_IsBool(state)) {
+		WebSocketController::replyError(request, message, "Property \"state\" is not a boolean.");
+		return;
+	}
+	bool enabled = cJSON_IsTrue(state);
+	if (!output->second->enable(enabled)) {
+		WebSocketController::replyError(request, message, "Power-on of the output exceeds the power budget.");
+		return;
+	}
+	cJSON *response = WebSocketController::createResponse("switch");
+	cJSON_AddNumberToObject(response, "output", output->first);
+	cJSON_AddBoolToObject(response, "state", enabled);
+	WebSocketController::reply(request, message, response);
+}
+
+cJSON *WebSocketController::createResponse(const char *type) {
+	cJSON *response = cJSON_CreateObject();
+	cJSON_AddStringToObject(response, "type", type);
+	return response;
+}
+
+void WebSocketController::reply(httpd_req_t *request, const cJSON *message, cJSON *response) {
+	const cJSON *id = cJSON_GetObjectItem(message, "id");
+	if (cJSON_IsNumber(id)) {
+		cJSON_AddNumberToObject(response, "id", id->valuedouble);
+	}
+	char *payload = cJSON_PrintUnformatted(response);
+	cJSON_Delete(response);
+	if (payload == nullptr) {
+		return;
+	}
+	httpd_ws_frame_t frame = {
+		.final = true,
+		.fragmented = false,
+		.type = HTTPD_WS_TYPE_TEXT,
+		.payload = reinterpret_cast<uint8_t *>(payload),
+		.len = strlen(payload),
+	};
+	esp_err_t result = httpd_ws_send_frame(request, &frame);
+	if (result != ESP_OK) {
+		ESP_LOGW(TAG, "Failed to send the response: %s", esp_err_to_name(result));
+	}
+	cJSON_free(payload);
+}
+
+void WebSocketController::replyError(httpd_req_t *request, const cJSON *message, const std::string &error) {
+	cJSON *response = WebSocketController::createResponse("error");
+	cJSON_AddStringToObject(response, "message", error.c_str());
+	WebSocketController::reply(request, message, response);
+}
+
+bool WebSocketController::hasSubscribers() {
+	if (WebSocketController::mutex == nullptr) {
+		return false;
+	}
+	xSemaphoreTake(WebSocketController::mutex, portMAX_DELAY);
+	bool subscribed = std::any_of(WebSocketController::clients.begin(), WebSocketController::clients.end(), [](const webSocketClient_t &client) {
+		return client.subscribed;
+	});
+	xSemaphoreGive(WebSocketController::mutex);
+	return subscribed;
+}
+
+void WebSocketController::publish(const std::vector<telemetrySample_t> &samples) {
+	if (WebSocketController::server == nullptr) {
+		return;
+	}
+	struct timeval now;
+	gettimeofday(&now, nullptr);
+	int64_t timestamp = static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_usec / 1000;
+	int64_t uptime = esp_timer_get_time();
+	xSemaphoreTake(WebSocketController::mutex, portMAX_DELAY);
+	std::erase_if(WebSocketController::clients, [](const webSocketClient_t &client) {
+		return client.pending == 0 && httpd_ws_get_fd_info(WebSocketController::server, client.fd) != HTTPD_WS_CLIENT_WEBSOCKET;
+	});
+	for (webSocketClient_t &client : WebSocketController::clients) {
+		// Slow clients skip the updates until the previous one is sent, the next update carries all changes since then
+		if (!client.subscribed || client.pending > 0 || uptime - client.lastUpdate < client.interval) {
+			continue;
+		}
+		std::map<uint8_t, telemetrySample_t> sent = client.sent;
+		std::string payload = "{\"type\":\"outputs\",\"timestamp\":" + std::to_string(timestamp) + ",\"outputs\":[";
+		bool empty = true;
+		for (const telemetrySample_t &sample : samples) {
+			auto previous = sent.find(sample.output);
+			if (previous != sent.end() && !WebSocketController::hasChanged(previous->second, sample)) {
+				continue;
+			}
+			// [index, flags, current in mA, voltage in V]
+			char item[64];
+			snprintf(item, sizeof(item), "%s[%u,%u,%.2f,%.3f]", empty ? "" : ",", sample.output, sample.flags, sample.current / 1000.0, sample.voltage / 1000000.0);
+			payload += item;
+			sent[sample.output] = sample;
+			empty = false;
+		}
+		if (empty) {
+			continue;
+		}
+		payload += "]}";
+		webSocketUpdate_t *update = new webSocketUpdate_t{
+			.fd = client.fd,
+			.payload = std::move(payload),
+		};
+		if (httpd_queue_work(WebSocketController::server, &WebSocketController::sendUpdate, update) != ESP_OK) {
+			ESP_LOGW(TAG, "Failed to queue the update for the client %d.", client.fd);
+			delete update;
+			continue;
+		}
+		client.sent = std::move(sent);
+		client.lastUpdate = uptime;
+		client.pending++;
+	}
+	xSemaphoreGive(WebSocketController::mutex);
+}
+
+void WebSocketController::sendUpdate(void *arg) {
+	webSocketUpdate_t *update = reinterpret_cast<webSocketUpdate_t *>(arg);
+	httpd_ws_frame_t frame = {
+		.final = true,
+		.fragmented = false,
+		.type = HTTPD_WS_TYPE_TEXT,
+		.payload = reinterpret_cast<uint8_t *>(update->payload.data()),
+		.len = update->payload.length(),
+	};
+	esp_err_t result = httpd_ws_send_frame_async(WebSocketController::server, update->fd, &frame);
+	xSemaphoreTake(WebSocketController::mutex, portMAX_DELAY);
+	webSocketClient_t *client = WebSocketController::findClient(update->fd);
+	if (client != nullptr) {
+		client->pending--;
+		if (result != ESP_OK) {
+			client->subscribed = false;
+		}
+	}
+	xSemaphoreGive(WebSocketController::mutex);
+	if (result != ESP_OK) {
+		ESP_LOGW(TAG, "Failed to send the update to the client %d: %s", update->fd, esp_err_to_name(result));
+		httpd_sess_trigger_close(WebSocketController::server, update->fd);
+	}
+	delete update;
+}
+
+webSocketClient_t *WebSocketController::findClient(int fd) {
+	for (webSocketClient_t &client : WebSocketController::clients) {
+		if (client.fd == fd) {
+			return &client;
+		}
+	}
+	return nullptr;
+}
+
+bool WebSocketController::hasChanged(const telemetrySample_t &previous, const telemetrySample_t &sample) {
+	return previous.flags != sample.flags ||
+		std::abs(previous.current - sample.current) >= WebSocketController::CURRENT_DEAD_BAND ||
+		std::abs(previous.voltage - sample.voltage) >= WebSocketController::VOLTAGE_DEAD_BAND;
+}
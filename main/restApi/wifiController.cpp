@@ -17,57 +17,57 @@
 
 using namespace sbc_pdu::restApi;
 
-WifiController::WifiController(Wifi *manager) {
-	this->getConfigHandler = {
+Wifi *WifiController::manager = nullptr;
+
+const restApiField_t WifiController::configFields[] = {
+	REST_API_FIELD(wifiConfigMessage_t, authMode, JSON_FIELD_STRING, true),
+	REST_API_FIELD(wifiConfigMessage_t, ssid, JSON_FIELD_STRING, true),
+	REST_API_FIELD(wifiConfigMessage_t, psk, JSON_FIELD_STRING, true),
+};
+
+const restApiSchema_t WifiController::configSchema = REST_API_SCHEMA(wifiConfigMessage_t, WifiController::configFields);
+
+const restApiRoute_t WifiController::routes[] = {
+	{
 		.uri = "/api/v1/wifi",
 		.method = HTTP_GET,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &WifiController::getConfig,
-		.user_ctx = nullptr,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
-	this->putConfigHandler = {
+		.request = nullptr,
+		.response = &WifiController::configSchema,
+		.json = false,
+	},
+	{
 		.uri = "/api/v1/wifi",
 		.method = HTTP_PUT,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &WifiController::putConfig,
-		.user_ctx = nullptr,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
-	this->scanHandler = {
+		.request = &WifiController::configSchema,
+		.response = nullptr,
+		.json = false,
+	},
+	{
 		.uri = "/api/v1/wifi/scan",
 		.method = HTTP_GET,
+		.auth = REST_API_AUTH_ANY,
 		.handler = &WifiController::scan,
-		.user_ctx = manager,
-#ifdef CONFIG_HTTPD_WS_SUPPORT
-		.is_websocket = false,
-		.handle_ws_control_frames = false,
-		.supported_subprotocol = nullptr,
-#endif
-	};
+		.request = nullptr,
+		.response = nullptr,
+		.json = true,
+	},
+};
+
+WifiController::WifiController(Wifi *manager) {
+	WifiController::manager = manager;
 }
 
 void WifiController::registerEndpoints(const httpd_handle_t &server) {
-	httpd_register_uri_handler(server, &this->getConfigHandler);
-	httpd_register_uri_handler(server, &this->putConfigHandler);
-	httpd_register_uri_handler(server, &this->scanHandler);
+	Router::registerRoutes(server, WifiController::routes);
 }
 
-esp_err_t WifiController::getConfig(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
-	sbc_pdu::restApi::BasicAuthenticator authenticator = sbc_pdu::restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
-	}
+esp_err_t WifiController::getConfig(restApiCall_t &call) {
+	wifiConfigMessage_t *response = static_cast<wifiConfigMessage_t *>(call.response);
 	NvsManager nvs = NvsManager("wifi");
-	httpd_resp_set_type(request, "application/json");
-	cJSON *root = cJSON_CreateObject();
 	uint8_t authModeValue;
 	if (nvs.get("authmode", authModeValue) != ESP_OK) {
 		authModeValue = static_cast<uint8_t>(WIFI_AUTH_OPEN);
@@ -75,111 +75,52 @@ esp_err_t WifiController::getConfig(httpd_req_t *request) {
 	auto authMode = Wifi::authModes.find(
 		static_cast<wifi_auth_mode_t>(authModeValue)
 	);
-	std::string authModeString = authMode != Wifi::authModes.end() ? authMode->second : "unknown";
-	cJSON_AddStringToObject(root, "authMode", authModeString.c_str());
-	std::string ssid;
-	if (nvs.getString("ssid", ssid) != ESP_OK) {
-		ssid = "";
+	snprintf(response->authMode, sizeof(response->authMode), "%s", authMode != Wifi::authModes.end() ? authMode->second.c_str() : "unknown");
+	std::string value;
+	if (nvs.getString("ssid", value) == ESP_OK) {
+		snprintf(response->ssid, sizeof(response->ssid), "%s", value.c_str());
 	}
-	cJSON_AddStringToObject(root, "ssid", ssid.c_str());
-	std::string psk;
-	if (nvs.getString("psk", psk) != ESP_OK) {
-		psk = "";
+	if (nvs.getString("psk", value) == ESP_OK) {
+		snprintf(response->psk, sizeof(response->psk), "%s", value.c_str());
 	}
-	cJSON_AddStringToObject(root, "psk", psk.c_str());
-	const char *response = cJSON_PrintUnformatted(root);
-	httpd_resp_sendstr(request, response);
-	delete response;
-	cJSON_Delete(root);
 	return ESP_OK;
 }
 
-esp_err_t WifiController::putConfig(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
-	restApi::BasicAuthenticator authenticator = restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
-	}
-	cJSON *root = nullptr;
-	esp_err_t result = RestApiUtils::parseJsonRequest(request, &root);
-	if (result != ESP_OK) {
-		return result;
-	}
-	bool valid = true;
-	NvsManager nvs = NvsManager("wifi");
-	cJSON *authMode = cJSON_GetObjectItem(root, "authMode");
-	if (authMode == nullptr) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Missing \"authMode\" property.");
-
-	}
-	if (!cJSON_IsString(authMode)) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"authMode\" is not a string.");
-	}
+esp_err_t WifiController::putConfig(restApiCall_t &call) {
+	const wifiConfigMessage_t *body = static_cast<const wifiConfigMessage_t *>(call.body);
 	auto authModeValue = std::find_if(
 		Wifi::authModes.begin(),
 		Wifi::authModes.end(),
-		[authMode](const std::pair<wifi_auth_mode_t, std::string> &pair) {
-			return pair.second == authMode->valuestring;
+		[body](const std::pair<wifi_auth_mode_t, std::string> &pair) {
+			return pair.second == body->authMode;
 		}
 	);
 	if (authModeValue == Wifi::authModes.end()) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Unknown \"authMode\" value.");
-	}
-	cJSON *ssid = cJSON_GetObjectItem(root, "ssid");
-	if (ssid == nullptr) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Missing \"ssid\" property.");
-	}
-	if (!cJSON_IsString(ssid)) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"ssid\" is not a string.");
-	}
-	cJSON *psk = cJSON_GetObjectItem(root, "psk");
-	if (psk == nullptr) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Missing \"psk\" property.");
-	}
-	if (!cJSON_IsString(psk)) {
-		valid = false;
-		RestApiUtils::createBadRequestResponse(request, "Property \"psk\" is not a string.");
+		call.error = "Unknown \"authMode\" value.";
+		return ESP_ERR_INVALID_ARG;
 	}
-	if (valid) {
-		nvs.set("authmode", static_cast<uint8_t>(authModeValue->first));
-		nvs.setString("ssid", ssid->valuestring);
-		nvs.setString("psk", psk->valuestring);
-		nvs.commit();
-	}
-	httpd_resp_sendstr(request, nullptr);
-	cJSON_Delete(root);
+	NvsManager nvs = NvsManager("wifi");
+	nvs.set("authmode", static_cast<uint8_t>(authModeValue->first));
+	nvs.setString("ssid", body->ssid);
+	nvs.setString("psk", body->psk);
+	nvs.commit();
+	httpd_resp_sendstr(call.request, nullptr);
 	return ESP_OK;
 }
 
-esp_err_t WifiController::scan(httpd_req_t *request) {
-	sbc_pdu::restApi::Cors::addHeaders(request);
-	sbc_pdu::restApi::BasicAuthenticator authenticator = sbc_pdu::restApi::BasicAuthenticator();
-	if (!authenticator.authenticate(request)) {
-		return ESP_OK;
-	}
-	Wifi *manager = reinterpret_cast<Wifi*>(request->user_ctx);
-	httpd_resp_set_type(request, "application/json");
-	cJSON *root = cJSON_CreateArray();
-	std::vector<WifiApInfo> list = manager->scan();
+esp_err_t WifiController::scan(restApiCall_t &call) {
+	JsonWriter &writer = *call.writer;
+	writer.beginArray();
+	std::vector<WifiApInfo> list = WifiController::manager->scan();
 	for (WifiApInfo &apInfo : list) {
-		cJSON *ap = cJSON_CreateObject();
-		cJSON_AddStringToObject(ap, "authMode", apInfo.getAuthMode().c_str());
-		cJSON_AddStringToObject(ap, "bssid", InterfaceUtils::macToString(apInfo.getBssid(), ":").c_str());
-		cJSON_AddBoolToObject(ap, "inUse", apInfo.isInUse());
-		cJSON_AddNumberToObject(ap, "rssi", apInfo.getRssi());
-		cJSON_AddStringToObject(ap, "ssid", apInfo.getSsid().c_str());
-		cJSON_AddItemToArray(root, ap);
-	}
-	const char *response = cJSON_PrintUnformatted(root);
-	httpd_resp_sendstr(request, response);
-	delete response;
-	cJSON_Delete(root);
+		writer.beginObject();
+		writer.writeString("authMode", apInfo.getAuthMode());
+		writer.writeString("bssid", InterfaceUtils::macToString(apInfo.getBssid(), ":"));
+		writer.writeBool("inUse", apInfo.isInUse());
+		writer.writeInteger("rssi", apInfo.getRssi());
+		writer.writeString("ssid", apInfo.getSsid());
+		writer.endObject();
+	}
+	writer.endArray();
 	return ESP_OK;
 }
-
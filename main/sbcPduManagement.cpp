@@ -17,18 +17,41 @@
 
 std::string SbcPduManagement::baseTopic = "sbc_pdu/" + Wifi::getPrimaryMacAddress();
 Mqtt *SbcPduManagement::mqtt = nullptr;
+Mqtt *SbcPduManagement::telemetryMqtt = nullptr;
 std::map<uint8_t, Output*> *SbcPduManagement::outputs = nullptr;
+TelemetryBuffer *SbcPduManagement::telemetryBuffer = nullptr;
+std::atomic<int> SbcPduManagement::historyMessageId = 0;
+std::atomic<bool> SbcPduManagement::historyDelivered = false;
+std::map<uint8_t, int64_t> SbcPduManagement::lastBuffered = {};
+int64_t SbcPduManagement::lastDiagnostics = 0;
+payload_format_t SbcPduManagement::telemetryFormat = PAYLOAD_FORMAT_TEXT;
+payload_format_t SbcPduManagement::historyFormat = PAYLOAD_FORMAT_TEXT;
+std::vector<uint8_t> SbcPduManagement::frameBuffer = {};
 
-SbcPduManagement::SbcPduManagement(Mqtt *mqtt, std::map<uint8_t, Output*> *outputs) {
+SbcPduManagement::SbcPduManagement(Mqtt *mqtt, std::map<uint8_t, Output*> *outputs, TelemetryBuffer *telemetryBuffer, Mqtt *telemetryMqtt) {
 	this->outputs = outputs;
 	this->mqtt = mqtt;
+	this->telemetryMqtt = telemetryMqtt != nullptr ? telemetryMqtt : mqtt;
+	this->telemetryBuffer = telemetryBuffer;
+	NvsManager nvs("mqtt");
+	uint8_t format = PAYLOAD_FORMAT_TEXT;
+	nvs.get("telemetryFmt", format);
+	this->telemetryFormat = format == PAYLOAD_FORMAT_CBOR ? PAYLOAD_FORMAT_CBOR : PAYLOAD_FORMAT_TEXT;
+	format = PAYLOAD_FORMAT_TEXT;
+	nvs.get("historyFmt", format);
+	this->historyFormat = format == PAYLOAD_FORMAT_CBOR ? PAYLOAD_FORMAT_CBOR : PAYLOAD_FORMAT_TEXT;
+	if (this->telemetryFormat == PAYLOAD_FORMAT_CBOR) {
+		this->frameBuffer.resize(TelemetryFrame::MAX_HEADER_SIZE + outputs->size() * TelemetryFrame::MAX_SAMPLE_SIZE);
+	}
+	SbcPduManagement::subscribeCommands();
+	if (telemetryBuffer != nullptr && telemetryBuffer->isAvailable()) {
+		this->telemetryMqtt->setOnPublished(SbcPduManagement::publishedCallback);
+		xTaskCreate(SbcPduManagement::historyTask, "historyTask", 4096, nullptr, 5, nullptr);
+	}
 }
 
 void SbcPduManagement::connectCallback(Mqtt* client, esp_event_base_t base, esp_mqtt_event_handle_t event) {
 	client->publishString(SbcPduManagement::getDeviceBaseTopic() + "/status", "online", 2, true);
-	for (const auto& outputPair : *outputs) {
-		SbcPduManagement::subscribeOutputEnablement(outputPair.second);
-	}
 }
 
 std::string SbcPduManagement::getDeviceBaseTopic() {
@@ -43,27 +66,315 @@ void SbcPduManagement::publishOutputAlert(Output *output) {
 	SbcPduManagement::mqtt->publishString(SbcPduManagement::getOutputBaseTopic(output) + "/alert", std::to_string(output->hasAlert()), 2, false);
 }
 
-void SbcPduManagement::publishOutputMeasurements(Output *output) {
+void SbcPduManagement::publishMeasurements(const std::vector<telemetrySample_t> &samples) {
+	SbcPduManagement::publishDiagnostics();
+	for (const telemetrySample_t &sample : samples) {
+		auto output = outputs->find(sample.output);
+		if (output != outputs->end()) {
+			SbcPduManagement::publishOutputMeasurements(output->second, sample);
+		}
+	}
+	if (SbcPduManagement::telemetryFormat != PAYLOAD_FORMAT_CBOR || !SbcPduManagement::telemetryMqtt->isConnected()) {
+		return;
+	}
+	struct timeval now;
+	gettimeofday(&now, nullptr);
+	int64_t timestamp = static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_usec / 1000;
+	CborWriter writer(SbcPduManagement::frameBuffer.data(), SbcPduManagement::frameBuffer.size());
+	TelemetryFrame::begin(writer, timestamp, false, samples.size());
+	for (telemetrySample_t sample : samples) {
+		sample.timestamp = timestamp;
+		TelemetryFrame::addSample(writer, sample, timestamp);
+	}
+	SbcPduManagement::publishFrame(SbcPduManagement::baseTopic + "/telemetry", writer, SbcPduManagement::telemetryMqtt->getTelemetryQos(), SbcPduManagement::TELEMETRY_EXPIRY_INTERVAL, true);
+}
+
+payload_format_t SbcPduManagement::getTelemetryFormat() {
+	return SbcPduManagement::telemetryFormat;
+}
+
+Mqtt *SbcPduManagement::getMqtt() {
+	return SbcPduManagement::mqtt;
+}
+
+Mqtt *SbcPduManagement::getTelemetryMqtt() {
+	return SbcPduManagement::telemetryMqtt;
+}
+
+cJSON *SbcPduManagement::createDiagnostics() {
+	cJSON *root = cJSON_CreateObject();
+	cJSON *clients = cJSON_AddArrayToObject(root, "clients");
+	for (Mqtt *client : Mqtt::getInstances()) {
+		cJSON_AddItemToArray(clients, client->getDiagnostics());
+	}
+	return root;
+}
+
+void SbcPduManagement::publishDiagnostics() {
+	int64_t now = esp_timer_get_time();
+	if (now - SbcPduManagement::lastDiagnostics < SbcPduManagement::DIAGNOSTICS_INTERVAL) {
+		return;
+	}
+	SbcPduManagement::lastDiagnostics = now;
+	cJSON *root = SbcPduManagement::createDiagnostics();
+	char *payload = cJSON_PrintUnformatted(root);
+	cJSON_Delete(root);
+	if (payload == nullptr) {
+		return;
+	}
+	std::string data(payload);
+	cJSON_free(payload);
+	for (Mqtt *client : Mqtt::getInstances()) {
+		if (client->isConnected()) {
+			client->publishString(SbcPduManagement::baseTopic + "/diagnostics", data, 0, false);
+		}
+	}
+}
+
+int SbcPduManagement::publishFrame(const std::string &topic, const CborWriter &writer, int qos, uint32_t expiryInterval, bool telemetry) {
+	if (writer.hasOverflowed()) {
+		ESP_LOGE(TAG, "Telemetry frame for the topic \"%s\" does not fit into the buffer.", topic.c_str());
+		return -1;
+	}
+	mqttPublishProperties_t properties = {
+		.messageExpiryInterval = expiryInterval,
+		.topicAlias = qos == 0,
+		.contentType = SbcPduManagement::CBOR_CONTENT_TYPE,
+	};
+	if (telemetry) {
+		return SbcPduManagement::telemetryMqtt->publishTelemetry(topic, writer.getData(), writer.getLength(), qos, false, &properties);
+	}
+	return SbcPduManagement::telemetryMqtt->publish(topic, writer.getData(), writer.getLength(), qos, false, &properties);
+}
+
+void SbcPduManagement::publishOutputMeasurements(Output *output, const telemetrySample_t &sample) {
+	// Text telemetry is carried by the state client, CBOR frames by the telemetry client
+	Mqtt *carrier = SbcPduManagement::telemetryFormat == PAYLOAD_FORMAT_CBOR ? SbcPduManagement::telemetryMqtt : SbcPduManagement::mqtt;
+	if (!carrier->isConnected()) {
+		SbcPduManagement::bufferOutputMeasurements(sample);
+	}
+	if (!SbcPduManagement::mqtt->isConnected()) {
+		return;
+	}
 	std::string topic = SbcPduManagement::getOutputBaseTopic(output);
 	SbcPduManagement::publishOutputAlert(output);
-	SbcPduManagement::mqtt->publishString(topic + "/enabled", std::to_string(output->isEnabled()), 2, false);
-	SbcPduManagement::mqtt->publishString(topic + "/current", std::to_string(fabs(output->readCurrent())), 2, false);
-	SbcPduManagement::mqtt->publishString(topic + "/voltage", std::to_string(output->readVoltage()), 2, false);
+	SbcPduManagement::publishTelemetry(topic + "/enabled", std::to_string((sample.flags & TELEMETRY_FLAG_ENABLED) != 0), "");
+	SbcPduManagement::publishTelemetry(topic + "/current", std::to_string(sample.current / 1000.0), "mA");
+	SbcPduManagement::publishTelemetry(topic + "/voltage", std::to_string(sample.voltage / 1000000.0), "V");
 }
 
-void SbcPduManagement::subscribeOutputEnablement(Output *output) {
-	std::string topic = SbcPduManagement::getOutputBaseTopic(output) + "/enable";
-	SbcPduManagement::mqtt->subscribe(topic, SbcPduManagement::enablementCallback, 2);
+int SbcPduManagement::publishTelemetry(const std::string &topic, const std::string &value, const std::string &unit) {
+	const uint8_t *data = reinterpret_cast<const uint8_t *>(value.data());
+	int qos = SbcPduManagement::mqtt->getTelemetryQos();
+	if (SbcPduManagement::mqtt->getProtocolVersion() != MQTT_PROTOCOL_V_5) {
+		return SbcPduManagement::mqtt->publishTelemetry(topic, data, value.length(), qos, false);
+	}
+	struct timeval now;
+	gettimeofday(&now, nullptr);
+	int64_t timestamp = static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_usec / 1000;
+	mqttPublishProperties_t properties = {
+		.messageExpiryInterval = SbcPduManagement::TELEMETRY_EXPIRY_INTERVAL,
+		.topicAlias = true,
+		.userProperties = {{"timestamp", std::to_string(timestamp)}},
+	};
+	if (!unit.empty()) {
+		properties.userProperties.emplace_back("unit", unit);
+	}
+	return SbcPduManagement::mqtt->publishTelemetry(topic, data, value.length(), qos, false, &properties);
+}
+
+void SbcPduManagement::bufferOutputMeasurements(const telemetrySample_t &sample) {
+	if (SbcPduManagement::telemetryBuffer == nullptr) {
+		return;
+	}
+	// Records without the synchronized time would carry bogus timestamps
+	time_t timestamp = time(nullptr);
+	if (timestamp < MeasurementHistory::MIN_TIMESTAMP) {
+		return;
+	}
+	int64_t now = esp_timer_get_time();
+	auto last = SbcPduManagement::lastBuffered.find(sample.output);
+	if (last != SbcPduManagement::lastBuffered.end() && now - last->second < SbcPduManagement::HISTORY_SAMPLE_INTERVAL) {
+		return;
+	}
+	SbcPduManagement::lastBuffered[sample.output] = now;
+	telemetryRecord_t record = {
+		.sequence = 0,
+		.timestamp = static_cast<uint32_t>(timestamp),
+		.current = static_cast<float>(sample.current / 1000.0),
+		.voltage = static_cast<uint16_t>(sample.voltage / 1000),
+		.output = sample.output,
+		.flags = sample.flags,
+	};
+	SbcPduManagement::telemetryBuffer->append(record);
+}
+
+void SbcPduManagement::historyTask(void *arg) {
+	telemetryRecord_t records[SbcPduManagement::HISTORY_BATCH_SIZE];
+	uint32_t pendingSequence = 0;
+	int64_t publishedAt = 0;
+	while (true) {
+		vTaskDelay(pdMS_TO_TICKS(SbcPduManagement::HISTORY_BATCH_INTERVAL));
+		// Records are acknowledged only after the broker acknowledged the batch, so they survive a reboot or an outbox expiry
+		if (SbcPduManagement::historyMessageId != 0) {
+			if (SbcPduManagement::historyDelivered) {
+				SbcPduManagement::telemetryBuffer->acknowledge(pendingSequence);
+			} else if (esp_timer_get_time() - publishedAt < SbcPduManagement::HISTORY_ACK_TIMEOUT) {
+				continue;
+			} else {
+				ESP_LOGW(TAG, "History batch was not acknowledged, publishing it again.");
+			}
+			SbcPduManagement::historyMessageId = 0;
+		}
+		// History is forwarded only while the outbox is not congested by live telemetry
+		if (!SbcPduManagement::telemetryMqtt->isConnected() || !SbcPduManagement::telemetryMqtt->hasOutboxSpace(0)) {
+			continue;
+		}
+		size_t count = SbcPduManagement::telemetryBuffer->peek(records, SbcPduManagement::HISTORY_BATCH_SIZE);
+		if (count == 0) {
+			continue;
+		}
+		SbcPduManagement::historyDelivered = false;
+		int msgId = SbcPduManagement::publishHistory(records, count);
+		if (msgId > 0) {
+			pendingSequence = records[count - 1].sequence;
+			publishedAt = esp_timer_get_time();
+			SbcPduManagement::historyMessageId = msgId;
+		}
+	}
+}
+
+void SbcPduManagement::publishedCallback(Mqtt *client, int msgId) {
+	if (msgId == SbcPduManagement::historyMessageId) {
+		SbcPduManagement::historyDelivered = true;
+	}
+}
+
+int SbcPduManagement::publishHistory(const telemetryRecord_t *records, size_t count) {
+	std::string topic = SbcPduManagement::baseTopic + "/history";
+	if (SbcPduManagement::historyFormat == PAYLOAD_FORMAT_CBOR) {
+		uint8_t buffer[TelemetryFrame::MAX_HEADER_SIZE + SbcPduManagement::HISTORY_BATCH_SIZE * TelemetryFrame::MAX_SAMPLE_SIZE];
+		CborWriter writer(buffer, sizeof(buffer));
+		int64_t frameTimestamp = static_cast<int64_t>(records[0].timestamp) * 1000;
+		TelemetryFrame::begin(writer, frameTimestamp, true, count);
+		for (size_t i = 0; i < count; ++i) {
+			const telemetryRecord_t &record = records[i];
+			telemetrySample_t sample = {
+				.output = record.output,
+				.flags = record.flags,
+				.current = TelemetryFrame::milliToMicro(record.current),
+				.voltage = static_cast<int32_t>(record.voltage) * 1000,
+				.timestamp = static_cast<int64_t>(record.timestamp) * 1000,
+			};
+			TelemetryFrame::addSample(writer, sample, frameTimestamp);
+		}
+		return SbcPduManagement::publishFrame(topic, writer, 1, 0, false);
+	}
+	cJSON *root = cJSON_CreateObject();
+	cJSON_AddTrueToObject(root, "historical");
+	cJSON *array = cJSON_AddArrayToObject(root, "records");
+	for (size_t i = 0; i < count; ++i) {
+		const telemetryRecord_t &record = records[i];
+		cJSON *item = cJSON_CreateObject();
+		cJSON_AddNumberToObject(item, "output", record.output);
+		cJSON_AddNumberToObject(item, "timestamp", record.timestamp);
+		cJSON_AddBoolToObject(item, "enabled", record.flags & TELEMETRY_FLAG_ENABLED);
+		cJSON_AddBoolToObject(item, "alert", record.flags & TELEMETRY_FLAG_ALERT);
+		cJSON_AddNumberToObject(item, "current", record.current);
+		cJSON_AddNumberToObject(item, "voltage", record.voltage / 1000.0);
+		cJSON_AddItemToArray(array, item);
+	}
+	char *payload = cJSON_PrintUnformatted(root);
+	cJSON_Delete(root);
+	if (payload == nullptr) {
+		return -1;
+	}
+	int msgId = SbcPduManagement::telemetryMqtt->publishString(topic, std::string(payload), 1, false);
+	cJSON_free(payload);
+	return msgId;
+}
+
+void SbcPduManagement::subscribeCommands() {
+	SbcPduManagement::mqtt->subscribe(SbcPduManagement::baseTopic + "/outputs/+/enable", SbcPduManagement::enablementCallback, 2);
+	SbcPduManagement::mqtt->subscribe(SbcPduManagement::baseTopic + "/command", SbcPduManagement::commandCallback, 2);
+	SbcPduManagement::mqtt->subscribe(SbcPduManagement::baseTopic + "/log", SbcPduManagement::logCallback, 1);
 }
 
 void SbcPduManagement::enablementCallback(esp_mqtt_event_handle_t event) {
-	std::string topic(event->topic, event->topic_len);
-	std::string data(event->data, event->data_len);
-	std::string outputTopic;
-	for (const auto& outputPair : *outputs) {
-		outputTopic = SbcPduManagement::getOutputBaseTopic(outputPair.second) + "/enable";
-		if (topic == outputTopic) {
-			outputPair.second->enable(data == "1");
+	std::string_view topic(event->topic, event->topic_len);
+	const size_t prefixLength = SbcPduManagement::baseTopic.length() + sizeof("/outputs/") - 1;
+	if (topic.length() <= prefixLength) {
+		return;
+	}
+	uint8_t index = 0;
+	const char *end = topic.data() + topic.length();
+	std::from_chars_result result = std::from_chars(topic.data() + prefixLength, end, index);
+	if (result.ec != std::errc() || result.ptr == end || *result.ptr != '/') {
+		ESP_LOGE(TAG, "Invalid output index in topic \"%.*s\".", event->topic_len, event->topic);
+		return;
+	}
+	auto output = outputs->find(index);
+	if (output == outputs->end()) {
+		ESP_LOGE(TAG, "Output with ID %u does not exist.", index);
+		return;
+	}
+	std::string_view data(event->data, event->data_len);
+	output->second->enable(data == "1");
+}
+
+void SbcPduManagement::commandCallback(esp_mqtt_event_handle_t event) {
+	cJSON *root = cJSON_ParseWithLength(event->data, event->data_len);
+	if (root == nullptr) {
+		ESP_LOGE(TAG, "Invalid command payload.");
+		return;
+	}
+	cJSON *action = cJSON_GetObjectItem(root, "action");
+	if (!cJSON_IsString(action)) {
+		ESP_LOGE(TAG, "Missing \"action\" property in the command.");
+		cJSON_Delete(root);
+		return;
+	}
+	std::string_view actionName(action->valuestring);
+	if (actionName != "enable" && actionName != "disable" && actionName != "toggle") {
+		ESP_LOGE(TAG, "Unknown command action \"%s\".", action->valuestring);
+		cJSON_Delete(root);
+		return;
+	}
+	auto execute = [&actionName](Output *output) {
+		if (actionName == "toggle") {
+			output->enable(!output->isEnabled());
+		} else {
+			output->enable(actionName == "enable");
+		}
+	};
+	cJSON *indices = cJSON_GetObjectItem(root, "outputs");
+	if (cJSON_IsArray(indices)) {
+		cJSON *index = nullptr;
+		cJSON_ArrayForEach(index, indices) {
+			if (!cJSON_IsNumber(index) || index->valuedouble < 0 || index->valuedouble > UINT8_MAX) {
+				continue;
+			}
+			auto output = outputs->find(index->valueint);
+			if (output != outputs->end()) {
+				execute(output->second);
+			}
+		}
+	} else {
+		for (const auto& outputPair : *outputs) {
+			execute(outputPair.second);
 		}
 	}
+	cJSON_Delete(root);
+}
+
+void SbcPduManagement::logCallback(esp_mqtt_event_handle_t event) {
+	cJSON *root = cJSON_ParseWithLength(event->data, event->data_len);
+	if (root == nullptr) {
+		ESP_LOGE(TAG, "Invalid log level payload.");
+		return;
+	}
+	if (LogManager::setLevels(root) != ESP_OK) {
+		ESP_LOGE(TAG, "Failed to set log levels, levels above \"%s\" are not compiled into the firmware.", LogManager::getLevelName(LogManager::MAXIMUM_LEVEL));
+	}
+	cJSON_Delete(root);
 }
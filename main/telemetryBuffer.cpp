@@ -0,0 +1,165 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "telemetryBuffer.h"
+
+TelemetryBuffer::TelemetryBuffer(const std::string &partitionLabel) {
+	this->partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partitionLabel.c_str());
+	if (this->partition == nullptr) {
+		ESP_LOGE(TAG, "Unable to find partition \"%s\", telemetry will not be buffered.", partitionLabel.c_str());
+		return;
+	}
+	uint32_t sectors = this->partition->size / this->partition->erase_size;
+	if (sectors < 2) {
+		ESP_LOGE(TAG, "Partition \"%s\" has to contain at least two sectors.", partitionLabel.c_str());
+		this->partition = nullptr;
+		return;
+	}
+	this->sectorRecords = this->partition->erase_size / sizeof(telemetryRecord_t);
+	this->capacity = sectors * this->sectorRecords;
+	this->mutex = xSemaphoreCreateMutex();
+	this->recover();
+	ESP_LOGI(TAG, "Capacity: %lu records, buffered: %lu records", this->capacity, this->count);
+}
+
+bool TelemetryBuffer::isAvailable() const {
+	return this->partition != nullptr;
+}
+
+void TelemetryBuffer::recover() {
+	uint32_t drained = 0;
+	this->nvs.getOptional("drained", drained);
+	uint32_t sectors = this->capacity / this->sectorRecords;
+	uint32_t headSector = 0;
+	uint32_t newestSequence = 0;
+	uint32_t oldestSequence = TelemetryBuffer::ERASED;
+	telemetryRecord_t record;
+	for (uint32_t sector = 0; sector < sectors; ++sector) {
+		if (this->readSlot(sector * this->sectorRecords, &record) != ESP_OK || record.sequence == TelemetryBuffer::ERASED) {
+			continue;
+		}
+		if (record.sequence >= newestSequence) {
+			newestSequence = record.sequence;
+			headSector = sector;
+		}
+		if (record.sequence < oldestSequence) {
+			oldestSequence = record.sequence;
+		}
+	}
+	if (oldestSequence == TelemetryBuffer::ERASED) {
+		this->nextSequence = drained + 1;
+		return;
+	}
+	// Find the first erased slot in the newest sector
+	uint32_t slot = 0;
+	for (; slot < this->sectorRecords; ++slot) {
+		if (this->readSlot(headSector * this->sectorRecords + slot, &record) != ESP_OK || record.sequence == TelemetryBuffer::ERASED) {
+			break;
+		}
+		newestSequence = record.sequence;
+	}
+	this->head = (headSector * this->sectorRecords + slot) % this->capacity;
+	this->nextSequence = newestSequence + 1;
+	uint32_t firstPending = std::max(drained + 1, oldestSequence);
+	if (firstPending < this->nextSequence) {
+		this->count = this->nextSequence - firstPending;
+	}
+	this->tail = (this->head + this->capacity - this->count) % this->capacity;
+}
+
+esp_err_t TelemetryBuffer::readSlot(uint32_t slot, telemetryRecord_t *record) {
+	return esp_partition_read(this->partition, slot * sizeof(telemetryRecord_t), record, sizeof(telemetryRecord_t));
+}
+
+esp_err_t TelemetryBuffer::append(telemetryRecord_t record) {
+	if (!this->isAvailable()) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	xSemaphoreTake(this->mutex, portMAX_DELAY);
+	if (this->head % this->sectorRecords == 0) {
+		esp_err_t result = esp_partition_erase_range(this->partition, this->head * sizeof(telemetryRecord_t), this->partition->erase_size);
+		if (result != ESP_OK) {
+			ESP_LOGE(TAG, "Failed to erase sector. Error: %s", esp_err_to_name(result));
+			xSemaphoreGive(this->mutex);
+			return result;
+		}
+		uint32_t maxCount = this->capacity - this->sectorRecords;
+		if (this->count > maxCount) {
+			this->dropped += this->count - maxCount;
+			this->count = maxCount;
+			this->tail = (this->head + this->sectorRecords) % this->capacity;
+		}
+	}
+	record.sequence = this->nextSequence;
+	esp_err_t result = esp_partition_write(this->partition, this->head * sizeof(telemetryRecord_t), &record, sizeof(telemetryRecord_t));
+	if (result == ESP_OK) {
+		this->head = (this->head + 1) % this->capacity;
+		++this->nextSequence;
+		++this->count;
+	} else {
+		ESP_LOGE(TAG, "Failed to write record. Error: %s", esp_err_to_name(result));
+	}
+	xSemaphoreGive(this->mutex);
+	return result;
+}
+
+size_t TelemetryBuffer::peek(telemetryRecord_t *records, size_t count) {
+	if (!this->isAvailable()) {
+		return 0;
+	}
+	xSemaphoreTake(this->mutex, portMAX_DELAY);
+	size_t readCount = std::min(count, static_cast<size_t>(this->count));
+	for (size_t i = 0; i < readCount; ++i) {
+		if (this->readSlot((this->tail + i) % this->capacity, &records[i]) != ESP_OK) {
+			readCount = i;
+			break;
+		}
+	}
+	xSemaphoreGive(this->mutex);
+	return readCount;
+}
+
+esp_err_t TelemetryBuffer::acknowledge(uint32_t sequence) {
+	if (!this->isAvailable()) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	xSemaphoreTake(this->mutex, portMAX_DELAY);
+	uint32_t firstPending = this->nextSequence - this->count;
+	if (this->count == 0 || sequence < firstPending) {
+		xSemaphoreGive(this->mutex);
+		return ESP_OK;
+	}
+	uint32_t acknowledged = std::min(sequence - firstPending + 1, this->count);
+	this->tail = (this->tail + acknowledged) % this->capacity;
+	this->count -= acknowledged;
+	this->nvs.set("drained", firstPending + acknowledged - 1);
+	esp_err_t result = this->nvs.commit();
+	xSemaphoreGive(this->mutex);
+	return result;
+}
+
+size_t TelemetryBuffer::size() {
+	if (!this->isAvailable()) {
+		return 0;
+	}
+	xSemaphoreTake(this->mutex, portMAX_DELAY);
+	size_t size = this->count;
+	xSemaphoreGive(this->mutex);
+	return size;
+}
+
+uint32_t TelemetryBuffer::getDropped() {
+	return this->dropped;
+}
@@ -0,0 +1,35 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "telemetryFrame.h"
+
+void TelemetryFrame::begin(CborWriter &writer, int64_t timestamp, bool historical, size_t sampleCount) {
+	writer.beginMap(historical ? 4 : 3);
+	writer.writeUnsigned(TelemetryFrame::KEY_VERSION).writeUnsigned(TelemetryFrame::VERSION);
+	writer.writeUnsigned(TelemetryFrame::KEY_TIMESTAMP).writeInteger(timestamp);
+	if (historical) {
+		writer.writeUnsigned(TelemetryFrame::KEY_HISTORICAL).writeBool(true);
+	}
+	writer.writeUnsigned(TelemetryFrame::KEY_SAMPLES).beginArray(sampleCount);
+}
+
+void TelemetryFrame::addSample(CborWriter &writer, const telemetrySample_t &sample, int64_t frameTimestamp) {
+	writer.beginArray(5);
+	writer.writeUnsigned(sample.output);
+	writer.writeUnsigned(sample.flags);
+	writer.writeInteger(sample.current);
+	writer.writeInteger(sample.voltage);
+	writer.writeInteger(sample.timestamp - frameTimestamp);
+}
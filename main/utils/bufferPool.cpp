@@ -0,0 +1,42 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "utils/bufferPool.h"
+
+BufferPool::BufferPool(size_t count, size_t size): memory(count * size), free(xQueueCreate(count, sizeof(char *))), size(size) {
+	for (size_t i = 0; i < count; ++i) {
+		char *buffer = this->memory.data() + i * size;
+		xQueueSend(this->free, &buffer, 0);
+	}
+}
+
+char *BufferPool::acquire(TickType_t timeout) {
+	char *buffer = nullptr;
+	if (xQueueReceive(this->free, &buffer, timeout) != pdTRUE) {
+		ESP_LOGW(TAG, "No buffer returned to the pool in time.");
+		return nullptr;
+	}
+	return buffer;
+}
+
+void BufferPool::release(char *buffer) {
+	if (buffer != nullptr) {
+		xQueueSend(this->free, &buffer, 0);
+	}
+}
+
+size_t BufferPool::getSize() const {
+	return this->size;
+}
@@ -0,0 +1,137 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "utils/cborWriter.h"
+
+/// Unsigned integer major type
+#define CBOR_MAJOR_UNSIGNED 0
+/// Negative integer major type
+#define CBOR_MAJOR_NEGATIVE 1
+/// Byte string major type
+#define CBOR_MAJOR_BYTES 2
+/// Text string major type
+#define CBOR_MAJOR_TEXT 3
+/// Array major type
+#define CBOR_MAJOR_ARRAY 4
+/// Map major type
+#define CBOR_MAJOR_MAP 5
+/// Simple value major type
+#define CBOR_MAJOR_SIMPLE 7
+
+CborWriter::CborWriter(uint8_t *buffer, size_t size): buffer(buffer), size(size) {}
+
+CborWriter &CborWriter::writeUnsigned(uint64_t value) {
+	this->writeHead(CBOR_MAJOR_UNSIGNED, value);
+	return *this;
+}
+
+CborWriter &CborWriter::writeInteger(int64_t value) {
+	if (value >= 0) {
+		this->writeHead(CBOR_MAJOR_UNSIGNED, static_cast<uint64_t>(value));
+	} else {
+		// Negative integers are encoded as -1 - n
+		this->writeHead(CBOR_MAJOR_NEGATIVE, static_cast<uint64_t>(-(value + 1)));
+	}
+	return *this;
+}
+
+CborWriter &CborWriter::writeBool(bool value) {
+	this->writeHead(CBOR_MAJOR_SIMPLE, value ? 21 : 20);
+	return *this;
+}
+
+CborWriter &CborWriter::writeNull() {
+	this->writeHead(CBOR_MAJOR_SIMPLE, 22);
+	return *this;
+}
+
+CborWriter &CborWriter::writeText(std::string_view value) {
+	this->writeHead(CBOR_MAJOR_TEXT, value.length());
+	this->writeRaw(reinterpret_cast<const uint8_t *>(value.data()), value.length());
+	return *this;
+}
+
+CborWriter &CborWriter::writeBytes(const uint8_t *data, size_t length) {
+	this->writeHead(CBOR_MAJOR_BYTES, length);
+	this->writeRaw(data, length);
+	return *this;
+}
+
+CborWriter &CborWriter::beginArray(size_t length) {
+	this->writeHead(CBOR_MAJOR_ARRAY, length);
+	return *this;
+}
+
+CborWriter &CborWriter::beginMap(size_t length) {
+	this->writeHead(CBOR_MAJOR_MAP, length);
+	return *this;
+}
+
+const uint8_t *CborWriter::getData() const {
+	return this->buffer;
+}
+
+size_t CborWriter::getLength() const {
+	return this->length;
+}
+
+bool CborWriter::hasOverflowed() const {
+	return this->overflow;
+}
+
+void CborWriter::reset() {
+	this->length = 0;
+	this->overflow = false;
+}
+
+void CborWriter::writeHead(uint8_t majorType, uint64_t argument) {
+	uint8_t head[9];
+	size_t argumentLength;
+	uint8_t additionalInformation;
+	if (argument < 24) {
+		additionalInformation = argument;
+		argumentLength = 0;
+	} else if (argument <= UINT8_MAX) {
+		additionalInformation = 24;
+		argumentLength = 1;
+	} else if (argument <= UINT16_MAX) {
+		additionalInformation = 25;
+		argumentLength = 2;
+	} else if (argument <= UINT32_MAX) {
+		additionalInformation = 26;
+		argumentLength = 4;
+	} else {
+		additionalInformation = 27;
+		argumentLength = 8;
+	}
+	head[0] = (majorType << 5) | additionalInformation;
+	// Arguments are encoded in network byte order
+	for (size_t i = 0; i < argumentLength; ++i) {
+		head[argumentLength - i] = (argument >> (8 * i)) & 0xff;
+	}
+	this->writeRaw(head, argumentLength + 1);
+}
+
+void CborWriter::writeRaw(const uint8_t *data, size_t length) {
+	if (this->overflow || this->length + length > this->size) {
+		this->overflow = true;
+		return;
+	}
+	if (length == 0) {
+		return;
+	}
+	memcpy(this->buffer + this->length, data, length);
+	this->length += length;
+}
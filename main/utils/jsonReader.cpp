@@ -0,0 +1,495 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "utils/jsonReader.h"
+
+JsonReader::JsonReader(jsonField_t *fields, size_t count): fields(fields), count(count) {
+	for (size_t i = 0; i < count; ++i) {
+		fields[i].found = false;
+	}
+}
+
+jsonField_t JsonReader::boolField(const char *name, bool *value, bool required) {
+	return {name, JSON_FIELD_BOOL, value, sizeof(bool), required, false};
+}
+
+jsonField_t JsonReader::integerField(const char *name, int32_t *value, bool required) {
+	return {name, JSON_FIELD_INTEGER, value, sizeof(int32_t), required, false};
+}
+
+jsonField_t JsonReader::numberField(const char *name, double *value, bool required) {
+	return {name, JSON_FIELD_NUMBER, value, sizeof(double), required, false};
+}
+
+jsonField_t JsonReader::stringField(const char *name, char *value, size_t size, bool required) {
+	return {name, JSON_FIELD_STRING, value, size, required, false};
+}
+
+esp_err_t JsonReader::feed(const char *data, size_t length) {
+	for (size_t i = 0; i < length && this->result == ESP_OK; ++i) {
+		this->consume(data[i]);
+		this->offset++;
+	}
+	return this->result;
+}
+
+esp_err_t JsonReader::finish() {
+	if (this->result != ESP_OK) {
+		return this->result;
+	}
+	if (this->state != STATE_DONE) {
+		this->fail("Request body is not a complete JSON object.");
+		return this->result;
+	}
+	for (size_t i = 0; i < this->count; ++i) {
+		if (this->fields[i].required && !this->fields[i].found) {
+			this->fail("Missing \"%s\" property.", this->fields[i].name);
+			break;
+		}
+	}
+	return this->result;
+}
+
+const char *JsonReader::getError() const {
+	return this->error;
+}
+
+void JsonReader::consume(char character) {
+	switch (this->state) {
+		case STATE_STRING:
+			this->consumeString(character);
+			return;
+		case STATE_ESCAPE:
+			this->consumeEscape(character);
+			return;
+		case STATE_UNICODE:
+			this->consumeUnicode(character);
+			return;
+		case STATE_NUMBER:
+			if (isdigit(static_cast<unsigned char>(character)) || strchr("+-.eE", character) != nullptr) {
+				if (this->numberLength == sizeof(this->number) - 1) {
+					this->failSyntax();
+					return;
+				}
+				this->number[this->numberLength++] = character;
+				return;
+			}
+			// The character after the number is structural
+			this->endNumber();
+			if (this->result != ESP_OK) {
+				return;
+			}
+			break;
+		case STATE_LITERAL:
+			if (character != this->literal[this->literalLength]) {
+				this->failSyntax();
+				return;
+			}
+			if (this->literal[++this->literalLength] == '\0') {
+				this->endLiteral();
+			}
+			return;
+		default:
+			break;
+	}
+	if (character == ' ' || character == '\t' || character == '\n' || character == '\r') {
+		return;
+	}
+	switch (this->state) {
+		case STATE_VALUE_OR_END:
+			if (character == ']') {
+				this->endContainer();
+				return;
+			}
+			this->beginValue(character);
+			return;
+		case STATE_VALUE:
+			this->beginValue(character);
+			return;
+		case STATE_KEY_OR_END:
+			if (character == '}') {
+				this->endContainer();
+				return;
+			}
+			[[fallthrough]];
+		case STATE_KEY:
+			if (character != '"') {
+				this->failSyntax();
+				return;
+			}
+			this->inKey = true;
+			this->keyLength = 0;
+			this->keyOverflow = false;
+			this->state = STATE_STRING;
+			return;
+		case STATE_COLON:
+			if (character != ':') {
+				this->failSyntax();
+				return;
+			}
+			this->field = this->depth == 1 ? this->findField() : nullptr;
+			this->state = STATE_VALUE;
+			return;
+		case STATE_AFTER_VALUE:
+			if (character == ',') {
+				this->state = this->isArray() ? STATE_VALUE : STATE_KEY;
+				return;
+			}
+			if (character == (this->isArray() ? ']' : '}')) {
+				this->endContainer();
+				return;
+			}
+			this->failSyntax();
+			return;
+		default:
+			this->failSyntax();
+			return;
+	}
+}
+
+void JsonReader::beginValue(char character) {
+	if (this->depth == 0 && character != '{') {
+		this->fail("Request body has to be a JSON object.");
+		return;
+	}
+	switch (character) {
+		case '{':
+		case '[':
+			if (this->field != nullptr) {
+				this->failType();
+				return;
+			}
+			if (this->depth == JsonReader::MAX_DEPTH - 1) {
+				this->fail("JSON nesting is deeper than %u levels.", JsonReader::MAX_DEPTH - 1);
+				return;
+			}
+			this->depth++;
+			if (character == '[') {
+				this->arrays |= 1UL << this->depth;
+				this->state = STATE_VALUE_OR_END;
+			} else {
+				this->arrays &= ~(1UL << this->depth);
+				this->state = STATE_KEY_OR_END;
+			}
+			return;
+		case '"':
+			if (this->field != nullptr && this->field->type != JSON_FIELD_STRING) {
+				this->failType();
+				return;
+			}
+			this->inKey = false;
+			this->stringLength = 0;
+			this->state = STATE_STRING;
+			return;
+		case 't':
+			this->literal = "true";
+			break;
+		case 'f':
+			this->literal = "false";
+			break;
+		case 'n':
+			this->literal = "null";
+			break;
+		default:
+			if (character != '-' && !isdigit(static_cast<unsigned char>(character))) {
+				this->failSyntax();
+				return;
+			}
+			this->number[0] = character;
+			this->numberLength = 1;
+			this->state = STATE_NUMBER;
+			return;
+	}
+	this->literalLength = 1;
+	this->state = STATE_LITERAL;
+}
+
+void JsonReader::endValue() {
+	if (this->field != nullptr) {
+		this->field->found = true;
+		this->field = nullptr;
+	}
+	this->state = this->depth == 0 ? STATE_DONE : STATE_AFTER_VALUE;
+}
+
+void JsonReader::endContainer() {
+	this->depth--;
+	this->endValue();
+}
+
+void JsonReader::consumeString(char character) {
+	if (this->highSurrogate != 0 && character != '\\') {
+		this->failSyntax();
+		return;
+	}
+	if (character == '\\') {
+		this->state = STATE_ESCAPE;
+		return;
+	}
+	if (static_cast<unsigned char>(character) < 0x20) {
+		this->failSyntax();
+		return;
+	}
+	if (character != '"') {
+		this->append(character);
+		return;
+	}
+	if (this->inKey) {
+		this->key[this->keyLength] = '\0';
+		this->state = STATE_COLON;
+		return;
+	}
+	if (this->field != nullptr) {
+		static_cast<char *>(this->field->value)[this->stringLength] = '\0';
+	}
+	this->endValue();
+}
+
+void JsonReader::consumeEscape(char character) {
+	if (this->highSurrogate != 0 && character != 'u') {
+		this->failSyntax();
+		return;
+	}
+	this->state = STATE_STRING;
+	switch (character) {
+		case '"':
+		case '\\':
+		case '/':
+			this->append(character);
+			return;
+		case 'b':
+			this->append('\b');
+			return;
+		case 'f':
+			this->append('\f');
+			return;
+		case 'n':
+			this->append('\n');
+			return;
+		case 'r':
+			this->append('\r');
+			return;
+		case 't':
+			this->append('\t');
+			return;
+		case 'u':
+			this->unicode = 0;
+			this->unicodeLength = 0;
+			this->state = STATE_UNICODE;
+			return;
+		default:
+			this->failSyntax();
+			return;
+	}
+}
+
+void JsonReader::consumeUnicode(char character) {
+	if (!isxdigit(static_cast<unsigned char>(character))) {
+		this->failSyntax();
+		return;
+	}
+	char digit[2] = {character, '\0'};
+	this->unicode = (this->unicode << 4) | strtoul(digit, nullptr, 16);
+	if (++this->unicodeLength < 4) {
+		return;
+	}
+	this->state = STATE_STRING;
+	bool low = this->unicode >= 0xdc00 && this->unicode <= 0xdfff;
+	if (this->highSurrogate != 0) {
+		if (!low) {
+			this->failSyntax();
+			return;
+		}
+		this->appendCodePoint(0x10000 + ((this->highSurrogate - 0xd800) << 10) + (this->unicode - 0xdc00));
+		this->highSurrogate = 0;
+	} else if (this->unicode >= 0xd800 && this->unicode <= 0xdbff) {
+		this->highSurrogate = this->unicode;
+	} else if (low) {
+		this->failSyntax();
+	} else {
+		this->appendCodePoint(this->unicode);
+	}
+}
+
+void JsonReader::endNumber() {
+	this->number[this->numberLength] = '\0';
+	// strtod accepts more than the JSON grammar (leading zeros, `1.`, `.5`, hexadecimal numbers)
+	if (!JsonReader::isValidNumber(this->number)) {
+		this->failSyntax();
+		return;
+	}
+	double value = strtod(this->number, nullptr);
+	if (this->field != nullptr) {
+		switch (this->field->type) {
+			case JSON_FIELD_INTEGER: {
+				if (strpbrk(this->number, ".eE") != nullptr) {
+					this->failType();
+					return;
+				}
+				errno = 0;
+				long long integer = strtoll(this->number, nullptr, 10);
+				if (errno == ERANGE || integer < INT32_MIN || integer > INT32_MAX) {
+					this->fail("Property \"%s\" is out of range.", this->field->name);
+					return;
+				}
+				*static_cast<int32_t *>(this->field->value) = integer;
+				break;
+			}
+			case JSON_FIELD_NUMBER:
+				*static_cast<double *>(this->field->value) = value;
+				break;
+			default:
+				this->failType();
+				return;
+		}
+	}
+	this->endValue();
+}
+
+bool JsonReader::isValidNumber(const char *number) {
+	auto digits = [&number]() {
+		const char *start = number;
+		while (isdigit(static_cast<unsigned char>(*number))) {
+			++number;
+		}
+		return number - start;
+	};
+	if (*number == '-') {
+		++number;
+	}
+	if (*number == '0') {
+		++number;
+	} else if (digits() == 0) {
+		return false;
+	}
+	if (*number == '.') {
+		++number;
+		if (digits() == 0) {
+			return false;
+		}
+	}
+	if (*number == 'e' || *number == 'E') {
+		++number;
+		if (*number == '+' || *number == '-') {
+			++number;
+		}
+		if (digits() == 0) {
+			return false;
+		}
+	}
+	return *number == '\0';
+}
+
+void JsonReader::endLiteral() {
+	if (this->field != nullptr) {
+		if (this->field->type != JSON_FIELD_BOOL || this->literal[0] == 'n') {
+			this->failType();
+			return;
+		}
+		*static_cast<bool *>(this->field->value) = this->literal[0] == 't';
+	}
+	this->endValue();
+}
+
+void JsonReader::append(char character) {
+	if (this->inKey) {
+		if (this->keyLength == sizeof(this->key) - 1) {
+			this->keyOverflow = true;
+			return;
+		}
+		this->key[this->keyLength++] = character;
+		return;
+	}
+	if (this->field == nullptr) {
+		return;
+	}
+	if (this->stringLength + 1 >= this->field->size) {
+		this->fail("Property \"%s\" is longer than %u characters.", this->field->name, static_cast<unsigned>(this->field->size - 1));
+		return;
+	}
+	static_cast<char *>(this->field->value)[this->stringLength++] = character;
+}
+
+void JsonReader::appendCodePoint(uint32_t codePoint) {
+	// Null character would truncate the key or the string value
+	if (codePoint == 0) {
+		if (this->inKey) {
+			this->failSyntax();
+		} else if (this->field != nullptr) {
+			this->fail("Property \"%s\" contains a null character.", this->field->name);
+		}
+		return;
+	}
+	if (codePoint < 0x80) {
+		this->append(codePoint);
+	} else if (codePoint < 0x800) {
+		this->append(0xc0 | (codePoint >> 6));
+		this->append(0x80 | (codePoint & 0x3f));
+	} else if (codePoint < 0x10000) {
+		this->append(0xe0 | (codePoint >> 12));
+		this->append(0x80 | ((codePoint >> 6) & 0x3f));
+		this->append(0x80 | (codePoint & 0x3f));
+	} else {
+		this->append(0xf0 | (codePoint >> 18));
+		this->append(0x80 | ((codePoint >> 12) & 0x3f));
+		this->append(0x80 | ((codePoint >> 6) & 0x3f));
+		this->append(0x80 | (codePoint & 0x3f));
+	}
+}
+
+jsonField_t *JsonReader::findField() {
+	if (this->keyOverflow) {
+		return nullptr;
+	}
+	for (size_t i = 0; i < this->count; ++i) {
+		if (strcmp(this->fields[i].name, this->key) == 0) {
+			return &this->fields[i];
+		}
+	}
+	return nullptr;
+}
+
+bool JsonReader::isArray() const {
+	return this->arrays & (1UL << this->depth);
+}
+
+void JsonReader::failType() {
+	switch (this->field->type) {
+		case JSON_FIELD_BOOL:
+			this->fail("Property \"%s\" is not a boolean.", this->field->name);
+			break;
+		case JSON_FIELD_INTEGER:
+			this->fail("Property \"%s\" is not an integer.", this->field->name);
+			break;
+		case JSON_FIELD_NUMBER:
+			this->fail("Property \"%s\" is not a number.", this->field->name);
+			break;
+		case JSON_FIELD_STRING:
+			this->fail("Property \"%s\" is not a string.", this->field->name);
+			break;
+	}
+}
+
+void JsonReader::failSyntax() {
+	this->fail("Invalid JSON at offset %u.", static_cast<unsigned>(this->offset));
+}
+
+void JsonReader::fail(const char *format, ...) {
+	va_list arguments;
+	va_start(arguments, format);
+	vsnprintf(this->error, sizeof(this->error), format, arguments);
+	va_end(arguments);
+	this->result = ESP_ERR_INVALID_ARG;
+}
@@ -0,0 +1,284 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "utils/jsonWriter.h"
+
+JsonWriter::JsonWriter(httpd_req_t *request): request(request) {}
+
+JsonWriter &JsonWriter::writeKey(std::string_view key) {
+	this->beginValue();
+	this->writeEscaped(key);
+	this->writeRaw(":", 1);
+	this->afterKey = true;
+	return *this;
+}
+
+JsonWriter &JsonWriter::beginObject() {
+	this->beginContainer('{');
+	return *this;
+}
+
+JsonWriter &JsonWriter::beginObject(std::string_view key) {
+	this->writeKey(key);
+	return this->beginObject();
+}
+
+JsonWriter &JsonWriter::endObject() {
+	this->endContainer('}');
+	return *this;
+}
+
+JsonWriter &JsonWriter::beginArray() {
+	this->beginContainer('[');
+	return *this;
+}
+
+JsonWriter &JsonWriter::beginArray(std::string_view key) {
+	this->writeKey(key);
+	return this->beginArray();
+}
+
+JsonWriter &JsonWriter::endArray() {
+	this->endContainer(']');
+	return *this;
+}
+
+JsonWriter &JsonWriter::writeString(std::string_view value) {
+	this->beginValue();
+	this->writeEscaped(value);
+	return *this;
+}
+
+JsonWriter &JsonWriter::writeString(std::string_view key, std::string_view value) {
+	this->writeKey(key);
+	return this->writeString(value);
+}
+
+JsonWriter &JsonWriter::writeNumber(double value) {
+	if (!std::isfinite(value)) {
+		return this->writeNull();
+	}
+	this->beginValue();
+	// Same precision as cJSON, 15 significant digits are used if they represent the value exactly
+	char number[32];
+	int length = snprintf(number, sizeof(number), "%1.15g", value);
+	if (strtod(number, nullptr) != value) {
+		length = snprintf(number, sizeof(number), "%1.17g", value);
+	}
+	this->writeRaw(number, length);
+	return *this;
+}
+
+JsonWriter &JsonWriter::writeNumber(std::string_view key, double value) {
+	this->writeKey(key);
+	return this->writeNumber(value);
+}
+
+JsonWriter &JsonWriter::writeInteger(int64_t value) {
+	this->beginValue();
+	char number[24];
+	int length = snprintf(number, sizeof(number), "%" PRId64, value);
+	this->writeRaw(number, length);
+	return *this;
+}
+
+JsonWriter &JsonWriter::writeInteger(std::string_view key, int64_t value) {
+	this->writeKey(key);
+	return this->writeInteger(value);
+}
+
+JsonWriter &JsonWriter::writeBool(bool value) {
+	this->beginValue();
+	if (value) {
+		this->writeRaw("true", 4);
+	} else {
+		this->writeRaw("false", 5);
+	}
+	return *this;
+}
+
+JsonWriter &JsonWriter::writeBool(std::string_view key, bool value) {
+	this->writeKey(key);
+	return this->writeBool(value);
+}
+
+JsonWriter &JsonWriter::writeNull() {
+	this->beginValue();
+	this->writeRaw("null", 4);
+	return *this;
+}
+
+JsonWriter &JsonWriter::writeNull(std::string_view key) {
+	this->writeKey(key);
+	return this->writeNull();
+}
+
+JsonWriter &JsonWriter::writeJson(const cJSON *item) {
+	if (item == nullptr || cJSON_IsNull(item) || cJSON_IsInvalid(item)) {
+		return this->writeNull();
+	}
+	if (cJSON_IsBool(item)) {
+		return this->writeBool(cJSON_IsTrue(item));
+	}
+	if (cJSON_IsNumber(item)) {
+		return this->writeNumber(item->valuedouble);
+	}
+	if (cJSON_IsString(item)) {
+		return this->writeString(item->valuestring);
+	}
+	if (cJSON_IsRaw(item)) {
+		this->beginValue();
+		this->writeRaw(item->valuestring, strlen(item->valuestring));
+		return *this;
+	}
+	bool object = cJSON_IsObject(item);
+	this->beginContainer(object ? '{' : '[');
+	for (const cJSON *child = item->child; child != nullptr; child = child->next) {
+		if (object) {
+			this->writeJson(child->string, child);
+		} else {
+			this->writeJson(child);
+		}
+	}
+	this->endContainer(object ? '}' : ']');
+	return *this;
+}
+
+JsonWriter &JsonWriter::writeJson(std::string_view key, const cJSON *item) {
+	this->writeKey(key);
+	return this->writeJson(item);
+}
+
+esp_err_t JsonWriter::finish() {
+	if (this->result != ESP_OK) {
+		return this->result;
+	}
+	if (!this->chunked) {
+		// Whole response fits into the buffer
+		this->result = httpd_resp_send(this->request, this->buffer, this->length);
+		return this->result;
+	}
+	this->flush();
+	if (this->result == ESP_OK) {
+		this->result = httpd_resp_send_chunk(this->request, nullptr, 0);
+	}
+	return this->result;
+}
+
+bool JsonWriter::hasFailed() const {
+	return this->result != ESP_OK;
+}
+
+void JsonWriter::beginValue() {
+	if (this->afterKey) {
+		this->afterKey = false;
+		return;
+	}
+	if (this->depth == 0) {
+		return;
+	}
+	uint32_t level = 1UL << this->depth;
+	if (this->nonEmpty & level) {
+		this->writeRaw(",", 1);
+	}
+	this->nonEmpty |= level;
+}
+
+void JsonWriter::beginContainer(char bracket) {
+	this->beginValue();
+	if (this->depth == JsonWriter::MAX_DEPTH) {
+		this->result = ESP_ERR_INVALID_STATE;
+		return;
+	}
+	this->writeRaw(&bracket, 1);
+	this->depth++;
+	this->nonEmpty &= ~(1UL << this->depth);
+}
+
+void JsonWriter::endContainer(char bracket) {
+	if (this->depth == 0) {
+		this->result = ESP_ERR_INVALID_STATE;
+		return;
+	}
+	this->writeRaw(&bracket, 1);
+	this->depth--;
+}
+
+void JsonWriter::writeEscaped(std::string_view value) {
+	this->writeRaw("\"", 1);
+	size_t start = 0;
+	for (size_t i = 0; i < value.length(); ++i) {
+		unsigned char character = value[i];
+		if (character >= 0x20 && character != '"' && character != '\\') {
+			continue;
+		}
+		this->writeRaw(value.data() + start, i - start);
+		start = i + 1;
+		char escaped[7];
+		int length = 2;
+		switch (character) {
+			case '"':
+			case '\\':
+				escaped[0] = '\\';
+				escaped[1] = character;
+				break;
+			case '\b':
+				memcpy(escaped, "\\b", 2);
+				break;
+			case '\f':
+				memcpy(escaped, "\\f", 2);
+				break;
+			case '\n':
+				memcpy(escaped, "\\n", 2);
+				break;
+			case '\r':
+				memcpy(escaped, "\\r", 2);
+				break;
+			case '\t':
+				memcpy(escaped, "\\t", 2);
+				break;
+			default:
+				length = snprintf(escaped, sizeof(escaped), "\\u%04x", character);
+				break;
+		}
+		this->writeRaw(escaped, length);
+	}
+	this->writeRaw(value.data() + start, value.length() - start);
+	this->writeRaw("\"", 1);
+}
+
+void JsonWriter::writeRaw(const char *data, size_t length) {
+	while (length > 0 && this->result == ESP_OK) {
+		size_t free = JsonWriter::BUFFER_SIZE - this->length;
+		if (free == 0) {
+			this->flush();
+			continue;
+		}
+		size_t part = length < free ? length : free;
+		memcpy(this->buffer + this->length, data, part);
+		this->length += part;
+		data += part;
+		length -= part;
+	}
+}
+
+void JsonWriter::flush() {
+	if (this->length == 0 || this->result != ESP_OK) {
+		return;
+	}
+	this->result = httpd_resp_send_chunk(this->request, this->buffer, this->length);
+	this->chunked = true;
+	this->length = 0;
+}
@@ -0,0 +1,569 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cJSON.h>
+
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+
+namespace {
+	char *duplicate(const char *string) {
+		size_t length = std::strlen(string) + 1;
+		char *copy = static_cast<char *>(std::malloc(length));
+		std::memcpy(copy, string, length);
+		return copy;
+	}
+
+	cJSON *createItem(int type) {
+		cJSON *item = static_cast<cJSON *>(std::calloc(1, sizeof(cJSON)));
+		item->type = type;
+		return item;
+	}
+
+	/**
+	 * Parser of the JSON document into cJSON items
+	 */
+	class Parser {
+		public:
+			Parser(const char *data, size_t length): position(data), end(data + length) {}
+
+			cJSON *parseValue(unsigned depth) {
+				this->skipWhitespace();
+				if (this->position == this->end || depth > 1000) {
+					return nullptr;
+				}
+				switch (*this->position) {
+					case '{':
+						return this->parseObject(depth);
+					case '[':
+						return this->parseArray(depth);
+					case '"': {
+						std::string value;
+						if (!this->parseString(value)) {
+							return nullptr;
+						}
+						return cJSON_CreateString(value.c_str());
+					}
+					case 't':
+						return this->parseLiteral("true", cJSON_True);
+					case 'f':
+						return this->parseLiteral("false", cJSON_False);
+					case 'n':
+						return this->parseLiteral("null", cJSON_NULL);
+					default:
+						return this->parseNumber();
+				}
+			}
+
+		private:
+			void skipWhitespace() {
+				while (this->position != this->end && static_cast<unsigned char>(*this->position) <= ' ') {
+					++this->position;
+				}
+			}
+
+			cJSON *parseLiteral(const char *literal, int type) {
+				size_t length = std::strlen(literal);
+				if (static_cast<size_t>(this->end - this->position) < length || std::strncmp(this->position, literal, length) != 0) {
+					return nullptr;
+				}
+				this->position += length;
+				cJSON *item = createItem(type);
+				item->valueint = type == cJSON_True;
+				return item;
+			}
+
+			cJSON *parseNumber() {
+				const char *start = this->position;
+				while (this->position != this->end && (std::isdigit(static_cast<unsigned char>(*this->position)) || std::strchr("+-.eE", *this->position) != nullptr)) {
+					++this->position;
+				}
+				if (start == this->position) {
+					return nullptr;
+				}
+				std::string number(start, this->position);
+				char *numberEnd = nullptr;
+				double value = std::strtod(number.c_str(), &numberEnd);
+				if (numberEnd != number.c_str() + number.size()) {
+					return nullptr;
+				}
+				return cJSON_CreateNumber(value);
+			}
+
+			bool parseHex(unsigned &value) {
+				if (this->end - this->position < 4) {
+					return false;
+				}
+				value = 0;
+				for (int i = 0; i < 4; ++i) {
+					char digit = *this->position++;
+					if (!std::isxdigit(static_cast<unsigned char>(digit))) {
+						return false;
+					}
+					value = value * 16 + (std::isdigit(static_cast<unsigned char>(digit)) ? digit - '0' : (std::tolower(digit) - 'a' + 10));
+				}
+				return true;
+			}
+
+			bool parseString(std::string &value) {
+				++this->position;
+				while (this->position != this->end && *this->position != '"') {
+					char character = *this->position++;
+					if (character != '\\') {
+						value += character;
+						continue;
+					}
+					if (this->position == this->end) {
+						return false;
+					}
+					character = *this->position++;
+					switch (character) {
+						case 'b': value += '\b'; break;
+						case 'f': value += '\f'; break;
+						case 'n': value += '\n'; break;
+						case 'r': value += '\r'; break;
+						case 't': value += '\t'; break;
+						case '"':
+						case '\\':
+						case '/':
+							value += character;
+							break;
+						case 'u': {
+							unsigned codePoint;
+							if (!this->parseHex(codePoint)) {
+								return false;
+							}
+							if (codePoint >= 0xd800 && codePoint <= 0xdbff) {
+								unsigned low;
+								if (this->end - this->position < 6 || this->position[0] != '\\' || this->position[1] != 'u') {
+									return false;
+								}
+								this->position += 2;
+								if (!this->parseHex(low) || low < 0xdc00 || low > 0xdfff) {
+									return false;
+								}
+								codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+							}
+							if (codePoint < 0x80) {
+								value += static_cast<char>(codePoint);
+							} else if (codePoint < 0x800) {
+								value += static_cast<char>(0xc0 | (codePoint >> 6));
+								value += static_cast<char>(0x80 | (codePoint & 0x3f));
+							} else if (codePoint < 0x10000) {
+								value += static_cast<char>(0xe0 | (codePoint >> 12));
+								value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+								value += static_cast<char>(0x80 | (codePoint & 0x3f));
+							} else {
+								value += static_cast<char>(0xf0 | (codePoint >> 18));
+								value += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+								value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+								value += static_cast<char>(0x80 | (codePoint & 0x3f));
+							}
+							break;
+						}
+						default:
+							return false;
+					}
+				}
+				if (this->position == this->end) {
+					return false;
+				}
+				++this->position;
+				return true;
+			}
+
+			cJSON *parseArray(unsigned depth) {
+				++this->position;
+				cJSON *array = cJSON_CreateArray();
+				this->skipWhitespace();
+				if (this->position != this->end && *this->position == ']') {
+					++this->position;
+					return array;
+				}
+				while (true) {
+					cJSON *item = this->parseValue(depth + 1);
+					if (item == nullptr) {
+						cJSON_Delete(array);
+						return nullptr;
+					}
+					cJSON_AddItemToArray(array, item);
+					this->skipWhitespace();
+					if (this->position != this->end && *this->position == ',') {
+						++this->position;
+						continue;
+					}
+					if (this->position != this->end && *this->position == ']') {
+						++this->position;
+						return array;
+					}
+					cJSON_Delete(array);
+					return nullptr;
+				}
+			}
+
+			cJSON *parseObject(unsigned depth) {
+				++this->position;
+				cJSON *object = cJSON_CreateObject();
+				this->skipWhitespace();
+				if (this->position != this->end && *this->position == '}') {
+					++this->position;
+					return object;
+				}
+				while (true) {
+					this->skipWhitespace();
+					std::string key;
+					if (this->position == this->end || *this->position != '"' || !this->parseString(key)) {
+						cJSON_Delete(object);
+						return nullptr;
+					}
+					this->skipWhitespace();
+					if (this->position == this->end || *this->position != ':') {
+						cJSON_Delete(object);
+						return nullptr;
+					}
+					++this->position;
+					cJSON *item = this->parseValue(depth + 1);
+					if (item == nullptr) {
+						cJSON_Delete(object);
+						return nullptr;
+					}
+					cJSON_AddItemToObject(object, key.c_str(), item);
+					this->skipWhitespace();
+					if (this->position != this->end && *this->position == ',') {
+						++this->position;
+						continue;
+					}
+					if (this->position != this->end && *this->position == '}') {
+						++this->position;
+						return object;
+					}
+					cJSON_Delete(object);
+					return nullptr;
+				}
+			}
+
+			/// Current position
+			const char *position;
+			/// End of the document
+			const char *end;
+	};
+
+	void printString(std::string &output, const char *value) {
+		output += '"';
+		for (const char *character = value; *character != '\0'; ++character) {
+			switch (*character) {
+				case '"': output += "\\\""; break;
+				case '\\': output += "\\\\"; break;
+				case '\b': output += "\\b"; break;
+				case '\f': output += "\\f"; break;
+				case '\n': output += "\\n"; break;
+				case '\r': output += "\\r"; break;
+				case '\t': output += "\\t"; break;
+				default:
+					if (static_cast<unsigned char>(*character) < ' ') {
+						char escaped[7];
+						std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(*character));
+						output += escaped;
+					} else {
+						output += *character;
+					}
+			}
+		}
+		output += '"';
+	}
+
+	void printNumber(std::string &output, const cJSON *item) {
+		char number[32];
+		double value = item->valuedouble;
+		if (std::isnan(value) || std::isinf(value)) {
+			output += "null";
+			return;
+		}
+		if (value == static_cast<double>(item->valueint)) {
+			std::snprintf(number, sizeof(number), "%d", item->valueint);
+		} else {
+			// Same precision selection as cJSON, the shortest representation which is parsed back to the same value
+			std::snprintf(number, sizeof(number), "%1.15g", value);
+			if (std::strtod(number, nullptr) != value) {
+				std::snprintf(number, sizeof(number), "%1.17g", value);
+			}
+		}
+		output += number;
+	}
+
+	void printValue(std::string &output, const cJSON *item) {
+		switch (item->type & 0xff) {
+			case cJSON_False:
+				output += "false";
+				break;
+			case cJSON_True:
+				output += "true";
+				break;
+			case cJSON_NULL:
+				output += "null";
+				break;
+			case cJSON_Number:
+				printNumber(output, item);
+				break;
+			case cJSON_String:
+				printString(output, item->valuestring != nullptr ? item->valuestring : "");
+				break;
+			case cJSON_Raw:
+				output += item->valuestring != nullptr ? item->valuestring : "";
+				break;
+			case cJSON_Array:
+			case cJSON_Object: {
+				bool object = (item->type & 0xff) == cJSON_Object;
+				output += object ? '{' : '[';
+				for (const cJSON *child = item->child; child != nullptr; child = child->next) {
+					if (child != item->child) {
+						output += ',';
+					}
+					if (object) {
+						printString(output, child->string != nullptr ? child->string : "");
+						output += ':';
+					}
+					printValue(output, child);
+				}
+				output += object ? '}' : ']';
+				break;
+			}
+		}
+	}
+
+	cJSON *addToObject(cJSON *object, const char *name, cJSON *item) {
+		if (!cJSON_AddItemToObject(object, name, item)) {
+			cJSON_Delete(item);
+			return nullptr;
+		}
+		return item;
+	}
+}
+
+cJSON *cJSON_ParseWithLength(const char *value, size_t length) {
+	if (value == nullptr) {
+		return nullptr;
+	}
+	Parser parser(value, length);
+	return parser.parseValue(0);
+}
+
+char *cJSON_PrintUnformatted(const cJSON *item) {
+	if (item == nullptr) {
+		return nullptr;
+	}
+	std::string output;
+	printValue(output, item);
+	return duplicate(output.c_str());
+}
+
+void cJSON_Delete(cJSON *item) {
+	while (item != nullptr) {
+		cJSON *next = item->next;
+		cJSON_Delete(item->child);
+		std::free(item->valuestring);
+		std::free(item->string);
+		std::free(item);
+		item = next;
+	}
+}
+
+void cJSON_free(void *pointer) {
+	std::free(pointer);
+}
+
+cJSON *cJSON_CreateNumber(double number) {
+	cJSON *item = createItem(cJSON_Number);
+	item->valuedouble = number;
+	if (number >= INT_MAX) {
+		item->valueint = INT_MAX;
+	} else if (number <= static_cast<double>(INT_MIN)) {
+		item->valueint = INT_MIN;
+	} else {
+		item->valueint = static_cast<int>(number);
+	}
+	return item;
+}
+
+cJSON *cJSON_CreateString(const char *string) {
+	cJSON *item = createItem(cJSON_String);
+	item->valuestring = duplicate(string);
+	return item;
+}
+
+cJSON *cJSON_CreateArray() {
+	return createItem(cJSON_Array);
+}
+
+cJSON *cJSON_CreateObject() {
+	return createItem(cJSON_Object);
+}
+
+int cJSON_GetArraySize(const cJSON *array) {
+	int size = 0;
+	if (array != nullptr) {
+		for (const cJSON *child = array->child; child != nullptr; child = child->next) {
+			++size;
+		}
+	}
+	return size;
+}
+
+cJSON *cJSON_GetArrayItem(const cJSON *array, int index) {
+	if (array == nullptr || index < 0) {
+		return nullptr;
+	}
+	cJSON *child = array->child;
+	while (child != nullptr && index-- > 0) {
+		child = child->next;
+	}
+	return child;
+}
+
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *string) {
+	if (object == nullptr || string == nullptr) {
+		return nullptr;
+	}
+	// Object keys are compared case-insensitively like in cJSON
+	for (cJSON *child = object->child; child != nullptr; child = child->next) {
+		if (child->string != nullptr && strcasecmp(child->string, string) == 0) {
+			return child;
+		}
+	}
+	return nullptr;
+}
+
+cJSON_bool cJSON_IsInvalid(const cJSON *item) {
+	return item != nullptr && (item->type & 0xff) == cJSON_Invalid;
+}
+
+cJSON_bool cJSON_IsFalse(const cJSON *item) {
+	return item != nullptr && (item->type & 0xff) == cJSON_False;
+}
+
+cJSON_bool cJSON_IsTrue(const cJSON *item) {
+	return item != nullptr && (item->type & 0xff) == cJSON_True;
+}
+
+cJSON_bool cJSON_IsBool(const cJSON *item) {
+	return item != nullptr && (item->type & (cJSON_True | cJSON_False)) != 0;
+}
+
+cJSON_bool cJSON_IsNull(const cJSON *item) {
+	return item != nullptr && (item->type & 0xff) == cJSON_NULL;
+}
+
+cJSON_bool cJSON_IsNumber(const cJSON *item) {
+	return item != nullptr && (item->type & 0xff) == cJSON_Number;
+}
+
+cJSON_bool cJSON_IsString(const cJSON *item) {
+	return item != nullptr && (item->type & 0xff) == cJSON_String;
+}
+
+cJSON_bool cJSON_IsArray(const cJSON *item) {
+	return item != nullptr && (item->type & 0xff) == cJSON_Array;
+}
+
+cJSON_bool cJSON_IsObject(const cJSON *item) {
+	return item != nullptr && (item->type & 0xff) == cJSON_Object;
+}
+
+cJSON_bool cJSON_IsRaw(const cJSON *item) {
+	return item != nullptr && (item->type & 0xff) == cJSON_Raw;
+}
+
+cJSON_bool cJSON_AddItemToArray(cJSON *array, cJSON *item) {
+	if (array == nullptr || item == nullptr || array == item) {
+		return false;
+	}
+	if (array->child == nullptr) {
+		array->child = item;
+		item->prev = item;
+		item->next = nullptr;
+		return true;
+	}
+	// The first child keeps the last one in prev like in cJSON
+	cJSON *last = array->child->prev;
+	last->next = item;
+	item->prev = last;
+	item->next = nullptr;
+	array->child->prev = item;
+	return true;
+}
+
+cJSON_bool cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item) {
+	if (object == nullptr || string == nullptr || item == nullptr || object == item) {
+		return false;
+	}
+	std::free(item->string);
+	item->string = duplicate(string);
+	return cJSON_AddItemToArray(object, item);
+}
+
+cJSON *cJSON_DetachItemFromObject(cJSON *object, const char *string) {
+	cJSON *item = cJSON_GetObjectItem(object, string);
+	if (item == nullptr) {
+		return nullptr;
+	}
+	if (item != object->child) {
+		item->prev->next = item->next;
+	}
+	if (item->next != nullptr) {
+		item->next->prev = item->prev;
+	}
+	if (item == object->child) {
+		object->child = item->next;
+	} else if (item->next == nullptr) {
+		object->child->prev = item->prev;
+	}
+	item->prev = nullptr;
+	item->next = nullptr;
+	return item;
+}
+
+cJSON *cJSON_AddTrueToObject(cJSON *object, const char *name) {
+	return addToObject(object, name, createItem(cJSON_True));
+}
+
+cJSON *cJSON_AddFalseToObject(cJSON *object, const char *name) {
+	return addToObject(object, name, createItem(cJSON_False));
+}
+
+cJSON *cJSON_AddBoolToObject(cJSON *object, const char *name, cJSON_bool boolean) {
+	return addToObject(object, name, createItem(boolean ? cJSON_True : cJSON_False));
+}
+
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number) {
+	return addToObject(object, name, cJSON_CreateNumber(number));
+}
+
+cJSON *cJSON_AddStringToObject(cJSON *object, const char *name, const char *string) {
+	return addToObject(object, name, cJSON_CreateString(string));
+}
+
+cJSON *cJSON_AddObjectToObject(cJSON *object, const char *name) {
+	return addToObject(object, name, cJSON_CreateObject());
+}
+
+cJSON *cJSON_AddArrayToObject(cJSON *object, const char *name) {
+	return addToObject(object, name, cJSON_CreateArray());
+}
@@ -0,0 +1,263 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fakeEsp.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include <esp_crt_bundle.h>
+#include <esp_err.h>
+#include <esp_http_server.h>
+#include <esp_log.h>
+#include <esp_mac.h>
+#include <esp_partition.h>
+#include <esp_random.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <nvs_flash.h>
+#include <nvs_handle.hpp>
+
+int64_t FakeEsp::time = 1000000;
+uint8_t FakeEsp::mac[6] = {0x24, 0x6f, 0x28, 0x00, 0x00, 0x01};
+std::map<gpio_num_t, uint32_t> FakeEsp::gpioLevels = {};
+std::map<int, float> FakeEsp::currents = {};
+std::map<int, float> FakeEsp::voltages = {};
+esp_app_desc_t FakeEsp::appDescription = {
+	.magic_word = 0xabcd5432,
+	.secure_version = 0,
+	.version = "v1.0.0-host",
+	.project_name = "sbc-pdu",
+	.time = "00:00:00",
+	.date = "Jan  1 2024",
+	.idf_ver = "v5.2.2",
+	.app_elf_sha256 = {},
+};
+bool FakeEsp::verbose = std::getenv("HOST_TEST_VERBOSE") != nullptr;
+
+void FakeEsp::reset() {
+	FakeEsp::time = 1000000;
+	const uint8_t mac[6] = {0x24, 0x6f, 0x28, 0x00, 0x00, 0x01};
+	std::memcpy(FakeEsp::mac, mac, sizeof(mac));
+	FakeEsp::gpioLevels.clear();
+	FakeEsp::currents.clear();
+	FakeEsp::voltages.clear();
+	nvs::storage().clear();
+}
+
+void FakeEsp::advance(int64_t microseconds) {
+	FakeEsp::time += microseconds;
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+	switch (code) {
+		case ESP_OK:
+			return "ESP_OK";
+		case ESP_FAIL:
+			return "ESP_FAIL";
+		case ESP_ERR_NO_MEM:
+			return "ESP_ERR_NO_MEM";
+		case ESP_ERR_INVALID_ARG:
+			return "ESP_ERR_INVALID_ARG";
+		case ESP_ERR_INVALID_STATE:
+			return "ESP_ERR_INVALID_STATE";
+		case ESP_ERR_NOT_FOUND:
+			return "ESP_ERR_NOT_FOUND";
+		case ESP_ERR_NVS_NOT_FOUND:
+			return "ESP_ERR_NVS_NOT_FOUND";
+		default:
+			return "UNKNOWN ERROR";
+	}
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+	if (!FakeEsp::verbose) {
+		return;
+	}
+	static const char levels[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+	std::fprintf(stderr, "%c (%lld) %s: ", levels[level], static_cast<long long>(FakeEsp::time / 1000), tag);
+	va_list arguments;
+	va_start(arguments, format);
+	std::vfprintf(stderr, format, arguments);
+	va_end(arguments);
+	std::fputc('\n', stderr);
+}
+
+void esp_log_level_set(const char *, esp_log_level_t) {}
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func) {
+	return func;
+}
+
+int64_t esp_timer_get_time() {
+	return FakeEsp::time;
+}
+
+uint32_t esp_random() {
+	static std::mt19937 generator(42);
+	return generator();
+}
+
+void esp_fill_random(void *buffer, size_t length) {
+	uint8_t *bytes = static_cast<uint8_t *>(buffer);
+	for (size_t i = 0; i < length; ++i) {
+		bytes[i] = static_cast<uint8_t>(esp_random());
+	}
+}
+
+void esp_restart() {
+	std::abort();
+}
+
+size_t esp_get_free_heap_size() {
+	return 200000;
+}
+
+size_t esp_get_minimum_free_heap_size() {
+	return 150000;
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t) {
+	std::memcpy(mac, FakeEsp::mac, sizeof(FakeEsp::mac));
+	return ESP_OK;
+}
+
+esp_err_t esp_crt_bundle_attach(void *) {
+	return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *request, const char *buffer, ssize_t length) {
+	request->response.assign(buffer, length == HTTPD_RESP_USE_STRLEN ? std::strlen(buffer) : length);
+	request->completed = true;
+	return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *request, const char *buffer, ssize_t length) {
+	if (buffer == nullptr) {
+		request->completed = true;
+		return ESP_OK;
+	}
+	request->response.append(buffer, length == HTTPD_RESP_USE_STRLEN ? std::strlen(buffer) : length);
+	return ESP_OK;
+}
+
+const esp_app_desc_t *esp_app_get_description() {
+	return &FakeEsp::appDescription;
+}
+
+esp_err_t gpio_config(const gpio_config_t *) {
+	return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level) {
+	FakeEsp::gpioLevels.insert_or_assign(pin, level);
+	return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin) {
+	auto level = FakeEsp::gpioLevels.find(pin);
+	// Inputs are pulled up, the alert pins are active low
+	return level != FakeEsp::gpioLevels.end() ? level->second : 1;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t, gpio_isr_t, void *) {
+	return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t) {
+	return ESP_OK;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t, esp_partition_subtype_t, const char *) {
+	return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *, size_t, void *, size_t) {
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *, size_t, const void *, size_t) {
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *, size_t, size_t) {
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *, size_t, size_t, esp_partition_mmap_memory_t, const void **, esp_partition_mmap_handle_t *) {
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t) {}
+
+esp_err_t nvs_flash_init() {
+	return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase() {
+	nvs::storage().clear();
+	return ESP_OK;
+}
+
+std::map<std::string, std::map<std::string, nvs::item_t>> &nvs::storage() {
+	static std::map<std::string, std::map<std::string, nvs::item_t>> storage;
+	return storage;
+}
+
+esp_err_t nvs::NVSHandle::get_item_size(nvs::ItemType type, const char *key, size_t &size) {
+	auto item = this->items.find(key);
+	if (item == this->items.end()) {
+		return ESP_ERR_NVS_NOT_FOUND;
+	}
+	if (type != nvs::ItemType::SZ || !std::holds_alternative<std::string>(item->second)) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	size = std::get<std::string>(item->second).size() + 1;
+	return ESP_OK;
+}
+
+esp_err_t nvs::NVSHandle::get_string(const char *key, char *value, size_t size) {
+	size_t length;
+	esp_err_t result = this->get_item_size(nvs::ItemType::SZ, key, length);
+	if (result != ESP_OK) {
+		return result;
+	}
+	if (length > size) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	std::memcpy(value, std::get<std::string>(this->items.at(key)).c_str(), length);
+	return ESP_OK;
+}
+
+esp_err_t nvs::NVSHandle::set_string(const char *key, const char *value) {
+	this->items.insert_or_assign(key, std::string(value));
+	return ESP_OK;
+}
+
+esp_err_t nvs::NVSHandle::erase_item(const char *key) {
+	return this->items.erase(key) > 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs::NVSHandle::commit() {
+	return ESP_OK;
+}
+
+std::unique_ptr<nvs::NVSHandle> nvs::open_nvs_handle(const char *nameSpace, nvs_open_mode_t, esp_err_t *result) {
+	*result = ESP_OK;
+	return std::make_unique<nvs::NVSHandle>(nameSpace);
+}
@@ -0,0 +1,312 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fakeBroker.h"
+
+#include <algorithm>
+#include <map>
+
+#include "network/mqttTlsTransport.h"
+#include "network/mqttTopicFilter.h"
+
+namespace {
+	/**
+	 * Queued client event
+	 */
+	struct PendingEvent {
+		/// Client
+		esp_mqtt_client_handle_t client;
+		/// Event ID
+		esp_mqtt_event_id_t id;
+		/// Message ID
+		int msgId;
+		/// Topic of the received message
+		std::string topic;
+		/// Payload of the received message
+		std::string data;
+		/// Retain flag of the received message
+		bool retain;
+	};
+
+	/**
+	 * Message waiting for the acknowledgement in the client outbox
+	 */
+	struct OutboxMessage {
+		/// Message ID
+		int msgId;
+		/// Message
+		FakeBroker::Message message;
+	};
+
+	/// Queued client events
+	std::deque<PendingEvent> events;
+	/// Retained messages <topic, message>
+	std::map<std::string, FakeBroker::Message> retained;
+}
+
+/**
+ * ESP-MQTT client connected to the fake broker
+ */
+struct esp_mqtt_client {
+	/// Broker URI
+	std::string uri;
+	/// Client ID
+	std::string clientId;
+	/// Outbox memory limit in bytes, 0 if unlimited
+	size_t outboxLimit;
+	/// Event handler
+	esp_event_handler_t handler = nullptr;
+	/// Event handler arguments
+	void *arguments = nullptr;
+	/// Is the client started?
+	bool started = false;
+	/// Is the client connected?
+	bool connected = false;
+	/// Subscriptions of the current session
+	std::vector<std::pair<MqttTopicFilter, int>> subscriptions;
+	/// Messages with QoS > 0 waiting for the acknowledgement
+	std::deque<OutboxMessage> outbox;
+	/// Last message ID
+	int lastMsgId = 0;
+};
+
+namespace {
+	/// All created clients
+	std::vector<esp_mqtt_client_handle_t> clients;
+
+	int nextMsgId(esp_mqtt_client_handle_t client) {
+		client->lastMsgId = client->lastMsgId % 65535 + 1;
+		return client->lastMsgId;
+	}
+
+	size_t getOutboxSize(esp_mqtt_client_handle_t client) {
+		size_t size = 0;
+		for (const OutboxMessage &message : client->outbox) {
+			size += message.message.topic.size() + message.message.data.size();
+		}
+		return size;
+	}
+
+	void route(const FakeBroker::Message &message) {
+		FakeBroker::published.push_back(message);
+		if (message.retain) {
+			if (message.data.empty()) {
+				retained.erase(message.topic);
+			} else {
+				retained.insert_or_assign(message.topic, message);
+			}
+		}
+		for (esp_mqtt_client_handle_t client : clients) {
+			if (!client->connected) {
+				continue;
+			}
+			bool subscribed = std::any_of(client->subscriptions.begin(), client->subscriptions.end(), [&message](const auto &subscription) {
+				return subscription.first.match(message.topic);
+			});
+			if (subscribed) {
+				events.push_back({client, MQTT_EVENT_DATA, 0, message.topic, message.data, false});
+			}
+		}
+	}
+
+	void send(esp_mqtt_client_handle_t client, int msgId, const FakeBroker::Message &message) {
+		route(message);
+		if (message.qos > 0 && FakeBroker::acknowledge) {
+			events.push_back({client, MQTT_EVENT_PUBLISHED, msgId, "", "", false});
+		}
+	}
+
+	void connect(esp_mqtt_client_handle_t client) {
+		client->connected = true;
+		// Clean session, the client subscribes again after the connection
+		client->subscriptions.clear();
+		events.push_back({client, MQTT_EVENT_CONNECTED, 0, "", "", false});
+		for (const OutboxMessage &message : client->outbox) {
+			send(client, message.msgId, message.message);
+		}
+	}
+
+	esp_mqtt_client_handle_t findClient(Mqtt *mqtt) {
+		auto client = std::find_if(clients.begin(), clients.end(), [mqtt](esp_mqtt_client_handle_t client) {
+			return client->arguments == mqtt;
+		});
+		return client != clients.end() ? *client : nullptr;
+	}
+}
+
+std::vector<FakeBroker::Message> FakeBroker::published = {};
+bool FakeBroker::acknowledge = true;
+
+size_t FakeBroker::process() {
+	size_t count = 0;
+	while (!events.empty()) {
+		PendingEvent pending = std::move(events.front());
+		events.pop_front();
+		esp_mqtt_client_handle_t client = pending.client;
+		if (pending.id == MQTT_EVENT_PUBLISHED) {
+			std::erase_if(client->outbox, [&pending](const OutboxMessage &message) {
+				return message.msgId == pending.msgId;
+			});
+		}
+		if (client->handler == nullptr || (pending.id != MQTT_EVENT_DISCONNECTED && !client->connected)) {
+			continue;
+		}
+		esp_mqtt_event_t event = {};
+		event.event_id = pending.id;
+		event.client = client;
+		event.msg_id = pending.msgId;
+		event.topic = pending.topic.data();
+		event.topic_len = static_cast<int>(pending.topic.size());
+		event.data = pending.data.data();
+		event.data_len = static_cast<int>(pending.data.size());
+		event.total_data_len = event.data_len;
+		event.retain = pending.retain;
+		event.protocol_ver = MQTT_PROTOCOL_V_3_1_1;
+		client->handler(client->arguments, "MQTT_EVENTS", pending.id, &event);
+		++count;
+	}
+	return count;
+}
+
+void FakeBroker::inject(const std::string &topic, const std::string &data, bool retain) {
+	route({"", topic, data, 0, retain});
+}
+
+void FakeBroker::disconnect(Mqtt *mqtt) {
+	esp_mqtt_client_handle_t client = findClient(mqtt);
+	if (client == nullptr || !client->connected) {
+		return;
+	}
+	client->connected = false;
+	client->subscriptions.clear();
+	events.push_back({client, MQTT_EVENT_DISCONNECTED, 0, "", "", false});
+}
+
+void FakeBroker::reconnect(Mqtt *mqtt) {
+	esp_mqtt_client_handle_t client = findClient(mqtt);
+	if (client == nullptr || client->connected || !client->started) {
+		return;
+	}
+	connect(client);
+}
+
+std::vector<FakeBroker::Message> FakeBroker::find(const std::string &filter) {
+	MqttTopicFilter topicFilter(filter);
+	std::vector<FakeBroker::Message> messages;
+	std::copy_if(FakeBroker::published.begin(), FakeBroker::published.end(), std::back_inserter(messages), [&topicFilter](const FakeBroker::Message &message) {
+		return topicFilter.match(message.topic);
+	});
+	return messages;
+}
+
+const FakeBroker::Message *FakeBroker::last(const std::string &topic) {
+	auto message = std::find_if(FakeBroker::published.rbegin(), FakeBroker::published.rend(), [&topic](const FakeBroker::Message &message) {
+		return message.topic == topic;
+	});
+	return message != FakeBroker::published.rend() ? &*message : nullptr;
+}
+
+void FakeBroker::clear() {
+	FakeBroker::published.clear();
+	retained.clear();
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config) {
+	esp_mqtt_client_handle_t client = new esp_mqtt_client();
+	client->uri = config->broker.address.uri != nullptr ? config->broker.address.uri : "";
+	client->clientId = config->credentials.client_id != nullptr ? config->credentials.client_id : "";
+	client->outboxLimit = config->outbox.limit;
+	clients.push_back(client);
+	return client;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client) {
+	if (client == nullptr || client->started) {
+		return ESP_FAIL;
+	}
+	client->started = true;
+	connect(client);
+	return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t, esp_event_handler_t handler, void *arguments) {
+	client->handler = handler;
+	client->arguments = arguments;
+	return ESP_OK;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int length, int qos, int retain) {
+	if (length == 0 && data != nullptr) {
+		length = static_cast<int>(std::char_traits<char>::length(data));
+	}
+	// Clients are created only by Mqtt, which registers itself as the event handler argument
+	const std::string &name = static_cast<Mqtt *>(client->arguments)->getName();
+	FakeBroker::Message message = {name, topic, std::string(data != nullptr ? data : "", length), qos, retain != 0};
+	if (qos == 0) {
+		if (!client->connected) {
+			return -1;
+		}
+		route(message);
+		return 0;
+	}
+	if (client->outboxLimit != 0 && getOutboxSize(client) + message.topic.size() + message.data.size() > client->outboxLimit) {
+		return -2;
+	}
+	int msgId = nextMsgId(client);
+	client->outbox.push_back({msgId, message});
+	if (client->connected) {
+		send(client, msgId, message);
+	}
+	return msgId;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos) {
+	if (!client->connected) {
+		return -1;
+	}
+	MqttTopicFilter filter(topic);
+	client->subscriptions.emplace_back(filter, qos);
+	for (const auto &[retainedTopic, message] : retained) {
+		if (filter.match(retainedTopic)) {
+			events.push_back({client, MQTT_EVENT_DATA, 0, message.topic, message.data, true});
+		}
+	}
+	return nextMsgId(client);
+}
+
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char *topic) {
+	if (!client->connected) {
+		return -1;
+	}
+	std::erase_if(client->subscriptions, [topic](const auto &subscription) {
+		return subscription.first.getFilter() == topic;
+	});
+	return nextMsgId(client);
+}
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client) {
+	return static_cast<int>(getOutboxSize(client));
+}
+
+// TLS connections are not made by the fake broker, the transport only has to be linked
+MqttTlsTransport::MqttTlsTransport(const std::string &certificate, bool resumeSessions): certificate(certificate), resumeSessions(resumeSessions) {}
+
+esp_transport_handle_t MqttTlsTransport::getHandle() const {
+	return this->handle;
+}
+
+void MqttTlsTransport::setOnHandshake(const MqttTlsTransport::handshake_callback_t &onHandshake) {
+	this->onHandshake = onHandshake;
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <mqtt_client.h>
+
+#include "network/mqtt.h"
+
+/**
+ * In-memory MQTT broker serving the ESP-MQTT clients of the tested Mqtt instances
+ *
+ * Clients are connected by esp_mqtt_client_start(), events are queued and run by process() in the calling thread,
+ * so the event handlers run the same way as in the ESP-MQTT client task. Every published message is recorded.
+ */
+class FakeBroker {
+	public:
+		/**
+		 * Message published to the broker
+		 */
+		struct Message {
+			/// Name of the publishing client, empty for injected messages
+			std::string client;
+			/// Topic
+			std::string topic;
+			/// Payload
+			std::string data;
+			/// QoS
+			int qos;
+			/// Retain flag
+			bool retain;
+		};
+
+		/**
+		 * Runs the queued client events until there are none left
+		 * @return Number of run events
+		 */
+		static size_t process();
+
+		/**
+		 * Publishes the message from an external client
+		 * @param topic Topic
+		 * @param data Payload
+		 * @param retain Retain flag
+		 */
+		static void inject(const std::string &topic, const std::string &data, bool retain = false);
+
+		/**
+		 * Drops the connection of the client, unacknowledged messages with QoS > 0 are kept in its outbox
+		 * @param mqtt MQTT client
+		 */
+		static void disconnect(Mqtt *mqtt);
+
+		/**
+		 * Connects the client again and resends its outbox
+		 * @param mqtt MQTT client
+		 */
+		static void reconnect(Mqtt *mqtt);
+
+		/**
+		 * Returns messages published to topics matching the filter
+		 * @param filter Topic filter
+		 * @return Matching messages in the order of publishing
+		 */
+		static std::vector<FakeBroker::Message> find(const std::string &filter);
+
+		/**
+		 * Returns the last message published to the topic
+		 * @param topic Topic
+		 * @return Last message, nullptr if nothing was published to the topic
+		 */
+		static const FakeBroker::Message *last(const std::string &topic);
+
+		/**
+		 * Forgets published and retained messages, client connections are kept
+		 */
+		static void clear();
+
+		/// All published messages
+		static std::vector<FakeBroker::Message> published;
+		/// Acknowledge messages with QoS > 0 (MQTT_EVENT_PUBLISHED) when they are delivered
+		static bool acknowledge;
+};
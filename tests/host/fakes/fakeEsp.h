@@ -0,0 +1,55 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+#include <esp_app_desc.h>
+#include <driver/gpio.h>
+
+/**
+ * State of the ESP-IDF stand-ins shared by the host tests
+ */
+class FakeEsp {
+	public:
+		/**
+		 * Clears NVS, GPIO levels and INA3221 readings, resets the time and the MAC address
+		 * NVS handles opened before the reset must not be used afterwards.
+		 */
+		static void reset();
+
+		/**
+		 * Advances the time returned by esp_timer_get_time()
+		 * @param microseconds Time step in microseconds
+		 */
+		static void advance(int64_t microseconds);
+
+		/// Time returned by esp_timer_get_time() in microseconds
+		static int64_t time;
+		/// MAC address returned by esp_read_mac()
+		static uint8_t mac[6];
+		/// Levels of GPIO pins set by gpio_set_level() <pin, level>
+		static std::map<gpio_num_t, uint32_t> gpioLevels;
+		/// Currents returned by Ina3221::readCurrent() in milliamps <channel, current>
+		static std::map<int, float> currents;
+		/// Voltages returned by Ina3221::readBusVoltage() in volts <channel, voltage>
+		static std::map<int, float> voltages;
+		/// Application description returned by esp_app_get_description()
+		static esp_app_desc_t appDescription;
+		/// Print log messages to stderr
+		static bool verbose;
+};
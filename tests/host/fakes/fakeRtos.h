@@ -0,0 +1,60 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+
+/**
+ * State of the FreeRTOS stand-ins shared by the host tests
+ *
+ * Created tasks are not started, they are recorded and run() runs them in the calling thread until they delete themselves.
+ * Delays of the tasks advance the time of FakeEsp instead of waiting.
+ */
+class FakeRtos {
+	public:
+		/**
+		 * Created task
+		 */
+		struct Task {
+			/// Task function
+			TaskFunction_t function;
+			/// Task name
+			std::string name;
+			/// Task parameters
+			void *parameters;
+		};
+
+		/**
+		 * Runs the oldest created task with the name until it deletes itself, tasks running forever must not be run
+		 * @param name Task name
+		 * @return true if the task was run, false if there is no such task
+		 */
+		static bool run(const std::string &name);
+
+		/**
+		 * Forgets the created tasks and the delay callback
+		 */
+		static void reset();
+
+		/// Created tasks which were not run yet
+		static std::vector<FakeRtos::Task> tasks;
+		/// Called after every delay, the time is already advanced
+		static std::function<void()> onDelay;
+};
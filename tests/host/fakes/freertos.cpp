@@ -0,0 +1,225 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "fakeEsp.h"
+#include "fakeRtos.h"
+
+/**
+ * Counting semaphore, FreeRTOS mutexes and binary semaphores are semaphores with one token
+ */
+struct FakeSemaphore {
+	/// Mutex protecting the count
+	std::mutex mutex;
+	/// Signalled when a token is given
+	std::condition_variable given;
+	/// Available tokens
+	UBaseType_t count;
+	/// Maximal number of tokens
+	UBaseType_t maximum;
+};
+
+/**
+ * Queue of fixed size items
+ */
+struct FakeQueue {
+	/// Items
+	std::deque<std::vector<uint8_t>> items;
+	/// Maximal number of items
+	UBaseType_t length;
+	/// Item size
+	UBaseType_t itemSize;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+	return new FakeSemaphore{.mutex = {}, .given = {}, .count = 1, .maximum = 1};
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+	return new FakeSemaphore{.mutex = {}, .given = {}, .count = 0, .maximum = 1};
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maximum, UBaseType_t initial) {
+	return new FakeSemaphore{.mutex = {}, .given = {}, .count = initial, .maximum = maximum};
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+	std::unique_lock lock(semaphore->mutex);
+	auto available = [semaphore]() {
+		return semaphore->count > 0;
+	};
+	if (ticks == portMAX_DELAY) {
+		semaphore->given.wait(lock, available);
+	} else if (!semaphore->given.wait_for(lock, std::chrono::milliseconds(ticks), available)) {
+		return pdFALSE;
+	}
+	--semaphore->count;
+	return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+	std::lock_guard lock(semaphore->mutex);
+	if (semaphore->count >= semaphore->maximum) {
+		return pdFALSE;
+	}
+	++semaphore->count;
+	semaphore->given.notify_one();
+	return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+	delete semaphore;
+}
+
+/**
+ * Thrown by vTaskDelete() to end the task run by FakeRtos::run()
+ */
+struct FakeTaskDeleted {};
+
+std::vector<FakeRtos::Task> FakeRtos::tasks = {};
+std::function<void()> FakeRtos::onDelay = nullptr;
+
+/// Number of nested tasks run by FakeRtos::run()
+static int runningTasks = 0;
+
+bool FakeRtos::run(const std::string &name) {
+	auto task = std::find_if(FakeRtos::tasks.begin(), FakeRtos::tasks.end(), [&name](const FakeRtos::Task &item) {
+		return item.name == name;
+	});
+	if (task == FakeRtos::tasks.end()) {
+		return false;
+	}
+	FakeRtos::Task running = *task;
+	FakeRtos::tasks.erase(task);
+	++runningTasks;
+	try {
+		running.function(running.parameters);
+	} catch (const FakeTaskDeleted &) {}
+	--runningTasks;
+	return true;
+}
+
+void FakeRtos::reset() {
+	FakeRtos::tasks.clear();
+	FakeRtos::onDelay = nullptr;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t, void *parameters, UBaseType_t, TaskHandle_t *handle) {
+	// Tasks are not started, the tests run the recorded tasks they need by FakeRtos::run()
+	FakeRtos::tasks.push_back({function, name, parameters});
+	if (handle != nullptr) {
+		*handle = nullptr;
+	}
+	return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth, void *parameters, UBaseType_t priority, TaskHandle_t *handle, BaseType_t) {
+	return xTaskCreate(function, name, stackDepth, parameters, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+	if (task == nullptr && runningTasks > 0) {
+		throw FakeTaskDeleted();
+	}
+}
+
+void vTaskDelay(TickType_t ticks) {
+	FakeEsp::advance(static_cast<int64_t>(ticks) * 1000 * portTICK_PERIOD_MS);
+	if (FakeRtos::onDelay) {
+		FakeRtos::onDelay();
+	}
+}
+
+void vTaskDelayUntil(TickType_t *previousWake, TickType_t increment) {
+	*previousWake += increment;
+	int64_t wake = static_cast<int64_t>(*previousWake) * 1000 * portTICK_PERIOD_MS;
+	if (FakeEsp::time < wake) {
+		FakeEsp::time = wake;
+	}
+	if (FakeRtos::onDelay) {
+		FakeRtos::onDelay();
+	}
+}
+
+TickType_t xTaskGetTickCount() {
+	return static_cast<TickType_t>(FakeEsp::time / 1000 / portTICK_PERIOD_MS);
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) {
+	return 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t) {
+	return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) {
+	return 0;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+	return new FakeQueue{.items = {}, .length = length, .itemSize = itemSize};
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t) {
+	if (queue->items.size() >= queue->length) {
+		return pdFALSE;
+	}
+	const uint8_t *bytes = static_cast<const uint8_t *>(item);
+	queue->items.emplace_back(bytes, bytes + queue->itemSize);
+	return pdTRUE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *) {
+	return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t) {
+	if (queue->items.empty()) {
+		return pdFALSE;
+	}
+	std::memcpy(item, queue->items.front().data(), queue->itemSize);
+	queue->items.pop_front();
+	return pdTRUE;
+}
+
+EventGroupHandle_t xEventGroupCreate() {
+	return new EventBits_t(0);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+	return *static_cast<EventBits_t *>(group) |= bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear, BaseType_t, TickType_t) {
+	EventBits_t current = *static_cast<EventBits_t *>(group);
+	if (clear) {
+		*static_cast<EventBits_t *>(group) &= ~bits;
+	}
+	return current;
+}
@@ -0,0 +1,29 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "ina3221.h"
+
+#include "fakeEsp.h"
+
+// Measurements are set by the tests, the I2C bus is not used
+Ina3221::Ina3221(I2C *i2c, ina3221_address_t address): i2c(i2c), address(address) {}
+
+float Ina3221::readBusVoltage(ina3221_channel_t channel) {
+	return FakeEsp::voltages[channel];
+}
+
+float Ina3221::readCurrent(ina3221_channel_t channel, float) {
+	return FakeEsp::currents[channel];
+}
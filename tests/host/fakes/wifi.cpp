@@ -0,0 +1,23 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "network/wifi.h"
+
+// Only the MAC address of the WiFi station is used by the tested sources, the station itself is not started
+std::string Wifi::getPrimaryMacAddress(const std::string &separator) {
+	uint8_t buffer[6] = {0, 0, 0, 0, 0, 0};
+	ESP_ERROR_CHECK(esp_read_mac(buffer, ESP_MAC_WIFI_STA));
+	return InterfaceUtils::macToString(buffer, separator);
+}
@@ -0,0 +1,113 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "testing.h"
+#include "utils/jsonReader.h"
+
+/// Extracted values
+static struct {
+	bool enabled;
+	int32_t output;
+	double limit;
+	char name[8];
+} values;
+
+/**
+ * Reads the document fed in parts of the given size
+ * @param document JSON document
+ * @param chunk Part size
+ * @return Execution status
+ */
+static esp_err_t read(std::string_view document, size_t chunk = SIZE_MAX) {
+	values = {};
+	jsonField_t fields[] = {
+		JsonReader::boolField("enabled", &values.enabled, false),
+		JsonReader::integerField("output", &values.output),
+		JsonReader::numberField("limit", &values.limit, false),
+		JsonReader::stringField("name", values.name, sizeof(values.name), false),
+	};
+	JsonReader reader(fields, sizeof(fields) / sizeof(fields[0]));
+	for (size_t offset = 0; offset < document.size(); offset += chunk) {
+		size_t length = std::min(chunk, document.size() - offset);
+		if (reader.feed(document.data() + offset, length) != ESP_OK) {
+			return ESP_ERR_INVALID_ARG;
+		}
+	}
+	esp_err_t result = reader.finish();
+	CHECK((result == ESP_OK) == (std::strlen(reader.getError()) == 0));
+	return result;
+}
+
+/**
+ * Reads a document with the number as the extracted and as an unknown value
+ * @param number Number literal
+ * @return Both documents are valid
+ */
+static bool isValidNumber(std::string_view number) {
+	std::string document = "{\"output\":1,\"limit\":" + std::string(number) + "}";
+	bool extracted = read(document) == ESP_OK;
+	document = "{\"output\":1,\"unknown\":[" + std::string(number) + "]}";
+	bool skipped = read(document) == ESP_OK;
+	CHECK(extracted == skipped);
+	return extracted && skipped;
+}
+
+int main() {
+	const char *document = " {\"enabled\": true, \"output\": -3, \"limit\": 2.5e1, \"name\": \"r\\u00e1\\\"k\", \"extra\": {\"a\": [null, false, \"}\"]}} ";
+	for (size_t chunk : {SIZE_MAX, static_cast<size_t>(1), static_cast<size_t>(3)}) {
+		CHECK(read(document, chunk) == ESP_OK);
+		CHECK(values.enabled);
+		CHECK(values.output == -3);
+		CHECK(values.limit == 25.0);
+		CHECK(std::strcmp(values.name, "r\xc3\xa1\"k") == 0);
+	}
+
+	// Required and typed fields
+	CHECK(read("{\"enabled\":true}") != ESP_OK);
+	CHECK(read("{\"output\":1.5}") != ESP_OK);
+	CHECK(read("{\"output\":2147483648}") != ESP_OK);
+	CHECK(read("{\"output\":\"1\"}") != ESP_OK);
+	CHECK(read("{\"output\":1,\"name\":\"too long\"}") != ESP_OK);
+
+	// Document structure
+	CHECK(read("") != ESP_OK);
+	CHECK(read("[]") != ESP_OK);
+	CHECK(read("{\"output\":1") != ESP_OK);
+	CHECK(read("{\"output\":1,}") != ESP_OK);
+	CHECK(read("{\"output\":1} {}") != ESP_OK);
+	CHECK(read("{\"output\":1,\"x\":[1,]}") != ESP_OK);
+	CHECK(read("{\"output\":1,\"x\":tru}") != ESP_OK);
+
+	// Null characters
+	CHECK(read("{\"output\":1,\"name\":\"a\\u0000b\"}") != ESP_OK);
+	CHECK(read("{\"output\":1,\"a\\u0000b\":1}") != ESP_OK);
+	const char raw[] = "{\"output\":1,\"name\":\"a\0b\"}";
+	CHECK(read(std::string_view(raw, sizeof(raw) - 1)) != ESP_OK);
+
+	// JSON number grammar
+	for (const char *number : {"0", "-0", "10", "1.5", "-0.5e+2", "1e5", "1E-5"}) {
+		CHECK(isValidNumber(number));
+	}
+	for (const char *number : {"01", "-01", "1.", ".5", "-", "+1", "1e", "1e+", "0x1", "Infinity", "NaN"}) {
+		CHECK(!isValidNumber(number));
+	}
+	return TEST_RESULT();
+}
@@ -0,0 +1,172 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <cJSON.h>
+#include <esp_http_server.h>
+
+#include "fakeBroker.h"
+#include "fakeEsp.h"
+#include "fakeRtos.h"
+#include "mqttBenchmark.h"
+#include "nvsManager.h"
+#include "output.h"
+#include "sbcPduManagement.h"
+#include "testing.h"
+#include "utils/jsonWriter.h"
+
+/// Benchmark topics of the device with the MAC address of FakeEsp
+static const std::string BENCHMARK_TOPIC = "sbc_pdu/246f28000001/benchmark/#";
+
+/**
+ * Runs the benchmark task, the callback is called after every measurement period
+ */
+static void runBenchmark(const std::function<void(uint32_t period)> &onPeriod) {
+	uint32_t period = 0;
+	FakeRtos::onDelay = [&period, &onPeriod]() {
+		onPeriod(++period);
+		FakeBroker::process();
+	};
+	CHECK(FakeRtos::run("mqttBenchmarkTask"));
+	FakeRtos::onDelay = nullptr;
+	FakeBroker::process();
+}
+
+/**
+ * Returns the benchmark result as the REST API does
+ */
+static cJSON *readResult() {
+	httpd_req_t request = {};
+	JsonWriter writer(&request);
+	MqttBenchmark::writeJson(writer);
+	writer.finish();
+	return cJSON_ParseWithLength(request.response.data(), request.response.length());
+}
+
+/**
+ * Returns the number of payload bytes published to the benchmark topics
+ */
+static uint64_t countBytes(const std::vector<FakeBroker::Message> &messages) {
+	uint64_t bytes = 0;
+	for (const FakeBroker::Message &message : messages) {
+		bytes += message.data.length();
+	}
+	return bytes;
+}
+
+int main() {
+	FakeEsp::reset();
+	FakeRtos::reset();
+	MqttBenchmark::init();
+	std::map<uint8_t, Output*> outputs = {
+		{1, new Output(nullptr, INA3221_CHANNEL_1, GPIO_NUM_4, GPIO_NUM_5, GPIO_NUM_MAX, 1)},
+	};
+	Mqtt *mqtt = new Mqtt(MqttConfig());
+	new SbcPduManagement(mqtt, &outputs, nullptr);
+	mqtt->connect();
+	FakeBroker::process();
+
+	CHECK(MqttBenchmark::start(MqttBenchmark::MIN_OUTPUTS - 1, 10) == ESP_ERR_INVALID_ARG);
+	CHECK(MqttBenchmark::start(MqttBenchmark::MAX_OUTPUTS + 1, 10) == ESP_ERR_INVALID_ARG);
+	CHECK(MqttBenchmark::start(3, 0) == ESP_ERR_INVALID_ARG);
+	CHECK(MqttBenchmark::start(3, MqttBenchmark::MAX_DURATION + 1) == ESP_ERR_INVALID_ARG);
+
+	// Ten periods of three outputs, the broker is unreachable for four of them
+	CHECK(MqttBenchmark::start(3, 5) == ESP_OK);
+	CHECK(MqttBenchmark::isRunning());
+	CHECK(MqttBenchmark::start(3, 5) == ESP_ERR_INVALID_STATE);
+	runBenchmark([mqtt](uint32_t period) {
+		if (period == 2) {
+			FakeBroker::disconnect(mqtt);
+		} else if (period == 6) {
+			FakeBroker::reconnect(mqtt);
+		}
+	});
+	CHECK(!MqttBenchmark::isRunning());
+	std::vector<FakeBroker::Message> delivered = FakeBroker::find(BENCHMARK_TOPIC);
+	CHECK(delivered.size() == 6 * 3 * 4);
+	cJSON *result = readResult();
+	CHECK(result != nullptr);
+	if (result != nullptr) {
+		CHECK(cJSON_IsFalse(cJSON_GetObjectItem(result, "running")));
+		CHECK(cJSON_GetObjectItem(result, "outputs")->valueint == 3);
+		CHECK(std::string(cJSON_GetObjectItem(result, "format")->valuestring) == "text");
+		CHECK(cJSON_GetObjectItem(result, "elapsed")->valuedouble == 5);
+		// Every published message reached the broker, messages of the disconnected periods are reported as lost
+		CHECK(cJSON_GetObjectItem(result, "messages")->valueint == static_cast<int>(delivered.size()));
+		CHECK(cJSON_GetObjectItem(result, "bytes")->valuedouble == countBytes(delivered));
+		CHECK(cJSON_GetObjectItem(result, "failed")->valueint == 0);
+		CHECK(cJSON_GetObjectItem(result, "messagesPerSecond")->valuedouble == 72 / 5.0);
+		CHECK(cJSON_GetObjectItem(result, "lost")->valueint == 4 * 3 * 4);
+		CHECK(cJSON_GetObjectItem(result, "disconnects")->valueint == 1);
+		CHECK(cJSON_GetObjectItem(result, "reconnects")->valueint == 1);
+		cJSON *reconnectLatency = cJSON_GetObjectItem(result, "reconnectLatency");
+		CHECK(cJSON_GetObjectItem(reconnectLatency, "average")->valuedouble == 2000);
+		CHECK(cJSON_GetObjectItem(reconnectLatency, "max")->valuedouble == 2000);
+		CHECK(cJSON_GetObjectItem(result, "dropped")->valueint == 0);
+		CHECK(cJSON_GetObjectItem(result, "expired")->valueint == 0);
+		CHECK(cJSON_GetObjectItem(cJSON_GetObjectItem(result, "heap"), "minimum")->valueint > 0);
+		cJSON_Delete(result);
+	}
+
+	// Messages unacknowledged when the connection is lost are delivered again after the reconnection, they are not lost
+	FakeBroker::clear();
+	FakeBroker::acknowledge = false;
+	CHECK(MqttBenchmark::start(MqttBenchmark::MAX_OUTPUTS, 1) == ESP_OK);
+	runBenchmark([mqtt](uint32_t period) {
+		if (period == 1) {
+			FakeBroker::disconnect(mqtt);
+			FakeBroker::acknowledge = true;
+			FakeBroker::process();
+			FakeBroker::reconnect(mqtt);
+		}
+	});
+	result = readResult();
+	CHECK(result != nullptr);
+	if (result != nullptr) {
+		CHECK(cJSON_GetObjectItem(result, "outputs")->valueint == 64);
+		CHECK(cJSON_GetObjectItem(result, "reconnects")->valueint == 1);
+		CHECK(cJSON_GetObjectItem(cJSON_GetObjectItem(result, "reconnectLatency"), "max")->valuedouble == 0);
+		CHECK(cJSON_GetObjectItem(result, "lost")->valueint == 0);
+		CHECK(cJSON_GetObjectItem(result, "messages")->valueint == 2 * 64 * 4);
+		CHECK(cJSON_GetObjectItem(result, "dropped")->valueint == 0);
+		CHECK(cJSON_GetObjectItem(result, "expired")->valueint == 0);
+		cJSON_Delete(result);
+	}
+	CHECK(FakeBroker::find(BENCHMARK_TOPIC).size() > 2 * 64 * 4);
+
+	// CBOR telemetry is published in one frame per period
+	NvsManager nvs("mqtt");
+	nvs.set("telemetryFmt", static_cast<uint8_t>(PAYLOAD_FORMAT_CBOR));
+	new SbcPduManagement(mqtt, &outputs, nullptr);
+	FakeBroker::clear();
+	CHECK(MqttBenchmark::start(3, 1) == ESP_OK);
+	runBenchmark([](uint32_t) {});
+	CHECK(FakeBroker::find("sbc_pdu/246f28000001/benchmark/telemetry").size() == 2);
+	result = readResult();
+	CHECK(result != nullptr);
+	if (result != nullptr) {
+		CHECK(std::string(cJSON_GetObjectItem(result, "format")->valuestring) == "cbor");
+		CHECK(cJSON_GetObjectItem(result, "messages")->valueint == 2 * (3 + 1));
+		cJSON_Delete(result);
+	}
+
+	return TEST_RESULT();
+}
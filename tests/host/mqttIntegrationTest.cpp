@@ -0,0 +1,260 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <cJSON.h>
+
+#include "fakeBroker.h"
+#include "fakeEsp.h"
+#include "fakeRtos.h"
+#include "homeAssistant.h"
+#include "ina3221.h"
+#include "mqttRpc.h"
+#include "nvsManager.h"
+#include "output.h"
+#include "sbcPduManagement.h"
+#include "testing.h"
+
+/// Base topic of the device with the MAC address of FakeEsp
+static const std::string BASE_TOPIC = "sbc_pdu/246f28000001";
+
+/**
+ * Measures the outputs the same way as the main loop
+ */
+static std::vector<telemetrySample_t> measure(std::map<uint8_t, Output*> &outputs) {
+	std::vector<telemetrySample_t> samples;
+	for (const auto &[index, output] : outputs) {
+		samples.push_back({
+			.output = index,
+			.flags = static_cast<uint8_t>((output->isEnabled() ? TELEMETRY_FLAG_ENABLED : 0) | (output->hasAlert() ? TELEMETRY_FLAG_ALERT : 0)),
+			.current = TelemetryFrame::milliToMicro(fabs(output->readCurrent())),
+			.voltage = TelemetryFrame::milliToMicro(output->readVoltage() * 1000),
+			.timestamp = 0,
+		});
+	}
+	return samples;
+}
+
+/**
+ * Returns the payload of the last message published to the topic, "<none>" if nothing was published
+ */
+static std::string lastPayload(const std::string &topic) {
+	const FakeBroker::Message *message = FakeBroker::last(topic);
+	return message != nullptr ? message->data : "<none>";
+}
+
+/**
+ * Sends the RPC request and returns the response published to the topic
+ */
+static std::string call(const std::string &request, const std::string &responseTopic = BASE_TOPIC + "/rpc/response") {
+	size_t published = FakeBroker::find(responseTopic).size();
+	FakeBroker::inject(BASE_TOPIC + "/rpc", request);
+	FakeBroker::process();
+	std::vector<FakeBroker::Message> responses = FakeBroker::find(responseTopic);
+	return responses.size() > published ? responses.back().data : "<none>";
+}
+
+int main() {
+	FakeEsp::reset();
+	Ina3221 ina3221(nullptr, INA3221_ADDRESS_GND);
+	std::map<uint8_t, Output*> outputs = {
+		{1, new Output(&ina3221, INA3221_CHANNEL_1, GPIO_NUM_4, GPIO_NUM_5, GPIO_NUM_MAX, 1)},
+		{2, new Output(&ina3221, INA3221_CHANNEL_2, GPIO_NUM_18, GPIO_NUM_19, GPIO_NUM_MAX, 2)},
+		{3, new Output(&ina3221, INA3221_CHANNEL_3, GPIO_NUM_25, GPIO_NUM_26, GPIO_NUM_MAX, 3)},
+	};
+	Mqtt *mqtt = new Mqtt(MqttConfig());
+	mqtt->setOnConnect([](Mqtt *client, esp_event_base_t base, esp_mqtt_event_handle_t event) {
+		HomeAssistant::connectCallback(client, base, event);
+		SbcPduManagement::connectCallback(client, base, event);
+	});
+	new HomeAssistant(mqtt, &outputs);
+	SbcPduManagement *pduManagement = new SbcPduManagement(mqtt, &outputs, nullptr);
+	new MqttRpc(mqtt, &outputs);
+	mqtt->connect();
+	FakeBroker::process();
+
+	// Availability and the entity discovery are published on the connection
+	const FakeBroker::Message *status = FakeBroker::last(BASE_TOPIC + "/status");
+	CHECK(status != nullptr && status->data == "online" && status->retain && status->qos == 2);
+	std::vector<FakeBroker::Message> discovery = FakeBroker::find("homeassistant/+/+/config");
+	CHECK(discovery.size() == 12);
+	CHECK(std::all_of(discovery.begin(), discovery.end(), [](const FakeBroker::Message &message) {
+		return message.retain && message.qos == 2;
+	}));
+	const std::string device = R"("device":{"identifiers":"246f28000001","configuration_url":"http://sbc-pdu_246f28000001.local","name":"SBC PDU #246f28000001","model":"SBC PDU","manufacturer":"Roman Ondráček","sw_version":"v1.0.0-host","hw_version":"1.0 rev. 3"})";
+	CHECK(lastPayload("homeassistant/switch/sbc-pdu_246f28000001_output_1_switch/config") ==
+		R"({"name":"Output #1","availability_topic":"sbc_pdu/246f28000001/status",)" + device +
+		R"(,"state_topic":"sbc_pdu/246f28000001/outputs/1/enabled","command_topic":"sbc_pdu/246f28000001/outputs/1/enable","payload_on":"1","payload_off":"0","qos":2,"enabled_by_default":true,"icon":"mdi:power","unique_id":"sbc-pdu_246f28000001_output_1_switch"})");
+	CHECK(lastPayload("homeassistant/sensor/sbc-pdu_246f28000001_output_2_current/config") ==
+		R"({"name":"Output #2 current","availability_topic":"sbc_pdu/246f28000001/status",)" + device +
+		R"(,"device_class":"current","enabled_by_default":true,"icon":"mdi:current-dc","state_topic":"sbc_pdu/246f28000001/outputs/2/current","unique_id":"sbc-pdu_246f28000001_output_2_current","unit_of_measurement":"mA","state_class":"measurement"})");
+	CHECK(lastPayload("homeassistant/binary_sensor/sbc-pdu_246f28000001_output_3_alert/config") ==
+		R"({"name":"Output #3 alert","availability_topic":"sbc_pdu/246f28000001/status",)" + device +
+		R"(,"device_class":"problem","enabled_by_default":true,"icon":"mdi:fuse-alert","state_topic":"sbc_pdu/246f28000001/outputs/3/alert","payload_on":"1","payload_off":"0","unique_id":"sbc-pdu_246f28000001_output_3_alert","state_class":"measurement"})");
+	NvsManager nvs("mqtt");
+	uint32_t publishedDigest = 0;
+	CHECK(nvs.get("haPublished", publishedDigest) == ESP_OK && publishedDigest != 0);
+
+	// Unchanged discovery is not published again after the reconnection, Home Assistant coming online gets all of it
+	FakeBroker::disconnect(mqtt);
+	FakeBroker::process();
+	FakeBroker::reconnect(mqtt);
+	FakeBroker::process();
+	CHECK(FakeBroker::find("homeassistant/+/+/config").size() == 12);
+	FakeBroker::inject("homeassistant/status", "online", true);
+	FakeBroker::process();
+	CHECK(FakeBroker::find("homeassistant/+/+/config").size() == 24);
+	FakeBroker::disconnect(mqtt);
+	FakeBroker::process();
+	FakeBroker::reconnect(mqtt);
+	FakeBroker::process();
+	CHECK(FakeBroker::find("homeassistant/+/+/config").size() == 24);
+
+	// Output enablement round trip, the state is published with the next measurements
+	FakeEsp::currents[INA3221_CHANNEL_2] = 251.6;
+	FakeEsp::voltages[INA3221_CHANNEL_2] = 5;
+	FakeBroker::inject(BASE_TOPIC + "/outputs/2/enable", "1");
+	FakeBroker::inject(BASE_TOPIC + "/outputs/9/enable", "1");
+	FakeBroker::inject(BASE_TOPIC + "/outputs/x/enable", "1");
+	FakeBroker::process();
+	CHECK(!outputs[1]->isEnabled());
+	CHECK(outputs[2]->isEnabled());
+	CHECK(FakeEsp::gpioLevels[GPIO_NUM_18] == 0);
+	CHECK(!outputs[3]->isEnabled());
+	pduManagement->publishMeasurements(measure(outputs));
+	FakeBroker::process();
+	CHECK(lastPayload(BASE_TOPIC + "/outputs/1/enabled") == "0");
+	CHECK(lastPayload(BASE_TOPIC + "/outputs/2/enabled") == "1");
+	CHECK(lastPayload(BASE_TOPIC + "/outputs/2/current") == "250.000000");
+	CHECK(lastPayload(BASE_TOPIC + "/outputs/2/voltage") == "5.000000");
+	CHECK(lastPayload(BASE_TOPIC + "/outputs/2/alert") == "0");
+	FakeBroker::inject(BASE_TOPIC + "/outputs/2/enable", "0");
+	FakeBroker::process();
+	CHECK(!outputs[2]->isEnabled());
+	CHECK(FakeEsp::gpioLevels[GPIO_NUM_18] == 1);
+
+	// Commands switch the listed outputs or all of them, invalid commands are ignored
+	FakeBroker::inject(BASE_TOPIC + "/command", R"({"action": "enable", "outputs": [1, 3, 9, -1]})");
+	FakeBroker::process();
+	CHECK(outputs[1]->isEnabled() && !outputs[2]->isEnabled() && outputs[3]->isEnabled());
+	FakeBroker::inject(BASE_TOPIC + "/command", R"({"action": "toggle"})");
+	FakeBroker::process();
+	CHECK(!outputs[1]->isEnabled() && outputs[2]->isEnabled() && !outputs[3]->isEnabled());
+	FakeBroker::inject(BASE_TOPIC + "/command", R"({"action": "reboot"})");
+	FakeBroker::inject(BASE_TOPIC + "/command", "not a command");
+	FakeBroker::process();
+	CHECK(!outputs[1]->isEnabled() && outputs[2]->isEnabled() && !outputs[3]->isEnabled());
+	pduManagement->publishMeasurements(measure(outputs));
+	FakeBroker::process();
+	CHECK(lastPayload(BASE_TOPIC + "/outputs/1/enabled") == "0");
+	CHECK(lastPayload(BASE_TOPIC + "/outputs/2/enabled") == "1");
+	CHECK(lastPayload(BASE_TOPIC + "/outputs/3/enabled") == "0");
+
+	// The discovered command topic switches the output
+	FakeBroker::inject("sbc_pdu/246f28000001/outputs/3/enable", "1");
+	FakeBroker::process();
+	CHECK(outputs[3]->isEnabled());
+
+	// RPC responses are published to the default response topic or the requested one
+	CHECK(call(R"({"id": "1", "method": "switch", "params": {"output": 1, "enabled": true}})") ==
+		R"({"ok":true,"result":{"output":1,"enabled":true,"alert":false},"id":"1","duration":0})");
+	CHECK(outputs[1]->isEnabled());
+	CHECK(call(R"({"id": "2", "method": "getConfig", "replyTo": "clients/dashboard/reply"})", "clients/dashboard/reply") ==
+		R"({"ok":true,"result":{"macAddress":"246f28000001","firmware":"v1.0.0-host","revision":3,"protocol":4,"outputs":[1,2,3]},"id":"2","duration":0})");
+	std::string stats = call(R"({"id": "3", "method": "stats", "params": {"output": 2}})");
+	cJSON *response = cJSON_ParseWithLength(stats.data(), stats.length());
+	CHECK(response != nullptr && cJSON_IsTrue(cJSON_GetObjectItem(response, "ok")));
+	cJSON *states = cJSON_GetObjectItem(cJSON_GetObjectItem(response, "result"), "outputs");
+	CHECK(cJSON_GetArraySize(states) == 1);
+	cJSON *state = cJSON_GetArrayItem(states, 0);
+	CHECK(state != nullptr && cJSON_GetObjectItem(state, "output")->valueint == 2);
+	CHECK(state != nullptr && std::fabs(cJSON_GetObjectItem(state, "current")->valuedouble - 250) < 0.01);
+	CHECK(state != nullptr && cJSON_GetObjectItem(state, "voltage")->valuedouble == 5);
+	cJSON_Delete(response);
+
+	// The power cycle is answered after the output is powered on again
+	CHECK(call(R"({"id": "4", "method": "powerCycle", "params": {"output": 2, "delay": 250}})") == "<none>");
+	CHECK(!outputs[2]->isEnabled());
+	CHECK(FakeRtos::run("powerCycleTask"));
+	FakeBroker::process();
+	CHECK(outputs[2]->isEnabled());
+	CHECK(lastPayload(BASE_TOPIC + "/rpc/response") ==
+		R"({"ok":true,"result":{"output":2,"enabled":true,"alert":false,"delay":250},"id":"4","duration":250000})");
+
+	// Invalid requests are answered with an error, responses are never delivered to the topics of the device
+	CHECK(call(R"({"id": "5", "method": "reboot"})") == R"({"ok":false,"error":"Unknown method \"reboot\".","id":"5","duration":0})");
+	CHECK(call(R"({"id": "6", "method": "switch", "params": {"output": 7, "enabled": true}})") ==
+		R"({"ok":false,"error":"Output with ID 7 does not exist.","id":"6","duration":0})");
+	CHECK(call(R"({"id": "7", "method": "switch", "params": {"output": 1, "enabled": "yes"}})") ==
+		R"({"ok":false,"error":"Param \"enabled\" is not a boolean.","id":"7","duration":0})");
+	CHECK(call("{") == R"({"ok":false,"error":"Invalid JSON payload.","duration":0})");
+	CHECK(call(R"({"id": "8", "method": "switch", "params": {"output": 1, "enabled": false}, "replyTo": "sbc_pdu/246f28000001/outputs/1/enable"})") ==
+		R"({"ok":false,"error":"Invalid response topic.","id":"8","duration":0})");
+	CHECK(outputs[1]->isEnabled());
+	CHECK(FakeBroker::find(BASE_TOPIC + "/outputs/1/enable").size() == 0);
+
+	// Device discovery replaces the entity discovery, the entity messages are removed
+	HomeAssistant::setMode(HA_DISCOVERY_DEVICE);
+	FakeBroker::process();
+	std::string switchTopic = "homeassistant/switch/sbc-pdu_246f28000001_output_1_switch/config";
+	const FakeBroker::Message *removed = FakeBroker::last(switchTopic);
+	CHECK(removed != nullptr && removed->data.empty() && removed->retain);
+	std::vector<FakeBroker::Message> removals = FakeBroker::find("homeassistant/+/+/config");
+	CHECK(std::count_if(removals.begin(), removals.end(), [](const FakeBroker::Message &message) {
+		return message.data.empty();
+	}) == 12);
+	const FakeBroker::Message *deviceDiscovery = FakeBroker::last("homeassistant/device/sbc-pdu_246f28000001/config");
+	CHECK(deviceDiscovery != nullptr && deviceDiscovery->retain && deviceDiscovery->qos == 2);
+	cJSON *root = deviceDiscovery != nullptr ? cJSON_ParseWithLength(deviceDiscovery->data.data(), deviceDiscovery->data.length()) : nullptr;
+	CHECK(root != nullptr);
+	if (root != nullptr) {
+		cJSON *dev = cJSON_GetObjectItem(root, "dev");
+		CHECK(std::string(cJSON_GetObjectItem(dev, "ids")->valuestring) == "246f28000001");
+		CHECK(std::string(cJSON_GetObjectItem(dev, "cu")->valuestring) == "http://sbc-pdu_246f28000001.local");
+		CHECK(std::string(cJSON_GetObjectItem(dev, "sw")->valuestring) == "v1.0.0-host");
+		CHECK(std::string(cJSON_GetObjectItem(dev, "hw")->valuestring) == "1.0 rev. 3");
+		CHECK(std::string(cJSON_GetObjectItem(root, "avty_t")->valuestring) == BASE_TOPIC + "/status");
+		cJSON *components = cJSON_GetObjectItem(root, "cmps");
+		CHECK(cJSON_GetArraySize(components) == 12);
+		cJSON *outputSwitch = cJSON_GetObjectItem(components, "sbc-pdu_246f28000001_output_1_switch");
+		CHECK(outputSwitch != nullptr);
+		if (outputSwitch != nullptr) {
+			CHECK(std::string(cJSON_GetObjectItem(outputSwitch, "p")->valuestring) == "switch");
+			CHECK(std::string(cJSON_GetObjectItem(outputSwitch, "stat_t")->valuestring) == BASE_TOPIC + "/outputs/1/enabled");
+			CHECK(std::string(cJSON_GetObjectItem(outputSwitch, "cmd_t")->valuestring) == BASE_TOPIC + "/outputs/1/enable");
+		}
+		cJSON *voltage = cJSON_GetObjectItem(components, "sbc-pdu_246f28000001_output_3_voltage");
+		CHECK(voltage != nullptr && std::string(cJSON_GetObjectItem(voltage, "unit_of_meas")->valuestring) == "V");
+		cJSON_Delete(root);
+	}
+	NvsManager advertisedNvs("mqtt");
+	uint8_t advertised = HA_DISCOVERY_ENTITY;
+	CHECK(advertisedNvs.get("haAdvertised", advertised) == ESP_OK && advertised == HA_DISCOVERY_DEVICE);
+
+	// The hostname is a part of the configuration URL, its change updates the discovery
+	HostnameManager hostname;
+	hostname.set("rack1-pdu");
+	FakeBroker::process();
+	deviceDiscovery = FakeBroker::last("homeassistant/device/sbc-pdu_246f28000001/config");
+	CHECK(deviceDiscovery != nullptr && deviceDiscovery->data.find(R"("cu":"http://rack1-pdu.local")") != std::string::npos);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,82 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string>
+#include <utility>
+
+#include "network/mqttOutbox.h"
+#include "testing.h"
+
+/**
+ * Creates a QoS 1 message
+ */
+static MqttOutbox::Message message(const std::string &topic, const std::string &data) {
+	return {
+		.topic = topic,
+		.data = data,
+		.qos = 1,
+		.retain = false,
+	};
+}
+
+int main() {
+	const size_t messageSize = MqttOutbox::getMessageSize(message("a", "1"));
+	MqttOutbox outbox(3 * messageSize);
+	CHECK(outbox.empty());
+
+	// Messages with the same topic supersede each other
+	CHECK(outbox.push(message("a", "1")));
+	CHECK(outbox.push(message("b", "1")));
+	CHECK(outbox.push(message("a", "2")));
+	CHECK(outbox.size() == 2);
+	CHECK(outbox.getSuperseded() == 1);
+	CHECK(outbox.getDropped() == 0);
+	CHECK(outbox.getBytes() == 2 * messageSize);
+	CHECK(outbox.front().topic == "b");
+
+	// The oldest messages are evicted when over capacity
+	CHECK(outbox.push(message("c", "1")));
+	CHECK(outbox.push(message("d", "1")));
+	CHECK(outbox.size() == 3);
+	CHECK(outbox.getDropped() == 1);
+	CHECK(outbox.getBytes() == 3 * messageSize);
+	CHECK(outbox.front().topic == "a");
+	CHECK(outbox.front().data == "2");
+
+	// A message larger than the capacity is dropped without evicting anything
+	CHECK(!outbox.push(message("e", std::string(3 * messageSize, 'x'))));
+	CHECK(outbox.size() == 3);
+	CHECK(outbox.getDropped() == 2);
+
+	// Publish properties are accounted for
+	MqttOutbox::Message withProperties = message("f", "1");
+	withProperties.hasProperties = true;
+	withProperties.properties.responseTopic = "sbc-pdu/rpc/response";
+	CHECK(MqttOutbox::getMessageSize(withProperties) > messageSize);
+
+	MqttOutbox::Message taken = outbox.take();
+	CHECK(taken.topic == "a");
+	CHECK(taken.data == "2");
+	CHECK(outbox.size() == 2);
+	CHECK(outbox.getBytes() == 2 * messageSize);
+	outbox.pop();
+	CHECK(outbox.front().topic == "d");
+
+	outbox.clear();
+	CHECK(outbox.empty());
+	CHECK(outbox.getBytes() == 0);
+	CHECK(outbox.getDropped() == 3);
+	return TEST_RESULT();
+}
@@ -0,0 +1,61 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "network/mqttTopicFilter.h"
+#include "testing.h"
+
+int main() {
+	MqttTopicFilter exact("sbc-pdu/outputs/1/enable");
+	CHECK(exact.isValid());
+	CHECK(!exact.hasWildcard());
+	CHECK(exact.match("sbc-pdu/outputs/1/enable"));
+	CHECK(!exact.match("sbc-pdu/outputs/1/enabled"));
+	CHECK(!exact.match("sbc-pdu/outputs/1"));
+
+	MqttTopicFilter single("sbc-pdu/outputs/+/enable");
+	CHECK(single.isValid());
+	CHECK(single.hasWildcard());
+	std::vector<std::string_view> wildcards;
+	CHECK(single.match("sbc-pdu/outputs/7/enable", &wildcards));
+	CHECK(wildcards.size() == 1 && wildcards[0] == "7");
+	CHECK(single.match("sbc-pdu/outputs//enable"));
+	CHECK(!single.match("sbc-pdu/outputs/7/8/enable"));
+	CHECK(!single.match("sbc-pdu/outputs/7"));
+
+	MqttTopicFilter multi("sbc-pdu/groups/#");
+	CHECK(multi.isValid());
+	wildcards.clear();
+	CHECK(multi.match("sbc-pdu/groups/rack/enable", &wildcards));
+	CHECK(wildcards.empty());
+	CHECK(multi.match("sbc-pdu/groups"));
+	CHECK(!multi.match("sbc-pdu/group"));
+
+	MqttTopicFilter mixed("+/groups/+/#");
+	CHECK(mixed.match("sbc-pdu/groups/rack/enable", &wildcards));
+	CHECK(wildcards.size() == 2 && wildcards[0] == "sbc-pdu" && wildcards[1] == "rack");
+
+	MqttTopicFilter all("#");
+	CHECK(all.match("sbc-pdu/outputs/1/enable"));
+	CHECK(!all.match("$SYS/broker/uptime"));
+
+	CHECK(!MqttTopicFilter("sbc-pdu/#/enable").isValid());
+	CHECK(!MqttTopicFilter("sbc-pdu/outputs+/enable").isValid());
+	CHECK(!MqttTopicFilter("sbc-pdu/out#").isValid());
+	return TEST_RESULT();
+}
@@ -0,0 +1,31 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "powerBudgetMember.h"
+
+// Compiled once for every member with PowerBudget and POWER_BUDGET_MEMBER defined by CMakeLists.txt
+#include "../../main/powerBudget.cpp"
+
+powerBudgetMember_t POWER_BUDGET_MEMBER() {
+	return {
+		.init = PowerBudget::init,
+		.attach = PowerBudget::attach,
+		.update = PowerBudget::update,
+		.isOverBudget = PowerBudget::isOverBudget,
+		.getLimit = PowerBudget::getLimit,
+		.isCoordinated = PowerBudget::isCoordinated,
+		.admit = PowerBudget::admit,
+	};
+}
@@ -0,0 +1,49 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+
+#include "network/mqtt.h"
+#include "output.h"
+
+/**
+ * Entry points of one copy of the PowerBudget class
+ *
+ * PowerBudget keeps its state in static members, so every PDU of the simulated budget domain is a separate copy
+ * of powerBudget.cpp compiled with the class renamed (see CMakeLists.txt).
+ */
+typedef struct PowerBudgetMember {
+	/// PowerBudget::init()
+	void (*init)();
+	/// PowerBudget::attach()
+	void (*attach)(Mqtt *mqtt);
+	/// PowerBudget::update()
+	void (*update)(float draw);
+	/// PowerBudget::isOverBudget()
+	bool (*isOverBudget)(float draw);
+	/// PowerBudget::getLimit()
+	uint32_t (*getLimit)();
+	/// PowerBudget::isCoordinated()
+	bool (*isCoordinated)();
+	/// PowerBudget::admit()
+	bool (*admit)(Output *output);
+} powerBudgetMember_t;
+
+powerBudgetMember_t getPowerBudgetA();
+powerBudgetMember_t getPowerBudgetB();
+powerBudgetMember_t getPowerBudgetC();
+powerBudgetMember_t getPowerBudgetLocal();
@@ -0,0 +1,183 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdint>
+#include <string>
+
+#include "fakeBroker.h"
+#include "fakeEsp.h"
+#include "nvsManager.h"
+#include "output.h"
+#include "powerBudgetMember.h"
+#include "testing.h"
+
+/**
+ * PDU of the simulated budget domain
+ */
+struct Pdu {
+	/// Power budget of the PDU
+	powerBudgetMember_t budget;
+	/// MQTT client of the PDU
+	Mqtt *mqtt;
+	/// Output powered on by the tests
+	Output *output;
+	/// Topic of the budget reports
+	std::string reportTopic;
+};
+
+/**
+ * Stores the budget configuration shared by all PDUs
+ */
+static void configureBudget(const std::string &domain) {
+	NvsManager nvs("budget");
+	nvs.setString("domain", domain);
+	nvs.set("total", static_cast<uint32_t>(5000));
+	nvs.set("fallback", static_cast<uint32_t>(4200));
+	nvs.set("reserve", static_cast<uint32_t>(600));
+}
+
+/**
+ * Creates the PDU with its own MAC address and MQTT client
+ */
+static Pdu createPdu(const powerBudgetMember_t &budget, uint8_t id) {
+	FakeEsp::mac[5] = id;
+	budget.init();
+	Pdu pdu = {
+		.budget = budget,
+		.mqtt = new Mqtt(MqttConfig()),
+		.output = new Output(nullptr, INA3221_CHANNEL_1, GPIO_NUM_4, GPIO_NUM_5, GPIO_NUM_MAX, 1),
+		.reportTopic = "sbc_pdu/budget/rack1/246f280000" + std::string(id < 16 ? "0" : "") + std::to_string(id),
+	};
+	budget.attach(pdu.mqtt);
+	pdu.mqtt->connect();
+	return pdu;
+}
+
+/**
+ * Powers the output of the PDU on through the admission of its power budget
+ */
+static bool powerOn(Pdu &pdu) {
+	Output::setAdmissionCallback(pdu.budget.admit);
+	pdu.output->enable(false);
+	bool admitted = pdu.output->enable(true);
+	FakeBroker::process();
+	return admitted;
+}
+
+/**
+ * Advances the time by one report interval, the PDUs report their draw and receive the reports of the others
+ */
+static void reportRound(Pdu &a, uint32_t drawA, Pdu &b, uint32_t drawB, Pdu &c, uint32_t drawC) {
+	FakeEsp::advance(1000000);
+	a.budget.update(drawA);
+	b.budget.update(drawB);
+	c.budget.update(drawC);
+	FakeBroker::process();
+}
+
+int main() {
+	FakeEsp::reset();
+	configureBudget("rack1");
+	Pdu a = createPdu(getPowerBudgetA(), 1);
+	Pdu b = createPdu(getPowerBudgetB(), 2);
+	Pdu c = createPdu(getPowerBudgetC(), 3);
+	FakeBroker::process();
+
+	// The safe local budget is used until the broker echoes own reports
+	CHECK(!a.budget.isCoordinated());
+	CHECK(a.budget.getLimit() == 4200);
+
+	reportRound(a, 2000, b, 2000, c, 0);
+	const FakeBroker::Message *report = FakeBroker::last(a.reportTopic);
+	CHECK(report != nullptr && report->data == R"({"draw":2000,"reserved":0,"total":5000})");
+	CHECK(a.budget.isCoordinated());
+	CHECK(b.budget.isCoordinated());
+	CHECK(c.budget.isCoordinated());
+	CHECK(a.budget.getLimit() == 3000);
+	CHECK(c.budget.getLimit() == 1000);
+
+	// The reservation is published immediately and the other PDUs count it before admitting their own outputs
+	CHECK(powerOn(a));
+	report = FakeBroker::last(a.reportTopic);
+	CHECK(report != nullptr && report->data == R"({"draw":2000,"reserved":600,"total":5000})");
+	CHECK(b.budget.getLimit() == 2400);
+	CHECK(!powerOn(b));
+	CHECK(!b.output->isEnabled());
+	CHECK(!powerOn(c));
+
+	// The reservation expires after the hold time, the draw of the output is measured by then
+	reportRound(a, 2000, b, 2000, c, 0);
+	reportRound(a, 2000, b, 2000, c, 0);
+	CHECK(b.budget.getLimit() == 2400);
+	reportRound(a, 2000, b, 2000, c, 0);
+	CHECK(b.budget.getLimit() == 3000);
+	CHECK(powerOn(b));
+	CHECK(b.output->isEnabled());
+
+	// The lowest total advertised by a member is the shared budget, invalid reports are ignored
+	FakeBroker::inject("sbc_pdu/budget/rack1/SIM001", R"({"draw": 0, "reserved": 0, "total": 4600})");
+	FakeBroker::inject("sbc_pdu/budget/rack1/SIM002", R"({"draw": -1000})");
+	FakeBroker::inject("sbc_pdu/budget/rack1/SIM003", "not a report");
+	FakeBroker::process();
+	CHECK(c.budget.getLimit() == 0);
+	CHECK(a.budget.getLimit() == 2000);
+
+	// Only the members drawing more than the fair share shed their outputs when the budget is exceeded
+	reportRound(a, 3000, b, 2500, c, 200);
+	CHECK(a.budget.isOverBudget(3000));
+	CHECK(b.budget.isOverBudget(2500));
+	CHECK(!c.budget.isOverBudget(200));
+	CHECK(c.budget.isOverBudget(4300));
+
+	// Silent members are not counted after the timeout
+	for (int i = 0; i < 6; ++i) {
+		FakeEsp::advance(1000000);
+		a.budget.update(1000);
+		c.budget.update(0);
+		FakeBroker::process();
+	}
+	CHECK(c.budget.getLimit() == 4000);
+
+	// The safe local budget applies while the coordination is unreachable and again after the reconnection until the next report
+	FakeBroker::disconnect(c.mqtt);
+	FakeBroker::process();
+	CHECK(!c.budget.isCoordinated());
+	CHECK(c.budget.getLimit() == 4200);
+	CHECK(powerOn(c));
+	FakeBroker::reconnect(c.mqtt);
+	FakeBroker::process();
+	FakeEsp::advance(5100000);
+	CHECK(!c.budget.isCoordinated());
+	a.budget.update(1000);
+	c.budget.update(600);
+	FakeBroker::process();
+	CHECK(c.budget.isCoordinated());
+	CHECK(c.budget.getLimit() == 4000);
+
+	// Without the domain the power-on is not restricted and outputs are shed only over the safe local budget
+	configureBudget("");
+	Output::setAdmissionCallback(nullptr);
+	powerBudgetMember_t local = getPowerBudgetLocal();
+	local.init();
+	local.update(4100);
+	CHECK(!local.isCoordinated());
+	CHECK(local.getLimit() == 4200);
+	Output output(nullptr, INA3221_CHANNEL_2, GPIO_NUM_18, GPIO_NUM_19, GPIO_NUM_MAX, 2);
+	CHECK(output.enable(true));
+	CHECK(!local.isOverBudget(4200));
+	CHECK(local.isOverBudget(4300));
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,81 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+
+/// Host replacement of the cJSON library bundled with ESP-IDF, only the API used by the firmware is implemented
+#define cJSON_Invalid (0)
+#define cJSON_False (1 << 0)
+#define cJSON_True (1 << 1)
+#define cJSON_NULL (1 << 2)
+#define cJSON_Number (1 << 3)
+#define cJSON_String (1 << 4)
+#define cJSON_Array (1 << 5)
+#define cJSON_Object (1 << 6)
+#define cJSON_Raw (1 << 7)
+
+typedef struct cJSON {
+	struct cJSON *next;
+	struct cJSON *prev;
+	struct cJSON *child;
+	int type;
+	char *valuestring;
+	int valueint;
+	double valuedouble;
+	char *string;
+} cJSON;
+
+typedef int cJSON_bool;
+
+cJSON *cJSON_ParseWithLength(const char *value, size_t length);
+char *cJSON_PrintUnformatted(const cJSON *item);
+void cJSON_Delete(cJSON *item);
+void cJSON_free(void *pointer);
+
+cJSON *cJSON_CreateNumber(double number);
+cJSON *cJSON_CreateString(const char *string);
+cJSON *cJSON_CreateArray();
+cJSON *cJSON_CreateObject();
+
+int cJSON_GetArraySize(const cJSON *array);
+cJSON *cJSON_GetArrayItem(const cJSON *array, int index);
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *string);
+
+cJSON_bool cJSON_IsInvalid(const cJSON *item);
+cJSON_bool cJSON_IsFalse(const cJSON *item);
+cJSON_bool cJSON_IsTrue(const cJSON *item);
+cJSON_bool cJSON_IsBool(const cJSON *item);
+cJSON_bool cJSON_IsNull(const cJSON *item);
+cJSON_bool cJSON_IsNumber(const cJSON *item);
+cJSON_bool cJSON_IsString(const cJSON *item);
+cJSON_bool cJSON_IsArray(const cJSON *item);
+cJSON_bool cJSON_IsObject(const cJSON *item);
+cJSON_bool cJSON_IsRaw(const cJSON *item);
+
+cJSON_bool cJSON_AddItemToArray(cJSON *array, cJSON *item);
+cJSON_bool cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item);
+cJSON *cJSON_DetachItemFromObject(cJSON *object, const char *string);
+
+cJSON *cJSON_AddTrueToObject(cJSON *object, const char *name);
+cJSON *cJSON_AddFalseToObject(cJSON *object, const char *name);
+cJSON *cJSON_AddBoolToObject(cJSON *object, const char *name, cJSON_bool boolean);
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number);
+cJSON *cJSON_AddStringToObject(cJSON *object, const char *name, const char *string);
+cJSON *cJSON_AddObjectToObject(cJSON *object, const char *name);
+cJSON *cJSON_AddArrayToObject(cJSON *object, const char *name);
+
+#define cJSON_ArrayForEach(element, array) for (element = (array != nullptr) ? (array)->child : nullptr; element != nullptr; element = element->next)
@@ -0,0 +1,75 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+
+#include <esp_err.h>
+
+/// Host stand-in for the ESP-IDF GPIO driver, levels are kept in memory
+typedef enum {
+	GPIO_NUM_0 = 0,
+	GPIO_NUM_4 = 4,
+	GPIO_NUM_5 = 5,
+	GPIO_NUM_18 = 18,
+	GPIO_NUM_19 = 19,
+	GPIO_NUM_21 = 21,
+	GPIO_NUM_25 = 25,
+	GPIO_NUM_26 = 26,
+	GPIO_NUM_32 = 32,
+	GPIO_NUM_33 = 33,
+	GPIO_NUM_34 = 34,
+	GPIO_NUM_35 = 35,
+	GPIO_NUM_MAX = 40,
+} gpio_num_t;
+
+typedef enum {
+	GPIO_MODE_INPUT,
+	GPIO_MODE_OUTPUT,
+} gpio_mode_t;
+
+typedef enum {
+	GPIO_PULLUP_DISABLE,
+	GPIO_PULLUP_ENABLE,
+} gpio_pullup_t;
+
+typedef enum {
+	GPIO_PULLDOWN_DISABLE,
+	GPIO_PULLDOWN_ENABLE,
+} gpio_pulldown_t;
+
+typedef enum {
+	GPIO_INTR_DISABLE,
+	GPIO_INTR_POSEDGE,
+	GPIO_INTR_NEGEDGE,
+	GPIO_INTR_ANYEDGE,
+} gpio_int_type_t;
+
+typedef struct {
+	uint64_t pin_bit_mask;
+	gpio_mode_t mode;
+	gpio_pullup_t pull_up_en;
+	gpio_pulldown_t pull_down_en;
+	gpio_int_type_t intr_type;
+} gpio_config_t;
+
+typedef void (*gpio_isr_t)(void *argument);
+
+esp_err_t gpio_config(const gpio_config_t *config);
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level);
+int gpio_get_level(gpio_num_t pin);
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t handler, void *argument);
+esp_err_t gpio_isr_handler_remove(gpio_num_t pin);
@@ -0,0 +1,29 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <esp_err.h>
+
+/// Host stand-in for the ESP-IDF I2C driver types, the INA3221 is replaced by FakeEsp
+typedef enum {
+	I2C_NUM_0,
+	I2C_NUM_1,
+} i2c_port_t;
+
+typedef void *i2c_cmd_handle_t;
@@ -0,0 +1,32 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+
+/// Host stand-in for the ESP-IDF application description, FakeEsp describes the firmware of the tests
+typedef struct {
+	uint32_t magic_word;
+	uint32_t secure_version;
+	char version[32];
+	char project_name[32];
+	char time[16];
+	char date[16];
+	char idf_ver[32];
+	uint8_t app_elf_sha256[32];
+} esp_app_desc_t;
+
+const esp_app_desc_t *esp_app_get_description();
@@ -0,0 +1,27 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+
+#include <esp_err.h>
+
+/// Host stand-in for the ESP-IDF event loop types
+typedef const char *esp_event_base_t;
+typedef void *esp_event_handler_instance_t;
+typedef void (*esp_event_handler_t)(void *arguments, esp_event_base_t base, int32_t id, void *data);
+
+#define ESP_EVENT_ANY_ID -1
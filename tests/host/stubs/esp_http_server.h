@@ -0,0 +1,36 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstring>
+#include <string>
+
+#include <sys/types.h>
+
+#include <esp_err.h>
+
+/// Host stand-in for the ESP-IDF HTTP server, the response is collected in the request
+typedef struct httpd_req {
+	/// Response body sent by the handler
+	std::string response;
+	/// Was the response completed?
+	bool completed;
+} httpd_req_t;
+
+#define HTTPD_RESP_USE_STRLEN -1
+
+esp_err_t httpd_resp_send(httpd_req_t *request, const char *buffer, ssize_t length);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *request, const char *buffer, ssize_t length);
@@ -0,0 +1,48 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdarg>
+
+/// Host stand-in for the ESP-IDF logging, messages are printed to stderr when HOST_TEST_VERBOSE is set
+typedef enum {
+	ESP_LOG_NONE,
+	ESP_LOG_ERROR,
+	ESP_LOG_WARN,
+	ESP_LOG_INFO,
+	ESP_LOG_DEBUG,
+	ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+#ifndef CONFIG_LOG_DEFAULT_LEVEL
+#define CONFIG_LOG_DEFAULT_LEVEL 2
+#endif
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL 3
+#endif
+
+typedef int (*vprintf_like_t)(const char *format, va_list args);
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func);
+
+#define ESP_LOGE(tag, format, ...) esp_log_write(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) esp_log_write(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) esp_log_write(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) esp_log_write(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) esp_log_write(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+#define ESP_LOG_BUFFER_HEXDUMP(tag, buffer, length, level) do { (void) (buffer); (void) (length); } while (false)
@@ -0,0 +1,28 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+
+#include <esp_err.h>
+
+/// Host stand-in for the ESP-IDF MAC address API
+typedef enum {
+	ESP_MAC_WIFI_STA,
+	ESP_MAC_ETH,
+} esp_mac_type_t;
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type);
@@ -0,0 +1,55 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <esp_err.h>
+
+/// Host stand-in for the ESP-IDF partition API, no partitions are present on the host
+typedef enum {
+	ESP_PARTITION_TYPE_APP = 0,
+	ESP_PARTITION_TYPE_DATA = 1,
+} esp_partition_type_t;
+
+typedef enum {
+	ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef struct {
+	esp_partition_type_t type;
+	esp_partition_subtype_t subtype;
+	uint32_t address;
+	uint32_t size;
+	uint32_t erase_size;
+	char label[17];
+	bool encrypted;
+} esp_partition_t;
+
+typedef uint32_t esp_partition_mmap_handle_t;
+
+typedef enum {
+	ESP_PARTITION_MMAP_DATA,
+	ESP_PARTITION_MMAP_INST,
+} esp_partition_mmap_memory_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *destination, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *source, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size);
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size, esp_partition_mmap_memory_t memory, const void **pointer, esp_partition_mmap_handle_t *handle);
+void esp_partition_munmap(esp_partition_mmap_handle_t handle);
@@ -0,0 +1,26 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <sys/types.h>
+
+#include <esp_err.h>
+
+/// Host stand-in for the ESP-IDF TLS types, the TLS transport is not tested on the host
+typedef struct esp_tls esp_tls_t;
+typedef struct esp_tls_client_session esp_tls_client_session_t;
+typedef struct esp_tls_last_error *esp_tls_error_handle_t;
@@ -0,0 +1,59 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+
+#include <esp_err.h>
+#include <esp_event.h>
+
+/// Host stand-in for the ESP-IDF WiFi types, the station is never started on the host
+typedef enum {
+	WIFI_AUTH_OPEN,
+	WIFI_AUTH_WEP,
+	WIFI_AUTH_WPA_PSK,
+	WIFI_AUTH_WPA2_PSK,
+	WIFI_AUTH_WPA_WPA2_PSK,
+	WIFI_AUTH_WPA2_ENTERPRISE,
+	WIFI_AUTH_WPA3_PSK,
+	WIFI_AUTH_WPA2_WPA3_PSK,
+} wifi_auth_mode_t;
+
+typedef enum {
+	WIFI_MODE_NULL,
+	WIFI_MODE_STA,
+} wifi_mode_t;
+
+typedef struct {
+	uint8_t bssid[6];
+	uint8_t ssid[33];
+	uint8_t primary;
+	int8_t rssi;
+	wifi_auth_mode_t authmode;
+} wifi_ap_record_t;
+
+typedef union {
+	struct {
+		uint8_t ssid[32];
+		uint8_t password[64];
+	} sta;
+} wifi_config_t;
+
+typedef struct {
+	int unused;
+} wifi_init_config_t;
+
+#define WIFI_INIT_CONFIG_DEFAULT() wifi_init_config_t{0}
@@ -0,0 +1,39 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+
+/// Host stand-in for the FreeRTOS types, semaphores are backed by the standard library and tasks are run by FakeRtos
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef struct FakeSemaphore *SemaphoreHandle_t;
+typedef struct FakeQueue *QueueHandle_t;
+typedef void *TaskHandle_t;
+typedef void *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+typedef void (*TaskFunction_t)(void *parameters);
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xffffffffU
+#define portTICK_PERIOD_MS 1
+#define configTICK_RATE_HZ 1000
+#define pdMS_TO_TICKS(ms) (static_cast<TickType_t>(ms))
+#define IRAM_ATTR
@@ -0,0 +1,23 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
@@ -0,0 +1,28 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stackDepth, void *parameters, UBaseType_t priority, TaskHandle_t *handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth, void *parameters, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previousWake, TickType_t increment);
+TickType_t xTaskGetTickCount();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
@@ -0,0 +1,140 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+
+#include <esp_err.h>
+#include <esp_event.h>
+
+/// Host stand-in for the ESP-MQTT client API, clients are connected to FakeBroker
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+
+typedef enum {
+	MQTT_EVENT_ANY = -1,
+	MQTT_EVENT_ERROR = 0,
+	MQTT_EVENT_CONNECTED,
+	MQTT_EVENT_DISCONNECTED,
+	MQTT_EVENT_SUBSCRIBED,
+	MQTT_EVENT_UNSUBSCRIBED,
+	MQTT_EVENT_PUBLISHED,
+	MQTT_EVENT_DATA,
+	MQTT_EVENT_BEFORE_CONNECT,
+	MQTT_EVENT_DELETED,
+} esp_mqtt_event_id_t;
+
+typedef enum {
+	MQTT_PROTOCOL_UNDEFINED = 0,
+	MQTT_PROTOCOL_V_3_1,
+	MQTT_PROTOCOL_V_3_1_1,
+	MQTT_PROTOCOL_V_5,
+} esp_mqtt_protocol_ver_t;
+
+typedef enum {
+	MQTT_ERROR_TYPE_NONE = 0,
+	MQTT_ERROR_TYPE_TCP_TRANSPORT,
+	MQTT_ERROR_TYPE_CONNECTION_REFUSED,
+	MQTT_ERROR_TYPE_SUBSCRIBE_FAILED,
+} esp_mqtt_error_type_t;
+
+typedef struct esp_mqtt_error_codes {
+	esp_err_t esp_tls_last_esp_err;
+	int esp_tls_stack_err;
+	int esp_tls_cert_verify_flags;
+	esp_mqtt_error_type_t error_type;
+	int connect_return_code;
+	int esp_transport_sock_errno;
+} esp_mqtt_error_codes_t;
+
+typedef struct {
+	bool payload_format_indicator;
+	int64_t message_expiry_interval;
+	uint16_t topic_alias;
+	char *response_topic;
+	int response_topic_len;
+	char *correlation_data;
+	uint16_t correlation_data_len;
+	char *content_type;
+	int content_type_len;
+	void *user_property;
+	uint32_t subscribe_id;
+} esp_mqtt5_event_property_t;
+
+typedef struct esp_mqtt_event_t {
+	esp_mqtt_event_id_t event_id;
+	esp_mqtt_client_handle_t client;
+	char *data;
+	int data_len;
+	int total_data_len;
+	int current_data_offset;
+	char *topic;
+	int topic_len;
+	int msg_id;
+	int session_present;
+	esp_mqtt_error_codes_t *error_handle;
+	bool retain;
+	int qos;
+	bool dup;
+	esp_mqtt_protocol_ver_t protocol_ver;
+	esp_mqtt5_event_property_t *property;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t *esp_mqtt_event_handle_t;
+
+typedef struct esp_mqtt_client_config_t {
+	struct broker_t {
+		struct address_t {
+			const char *uri;
+		} address;
+		struct verification_t {
+			esp_err_t (*crt_bundle_attach)(void *configuration);
+			const char *certificate;
+			size_t certificate_len;
+		} verification;
+	} broker;
+	struct credentials_t {
+		const char *username;
+		const char *client_id;
+		struct authentication_t {
+			const char *password;
+		} authentication;
+	} credentials;
+	struct session_t {
+		struct last_will_t {
+			const char *topic;
+			const char *msg;
+			int msg_len;
+			int qos;
+			int retain;
+		} last_will;
+		int keepalive;
+		esp_mqtt_protocol_ver_t protocol_ver;
+	} session;
+	struct network_t {
+		void *transport;
+	} network;
+	struct outbox_config_t {
+		uint64_t limit;
+	} outbox;
+} esp_mqtt_client_config_t;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event, esp_event_handler_t handler, void *arguments);
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int length, int qos, int retain);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos);
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char *topic);
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client);
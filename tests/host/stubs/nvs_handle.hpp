@@ -0,0 +1,94 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <variant>
+
+#include <esp_err.h>
+#include <nvs.h>
+
+/// Host stand-in for the ESP-IDF NVS C++ API, all namespaces are kept in memory
+namespace nvs {
+	enum class ItemType {
+		U8,
+		I8,
+		U16,
+		I16,
+		U32,
+		I32,
+		U64,
+		I64,
+		SZ,
+		BLOB,
+		ANY,
+	};
+
+	/// Stored item, integers are kept with their type like in the real NVS
+	typedef std::variant<uint8_t, int8_t, uint16_t, int16_t, uint32_t, int32_t, uint64_t, int64_t, std::string> item_t;
+
+	/// Items of all namespaces <namespace, <key, item>>
+	std::map<std::string, std::map<std::string, item_t>> &storage();
+
+	class NVSHandle {
+		public:
+			explicit NVSHandle(const std::string &nameSpace): items(storage()[nameSpace]) {}
+
+			template<typename T>
+			esp_err_t get_item(const char *key, T &value) {
+				auto item = this->items.find(key);
+				if (item == this->items.end()) {
+					return ESP_ERR_NVS_NOT_FOUND;
+				}
+				if constexpr (std::is_enum_v<T>) {
+					return this->get_item(key, reinterpret_cast<std::underlying_type_t<T> &>(value));
+				} else {
+					if (!std::holds_alternative<T>(item->second)) {
+						return ESP_ERR_INVALID_ARG;
+					}
+					value = std::get<T>(item->second);
+					return ESP_OK;
+				}
+			}
+
+			template<typename T>
+			esp_err_t set_item(const char *key, T value) {
+				if constexpr (std::is_enum_v<T>) {
+					this->items.insert_or_assign(key, static_cast<std::underlying_type_t<T>>(value));
+				} else {
+					this->items.insert_or_assign(key, value);
+				}
+				return ESP_OK;
+			}
+
+			esp_err_t get_item_size(ItemType type, const char *key, size_t &size);
+			esp_err_t get_string(const char *key, char *value, size_t size);
+			esp_err_t set_string(const char *key, const char *value);
+			esp_err_t erase_item(const char *key);
+			esp_err_t commit();
+
+		private:
+			/// Items of the namespace
+			std::map<std::string, item_t> &items;
+	};
+
+	std::unique_ptr<NVSHandle> open_nvs_handle(const char *nameSpace, nvs_open_mode_t mode, esp_err_t *result);
+}
@@ -0,0 +1,112 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "telemetryFrame.h"
+#include "testing.h"
+#include "utils/cborWriter.h"
+
+/// TELEMETRY_FLAG_ENABLED, telemetryBuffer.h depends on FreeRTOS
+static constexpr uint8_t FLAG_ENABLED = 1 << 0;
+
+/**
+ * Compares the encoded data with the expected bytes
+ */
+static bool equals(const CborWriter &writer, const std::vector<uint8_t> &expected) {
+	return writer.getLength() == expected.size() && std::memcmp(writer.getData(), expected.data(), expected.size()) == 0;
+}
+
+static void testWriter() {
+	uint8_t buffer[64];
+	CborWriter writer(buffer, sizeof(buffer));
+	writer.writeUnsigned(0).writeUnsigned(23).writeUnsigned(24).writeUnsigned(255).writeUnsigned(256);
+	CHECK(equals(writer, {0x00, 0x17, 0x18, 0x18, 0x18, 0xff, 0x19, 0x01, 0x00}));
+
+	writer.reset();
+	writer.writeUnsigned(65536).writeUnsigned(UINT64_C(0x100000000));
+	CHECK(equals(writer, {0x1a, 0x00, 0x01, 0x00, 0x00, 0x1b, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00}));
+
+	writer.reset();
+	writer.writeInteger(-1).writeInteger(-24).writeInteger(-25).writeInteger(-500).writeInteger(10);
+	CHECK(equals(writer, {0x20, 0x37, 0x38, 0x18, 0x39, 0x01, 0xf3, 0x0a}));
+
+	writer.reset();
+	writer.writeBool(false).writeBool(true).writeNull();
+	CHECK(equals(writer, {0xf4, 0xf5, 0xf6}));
+
+	writer.reset();
+	const uint8_t bytes[] = {0xde, 0xad};
+	writer.writeText("IETF").writeBytes(bytes, sizeof(bytes)).beginArray(2).beginMap(1);
+	CHECK(equals(writer, {0x64, 'I', 'E', 'T', 'F', 0x42, 0xde, 0xad, 0x82, 0xa1}));
+	CHECK(!writer.hasOverflowed());
+
+	uint8_t small[4];
+	CborWriter overflow(small, sizeof(small));
+	overflow.writeText("too long");
+	CHECK(overflow.hasOverflowed());
+	CHECK(overflow.getLength() <= sizeof(small));
+	overflow.reset();
+	CHECK(!overflow.hasOverflowed());
+	CHECK(overflow.getLength() == 0);
+}
+
+static void testFrame() {
+	uint8_t buffer[TelemetryFrame::MAX_HEADER_SIZE + 2 * TelemetryFrame::MAX_SAMPLE_SIZE];
+	CborWriter writer(buffer, sizeof(buffer));
+	const int64_t timestamp = 1700000000000;
+	TelemetryFrame::begin(writer, timestamp, false, 1);
+	telemetrySample_t sample = {
+		.output = 2,
+		.flags = FLAG_ENABLED,
+		.current = TelemetryFrame::milliToMicro(1.5f),
+		.voltage = TelemetryFrame::milliToMicro(-5.0f),
+		.timestamp = timestamp + 20,
+	};
+	TelemetryFrame::addSample(writer, sample, timestamp);
+	CHECK(!writer.hasOverflowed());
+	CHECK(equals(writer, {
+		// {0: 1, 1: 1700000000000, 3: [
+		0xa3, 0x00, 0x01, 0x01, 0x1b, 0x00, 0x00, 0x01, 0x8b, 0xcf, 0xe5, 0x68, 0x00, 0x03, 0x81,
+		// [2, flags, 1500, -5000, 20]]}
+		0x85, 0x02, FLAG_ENABLED, 0x19, 0x05, 0xdc, 0x39, 0x13, 0x87, 0x14,
+	}));
+
+	writer.reset();
+	TelemetryFrame::begin(writer, timestamp, true, 0);
+	CHECK(equals(writer, {0xa4, 0x00, 0x01, 0x01, 0x1b, 0x00, 0x00, 0x01, 0x8b, 0xcf, 0xe5, 0x68, 0x00, 0x02, 0xf5, 0x03, 0x80}));
+
+	writer.reset();
+	TelemetryFrame::begin(writer, INT64_MAX, true, 65536);
+	CHECK(writer.getLength() <= TelemetryFrame::MAX_HEADER_SIZE);
+	writer.reset();
+	sample = {
+		.output = UINT8_MAX,
+		.flags = UINT8_MAX,
+		.current = INT32_MIN,
+		.voltage = INT32_MIN,
+		.timestamp = INT64_MIN,
+	};
+	TelemetryFrame::addSample(writer, sample, INT64_MAX);
+	CHECK(writer.getLength() <= TelemetryFrame::MAX_SAMPLE_SIZE);
+}
+
+int main() {
+	testWriter();
+	testFrame();
+	return TEST_RESULT();
+}
@@ -0,0 +1,38 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+/// Number of failed checks
+inline int testFailures = 0;
+
+/**
+ * Records a failure when the condition does not hold
+ */
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			++testFailures; \
+		} \
+	} while (false)
+
+/**
+ * Reports the result, use as the return value of main()
+ */
+#define TEST_RESULT() (testFailures == 0 ? EXIT_SUCCESS : (std::fprintf(stderr, "%d check(s) failed\n", testFailures), EXIT_FAILURE))
@@ -0,0 +1,198 @@
+/**
+ * Copyright 2022-2024 Roman Ondráček <mail@romanondracek.cz>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+import { storeToRefs } from 'pinia';
+
+import { useUserStore } from '@/store/user';
+import { type LiveTelemetryMessage, type OutputUpdate } from '@/types/outputs';
+
+/**
+ * Pending request
+ */
+interface PendingRequest {
+	/// Resolves the request
+	resolve: () => void;
+	/// Rejects the request
+	reject: (error: Error) => void;
+}
+
+/**
+ * Live telemetry WebSocket service
+ */
+export default class LiveTelemetryService {
+
+	/**
+	 * @property {WebSocket|null} socket WebSocket
+	 */
+	private socket: WebSocket | null = null;
+
+	/**
+	 * @property {number} nextId Next request ID
+	 */
+	private nextId = 1;
+
+	/**
+	 * @property {Map<number, PendingRequest>} pending Requests waiting for the response
+	 */
+	private readonly pending = new Map<number, PendingRequest>();
+
+	/**
+	 * @property {number|null} reconnectTimer Reconnect timer
+	 */
+	private reconnectTimer: number | null = null;
+
+	/**
+	 * @property {boolean} closed Is the service closed?
+	 */
+	private closed = false;
+
+	/**
+	 * @property {boolean} subscribed Is the socket authenticated and subscribed?
+	 */
+	private subscribed = false;
+
+	/**
+	 * Constructor
+	 * @param {(updates: OutputUpdate[]) => void} onUpdate Changed outputs callback
+	 * @param {number} interval Minimal interval between updates in milliseconds
+	 */
+	public constructor(
+		private readonly onUpdate: (updates: OutputUpdate[]) => void,
+		private readonly interval: number = 500,
+	) {}
+
+	/**
+	 * Connects to the live telemetry stream, the connection is restored after it drops
+	 */
+	public connect(): void {
+		this.closed = false;
+		const url = new URL(`${import.meta.env.VITE_API_BASE_URL}/ws`, window.location.href);
+		url.protocol = url.protocol === 'https:' ? 'wss:' : 'ws:';
+		const socket = new WebSocket(url);
+		socket.addEventListener('open', () => {
+			this.authenticate()
+				.then(() => this.request({ type: 'subscribe', interval: this.interval }))
+				.then(() => {
+					this.subscribed = true;
+				})
+				.catch((error: Error) => {
+					console.error(error);
+					this.disconnect();
+				});
+		});
+		socket.addEventListener('message', (event: MessageEvent<string>) => this.handleMessage(JSON.parse(event.data) as LiveTelemetryMessage));
+		socket.addEventListener('close', () => {
+			this.socket = null;
+			this.subscribed = false;
+			this.rejectPending(new Error('Connection closed'));
+			if (!this.closed) {
+				this.reconnectTimer = window.setTimeout(() => this.connect(), 5_000);
+			}
+		});
+		this.socket = socket;
+	}
+
+	/**
+	 * Disconnects from the live telemetry stream
+	 */
+	public disconnect(): void {
+		this.closed = true;
+		if (this.reconnectTimer !== null) {
+			window.clearTimeout(this.reconnectTimer);
+			this.reconnectTimer = null;
+		}
+		this.socket?.close();
+		this.socket = null;
+		this.subscribed = false;
+	}
+
+	/**
+	 * Is the live telemetry stream connected and subscribed?
+	 * @return {boolean} Connection state
+	 */
+	public isConnected(): boolean {
+		return this.subscribed && this.socket?.readyState === WebSocket.OPEN;
+	}
+
+	/**
+	 * Switches output
+	 * @param {number} index Output index
+	 * @param {boolean} state Output state
+	 */
+	public async switch(index: number, state: boolean): Promise<void> {
+		await this.request({ type: 'switch', output: index, state: state });
+	}
+
+	/**
+	 * Sends the credentials of the signed in user
+	 */
+	private async authenticate(): Promise<void> {
+		const { credentials } = storeToRefs(useUserStore());
+		if (credentials.value === null) {
+			throw new Error('User is not signed in');
+		}
+		const authorization = `Basic ${btoa(`${credentials.value.username}:${credentials.value.password}`)}`;
+		await this.request({ type: 'auth', authorization: authorization });
+	}
+
+	/**
+	 * Sends the request and waits for the response
+	 * @param {Record<string, unknown>} message Request message
+	 */
+	private request(message: Record<string, unknown>): Promise<void> {
+		return new Promise((resolve, reject) => {
+			if (this.socket === null || this.socket.readyState !== WebSocket.OPEN) {
+				reject(new Error('Not connected'));
+				return;
+			}
+			const id = this.nextId++;
+			this.pending.set(id, { resolve: resolve, reject: reject });
+			this.socket.send(JSON.stringify({ ...message, id: id }));
+		});
+	}
+
+	/**
+	 * Handles the received message
+	 * @param {LiveTelemetryMessage} message Received message
+	 */
+	private handleMessage(message: LiveTelemetryMessage): void {
+		if (message.type === 'outputs') {
+			this.onUpdate(message.outputs ?? []);
+			return;
+		}
+		if (message.id === undefined) {
+			return;
+		}
+		const request = this.pending.get(message.id);
+		this.pending.delete(message.id);
+		if (message.type === 'error') {
+			request?.reject(new Error(message.message));
+		} else {
+			request?.resolve();
+		}
+	}
+
+	/**
+	 * Rejects all pending requests
+	 * @param {Error} error Error
+	 */
+	private rejectPending(error: Error): void {
+		for (const request of this.pending.values()) {
+			request.reject(error);
+		}
+		this.pending.clear();
+	}
+
+}
@@ -32,6 +32,8 @@ export interface MqttConfig {
 	username: string;
 	/// MQTT broker password
 	password: string;
+	/// MQTT protocol version (4 = MQTT 3.1.1, 5 = MQTT 5)
+	protocol?: number;
 }
 
 /**
@@ -26,3 +26,29 @@ export interface Output {
 	/// Voltage in V
 	voltage: number;
 }
+
+/**
+ * Live output update `[index, flags, current in mA, voltage in V]`
+ */
+export type OutputUpdate = [number, number, number, number];
+
+/**
+ * Live telemetry WebSocket message
+ */
+export interface LiveTelemetryMessage {
+	/// Message type
+	type: 'auth' | 'error' | 'outputs' | 'subscribe' | 'switch' | 'unsubscribe';
+	/// Request ID
+	id?: number;
+	/// Error message
+	message?: string;
+	/// Changed outputs
+	outputs?: OutputUpdate[];
+	/// Unix timestamp in milliseconds
+	timestamp?: number;
+}
+
+/// Output is enabled flag
+export const OUTPUT_FLAG_ENABLED = 1;
+/// Output is in alert state flag
+export const OUTPUT_FLAG_ALERT = 2;
@@ -14,14 +14,17 @@
  * limitations under the License.
  */
 import child_process from 'node:child_process';
+import crypto from 'node:crypto';
+import fs from 'node:fs';
 import path from 'node:path';
 import { fileURLToPath, URL } from 'node:url';
+import zlib from 'node:zlib';
 
 import VueI18nPlugin from '@intlify/unplugin-vue-i18n/vite';
 import { sentryVitePlugin } from '@sentry/vite-plugin';
 import UnheadVite from '@unhead/addons/vite';
 import vue from '@vitejs/plugin-vue';
-import { defineConfig, loadEnv } from 'vite';
+import { defineConfig, loadEnv, type Plugin } from 'vite';
 import { viteSingleFile } from 'vite-plugin-singlefile';
 import VueDevTools from 'vite-plugin-vue-devtools';
 import vuetify, { transformAssetUrls } from 'vite-plugin-vuetify';
@@ -30,6 +33,152 @@ import svgLoader from 'vite-svg-loader';
 // Git commit hash
 const gitCommitHash = child_process.execSync('git rev-parse --short HEAD').toString().trim();
 
+/**
+ * Stores gzip and brotli variants of compressible assets next to the originals, the firmware serves them according to Accept-Encoding
+ * @param {string} outDir Output directory
+ * @return {Plugin} Vite plugin
+ */
+function precompress(outDir: string): Plugin {
+	const compressible = /\.(css|html|ico|js|json|svg|txt|webmanifest)$/;
+	const compress = (dir: string): void => {
+		for (const entry of fs.readdirSync(dir, { withFileTypes: true })) {
+			const file = path.join(dir, entry.name);
+			if (entry.isDirectory()) {
+				compress(file);
+				continue;
+			}
+			if (!compressible.test(entry.name)) {
+				continue;
+			}
+			const content = fs.readFileSync(file);
+			const variants: Record<string, Buffer> = {
+				'.br': zlib.brotliCompressSync(content, {
+					params: {
+						[zlib.constants.BROTLI_PARAM_MODE]: zlib.constants.BROTLI_MODE_TEXT,
+						[zlib.constants.BROTLI_PARAM_QUALITY]: zlib.constants.BROTLI_MAX_QUALITY,
+						[zlib.constants.BROTLI_PARAM_SIZE_HINT]: content.length,
+					},
+				}),
+				'.gz': zlib.gzipSync(content, { level: zlib.constants.Z_BEST_COMPRESSION }),
+			};
+			for (const [extension, variant] of Object.entries(variants)) {
+				// Variants which do not save space would only waste the SPIFFS partition
+				if (variant.length < content.length) {
+					fs.writeFileSync(file + extension, variant);
+				}
+			}
+		}
+	};
+	return {
+		name: 'precompress',
+		apply: 'build',
+		closeBundle: {
+			sequential: true,
+			handler: () => compress(outDir),
+		},
+	};
+}
+
+/**
+ * Packs the built assets into a read-only asset pack served by the firmware from the memory-mapped `assets` partition
+ *
+ * All numbers are little-endian, offsets are relative to the beginning of the pack:
+ * - header: magic `SPAK`, version (u16), number of entries (u16), pack size (u32),
+ * - entries sorted by path: path, content type (u32 string offsets) and identity, brotli and gzip variants (u32 offset, u32 length, u32 entity tag string offset), absent variants have zero length,
+ * - NUL-terminated strings,
+ * - variant data aligned to 4 bytes.
+ * @param {string} outDir Output directory with the built assets and their pre-compressed variants
+ * @param {string} packFile Asset pack file
+ * @return {Plugin} Vite plugin
+ */
+function assetPack(outDir: string, packFile: string): Plugin {
+	const contentTypes: Record<string, string> = {
+		'.css': 'text/css',
+		'.html': 'text/html',
+		'.ico': 'image/x-icon',
+		'.js': 'application/javascript',
+		'.json': 'application/json',
+		'.png': 'image/png',
+		'.svg': 'image/svg+xml',
+		'.webmanifest': 'application/manifest+json',
+	};
+	const variantExtensions = ['', '.br', '.gz'];
+	const headerSize = 12;
+	const entrySize = 44;
+	const listFiles = (dir: string): string[] => fs.readdirSync(dir, { withFileTypes: true }).flatMap((entry) => {
+		const file = path.join(dir, entry.name);
+		return entry.isDirectory() ? listFiles(file) : [file];
+	});
+	const pack = (): void => {
+		const files = listFiles(outDir)
+			.filter((file: string): boolean => !/\.(br|gz)$/.test(file))
+			.map((file: string): string => '/' + path.relative(outDir, file).split(path.sep).join('/'))
+			.sort((a: string, b: string): number => Buffer.compare(Buffer.from(a), Buffer.from(b)));
+		const strings: Buffer[] = [];
+		const stringOffsets = new Map<string, number>();
+		let stringsSize = 0;
+		const addString = (value: string): number => {
+			if (!stringOffsets.has(value)) {
+				const buffer = Buffer.from(value + '\0');
+				stringOffsets.set(value, stringsSize);
+				strings.push(buffer);
+				stringsSize += buffer.length;
+			}
+			return stringOffsets.get(value)!;
+		};
+		const entries = files.map((file: string) => ({
+			path: addString(file),
+			contentType: addString(contentTypes[path.extname(file).toLowerCase()] ?? 'text/plain'),
+			variants: variantExtensions.map((extension: string) => {
+				const variantFile = path.join(outDir, file + extension);
+				if (!fs.existsSync(variantFile)) {
+					return null;
+				}
+				const data = fs.readFileSync(variantFile);
+				const entityTag = '"' + crypto.createHash('sha256').update(data).digest('hex').slice(0, 32) + '"';
+				return { data, entityTag: addString(entityTag) };
+			}),
+		}));
+		const stringsOffset = headerSize + entries.length * entrySize;
+		let dataOffset = (stringsOffset + stringsSize + 3) & ~3;
+		const index = Buffer.alloc(entries.length * entrySize);
+		const blobs: Buffer[] = [];
+		entries.forEach((entry, i: number): void => {
+			const offset = i * entrySize;
+			index.writeUInt32LE(stringsOffset + entry.path, offset);
+			index.writeUInt32LE(stringsOffset + entry.contentType, offset + 4);
+			entry.variants.forEach((variant, j: number): void => {
+				if (variant === null) {
+					return;
+				}
+				const padding = Buffer.alloc((4 - variant.data.length % 4) % 4);
+				index.writeUInt32LE(dataOffset, offset + 8 + j * 12);
+				index.writeUInt32LE(variant.data.length, offset + 12 + j * 12);
+				index.writeUInt32LE(stringsOffset + variant.entityTag, offset + 16 + j * 12);
+				blobs.push(variant.data, padding);
+				dataOffset += variant.data.length + padding.length;
+			});
+		});
+		const header = Buffer.alloc(headerSize);
+		header.write('SPAK', 0, 'ascii');
+		header.writeUInt16LE(1, 4);
+		header.writeUInt16LE(entries.length, 6);
+		header.writeUInt32LE(dataOffset, 8);
+		const stringsPadding = Buffer.alloc(((stringsOffset + stringsSize + 3) & ~3) - stringsOffset - stringsSize);
+		fs.mkdirSync(path.dirname(packFile), { recursive: true });
+		fs.writeFileSync(packFile, Buffer.concat([header, index, ...strings, stringsPadding, ...blobs]));
+	};
+	return {
+		name: 'asset-pack',
+		apply: 'build',
+		closeBundle: {
+			sequential: true,
+			order: 'post',
+			handler: pack,
+		},
+	};
+}
+
 // https://vitejs.dev/config/
 export default defineConfig(({ command, mode }) => {
 	const env = loadEnv(mode, process.cwd(), '');
@@ -67,6 +216,8 @@ export default defineConfig(({ command, mode }) => {
 				viteSingleFile({
 					removeViteModuleLoader: true,
 				}),
+				precompress(path.resolve(__dirname, 'dist')),
+				assetPack(path.resolve(__dirname, 'dist'), path.resolve(__dirname, 'dist-pack/assets.pack')),
 			] : [],
 		],
 		define: {